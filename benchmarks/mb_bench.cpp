@@ -0,0 +1,509 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+// Microbenchmarks of the library hot paths.
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "db.h"
+#include "dict.h"
+#include "dict_mem.h"
+#include "drm_base.h"
+#include "free_list.h"
+#include "lock_free.h"
+#include "rollable_file.h"
+#include "integer_4b_5b.h"
+#include "resource_pool.h"
+#include "mabain_consts.h"
+#include "error.h"
+#include "mb_bench.h"
+
+using namespace mabain;
+
+#define BENCH_ONE_MEGA          (1024*1024)
+#define BENCH_FILE_SIZE         (16*BENCH_ONE_MEGA)
+#define BENCH_FILE_BLOCK_SIZE   (4*BENCH_ONE_MEGA)
+#define BENCH_READ_SIZE         64
+#define BENCH_NUM_OFFSET        4096
+#define BENCH_NUM_FREE_BUFFER   128
+
+static int bench_cpu = -1;
+
+static void usage(const char *prog)
+{
+    std::cout << "Usage: " << prog << " [-d bench-directory] [-n num-keys] [-r repeats] [-f filter] [-c cpu] [-j]\n";
+    std::cout <<"\t-d directory for the benchmark files and log, default /var/tmp/mabain_bench/\n";
+    std::cout <<"\t-n number of keys in the index benchmarks, default 100000\n";
+    std::cout <<"\t-r number of timed repeats per benchmark, default 5\n";
+    std::cout <<"\t-f only run benchmarks whose name contains the filter\n";
+    std::cout <<"\t-c pin the benchmark thread to the cpu\n";
+    std::cout <<"\t-j write results in JSON\n";
+    std::cout <<"Benchmarks are not meant to be run while other mabain processes are running.\n";
+    exit(1);
+}
+
+static void remove_bench_files(const std::string &bench_dir)
+{
+    ResourcePool::getInstance().RemoveAll();
+    std::string cmd = std::string("rm -rf ") + bench_dir + "_*";
+    if(system(cmd.c_str()) != 0) {
+    }
+}
+
+// Deterministic pseudo random numbers so that every run is identical.
+static inline uint64_t bench_rand(uint64_t &state)
+{
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+}
+
+static void set_cpu_affinity(int cpu, bool exclude)
+{
+    if(cpu < 0)
+        return;
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if(exclude)
+    {
+        long num_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+        if(num_cpu <= 1)
+            return;
+        for(int i = 0; i < num_cpu; i++)
+        {
+            if(i != cpu)
+                CPU_SET(i, &cpu_set);
+        }
+    }
+    else
+    {
+        CPU_SET(cpu, &cpu_set);
+    }
+    if(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) != 0)
+        std::cerr << "failed to set cpu affinity\n";
+}
+
+//////////////////////////////////////////////////
+// Index traversal
+//////////////////////////////////////////////////
+
+// Reader path of Dict::Find without the edge string comparisons
+static int walk_next_edge(DictMem *mm, const std::string &key, MBData &mbd)
+{
+    EdgePtrs &edge_ptrs = mbd.edge_ptrs;
+    const uint8_t *p = reinterpret_cast<const uint8_t*>(key.data());
+    int len = static_cast<int>(key.length());
+    if(mm->GetRootEdge(0, p[0], edge_ptrs) != MBError::SUCCESS)
+        return 0;
+
+    int hops = 1;
+    int edge_len = edge_ptrs.len_ptr[0];
+    while(edge_len > 0 && edge_len < len && !(edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF))
+    {
+        p += edge_len;
+        len -= edge_len;
+        if(mm->NextEdge(p, edge_ptrs, mbd.node_buff, mbd) != MBError::SUCCESS)
+            break;
+        hops++;
+        edge_len = edge_ptrs.len_ptr[0];
+    }
+    return hops;
+}
+
+// Writer path of Dict::Add before the index is updated
+static int walk_find_next(DictMem *mm, const std::string &key, EdgePtrs &edge_ptrs,
+                          uint8_t *tmp_buff)
+{
+    const uint8_t *p = reinterpret_cast<const uint8_t*>(key.data());
+    int len = static_cast<int>(key.length());
+    if(mm->GetRootEdge_Writer(false, p[0], edge_ptrs) != MBError::SUCCESS)
+        return 0;
+
+    int hops = 1;
+    int edge_len = edge_ptrs.len_ptr[0];
+    if(edge_len == 0 || edge_len >= len)
+        return hops;
+    p += edge_len;
+    len -= edge_len;
+    int match_len;
+    while(mm->FindNext(p, len, match_len, edge_ptrs, tmp_buff))
+    {
+        hops++;
+        if(match_len < edge_ptrs.len_ptr[0])
+            break;
+        p += match_len;
+        len -= match_len;
+        if(len <= 0)
+            break;
+    }
+    return hops;
+}
+
+// The benchmarks are named with the prefix so that the index formats can
+// be compared.
+static void bench_index(BenchRunner &runner, const std::string &bench_dir, int num_key,
+                        const std::string &prefix, int options)
+{
+    if(!runner.Enabled(prefix))
+        return;
+
+    MBConfig mbconf;
+    memset(&mbconf, 0, sizeof(mbconf));
+    mbconf.mbdir = bench_dir.c_str();
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | options;
+    mbconf.memcap_index = 256LL*BENCH_ONE_MEGA;
+    mbconf.memcap_data = 256LL*BENCH_ONE_MEGA;
+    DB db(mbconf);
+    if(!db.is_open())
+    {
+        std::cerr << "failed to open db: " << db.StatusStr() << "\n";
+        return;
+    }
+
+    std::vector<std::string> keys;
+    uint64_t state = 1;
+    for(int i = 0; i < num_key; i++)
+    {
+        keys.push_back("bench_" + std::to_string(bench_rand(state)));
+        db.Add(keys.back(), keys.back());
+    }
+    // Look up keys in a different order than they were added.
+    std::vector<std::string> lookup_keys;
+    for(int i = 0; i < num_key; i++)
+        lookup_keys.push_back(keys[bench_rand(state) % num_key]);
+
+    DictMem *mm = db.GetDictPtr()->GetMM();
+    int64_t hops = 0;
+    runner.Run(prefix + "next_edge", num_key, [&](int64_t n) {
+        MBData mbd;
+        hops = 0;
+        for(int64_t i = 0; i < n; i++)
+            hops += walk_next_edge(mm, lookup_keys[i % num_key], mbd);
+    });
+    runner.AddCounter(prefix + "next_edge", "hops_per_op",
+                      static_cast<double>(hops) / num_key);
+
+    runner.Run(prefix + "find_next", num_key, [&](int64_t n) {
+        EdgePtrs edge_ptrs;
+        uint8_t tmp_buff[NUM_ALPHABET];
+        hops = 0;
+        for(int64_t i = 0; i < n; i++)
+            hops += walk_find_next(mm, lookup_keys[i % num_key], edge_ptrs, tmp_buff);
+    });
+    runner.AddCounter(prefix + "find_next", "hops_per_op",
+                      static_cast<double>(hops) / num_key);
+
+    db.Close();
+    remove_bench_files(bench_dir);
+}
+
+//////////////////////////////////////////////////
+// Lock-free reader check
+//////////////////////////////////////////////////
+
+typedef struct _LockFreeWriterContext
+{
+    LockFree *lfree;
+    std::atomic<bool> stop;
+} LockFreeWriterContext;
+
+static void* lock_free_writer(void *arg)
+{
+    LockFreeWriterContext *context = static_cast<LockFreeWriterContext*>(arg);
+    set_cpu_affinity(bench_cpu, true);
+    int64_t num_update = 0;
+    while(!context->stop.load(std::memory_order_relaxed))
+    {
+        context->lfree->WriterLockFreeStart(static_cast<size_t>(num_update % 1024) * EDGE_SIZE);
+        context->lfree->WriterLockFreeStop();
+        num_update++;
+    }
+    return NULL;
+}
+
+static void bench_lock_free(BenchRunner &runner)
+{
+    if(!runner.Enabled("lock_free_"))
+        return;
+
+    // The shared memory structures are normally in the DB header.
+    IndexHeader *header = static_cast<IndexHeader*>(calloc(1, sizeof(IndexHeader)));
+    LockFreeShmData *shm_data = static_cast<LockFreeShmData*>(calloc(1, sizeof(LockFreeShmData)));
+    LockFree lfree_writer;
+    LockFree lfree_reader;
+    lfree_writer.LockFreeInit(shm_data, header, CONSTS::ACCESS_MODE_WRITER);
+    lfree_reader.LockFreeInit(shm_data, header, CONSTS::ACCESS_MODE_READER);
+
+    int64_t num_op = 1000000;
+    int64_t num_retry = 0;
+    auto reader_check = [&](int64_t n) {
+        MBData mbd;
+        LockFreeData snapshot;
+        num_retry = 0;
+        for(int64_t i = 0; i < n; i++)
+        {
+            lfree_reader.ReaderLockFreeStart(snapshot);
+            size_t reader_offset = static_cast<size_t>(i % 1024) * EDGE_SIZE;
+            if(lfree_reader.ReaderLockFreeStop(snapshot, reader_offset, mbd) != MBError::SUCCESS)
+                num_retry++;
+        }
+    };
+
+    runner.Run("lock_free_reader_stop", num_op, reader_check);
+
+    LockFreeWriterContext context;
+    context.lfree = &lfree_writer;
+    context.stop.store(false, std::memory_order_relaxed);
+    pthread_t tid;
+    if(pthread_create(&tid, NULL, lock_free_writer, &context) != 0)
+    {
+        std::cerr << "failed to start lock-free writer thread\n";
+    }
+    else
+    {
+        runner.Run("lock_free_reader_stop_contended", num_op, reader_check);
+        runner.AddCounter("lock_free_reader_stop_contended", "retry_ratio",
+                          static_cast<double>(num_retry) / num_op);
+        context.stop.store(true, std::memory_order_relaxed);
+        pthread_join(tid, NULL);
+    }
+
+    free(shm_data);
+    free(header);
+}
+
+//////////////////////////////////////////////////
+// Free list
+//////////////////////////////////////////////////
+
+static void bench_free_list(BenchRunner &runner, const std::string &bench_dir)
+{
+    if(!runner.Enabled("free_list_"))
+        return;
+
+    FreeList free_list(bench_dir + "_bench_fl", DATA_BUFFER_ALIGNMENT, 0xFFFF);
+    int sizes[BENCH_NUM_FREE_BUFFER];
+    uint64_t state = 1;
+    for(int i = 0; i < BENCH_NUM_FREE_BUFFER; i++)
+        sizes[i] = 16 + static_cast<int>(bench_rand(state) % 1024);
+
+    // Every operation frees a buffer and reserves it again later.
+    runner.Run("free_list_add_remove", 1000000, [&](int64_t n) {
+        size_t offset = 0;
+        for(int64_t i = 0; i < n; i += BENCH_NUM_FREE_BUFFER)
+        {
+            for(int k = 0; k < BENCH_NUM_FREE_BUFFER; k++)
+                free_list.AddBuffer(static_cast<size_t>(k) * 4096, sizes[k]);
+            for(int k = 0; k < BENCH_NUM_FREE_BUFFER; k++)
+                free_list.RemoveBuffer(offset, sizes[k]);
+        }
+        BenchKeep(offset);
+    });
+    remove_bench_files(bench_dir);
+}
+
+//////////////////////////////////////////////////
+// Rollable file reads
+//////////////////////////////////////////////////
+
+static void bench_rollable_file(BenchRunner &runner, const std::string &bench_dir)
+{
+    if(!runner.Enabled("rollable_file_"))
+        return;
+
+    std::vector<uint8_t> chunk(BENCH_ONE_MEGA / 16, 'r');
+    std::vector<off_t> offsets;
+    uint64_t state = 1;
+    for(int i = 0; i < BENCH_NUM_OFFSET; i++)
+        offsets.push_back(bench_rand(state) % (BENCH_FILE_SIZE - BENCH_READ_SIZE));
+
+    const char *names[] = {"rollable_file_read_mapped", "rollable_file_read_unmapped"};
+    const char *paths[] = {"_bench_mapped", "_bench_unmapped"};
+    size_t memcaps[] = {BENCH_FILE_SIZE, 0};
+    for(int f = 0; f < 2; f++)
+    {
+        RollableFile rfile(bench_dir + paths[f], BENCH_FILE_BLOCK_SIZE, memcaps[f],
+                           CONSTS::ACCESS_MODE_WRITER, 0);
+        for(size_t off = 0; off < BENCH_FILE_SIZE; off += chunk.size())
+        {
+            size_t offset = off;
+            uint8_t *ptr;
+            if(rfile.Reserve(offset, chunk.size(), ptr) != MBError::SUCCESS ||
+               rfile.RandomWrite(chunk.data(), chunk.size(), offset) != chunk.size())
+            {
+                std::cerr << "failed to write " << bench_dir + paths[f] << "\n";
+                break;
+            }
+        }
+
+        runner.Run(names[f], 1000000, [&](int64_t n) {
+            uint8_t buff[BENCH_READ_SIZE];
+            size_t bytes = 0;
+            for(int64_t i = 0; i < n; i++)
+                bytes += rfile.RandomRead(buff, BENCH_READ_SIZE, offsets[i % BENCH_NUM_OFFSET]);
+            BenchKeep(bytes);
+        });
+    }
+    remove_bench_files(bench_dir);
+}
+
+//////////////////////////////////////////////////
+// 6-byte offsets
+//////////////////////////////////////////////////
+
+static void bench_6b_integer(BenchRunner &runner)
+{
+    std::vector<uint8_t> buffer(BENCH_NUM_OFFSET * OFFSET_SIZE);
+
+    runner.Run("write_6b_integer", 10000000, [&](int64_t n) {
+        for(int64_t i = 0; i < n; i++)
+            Write6BInteger(&buffer[(i % BENCH_NUM_OFFSET) * OFFSET_SIZE],
+                           static_cast<size_t>(i) & MAX_6B_OFFSET);
+        BenchKeep(buffer[0]);
+    });
+
+    runner.Run("get_6b_integer", 10000000, [&](int64_t n) {
+        size_t sum = 0;
+        for(int64_t i = 0; i < n; i++)
+            sum += Get6BInteger(&buffer[(i % BENCH_NUM_OFFSET) * OFFSET_SIZE]);
+        BenchKeep(sum);
+    });
+}
+
+//////////////////////////////////////////////////
+// MBData
+//////////////////////////////////////////////////
+
+static void bench_mbdata(BenchRunner &runner)
+{
+    const int sizes[] = {32, 256, 1024, 4096};
+
+    // A new MBData for every lookup
+    runner.Run("mbdata_construct", 1000000, [&](int64_t n) {
+        for(int64_t i = 0; i < n; i++)
+        {
+            MBData mbd(sizes[i & 3], CONSTS::OPTION_FIND_AND_STORE_PARENT);
+            BenchKeep(mbd.buff);
+        }
+    });
+
+    // One MBData reused by all lookups
+    runner.Run("mbdata_reuse", 1000000, [&](int64_t n) {
+        MBData mbd;
+        for(int64_t i = 0; i < n; i++)
+        {
+            mbd.Clear();
+            mbd.Resize(sizes[i & 3]);
+            BenchKeep(mbd.buff);
+        }
+    });
+}
+
+int main(int argc, char *argv[])
+{
+    std::string bench_dir = "/var/tmp/mabain_bench/";
+    std::string filter;
+    int num_key = 100000;
+    int repeats = 5;
+    bool json = false;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-d") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            bench_dir = argv[i];
+            if(bench_dir.back() != '/')
+                bench_dir += "/";
+        }
+        else if(strcmp(argv[i], "-n") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            num_key = atoi(argv[i]);
+        }
+        else if(strcmp(argv[i], "-r") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            repeats = atoi(argv[i]);
+        }
+        else if(strcmp(argv[i], "-f") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            filter = argv[i];
+        }
+        else if(strcmp(argv[i], "-c") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            bench_cpu = atoi(argv[i]);
+        }
+        else if(strcmp(argv[i], "-j") == 0)
+        {
+            json = true;
+        }
+        else
+        {
+            usage(argv[0]);
+        }
+    }
+    if(num_key <= 0)
+        usage(argv[0]);
+
+    std::string cmd = std::string("mkdir -p ") + bench_dir;
+    if(system(cmd.c_str()) != 0) {
+    }
+    remove_bench_files(bench_dir);
+    // Keep the stats printed by writer out of the results.
+    DB::SetLogFile(bench_dir + "mb_bench.log");
+    set_cpu_affinity(bench_cpu, false);
+
+    BenchRunner runner(repeats, filter);
+    try {
+        bench_index(runner, bench_dir, num_key, "dict_mem_", 0);
+        bench_index(runner, bench_dir, num_key, "dict_mem_aligned_", CONSTS::ALIGNED_INDEX);
+        bench_index(runner, bench_dir, num_key, "dict_mem_compact_", CONSTS::COMPACT_INDEX);
+        bench_lock_free(runner);
+        bench_free_list(runner, bench_dir);
+        bench_rollable_file(runner, bench_dir);
+        bench_6b_integer(runner);
+        bench_mbdata(runner);
+    } catch (int error) {
+        std::cerr << "benchmark failed: " << MBError::get_error_str(error) << "\n";
+        remove_bench_files(bench_dir);
+        DB::CloseLogFile();
+        return 1;
+    }
+    DB::CloseLogFile();
+
+    if(json)
+        runner.WriteJSON(std::cout);
+    else
+        runner.WriteText(std::cout);
+    return 0;
+}
@@ -0,0 +1,231 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __MB_BENCH_H__
+#define __MB_BENCH_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mabain {
+
+// Keep the compiler from optimizing away a value computed by a benchmark.
+template <typename T>
+inline void BenchKeep(const T &value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Log-bucketed latency histogram. Each power of two is divided into
+// 1 << BENCH_HIST_SUB_BITS buckets so that percentiles are reported within
+// about 12%. It is plain data so that it can be kept in shared memory
+// and merged across processes.
+#define BENCH_HIST_SUB_BITS      3
+#define BENCH_HIST_NUM_BUCKETS   (64 << BENCH_HIST_SUB_BITS)
+
+typedef struct _BenchHistogram
+{
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t buckets[BENCH_HIST_NUM_BUCKETS];
+} BenchHistogram;
+
+inline int BenchHistBucket(uint64_t ns)
+{
+    if(ns < (1ULL << BENCH_HIST_SUB_BITS))
+        return static_cast<int>(ns);
+    int msb = 63 - __builtin_clzll(ns);
+    int shift = msb - BENCH_HIST_SUB_BITS;
+    return ((shift + 1) << BENCH_HIST_SUB_BITS) +
+           static_cast<int>((ns >> shift) & ((1ULL << BENCH_HIST_SUB_BITS) - 1));
+}
+
+inline void BenchHistAdd(BenchHistogram &hist, uint64_t ns)
+{
+    hist.count++;
+    hist.total_ns += ns;
+    if(ns > hist.max_ns)
+        hist.max_ns = ns;
+    hist.buckets[BenchHistBucket(ns)]++;
+}
+
+inline void BenchHistMerge(BenchHistogram &dst, const BenchHistogram &src)
+{
+    dst.count += src.count;
+    dst.total_ns += src.total_ns;
+    if(src.max_ns > dst.max_ns)
+        dst.max_ns = src.max_ns;
+    for(int i = 0; i < BENCH_HIST_NUM_BUCKETS; i++)
+        dst.buckets[i] += src.buckets[i];
+}
+
+// Returns the upper bound of the bucket holding the q-th quantile.
+inline uint64_t BenchHistPercentile(const BenchHistogram &hist, double q)
+{
+    if(hist.count == 0)
+        return 0;
+    uint64_t rank = static_cast<uint64_t>(q * hist.count);
+    if(rank >= hist.count)
+        rank = hist.count - 1;
+    uint64_t seen = 0;
+    for(int i = 0; i < BENCH_HIST_NUM_BUCKETS; i++)
+    {
+        seen += hist.buckets[i];
+        if(seen <= rank)
+            continue;
+        if(i < (1 << BENCH_HIST_SUB_BITS))
+            return static_cast<uint64_t>(i);
+        int shift = (i >> BENCH_HIST_SUB_BITS) - 1;
+        uint64_t sub = static_cast<uint64_t>(i & ((1 << BENCH_HIST_SUB_BITS) - 1));
+        uint64_t upper = (((1ULL << BENCH_HIST_SUB_BITS) + sub + 1) << shift) - 1;
+        return upper < hist.max_ns ? upper : hist.max_ns;
+    }
+    return hist.max_ns;
+}
+
+typedef struct _BenchResult
+{
+    std::string name;
+    int64_t iterations;
+    // nanoseconds per operation over the timed repeats
+    double min_ns;
+    double median_ns;
+    double max_ns;
+    std::vector<std::pair<std::string, double>> counters;
+} BenchResult;
+
+// Minimal harness for the microbenchmarks. Every benchmark is run once
+// untimed to warm up caches and mappings and then run a fixed number of
+// times. The median is reported together with the min and max so that
+// noisy results can be recognized.
+class BenchRunner
+{
+public:
+    BenchRunner(int num_repeat, const std::string &name_filter)
+               : repeats(num_repeat < 1 ? 1 : num_repeat),
+                 filter(name_filter)
+    {
+    }
+
+    bool Enabled(const std::string &name) const
+    {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    }
+
+    // func(iterations) must run the operation iterations times.
+    template <typename F>
+    void Run(const std::string &name, int64_t iterations, F func)
+    {
+        if(!Enabled(name))
+            return;
+
+        func(iterations);
+        std::vector<double> samples;
+        for(int i = 0; i < repeats; i++)
+        {
+            uint64_t start = Now();
+            func(iterations);
+            samples.push_back(static_cast<double>(Now() - start) / iterations);
+        }
+        std::sort(samples.begin(), samples.end());
+
+        BenchResult result;
+        result.name = name;
+        result.iterations = iterations;
+        result.min_ns = samples.front();
+        result.median_ns = samples[samples.size() / 2];
+        result.max_ns = samples.back();
+        results.push_back(result);
+    }
+
+    // Attach a counter to the last benchmark that was run.
+    void AddCounter(const std::string &name, const std::string &counter, double value)
+    {
+        if(results.empty() || results.back().name != name)
+            return;
+        results.back().counters.push_back(std::make_pair(counter, value));
+    }
+
+    void WriteText(std::ostream &out_stream) const
+    {
+        char line[256];
+        snprintf(line, sizeof(line), "%-36s %12s %12s %12s %12s\n",
+                 "benchmark", "iterations", "ns/op", "min", "max");
+        out_stream << line;
+        for(const BenchResult &result : results)
+        {
+            snprintf(line, sizeof(line), "%-36s %12lld %12.2f %12.2f %12.2f",
+                     result.name.c_str(), static_cast<long long>(result.iterations),
+                     result.median_ns, result.min_ns, result.max_ns);
+            out_stream << line;
+            for(const auto &counter : result.counters)
+                out_stream << "  " << counter.first << "=" << counter.second;
+            out_stream << "\n";
+        }
+    }
+
+    void WriteJSON(std::ostream &out_stream) const
+    {
+        out_stream << "{\n";
+        out_stream << "  \"repeats\": " << repeats << ",\n";
+        out_stream << "  \"benchmarks\": [";
+        for(size_t i = 0; i < results.size(); i++)
+        {
+            const BenchResult &result = results[i];
+            out_stream << (i == 0 ? "\n" : ",\n");
+            out_stream << "    {\"name\": \"" << result.name << "\""
+                       << ", \"iterations\": " << result.iterations
+                       << ", \"ns_per_op\": " << result.median_ns
+                       << ", \"min_ns_per_op\": " << result.min_ns
+                       << ", \"max_ns_per_op\": " << result.max_ns
+                       << ", \"ops_per_sec\": "
+                       << (result.median_ns > 0 ? 1e9 / result.median_ns : 0)
+                       << ", \"counters\": {";
+            for(size_t k = 0; k < result.counters.size(); k++)
+            {
+                out_stream << (k == 0 ? "" : ", ") << "\"" << result.counters[k].first
+                           << "\": " << result.counters[k].second;
+            }
+            out_stream << "}}";
+        }
+        out_stream << "\n  ]\n}\n";
+    }
+
+    static inline uint64_t Now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    }
+
+private:
+    int repeats;
+    std::string filter;
+    std::vector<BenchResult> results;
+};
+
+}
+
+#endif
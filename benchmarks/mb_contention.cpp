@@ -0,0 +1,569 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+// Reader/writer contention benchmark. One writer process inserts keys at
+// a controlled rate while a number of reader processes look up keys that
+// were populated before the run. For every write rate the benchmark
+// reports the reader throughput and latency, how often readers had to
+// retry lookups that raced with the writer (MBError::TRY_AGAIN) and the
+// time they slept before the retries, and the lag between the writer
+// committing a key and readers observing it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <atomic>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "db.h"
+#include "mb_data.h"
+#include "error.h"
+#include "mb_slow_log.h"
+#include "resource_pool.h"
+
+#include "mb_bench.h"
+
+using namespace mabain;
+
+#define CONTENTION_MAX_READER      64
+#define CONTENTION_MAX_WRITE       (1 << 21)
+// Write rate step without throttling
+#define CONTENTION_RATE_MAX        -1
+
+typedef struct _ReaderStats
+{
+    uint64_t lookups;
+    uint64_t not_found;
+    uint64_t retries;
+    uint64_t sleep_ns;
+    uint64_t run_ns;
+    // keys written in this step that the reader observed
+    uint64_t observed;
+    uint64_t early_observed;
+    BenchHistogram latency;
+    BenchHistogram lag;
+} ReaderStats;
+
+// Shared by the benchmark processes of one write rate step
+typedef struct _ContentionShm
+{
+    std::atomic<int> num_ready;
+    std::atomic<int> start;
+    std::atomic<int> stop;
+    // sequence number of the key being written, -1 if none
+    std::atomic<int64_t> writing_seq;
+    int64_t num_write;
+    uint64_t write_ns;
+    ReaderStats readers[CONTENTION_MAX_READER];
+    // time when writer's Add returned
+    std::atomic<uint64_t> commit_ns[CONTENTION_MAX_WRITE];
+    // time when the key was found by a reader the first time
+    std::atomic<uint64_t> first_seen_ns[CONTENTION_MAX_WRITE];
+} ContentionShm;
+
+typedef struct _StepResult
+{
+    int64_t rate;
+    double write_rate;
+    double lookup_rate;
+    uint64_t lookups;
+    uint64_t not_found;
+    uint64_t retries;
+    uint64_t sleep_ns;
+    double sleep_ratio;
+    BenchHistogram latency;
+    BenchHistogram reader_lag;
+    BenchHistogram first_lag;
+    uint64_t early_observed;
+    double observed_ratio;
+} StepResult;
+
+static std::string bench_dir = "/var/tmp/mabain_contention/";
+static int num_reader = 4;
+static int64_t num_key = 100000;
+static double step_sec = 2.0;
+static size_t memcap = 256*1024*1024LL;
+static ContentionShm *shm = NULL;
+
+static std::string read_key(int64_t i)
+{
+    return "contention-key-" + std::to_string(i);
+}
+
+static std::string write_key(int step, int64_t seq)
+{
+    return "contention-write-" + std::to_string(step) + "-" + std::to_string(seq);
+}
+
+static inline uint64_t bench_rand(uint64_t &state)
+{
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+}
+
+static void populate_db()
+{
+    DB db(bench_dir.c_str(), CONSTS::WriterOptions(), memcap, memcap);
+    if(!db.is_open())
+    {
+        std::cerr << "failed to open db " << bench_dir << ": " << db.StatusStr() << "\n";
+        exit(1);
+    }
+    db.RemoveAll();
+    for(int64_t i = 0; i < num_key; i++)
+    {
+        std::string key = read_key(i);
+        db.Add(key, key);
+    }
+    db.Close();
+    // Do not pass the mappings to the benchmark processes.
+    ResourcePool::getInstance().RemoveAll();
+}
+
+static void wait_for_start()
+{
+    while(!shm->start.load(std::memory_order_acquire))
+        sched_yield();
+}
+
+static void run_writer(int step, int64_t rate)
+{
+    DB db(bench_dir.c_str(), CONSTS::WriterOptions(), memcap, memcap);
+    if(!db.is_open())
+    {
+        std::cerr << "writer failed to open db: " << db.StatusStr() << "\n";
+        _exit(1);
+    }
+
+    while(shm->num_ready.load(std::memory_order_acquire) < num_reader)
+        sched_yield();
+    uint64_t duration_ns = static_cast<uint64_t>(step_sec * 1000000000.0);
+    uint64_t start_ns = BenchRunner::Now();
+    shm->start.store(1, std::memory_order_release);
+
+    int64_t seq = 0;
+    uint64_t now = start_ns;
+    if(rate == 0)
+    {
+        usleep(static_cast<useconds_t>(duration_ns / 1000));
+        now = BenchRunner::Now();
+    }
+    while(rate != 0 && now - start_ns < duration_ns && seq < CONTENTION_MAX_WRITE)
+    {
+        if(rate > 0)
+        {
+            // Pace the writes. Sleep if far ahead of schedule, spin otherwise.
+            uint64_t target_ns = start_ns + static_cast<uint64_t>(seq * 1000000000.0 / rate);
+            while(now < target_ns)
+            {
+                if(target_ns - now > 100000)
+                {
+                    struct timespec ts = {0, static_cast<long>(target_ns - now - 50000)};
+                    nanosleep(&ts, NULL);
+                }
+                now = BenchRunner::Now();
+            }
+        }
+
+        std::string key = write_key(step, seq);
+        shm->writing_seq.store(seq, std::memory_order_release);
+        db.Add(key, key);
+        now = BenchRunner::Now();
+        shm->commit_ns[seq].store(now, std::memory_order_release);
+        seq++;
+    }
+
+    shm->num_write = seq;
+    shm->write_ns = now - start_ns;
+    shm->stop.store(1, std::memory_order_release);
+    db.Close();
+    _exit(0);
+}
+
+static void run_reader(int step, int id)
+{
+    DB db(bench_dir.c_str(), CONSTS::ReaderOptions(), memcap, memcap);
+    if(!db.is_open())
+    {
+        std::cerr << "reader failed to open db: " << db.StatusStr() << "\n";
+        _exit(1);
+    }
+
+    ReaderStats &stats = shm->readers[id];
+    std::vector<std::string> keys;
+    keys.reserve(num_key);
+    for(int64_t i = 0; i < num_key; i++)
+        keys.push_back(read_key(i));
+    std::vector<std::pair<int64_t, uint64_t>> observations;
+    uint64_t rand_state = 0x9e3779b97f4a7c15ULL * (id + 1);
+    int64_t last_seq = -1;
+    MBData mbd;
+
+    shm->num_ready.fetch_add(1, std::memory_order_release);
+    wait_for_start();
+    uint64_t start_ns = BenchRunner::Now();
+    while(!shm->stop.load(std::memory_order_acquire))
+    {
+        const std::string &key = keys[bench_rand(rand_state) % num_key];
+        memset(&mb_op_cost, 0, sizeof(mb_op_cost));
+        uint64_t op_start = BenchRunner::Now();
+        int rval = db.Find(key, mbd);
+        BenchHistAdd(stats.latency, BenchRunner::Now() - op_start);
+        stats.lookups++;
+        if(rval != MBError::SUCCESS)
+            stats.not_found++;
+        stats.retries += mb_op_cost.retries;
+        stats.sleep_ns += mb_op_cost.sleep_ns;
+
+        // Probe the key writer is working on until it shows up.
+        int64_t seq = shm->writing_seq.load(std::memory_order_acquire);
+        if(seq > last_seq && db.Find(write_key(step, seq), mbd) == MBError::SUCCESS)
+        {
+            uint64_t seen_ns = BenchRunner::Now();
+            observations.push_back(std::make_pair(seq, seen_ns));
+            uint64_t first_ns = shm->first_seen_ns[seq].load(std::memory_order_relaxed);
+            while((first_ns == 0 || seen_ns < first_ns) &&
+                  !shm->first_seen_ns[seq].compare_exchange_weak(first_ns, seen_ns))
+                ;
+            last_seq = seq;
+        }
+    }
+    stats.run_ns = BenchRunner::Now() - start_ns;
+
+    // Writer has recorded all commit times once stop is set.
+    for(const auto &obs : observations)
+    {
+        uint64_t commit_ns = shm->commit_ns[obs.first].load(std::memory_order_acquire);
+        if(commit_ns == 0 || obs.second < commit_ns)
+        {
+            // Found before writer's Add returned.
+            stats.early_observed++;
+            BenchHistAdd(stats.lag, 0);
+        }
+        else
+        {
+            BenchHistAdd(stats.lag, obs.second - commit_ns);
+        }
+        stats.observed++;
+    }
+
+    db.Close();
+    _exit(0);
+}
+
+static bool wait_children(const std::vector<pid_t> &pids)
+{
+    bool success = true;
+    for(pid_t pid : pids)
+    {
+        int status;
+        if(waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            success = false;
+    }
+    return success;
+}
+
+static bool run_step(int step, int64_t rate, StepResult &result)
+{
+    // Value-initialized; the atomics make memset unsafe on the struct.
+    new (shm) ContentionShm();
+    shm->writing_seq.store(-1);
+
+    std::vector<pid_t> pids;
+    for(int i = 0; i < num_reader; i++)
+    {
+        pid_t pid = fork();
+        if(pid < 0)
+        {
+            perror("fork");
+            break;
+        }
+        if(pid == 0)
+            run_reader(step, i);
+        pids.push_back(pid);
+    }
+    if(static_cast<int>(pids.size()) != num_reader)
+    {
+        shm->stop.store(1);
+        shm->start.store(1);
+        wait_children(pids);
+        return false;
+    }
+    pid_t pid = fork();
+    if(pid < 0)
+    {
+        perror("fork");
+        shm->stop.store(1);
+        shm->start.store(1);
+        wait_children(pids);
+        return false;
+    }
+    if(pid == 0)
+        run_writer(step, rate);
+    pids.push_back(pid);
+    if(!wait_children(pids))
+        return false;
+
+    memset(&result, 0, sizeof(result));
+    result.rate = rate;
+    uint64_t run_ns = 0;
+    uint64_t observed = 0;
+    for(int i = 0; i < num_reader; i++)
+    {
+        const ReaderStats &stats = shm->readers[i];
+        result.lookups += stats.lookups;
+        result.not_found += stats.not_found;
+        result.retries += stats.retries;
+        result.sleep_ns += stats.sleep_ns;
+        result.early_observed += stats.early_observed;
+        run_ns += stats.run_ns;
+        observed += stats.observed;
+        BenchHistMerge(result.latency, stats.latency);
+        BenchHistMerge(result.reader_lag, stats.lag);
+    }
+    if(run_ns > 0)
+    {
+        result.lookup_rate = result.lookups * 1000000000.0 / (run_ns / num_reader);
+        result.sleep_ratio = static_cast<double>(result.sleep_ns) / run_ns;
+    }
+    if(shm->write_ns > 0)
+        result.write_rate = shm->num_write * 1000000000.0 / shm->write_ns;
+
+    int64_t first_seen = 0;
+    for(int64_t seq = 0; seq < shm->num_write; seq++)
+    {
+        uint64_t seen_ns = shm->first_seen_ns[seq].load();
+        if(seen_ns == 0)
+            continue;
+        uint64_t commit_ns = shm->commit_ns[seq].load();
+        BenchHistAdd(result.first_lag, seen_ns > commit_ns ? seen_ns - commit_ns : 0);
+        first_seen++;
+    }
+    if(shm->num_write > 0)
+        result.observed_ratio = static_cast<double>(first_seen) / shm->num_write;
+    return true;
+}
+
+static std::string rate_str(int64_t rate)
+{
+    return rate == CONTENTION_RATE_MAX ? "max" : std::to_string(rate);
+}
+
+static void write_text(const std::vector<StepResult> &results)
+{
+    char line[512];
+    snprintf(line, sizeof(line), "%-8s %10s %12s %8s %8s %8s %12s %10s %8s %10s %10s %10s %10s\n",
+             "rate", "writes/s", "lookups/s", "p50", "p99", "p999", "retry/1M",
+             "sleep/op", "sleep%", "lag_p50", "lag_p99", "lag_max", "rlag_p99");
+    std::cout << line;
+    for(const StepResult &r : results)
+    {
+        double per_lookup = r.lookups > 0 ? 1.0 / r.lookups : 0;
+        snprintf(line, sizeof(line),
+                 "%-8s %10.0f %12.0f %8llu %8llu %8llu %12.2f %10.2f %8.3f %10llu %10llu %10llu %10llu\n",
+                 rate_str(r.rate).c_str(), r.write_rate, r.lookup_rate,
+                 (unsigned long long) BenchHistPercentile(r.latency, 0.5),
+                 (unsigned long long) BenchHistPercentile(r.latency, 0.99),
+                 (unsigned long long) BenchHistPercentile(r.latency, 0.999),
+                 r.retries * 1000000.0 * per_lookup, r.sleep_ns * per_lookup,
+                 r.sleep_ratio * 100,
+                 (unsigned long long) BenchHistPercentile(r.first_lag, 0.5),
+                 (unsigned long long) BenchHistPercentile(r.first_lag, 0.99),
+                 (unsigned long long) r.first_lag.max_ns,
+                 (unsigned long long) BenchHistPercentile(r.reader_lag, 0.99));
+        std::cout << line;
+    }
+    std::cout << "latencies and lags in ns; lag is measured from writer's Add returning to "
+                 "the first reader finding the key, rlag over all readers\n";
+}
+
+static void write_hist_json(const char *name, const BenchHistogram &hist)
+{
+    std::cout << ", \"" << name << "\": {\"count\": " << hist.count
+              << ", \"mean\": " << (hist.count > 0 ? hist.total_ns / hist.count : 0)
+              << ", \"p50\": " << BenchHistPercentile(hist, 0.5)
+              << ", \"p99\": " << BenchHistPercentile(hist, 0.99)
+              << ", \"p999\": " << BenchHistPercentile(hist, 0.999)
+              << ", \"max\": " << hist.max_ns << "}";
+}
+
+static void write_json(const std::vector<StepResult> &results)
+{
+    std::cout << "{\n";
+    std::cout << "  \"readers\": " << num_reader << ",\n";
+    std::cout << "  \"keys\": " << num_key << ",\n";
+    std::cout << "  \"step_seconds\": " << step_sec << ",\n";
+    std::cout << "  \"steps\": [";
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const StepResult &r = results[i];
+        double per_lookup = r.lookups > 0 ? 1.0 / r.lookups : 0;
+        std::cout << (i == 0 ? "\n" : ",\n");
+        std::cout << "    {\"target_write_rate\": \"" << rate_str(r.rate) << "\""
+                  << ", \"write_rate\": " << r.write_rate
+                  << ", \"lookup_rate\": " << r.lookup_rate
+                  << ", \"lookups\": " << r.lookups
+                  << ", \"not_found\": " << r.not_found
+                  << ", \"try_again\": " << r.retries
+                  << ", \"try_again_per_million\": " << r.retries * 1000000.0 * per_lookup
+                  << ", \"sleep_ns_per_lookup\": " << r.sleep_ns * per_lookup
+                  << ", \"sleep_ratio\": " << r.sleep_ratio
+                  << ", \"observed_ratio\": " << r.observed_ratio
+                  << ", \"early_observed\": " << r.early_observed;
+        write_hist_json("latency_ns", r.latency);
+        write_hist_json("first_lag_ns", r.first_lag);
+        write_hist_json("reader_lag_ns", r.reader_lag);
+        std::cout << "}";
+    }
+    std::cout << "\n  ]\n}\n";
+}
+
+static bool parse_rates(const char *arg, std::vector<int64_t> &rates)
+{
+    std::string rate_list(arg);
+    size_t pos = 0;
+    while(pos <= rate_list.size())
+    {
+        size_t end = rate_list.find(',', pos);
+        if(end == std::string::npos)
+            end = rate_list.size();
+        std::string rate = rate_list.substr(pos, end - pos);
+        if(rate == "max")
+            rates.push_back(CONTENTION_RATE_MAX);
+        else if(!rate.empty() && rate.find_first_not_of("0123456789") == std::string::npos)
+            rates.push_back(atoll(rate.c_str()));
+        else
+            return false;
+        pos = end + 1;
+    }
+    return !rates.empty();
+}
+
+static void usage(const char *prog)
+{
+    std::cout << "Usage: " << prog << " [-d dir] [-t readers] [-n keys] [-w rates] "
+              << "[-s seconds] [-m memcap] [-j]\n";
+    std::cout << "\t-d\tdatabase directory (default " << bench_dir << ")\n";
+    std::cout << "\t-t\tnumber of reader processes (default " << num_reader << ")\n";
+    std::cout << "\t-n\tnumber of keys populated for readers (default " << num_key << ")\n";
+    std::cout << "\t-w\tcomma separated writes per second, max for unthrottled "
+              << "(default 0,1000,10000,100000,max)\n";
+    std::cout << "\t-s\tseconds for each write rate (default " << step_sec << ")\n";
+    std::cout << "\t-m\tindex and data memcap in bytes (default " << memcap << ")\n";
+    std::cout << "\t-j\twrite the results in JSON\n";
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<int64_t> rates;
+    bool json = false;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+        {
+            bench_dir = argv[++i];
+            if(bench_dir.back() != '/')
+                bench_dir += "/";
+        }
+        else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            num_reader = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            num_key = atoll(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+        {
+            if(!parse_rates(argv[++i], rates))
+            {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+        {
+            step_sec = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+        {
+            memcap = static_cast<size_t>(atoll(argv[++i]));
+        }
+        else if(strcmp(argv[i], "-j") == 0)
+        {
+            json = true;
+        }
+        else
+        {
+            usage(argv[0]);
+            return strcmp(argv[i], "-h") == 0 ? 0 : 1;
+        }
+    }
+    if(num_reader < 1 || num_reader > CONTENTION_MAX_READER || num_key < 1 || step_sec <= 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if(rates.empty())
+        rates = {0, 1000, 10000, 100000, CONTENTION_RATE_MAX};
+
+    if(system(("mkdir -p " + bench_dir).c_str()) != 0)
+    {
+        std::cerr << "failed to create " << bench_dir << "\n";
+        return 1;
+    }
+    DB::SetLogFile(bench_dir + "mb_contention.log");
+    populate_db();
+
+    shm = static_cast<ContentionShm *>(mmap(NULL, sizeof(ContentionShm),
+                                            PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    if(shm == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    std::vector<StepResult> results;
+    for(size_t i = 0; i < rates.size(); i++)
+    {
+        StepResult result;
+        if(!run_step(static_cast<int>(i), rates[i], result))
+        {
+            std::cerr << "write rate " << rate_str(rates[i]) << " failed\n";
+            return 1;
+        }
+        results.push_back(result);
+    }
+    munmap(shm, sizeof(ContentionShm));
+
+    if(json)
+        write_json(results);
+    else
+        write_text(results);
+    return 0;
+}
@@ -0,0 +1,125 @@
+/**
+ * Copyright (C) 2017 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+// Report index shape and fragmentation of a mabain DB in JSON.
+
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include "db.h"
+#include "mb_analyze.h"
+#include "error.h"
+
+using namespace mabain;
+
+static void usage(const char *prog)
+{
+    std::cout << "Usage: " << prog << " -d mabain-directory [-t threads] [-im index-memcap] [-dm data-memcap] [-o output-file]\n";
+    std::cout <<"\t-d mabain databse directory\n";
+    std::cout <<"\t-t number of analyzer threads\n";
+    std::cout <<"\t-im index memcap\n";
+    std::cout <<"\t-dm data memcap\n";
+    std::cout <<"\t-o write JSON report to the file instead of stdout\n";
+    std::cout <<"Free lists are only reported if they were saved to disk.\n";
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int64_t memcap_i = 1024*1024LL;
+    int64_t memcap_d = 1024*1024LL;
+    const char *db_dir = NULL;
+    const char *output_file = NULL;
+    int num_threads = 4;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-d") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            db_dir = argv[i];
+        }
+        else if(strcmp(argv[i], "-t") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            num_threads = atoi(argv[i]);
+        }
+        else if(strcmp(argv[i], "-im") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            memcap_i = atoll(argv[i]);
+        }
+        else if(strcmp(argv[i], "-dm") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            memcap_d = atoll(argv[i]);
+        }
+        else if(strcmp(argv[i], "-o") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            output_file = argv[i];
+        }
+        else
+        {
+            usage(argv[0]);
+        }
+    }
+    if(db_dir == NULL)
+        usage(argv[0]);
+
+    MBConfig mbconf;
+    memset(&mbconf, 0, sizeof(mbconf));
+    mbconf.mbdir = db_dir;
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    mbconf.memcap_index = memcap_i;
+    mbconf.memcap_data = memcap_d;
+
+    DBAnalyzer analyzer(mbconf, num_threads);
+    int rval = analyzer.Analyze();
+    if(rval != MBError::SUCCESS)
+    {
+        std::cerr << "failed to analyze " << db_dir << ": "
+                  << MBError::get_error_str(rval) << "\n";
+        return 1;
+    }
+
+    if(output_file != NULL)
+    {
+        std::ofstream out(output_file);
+        if(!out.is_open())
+        {
+            std::cerr << "failed to open " << output_file << "\n";
+            return 1;
+        }
+        analyzer.WriteJSON(out);
+    }
+    else
+    {
+        analyzer.WriteJSON(std::cout);
+    }
+
+    return 0;
+}
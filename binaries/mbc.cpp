@@ -59,6 +59,8 @@ enum mbc_command {
     COMMAND_FIND_LPREFIX_HEX = 16,
     COMMAND_RECLAIM_RESOURCES = 17,
     COMMAND_PARSING_ERROR = 18,
+    COMMAND_LATENCY_STATS = 19,
+    COMMAND_HOT_KEYS = 20,
 };
 
 volatile bool quit_mbc = false;
@@ -103,6 +105,8 @@ static void show_help()
     std::cout << "\tdelete(\"key\")\t\tdelete entry by key\n";
     std::cout << "\tdeleteAll\t\tdelete all entries\n";
     std::cout << "\tshow\t\t\tshow database statistics\n";
+    std::cout << "\tstats\t\t\tshow operation latency percentiles\n";
+    std::cout << "\thotKeys\t\t\tshow keys found most often by readers\n";
     std::cout << "\thelp\t\t\tshow helps\n";
     std::cout << "\tquit\t\t\tquit mabain client\n";
     std::cout << "\tdecWriterCount\t\tClear writer count in shared memory header\n";
@@ -111,6 +115,26 @@ static void show_help()
     std::cout << "\treclaimResources\tReclaim deleted resources\n";
 }
 
+static void print_hot_keys(DB *db)
+{
+    std::vector<HotKey> hot_keys;
+    int rval = db->GetHotKeys(hot_keys);
+    if(rval != MBError::SUCCESS)
+    {
+        std::cout << MBError::get_error_str(rval) << "\n";
+        return;
+    }
+
+    std::cout << "\tcount\t\tkey\n";
+    for(size_t i = 0; i < hot_keys.size(); i++)
+    {
+        std::cout << "\t" << hot_keys[i].count << "\t\t" << hot_keys[i].key;
+        if(hot_keys[i].key_len > static_cast<int>(hot_keys[i].key.size()))
+            std::cout << "...";
+        std::cout << "\n";
+    }
+}
+
 static void trim_spaces(const char *cmd, std::string &cmd_trim)
 {
     cmd_trim.clear();
@@ -205,6 +229,8 @@ static int parse_command(std::string &cmd,
         case 's':
             if(cmd.compare("show") == 0)
                 return COMMAND_STATS;
+            else if(cmd.compare("stats") == 0)
+                return COMMAND_LATENCY_STATS;
             break;
         case 'f':
             hex_output = check_hex_output(cmd);
@@ -296,6 +322,8 @@ static int parse_command(std::string &cmd,
         case 'h':
             if(cmd.compare("help") == 0)
                 return COMMAND_HELP;
+            else if(cmd.compare("hotKeys") == 0)
+                return COMMAND_HOT_KEYS;
             break;
         case 'p':
             if(cmd.compare("printHeader") == 0)
@@ -412,6 +440,12 @@ static int RunCommand(int mode, DB *db, int cmd_id, const std::string &key, cons
         case COMMAND_STATS:
             db->PrintStats();
             break;
+        case COMMAND_LATENCY_STATS:
+            db->PrintLatencyStats();
+            break;
+        case COMMAND_HOT_KEYS:
+            print_hot_keys(db);
+            break;
         case COMMAND_HELP:
             show_help();
             break;
@@ -0,0 +1,136 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+// Apply mutations shipped by a mabain writer to a follower DB.
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+
+#include "db.h"
+#include "mb_repl.h"
+#include "error.h"
+
+using namespace mabain;
+
+static ReplicationFollower *follower = NULL;
+
+static void usage(const char *prog)
+{
+    std::cout << "Usage: " << prog << " -d mabain-directory -e endpoint [-im index-memcap] [-dm data-memcap]\n";
+    std::cout <<"\t-d follower databse directory\n";
+    std::cout <<"\t-e master endpoint, unix socket path or host:port\n";
+    std::cout <<"\t-im index memcap\n";
+    std::cout <<"\t-dm data memcap\n";
+    exit(1);
+}
+
+static void handle_signal(int sig)
+{
+    if(follower != NULL)
+        follower->Stop();
+}
+
+int main(int argc, char *argv[])
+{
+    int64_t memcap_i = 1024*1024LL;
+    int64_t memcap_d = 1024*1024LL;
+    const char *db_dir = NULL;
+    const char *endpoint = NULL;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-d") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            db_dir = argv[i];
+        }
+        else if(strcmp(argv[i], "-e") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            endpoint = argv[i];
+        }
+        else if(strcmp(argv[i], "-im") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            memcap_i = atoll(argv[i]);
+        }
+        else if(strcmp(argv[i], "-dm") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            memcap_d = atoll(argv[i]);
+        }
+        else
+        {
+            usage(argv[0]);
+        }
+    }
+    if(db_dir == NULL || endpoint == NULL)
+        usage(argv[0]);
+
+    MBConfig mbconf;
+    memset(&mbconf, 0, sizeof(mbconf));
+    mbconf.mbdir = db_dir;
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    mbconf.memcap_index = memcap_i;
+    mbconf.memcap_data = memcap_d;
+
+    DB db(mbconf);
+    if(!db.is_open())
+    {
+        std::cerr << "failed to open " << db_dir << ": " << db.StatusStr() << "\n";
+        return 1;
+    }
+
+    follower = new ReplicationFollower(db, endpoint);
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    // Reconnect until stopped or the master cannot serve this follower.
+    int rval;
+    while(true)
+    {
+        rval = follower->Run();
+        if(rval == MBError::DB_CLOSED || rval == MBError::NOT_EXIST ||
+           rval == MBError::INVALID_ARG)
+            break;
+        std::cerr << "replication interrupted at sequence " << follower->GetSeq()
+                  << ": " << MBError::get_error_str(rval) << ", retrying\n";
+        sleep(1);
+    }
+
+    if(rval == MBError::NOT_EXIST)
+        std::cerr << "follower at sequence " << follower->GetSeq()
+                  << " must be restored from a backup or snapshot of master\n";
+    else if(rval == MBError::INVALID_ARG)
+        std::cerr << "follower at sequence " << follower->GetSeq()
+                  << " is not a replica of master\n";
+    std::cout << "stopped at sequence " << follower->GetSeq() << "\n";
+
+    delete follower;
+    follower = NULL;
+    db.Close();
+    return (rval == MBError::DB_CLOSED) ? 0 : 2;
+}
@@ -0,0 +1,112 @@
+/**
+ * Copyright (C) 2017 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+// Verify index and data integrity of a mabain DB.
+
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+
+#include "db.h"
+#include "mb_verify.h"
+#include "error.h"
+
+using namespace mabain;
+
+static void usage(const char *prog)
+{
+    std::cout << "Usage: " << prog << " -d mabain-directory [-t threads] [-im index-memcap] [-dm data-memcap]\n";
+    std::cout <<"\t-d mabain databse directory\n";
+    std::cout <<"\t-t number of verifier threads\n";
+    std::cout <<"\t-im index memcap\n";
+    std::cout <<"\t-dm data memcap\n";
+    std::cout <<"Writer should be stopped during verification.\n";
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int64_t memcap_i = 1024*1024LL;
+    int64_t memcap_d = 1024*1024LL;
+    const char *db_dir = NULL;
+    int num_threads = 4;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-d") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            db_dir = argv[i];
+        }
+        else if(strcmp(argv[i], "-t") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            num_threads = atoi(argv[i]);
+        }
+        else if(strcmp(argv[i], "-im") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            memcap_i = atoll(argv[i]);
+        }
+        else if(strcmp(argv[i], "-dm") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            memcap_d = atoll(argv[i]);
+        }
+        else
+        {
+            usage(argv[0]);
+        }
+    }
+    if(db_dir == NULL)
+        usage(argv[0]);
+
+    MBConfig mbconf;
+    memset(&mbconf, 0, sizeof(mbconf));
+    mbconf.mbdir = db_dir;
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    mbconf.memcap_index = memcap_i;
+    mbconf.memcap_data = memcap_d;
+
+    DBVerifier verifier(mbconf, num_threads);
+    int rval = verifier.Verify();
+    if(rval != MBError::SUCCESS && verifier.GetErrorCount() == 0)
+    {
+        std::cerr << "failed to verify " << db_dir << ": "
+                  << MBError::get_error_str(rval) << "\n";
+        return 1;
+    }
+
+    const std::vector<VerifyError> &errors = verifier.GetErrors();
+    for(size_t i = 0; i < errors.size(); i++)
+    {
+        std::cout << (errors[i].index ? "index" : "data") << " offset "
+                  << errors[i].offset << ": "
+                  << MBError::get_error_str(errors[i].error) << "\n";
+    }
+    std::cout << "data records: " << verifier.GetRecordCount() << "\n";
+    std::cout << "data records with checksum: " << verifier.GetCheckedCount() << "\n";
+    std::cout << "errors: " << verifier.GetErrorCount() << "\n";
+
+    return (verifier.GetErrorCount() == 0) ? 0 : 2;
+}
@@ -6,7 +6,15 @@
 #include <assert.h>
 #include <unistd.h>
 #include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <time.h>
+#include <math.h>
 #include <openssl/sha.h>
+#include <atomic>
+#include <random>
+#include <vector>
 
 #ifdef LEVEL_DB
 #include <leveldb/db.h>
@@ -42,6 +50,25 @@ static int key_type         = 0;
 static bool sync_on_write   = false;
 static unsigned long long memcap = 1024ULL*1024*1024;
 
+// YCSB workload driver, enabled with -w
+//   -w workloads to run in order, any of abcdef
+//   -D key distribution overriding the one of the workload
+//   -v value size, values are the keys if not set
+//   -o number of operations per workload, default is the number of records
+//   -t number of client threads
+//   -p number of reader processes; writes are then run by this process
+//   -M comma separated memcaps to sweep, e.g. 256m,1g
+static const char *workloads = NULL;
+static int key_dist          = -1;
+static int value_size        = 0;
+static long long num_ops     = 0;
+static int n_proc            = 0;
+static int client_id         = -1;
+static char client_workload  = 0;
+static std::vector<unsigned long long> memcaps;
+static int prog_argc         = 0;
+static char **prog_argv      = NULL;
+
 static void get_sha256_str(int key, char *sha256_str)
 {
     unsigned char hash[SHA256_DIGEST_LENGTH];
@@ -72,6 +99,39 @@ static void get_sha1_str(int key, char *sha1_str)
     sha1_str[32] = 0;
 }
 
+static std::string get_key(long long i)
+{
+    char kv[65];
+    if(key_type == 0)
+        return std::to_string(i);
+    if(key_type == 1)
+        get_sha1_str(static_cast<int>(i), kv);
+    else
+        get_sha256_str(static_cast<int>(i), kv);
+    return std::string(kv);
+}
+
+// Values are the keys unless a value size is given.
+static std::string get_value(long long i, const std::string &key)
+{
+    if(value_size <= 0)
+        return key;
+    return std::string(value_size, static_cast<char>('a' + i % 26));
+}
+
+static unsigned long long parse_size(const char *size_str)
+{
+    char *end;
+    unsigned long long size = strtoull(size_str, &end, 10);
+    if(*end == 'k' || *end == 'K')
+        size *= 1024ULL;
+    else if(*end == 'm' || *end == 'M')
+        size *= 1024ULL*1024;
+    else if(*end == 'g' || *end == 'G')
+        size *= 1024ULL*1024*1024;
+    return size;
+}
+
 static void print_cpu_info()
 {
     std::ifstream cpu_info("/proc/cpuinfo", std::fstream::in);
@@ -159,7 +219,9 @@ static void InitDB(bool writer_mode = true)
     std::string db_dir_tmp = std::string(db_dir) + "/lmdb";
     mdb_env_create(&env);
     mdb_env_set_mapsize(env, memcap);
-    mdb_env_open(env, db_dir_tmp.c_str(), 0, 0664);
+    // Workloads commit every write in its own transaction.
+    mdb_env_open(env, db_dir_tmp.c_str(),
+                 (workloads != NULL && !sync_on_write) ? MDB_NOSYNC : 0, 0664);
     mdb_txn_begin(env, NULL, 0, &txn);
     mdb_open(txn, NULL, 0, &db);
     mdb_txn_commit(txn);
@@ -191,7 +253,6 @@ static void Add(int n)
         std::string key, val;
         if(key_type == 0) {
             key = std::to_string(i);
-            val = std::to_string(i);
         } else {
             if(key_type == 1) {
                 get_sha1_str(i, kv);
@@ -199,8 +260,8 @@ static void Add(int n)
                 get_sha256_str(i, kv);
             }
             key = kv;
-            val = kv;
         }
+        val = get_value(i, key);
 
 #ifdef LEVEL_DB
         leveldb::WriteOptions opts = leveldb::WriteOptions();
@@ -556,12 +617,641 @@ static void RemoveDB()
     }
 }
 
+///////////////////////////////////////////////////////////////////
+// YCSB workloads
+///////////////////////////////////////////////////////////////////
+
+#define YCSB_READ          0
+#define YCSB_UPDATE        1
+#define YCSB_INSERT        2
+#define YCSB_SCAN          3
+#define YCSB_RMW           4
+#define YCSB_NUM_OP        5
+#define YCSB_MAX_SCAN_LEN  100
+#define YCSB_MAX_CLIENT    64
+
+#define DIST_UNIFORM       0
+#define DIST_ZIPFIAN       1
+#define DIST_LATEST        2
+
+// Latencies below 2^HIST_SUB_BITS ns have their own bucket. Every power
+// of two above is split into 2^HIST_SUB_BITS buckets.
+#define HIST_SUB_BITS      3
+#define HIST_NUM_BUCKETS   ((64 - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+static const char *op_names[YCSB_NUM_OP] = {"READ", "UPDATE", "INSERT", "SCAN", "RMW"};
+static const char *dist_names[] = {"uniform", "zipfian", "latest"};
+
+typedef struct _Workload
+{
+    char name;
+    // operation mix in percent
+    int proportion[YCSB_NUM_OP];
+    int dist;
+} Workload;
+
+static const Workload ycsb_workloads[] = {
+    {'a', {50, 50, 0,  0,  0}, DIST_ZIPFIAN},
+    {'b', {95, 5,  0,  0,  0}, DIST_ZIPFIAN},
+    {'c', {100, 0, 0,  0,  0}, DIST_ZIPFIAN},
+    {'d', {95, 0,  5,  0,  0}, DIST_LATEST},
+    {'e', {0,  0,  5,  95, 0}, DIST_ZIPFIAN},
+    {'f', {50, 0,  0,  0,  50}, DIST_ZIPFIAN},
+};
+
+typedef struct _ClientStats
+{
+    uint64_t ops;
+    uint64_t not_found;
+    uint64_t count[YCSB_NUM_OP];
+    uint64_t total_ns[YCSB_NUM_OP];
+    uint64_t max_ns[YCSB_NUM_OP];
+    uint64_t hist[YCSB_NUM_OP][HIST_NUM_BUCKETS];
+} ClientStats;
+
+// Mapped by the client threads and the reader processes
+typedef struct _WorkloadShm
+{
+    // next record to insert
+    std::atomic<long long> num_record;
+    // Keys are only chosen from acknowledged inserts as in YCSB.
+    std::atomic<long long> num_acked;
+    ClientStats clients[YCSB_MAX_CLIENT+1];
+} WorkloadShm;
+
+typedef struct _ClientContext
+{
+    int id;
+    const Workload *workload;
+    int dist;
+    long long num_op;
+    // In reader process mode, reads are run by the reader processes and
+    // writes by the writer process.
+    bool read_only;
+    bool write_only;
+    WorkloadShm *shm;
+    pthread_t tid;
+} ClientContext;
+
+// Zipfian generator from "Quickly Generating Billion-Record Synthetic
+// Databases" by Gray et al., as used by YCSB. The number of items can
+// grow and zeta is then updated incrementally.
+class ZipfianGenerator
+{
+public:
+    ZipfianGenerator(long long n, double zipf_theta = 0.99)
+        : items(0), theta(zipf_theta), zetan(0), eta(0)
+    {
+        zeta2 = Zeta(0, 2, 0);
+        alpha = 1.0 / (1.0 - theta);
+        Resize(n);
+    }
+
+    void Resize(long long n)
+    {
+        if(n <= items)
+            return;
+        zetan = Zeta(items, n, zetan);
+        items = n;
+        eta = (1 - pow(2.0 / items, 1 - theta)) / (1 - zeta2 / zetan);
+    }
+
+    long long Next(std::mt19937_64 &rng)
+    {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        double uz = u * zetan;
+        if(uz < 1.0)
+            return 0;
+        if(uz < 1.0 + pow(0.5, theta))
+            return 1;
+        long long rank = static_cast<long long>(items * pow(eta * u - eta + 1, alpha));
+        return rank >= items ? items - 1 : rank;
+    }
+
+private:
+    double Zeta(long long from, long long to, double initial)
+    {
+        double sum = initial;
+        for(long long i = from; i < to; i++)
+            sum += 1.0 / pow(static_cast<double>(i + 1), theta);
+        return sum;
+    }
+
+    long long items;
+    double theta;
+    double zetan;
+    double zeta2;
+    double alpha;
+    double eta;
+};
+
+static inline uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline uint64_t fnv_hash64(uint64_t val)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for(int i = 0; i < 8; i++) {
+        hash ^= val & 0xFF;
+        hash *= 1099511628211ULL;
+        val >>= 8;
+    }
+    return hash;
+}
+
+static long long next_key_index(int dist, ZipfianGenerator &zipf, std::mt19937_64 &rng,
+                                long long n)
+{
+    if(dist == DIST_UNIFORM)
+        return static_cast<long long>(rng() % n);
+
+    zipf.Resize(n);
+    if(dist == DIST_LATEST)
+        return n - 1 - zipf.Next(rng);
+    // Popular keys are scattered over the key space as in YCSB.
+    return static_cast<long long>(fnv_hash64(zipf.Next(rng)) % n);
+}
+
+static inline int get_bucket(uint64_t ns)
+{
+    if(ns < (1ULL << HIST_SUB_BITS))
+        return static_cast<int>(ns);
+    int shift = 63 - __builtin_clzll(ns) - HIST_SUB_BITS;
+    return ((shift + 1) << HIST_SUB_BITS) +
+           static_cast<int>((ns >> shift) & ((1ULL << HIST_SUB_BITS) - 1));
+}
+
+// highest latency of the bucket
+static inline uint64_t bucket_value(int bucket)
+{
+    if(bucket < (1 << HIST_SUB_BITS))
+        return static_cast<uint64_t>(bucket);
+    int shift = (bucket >> HIST_SUB_BITS) - 1;
+    uint64_t sub = (1ULL << HIST_SUB_BITS) + (bucket & ((1 << HIST_SUB_BITS) - 1));
+    return (sub << shift) + ((1ULL << shift) - 1);
+}
+
+static const Workload* find_workload(char name)
+{
+    for(size_t i = 0; i < sizeof(ycsb_workloads)/sizeof(ycsb_workloads[0]); i++) {
+        if(ycsb_workloads[i].name == name)
+            return &ycsb_workloads[i];
+    }
+    return NULL;
+}
+
+static bool is_write_op(int op)
+{
+    return op == YCSB_UPDATE || op == YCSB_INSERT || op == YCSB_RMW;
+}
+
+static int write_percent(const Workload *workload)
+{
+    int percent = 0;
+    for(int op = 0; op < YCSB_NUM_OP; op++) {
+        if(is_write_op(op))
+            percent += workload->proportion[op];
+    }
+    return percent;
+}
+
+static bool reader_process_supported()
+{
+#if defined(MABAIN) || defined(LMDB)
+    return true;
+#else
+    return false;
+#endif
+}
+
+#if MABAIN
+typedef mabain::DB* ClientDB;
+#else
+typedef void* ClientDB;
+#endif
+
+// Every mabain client has its own reader handle. Writes are sent to the
+// async writer if the client is in the writer process.
+static ClientDB OpenClientDB()
+{
+#if MABAIN
+    std::string db_dir_tmp = std::string(db_dir) + "/mabain/";
+    mabain::DB *db_r = new mabain::DB(db_dir_tmp.c_str(), mabain::CONSTS::ReaderOptions(),
+                                      (unsigned long long)(0.6666667*memcap),
+                                      (unsigned long long)(0.3333333*memcap));
+    assert(db_r->is_open());
+    if(db != NULL)
+        db_r->SetAsyncWriterPtr(db);
+    return db_r;
+#else
+    return NULL;
+#endif
+}
+
+static void CloseClientDB(ClientDB cdb)
+{
+#if MABAIN
+    if(db != NULL)
+        cdb->UnsetAsyncWriterPtr(db);
+    cdb->Close();
+    delete cdb;
+#endif
+}
+
+static bool kv_get(ClientDB cdb, const std::string &key, std::string &value)
+{
+#ifdef LEVEL_DB
+    return db->Get(leveldb::ReadOptions(), key, &value).ok();
+#elif KYOTO_CABINET
+    return db->get(key, &value);
+#elif LMDB
+    MDB_txn *rtxn;
+    MDB_val lmdb_key, lmdb_value;
+    lmdb_key.mv_size = key.size();
+    lmdb_key.mv_data = (void*) key.data();
+    if(mdb_txn_begin(env, NULL, MDB_RDONLY, &rtxn) != 0)
+        return false;
+    bool found = (mdb_get(rtxn, db, &lmdb_key, &lmdb_value) == 0);
+    if(found)
+        value.assign((const char *) lmdb_value.mv_data, lmdb_value.mv_size);
+    mdb_txn_abort(rtxn);
+    return found;
+#elif MABAIN
+    mabain::MBData mbd;
+    if(cdb->Find(key, mbd) != 0)
+        return false;
+    value.assign((const char *) mbd.buff, mbd.data_len);
+    return true;
+#endif
+}
+
+static void kv_put(ClientDB cdb, const std::string &key, const std::string &value)
+{
+#ifdef LEVEL_DB
+    leveldb::WriteOptions opts = leveldb::WriteOptions();
+    opts.sync = sync_on_write;
+    db->Put(opts, key, value);
+#elif KYOTO_CABINET
+    db->set(key, value);
+#elif LMDB
+    MDB_txn *wtxn;
+    MDB_val lmdb_key, lmdb_value;
+    lmdb_key.mv_size = key.size();
+    lmdb_key.mv_data = (void*) key.data();
+    lmdb_value.mv_size = value.size();
+    lmdb_value.mv_data = (void*) value.data();
+    if(mdb_txn_begin(env, NULL, 0, &wtxn) != 0)
+        return;
+    mdb_put(wtxn, db, &lmdb_key, &lmdb_value, 0);
+    mdb_txn_commit(wtxn);
+#elif MABAIN
+    cdb->Add(key, value, true);
+#endif
+}
+
+static int kv_scan(ClientDB cdb, long long start, int len)
+{
+    int nfound = 0;
+#ifdef LEVEL_DB
+    leveldb::Iterator *it = db->NewIterator(leveldb::ReadOptions());
+    for(it->Seek(get_key(start)); it->Valid() && nfound < len; it->Next()) {
+        if(it->value().size() > 0) nfound++;
+    }
+    delete it;
+#elif LMDB
+    MDB_txn *rtxn;
+    MDB_cursor *cursor;
+    MDB_val lmdb_key, lmdb_value;
+    std::string key = get_key(start);
+    lmdb_key.mv_size = key.size();
+    lmdb_key.mv_data = (void*) key.data();
+    if(mdb_txn_begin(env, NULL, MDB_RDONLY, &rtxn) != 0)
+        return 0;
+    mdb_cursor_open(rtxn, db, &cursor);
+    int rval = mdb_cursor_get(cursor, &lmdb_key, &lmdb_value, MDB_SET_RANGE);
+    while(rval == 0 && nfound < len) {
+        nfound++;
+        rval = mdb_cursor_get(cursor, &lmdb_key, &lmdb_value, MDB_NEXT);
+    }
+    mdb_cursor_close(cursor);
+    mdb_txn_abort(rtxn);
+#else
+    // Hash DB and mabain have no ordered scan. Records inserted after the
+    // start record are read instead.
+    std::string value;
+    for(int i = 0; i < len; i++) {
+        if(kv_get(cdb, get_key(start + i), value)) nfound++;
+    }
+#endif
+    return nfound;
+}
+
+static void RunClient(ClientContext *ctx)
+{
+    ClientStats *stats = &ctx->shm->clients[ctx->id];
+    int proportion[YCSB_NUM_OP];
+    int total = 0;
+    for(int op = 0; op < YCSB_NUM_OP; op++) {
+        proportion[op] = ctx->workload->proportion[op];
+        if((ctx->read_only && is_write_op(op)) || (ctx->write_only && !is_write_op(op)))
+            proportion[op] = 0;
+        total += proportion[op];
+    }
+    if(total == 0 || ctx->num_op <= 0)
+        return;
+
+    ClientDB cdb = OpenClientDB();
+    std::mt19937_64 rng(ctx->id * 7919 + 1);
+    ZipfianGenerator zipf(ctx->shm->num_acked.load(std::memory_order_relaxed));
+    std::string key, value;
+    for(long long i = 0; i < ctx->num_op; i++) {
+        int r = static_cast<int>(rng() % total);
+        int op = 0;
+        while(r >= proportion[op]) {
+            r -= proportion[op];
+            op++;
+        }
+
+        long long n = ctx->shm->num_acked.load(std::memory_order_relaxed);
+        long long key_index;
+        if(op == YCSB_INSERT)
+            key_index = ctx->shm->num_record.fetch_add(1, std::memory_order_relaxed);
+        else
+            key_index = next_key_index(ctx->dist, zipf, rng, n);
+        key = get_key(key_index);
+        int scan_len = 1 + static_cast<int>(rng() % YCSB_MAX_SCAN_LEN);
+
+        bool found = true;
+        uint64_t start = now_ns();
+        switch(op) {
+            case YCSB_READ:
+                found = kv_get(cdb, key, value);
+                break;
+            case YCSB_UPDATE:
+            case YCSB_INSERT:
+                kv_put(cdb, key, get_value(key_index, key));
+                break;
+            case YCSB_SCAN:
+                found = (kv_scan(cdb, key_index, scan_len) > 0);
+                break;
+            case YCSB_RMW:
+                found = kv_get(cdb, key, value);
+                kv_put(cdb, key, get_value(key_index + 1, key));
+                break;
+        }
+        uint64_t latency = now_ns() - start;
+        if(op == YCSB_INSERT)
+            ctx->shm->num_acked.fetch_add(1, std::memory_order_relaxed);
+
+        stats->ops++;
+        stats->count[op]++;
+        stats->total_ns[op] += latency;
+        if(latency > stats->max_ns[op])
+            stats->max_ns[op] = latency;
+        stats->hist[op][get_bucket(latency)]++;
+        if(!found)
+            stats->not_found++;
+    }
+    CloseClientDB(cdb);
+}
+
+static void *ClientThread(void *arg)
+{
+    RunClient((ClientContext *) arg);
+    return NULL;
+}
+
+static long long reader_process_ops(const Workload *workload, long long ops)
+{
+    return ops * (100 - write_percent(workload)) / 100 / n_proc;
+}
+
+static WorkloadShm *MapWorkloadShm(bool create)
+{
+    std::string shm_path = std::string(db_dir) + "/ycsb_stats";
+    int fd = open(shm_path.c_str(), create ? (O_CREAT | O_RDWR | O_TRUNC) : O_RDWR, 0644);
+    if(fd < 0) {
+        std::cerr << "failed to open " << shm_path << "\n";
+        abort();
+    }
+    if(create && ftruncate(fd, sizeof(WorkloadShm)) != 0) {
+        std::cerr << "failed to resize " << shm_path << "\n";
+        abort();
+    }
+    void *addr = mmap(NULL, sizeof(WorkloadShm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED) {
+        std::cerr << "failed to map " << shm_path << "\n";
+        abort();
+    }
+    return (WorkloadShm *) addr;
+}
+
+// Reader processes run this program again with the client arguments.
+static pid_t SpawnReaderProcess(int id, char workload)
+{
+    pid_t pid = fork();
+    if(pid != 0)
+        return pid;
+
+    std::string id_str = std::to_string(id);
+    std::string workload_str(1, workload);
+    std::string memcap_str = std::to_string(memcap);
+    std::vector<char *> args(prog_argv, prog_argv + prog_argc);
+    args.push_back((char *) "-client");
+    args.push_back((char *) id_str.c_str());
+    args.push_back((char *) workload_str.c_str());
+    args.push_back((char *) "-m");
+    args.push_back((char *) memcap_str.c_str());
+    args.push_back(NULL);
+    execv("/proc/self/exe", args.data());
+    std::cerr << "failed to start reader process\n";
+    _exit(1);
+}
+
+static void RunReaderProcess()
+{
+    const Workload *workload = find_workload(client_workload);
+    if(workload == NULL)
+        return;
+    long long ops = num_ops > 0 ? num_ops : num_kv;
+#if LMDB
+    InitDB(false);
+#endif
+    ClientContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.id = client_id;
+    ctx.workload = workload;
+    ctx.dist = key_dist >= 0 ? key_dist : workload->dist;
+    ctx.num_op = reader_process_ops(workload, ops);
+    ctx.read_only = true;
+    ctx.shm = MapWorkloadShm(false);
+    RunClient(&ctx);
+    munmap(ctx.shm, sizeof(WorkloadShm));
+#if LMDB
+    DestroyDB();
+#endif
+}
+
+static void ReportWorkload(const Workload *workload, int dist, int n_client,
+                           WorkloadShm *shm, uint64_t elapsed_ns)
+{
+    ClientStats total;
+    memset(&total, 0, sizeof(total));
+    for(int c = 0; c <= YCSB_MAX_CLIENT; c++) {
+        const ClientStats &stats = shm->clients[c];
+        total.ops += stats.ops;
+        total.not_found += stats.not_found;
+        for(int op = 0; op < YCSB_NUM_OP; op++) {
+            total.count[op] += stats.count[op];
+            total.total_ns[op] += stats.total_ns[op];
+            if(stats.max_ns[op] > total.max_ns[op])
+                total.max_ns[op] = stats.max_ns[op];
+            for(int b = 0; b < HIST_NUM_BUCKETS; b++)
+                total.hist[op][b] += stats.hist[op][b];
+        }
+    }
+
+    double seconds = elapsed_ns / 1e9;
+    std::cout << "===== workload " << workload->name << " (" << dist_names[dist] << ", "
+              << n_client << (n_proc > 0 ? " reader processes" : " threads")
+              << ", memcap " << memcap << "): " << (seconds > 0 ? total.ops / seconds : 0)
+              << " ops per second, " << total.ops << " ops in " << seconds << " seconds\n";
+    for(int op = 0; op < YCSB_NUM_OP; op++) {
+        if(total.count[op] == 0)
+            continue;
+        const double quantiles[] = {0.5, 0.99, 0.999};
+        uint64_t values[3] = {0, 0, 0};
+        uint64_t sum = 0;
+        int q = 0;
+        for(int b = 0; b < HIST_NUM_BUCKETS && q < 3; b++) {
+            sum += total.hist[op][b];
+            while(q < 3 && sum >= static_cast<uint64_t>(ceil(quantiles[q] * total.count[op]))) {
+                values[q] = std::min(bucket_value(b), total.max_ns[op]);
+                q++;
+            }
+        }
+        std::cout << "      " << op_names[op] << "\tops: " << total.count[op]
+                  << "\tavg: " << total.total_ns[op] / 1000.0 / total.count[op]
+                  << "\tp50: " << values[0] / 1000.0
+                  << "\tp99: " << values[1] / 1000.0
+                  << "\tp999: " << values[2] / 1000.0
+                  << "\tmax: " << total.max_ns[op] / 1000.0 << " micro seconds\n";
+    }
+    // Includes reads of inserts not yet applied by an async writer
+    if(total.not_found > 0)
+        std::cout << "      not found: " << total.not_found << "\n";
+}
+
+static void RunWorkload(const Workload *workload, WorkloadShm *shm)
+{
+    int dist = key_dist >= 0 ? key_dist : workload->dist;
+    long long ops = num_ops > 0 ? num_ops : num_kv;
+    memset(shm->clients, 0, sizeof(shm->clients));
+
+    uint64_t start = now_ns();
+    int n_client;
+    if(n_proc > 0) {
+        n_client = n_proc;
+        std::vector<pid_t> pids;
+        for(int i = 0; i < n_proc; i++)
+            pids.push_back(SpawnReaderProcess(i + 1, workload->name));
+
+        // Writes of the mix are run in this process.
+        ClientContext ctx;
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.id = 0;
+        ctx.workload = workload;
+        ctx.dist = dist;
+        ctx.num_op = ops * write_percent(workload) / 100;
+        ctx.write_only = true;
+        ctx.shm = shm;
+        RunClient(&ctx);
+
+        for(size_t i = 0; i < pids.size(); i++) {
+            int status;
+            waitpid(pids[i], &status, 0);
+            if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                std::cerr << "reader process " << pids[i] << " failed\n";
+        }
+    } else {
+        n_client = n_reader > 0 ? n_reader : 1;
+        std::vector<ClientContext> ctxs(n_client);
+        for(int i = 0; i < n_client; i++) {
+            memset(&ctxs[i], 0, sizeof(ClientContext));
+            ctxs[i].id = i;
+            ctxs[i].workload = workload;
+            ctxs[i].dist = dist;
+            ctxs[i].num_op = ops / n_client;
+            ctxs[i].shm = shm;
+            if(pthread_create(&ctxs[i].tid, NULL, ClientThread, &ctxs[i]) != 0) {
+                std::cerr << "failed to create client thread\n";
+                abort();
+            }
+        }
+        for(int i = 0; i < n_client; i++)
+            pthread_join(ctxs[i].tid, NULL);
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    ReportWorkload(workload, dist, n_client, shm, elapsed);
+}
+
+// Load the records and run the workloads for every memcap.
+static void RunWorkloads()
+{
+    if(n_proc > 0 && !reader_process_supported()) {
+        std::cout << "===== reader processes not supported, using threads\n";
+        n_proc = 0;
+    }
+    if(n_proc > YCSB_MAX_CLIENT || n_reader > YCSB_MAX_CLIENT) {
+        std::cerr << "at most " << YCSB_MAX_CLIENT << " clients are supported\n";
+        abort();
+    }
+    if(memcaps.empty())
+        memcaps.push_back(memcap);
+
+    WorkloadShm *shm = MapWorkloadShm(true);
+    for(size_t m = 0; m < memcaps.size(); m++) {
+        memcap = memcaps[m];
+        std::cout << "===== Memcap is " << memcap << "\n";
+        RemoveDB();
+        InitDB();
+        Add(num_kv);
+        DestroyDB();
+
+        InitDB();
+        shm->num_record.store(num_kv, std::memory_order_relaxed);
+        shm->num_acked.store(num_kv, std::memory_order_relaxed);
+        for(const char *w = workloads; *w != '\0'; w++) {
+            const Workload *workload = find_workload(*w);
+            if(workload == NULL) {
+                std::cerr << "invalid workload: " << *w << "\n";
+                continue;
+            }
+            RunWorkload(workload, shm);
+        }
+        DestroyDB();
+    }
+    RemoveDB();
+
+    munmap(shm, sizeof(WorkloadShm));
+    std::string shm_path = std::string(db_dir) + "/ycsb_stats";
+    unlink(shm_path.c_str());
+}
+
 int main(int argc, char *argv[])
 {
 #ifdef MABAIN
     mabain::DB::SetLogFile("/var/tmp/mabain_test/mabain.log");
     // mabain::DB::SetLogLevel(2);
 #endif
+    prog_argc = argc;
+    prog_argv = argv;
     for(int i = 1; i < argc; i++) {
         if(strcmp(argv[i], "-n") == 0) {
             if(++i >= argc) abort();
@@ -588,17 +1278,74 @@ int main(int argc, char *argv[])
             sync_on_write = true;
         } else if(strcmp(argv[i], "-m") == 0) {
             if(++i >= argc) abort();
-            memcap = atoi(argv[i]);
+            memcap = parse_size(argv[i]);
+        } else if(strcmp(argv[i], "-M") == 0) {
+            // comma separated memcaps, e.g. 256m,1g
+            if(++i >= argc) abort();
+            std::string sweep = argv[i];
+            size_t pos = 0;
+            while(pos < sweep.length()) {
+                size_t end = sweep.find(',', pos);
+                if(end == std::string::npos) end = sweep.length();
+                memcaps.push_back(parse_size(sweep.substr(pos, end - pos).c_str()));
+                pos = end + 1;
+            }
+        } else if(strcmp(argv[i], "-w") == 0) {
+            // YCSB workloads to run in order, e.g. abcdef
+            if(++i >= argc) abort();
+            workloads = argv[i];
+        } else if(strcmp(argv[i], "-D") == 0) {
+            if(++i >= argc) abort();
+            if(strcmp(argv[i], "uniform") == 0) {
+                key_dist = DIST_UNIFORM;
+            } else if(strcmp(argv[i], "zipfian") == 0) {
+                key_dist = DIST_ZIPFIAN;
+            } else if(strcmp(argv[i], "latest") == 0) {
+                key_dist = DIST_LATEST;
+            } else {
+                std::cerr << "invalid key distribution: " << argv[i] << "\n";
+                abort();
+            }
+        } else if(strcmp(argv[i], "-v") == 0) {
+            if(++i >= argc) abort();
+            value_size = atoi(argv[i]);
+        } else if(strcmp(argv[i], "-o") == 0) {
+            if(++i >= argc) abort();
+            num_ops = atoll(argv[i]);
+        } else if(strcmp(argv[i], "-p") == 0) {
+            if(++i >= argc) abort();
+            n_proc = atoi(argv[i]);
+        } else if(strcmp(argv[i], "-client") == 0) {
+            // internal, used by reader processes
+            if(i + 2 >= argc) abort();
+            client_id = atoi(argv[++i]);
+            client_workload = argv[++i][0];
         } else {
             std::cerr << "invalid argument: " << argv[i] << "\n";
         }
     }
 
+    if(client_id >= 0) {
+        RunReaderProcess();
+#ifdef MABAIN
+        mabain::DB::CloseLogFile();
+#endif
+        return 0;
+    }
+
     print_cpu_info();
     if(sync_on_write)
         std::cout << "===== Disk sync is on\n";
     else
         std::cout << "===== Disk sync is off\n";
+    if(workloads != NULL) {
+        InitTestDir();
+        RunWorkloads();
+#ifdef MABAIN
+        mabain::DB::CloseLogFile();
+#endif
+        return 0;
+    }
     std::cout << "===== Memcap is " << memcap << "\n";
 
     InitTestDir();
@@ -25,6 +25,7 @@ const char *db_name = "my-memory-only-test";
 // memory-only mode test
 // No db directory is required. Need an unique name instead.
 // Note MEMORY_ONLY_MODE does not support multi-process accessing the DB.
+// Use SHARED_MEMORY_MODE for a memory-only DB shared by processes.
 int main(int argc, char *argv[])
 {
     DB db(db_name, CONSTS::WriterOptions() | CONSTS::MEMORY_ONLY_MODE);
@@ -0,0 +1,201 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include "async_reader.h"
+#include "error.h"
+#include "logger.h"
+
+namespace mabain {
+
+AsyncReader::AsyncReader(const MBConfig &config, int num_threads)
+                       : status(MBError::NOT_INITIALIZED),
+                         num_pending(0),
+                         stop_processing(false)
+{
+    if(config.options & CONSTS::ACCESS_MODE_WRITER)
+    {
+        status = MBError::INVALID_ARG;
+        return;
+    }
+    if(num_threads <= 0 || num_threads > MABAIN_ASYNC_READER_MAX_THREADS)
+    {
+        status = MBError::INVALID_ARG;
+        return;
+    }
+
+    if(pthread_mutex_init(&mutex, NULL) != 0 ||
+       pthread_cond_init(&cond_request, NULL) != 0 ||
+       pthread_cond_init(&cond_done, NULL) != 0)
+    {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to init async reader mutex");
+        throw (int) MBError::MUTEX_ERROR;
+    }
+
+    // Each thread uses its own reader handle.
+    contexts.resize(num_threads);
+    for(int i = 0; i < num_threads; i++)
+    {
+        MBConfig db_config = config;
+        contexts[i].reader = this;
+        contexts[i].running = false;
+        contexts[i].db = new DB(db_config);
+        if(!contexts[i].db->is_open())
+        {
+            status = contexts[i].db->Status();
+            Logger::Log(LOG_LEVEL_ERROR, "async reader failed to open db: %s",
+                        MBError::get_error_str(status));
+            break;
+        }
+    }
+
+    if(status == MBError::NOT_INITIALIZED)
+    {
+        for(int i = 0; i < num_threads; i++)
+        {
+            if(pthread_create(&contexts[i].tid, NULL, async_reader_thread, &contexts[i]) != 0)
+            {
+                Logger::Log(LOG_LEVEL_ERROR, "failed to create async reader thread");
+                status = MBError::THREAD_FAILED;
+                break;
+            }
+            contexts[i].running = true;
+        }
+    }
+
+    if(status == MBError::NOT_INITIALIZED)
+    {
+        status = MBError::SUCCESS;
+        Logger::Log(LOG_LEVEL_INFO, "async reader started with %d threads", num_threads);
+    }
+    else
+    {
+        Stop();
+    }
+}
+
+AsyncReader::~AsyncReader()
+{
+    if(status == MBError::INVALID_ARG)
+        return;
+
+    Stop();
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&cond_request);
+    pthread_cond_destroy(&cond_done);
+}
+
+int AsyncReader::Status() const
+{
+    return status;
+}
+
+int AsyncReader::Find(const std::string &key, AsyncFindCallback callback)
+{
+    if(status != MBError::SUCCESS)
+        return status;
+
+    pthread_mutex_lock(&mutex);
+    while(num_pending >= MABAIN_ASYNC_READER_QUEUE_SIZE && !stop_processing)
+        pthread_cond_wait(&cond_done, &mutex);
+    if(stop_processing)
+    {
+        pthread_mutex_unlock(&mutex);
+        return MBError::DB_CLOSED;
+    }
+
+    AsyncFindRequest request;
+    request.key = key;
+    request.callback = callback;
+    requests.push_back(request);
+    num_pending++;
+    pthread_cond_signal(&cond_request);
+    pthread_mutex_unlock(&mutex);
+
+    return MBError::SUCCESS;
+}
+
+void AsyncReader::Wait()
+{
+    pthread_mutex_lock(&mutex);
+    while(num_pending > 0 && !stop_processing)
+        pthread_cond_wait(&cond_done, &mutex);
+    pthread_mutex_unlock(&mutex);
+}
+
+// Stop the reader threads after all queued lookups are done.
+void AsyncReader::Stop()
+{
+    pthread_mutex_lock(&mutex);
+    stop_processing = true;
+    pthread_cond_broadcast(&cond_request);
+    pthread_cond_broadcast(&cond_done);
+    pthread_mutex_unlock(&mutex);
+
+    for(size_t i = 0; i < contexts.size(); i++)
+    {
+        if(contexts[i].running)
+            pthread_join(contexts[i].tid, NULL);
+        if(contexts[i].db != NULL)
+            delete contexts[i].db;
+        contexts[i].db = NULL;
+    }
+    contexts.clear();
+    if(status == MBError::SUCCESS)
+        status = MBError::DB_CLOSED;
+}
+
+void* AsyncReader::async_reader_thread(void *context)
+{
+    AsyncReaderContext *ctx = static_cast<AsyncReaderContext *>(context);
+    ctx->reader->ProcessRequests(ctx->db);
+    return NULL;
+}
+
+void AsyncReader::ProcessRequests(DB *db)
+{
+    MBData mbd;
+    AsyncFindRequest request;
+
+    while(true)
+    {
+        pthread_mutex_lock(&mutex);
+        while(requests.empty() && !stop_processing)
+            pthread_cond_wait(&cond_request, &mutex);
+        if(requests.empty())
+        {
+            // stop_processing is set and there is nothing left
+            pthread_mutex_unlock(&mutex);
+            break;
+        }
+        request = requests.front();
+        requests.pop_front();
+        pthread_mutex_unlock(&mutex);
+
+        int rval = db->Find(request.key, mbd);
+        if(request.callback)
+            request.callback(request.key, rval, mbd);
+        mbd.Clear();
+
+        pthread_mutex_lock(&mutex);
+        num_pending--;
+        pthread_cond_broadcast(&cond_done);
+        pthread_mutex_unlock(&mutex);
+    }
+}
+
+}
@@ -0,0 +1,88 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __ASYNC_READER_H__
+#define __ASYNC_READER_H__
+
+#include <pthread.h>
+#include <string>
+#include <deque>
+#include <vector>
+#include <functional>
+
+#include "db.h"
+
+namespace mabain {
+
+// maximum number of outstanding lookups
+#define MABAIN_ASYNC_READER_QUEUE_SIZE  4096
+#define MABAIN_ASYNC_READER_MAX_THREADS 256
+
+// Callback for asynchronous lookup. It is called in one of the reader
+// threads with the lookup result. Data are only valid during the call.
+typedef std::function<void(const std::string &key, int rval, MBData &data)> AsyncFindCallback;
+
+// Asynchronous lookup using a pool of reader threads.
+// Lookups that hit unmapped blocks block on pread in the reader thread,
+// so many outstanding lookups keep the storage queue deep while the
+// caller thread keeps submitting. Each thread has its own DB handle.
+class AsyncReader
+{
+public:
+    AsyncReader(const MBConfig &config, int num_threads);
+    ~AsyncReader();
+
+    int  Status() const;
+    // Queue a lookup. Block if there are too many outstanding lookups.
+    int  Find(const std::string &key, AsyncFindCallback callback);
+    // Wait until all queued lookups are done.
+    void Wait();
+    void Stop();
+
+private:
+    typedef struct _AsyncFindRequest
+    {
+        std::string key;
+        AsyncFindCallback callback;
+    } AsyncFindRequest;
+
+    typedef struct _AsyncReaderContext
+    {
+        AsyncReader *reader;
+        DB *db;
+        pthread_t tid;
+        bool running;
+    } AsyncReaderContext;
+
+    static void* async_reader_thread(void *context);
+    void ProcessRequests(DB *db);
+
+    std::vector<AsyncReaderContext> contexts;
+    int status;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond_request;
+    pthread_cond_t  cond_done;
+    std::deque<AsyncFindRequest> requests;
+    int num_pending;
+    bool stop_processing;
+};
+
+}
+
+#endif
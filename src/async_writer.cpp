@@ -18,12 +18,17 @@
 
 #include <unistd.h>
 #include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <new>
 
 #include "async_writer.h"
 #include "error.h"
 #include "logger.h"
 #include "mb_data.h"
+#include "mb_codec.h"
 #include "mb_rc.h"
+#include "mb_snapshot.h"
 #include "integer_4b_5b.h"
 
 namespace mabain {
@@ -46,6 +51,13 @@ static void free_async_node(AsyncNode *node_ptr)
         node_ptr->data_len = 0;
     }
 
+    if(node_ptr->enc_data != NULL)
+    {
+        free(node_ptr->enc_data);
+        node_ptr->enc_data = NULL;
+    }
+    node_ptr->encoded = false;
+
     node_ptr->type = MABAIN_ASYNC_TYPE_NONE;
 }
 
@@ -56,7 +68,9 @@ AsyncWriter::AsyncWriter(DB *db_ptr)
                          tid(0),
                          stop_processing(false),
                          queue_index(0),
-                         writer_index(0)
+                         writer_index(0),
+                         encode_ready(false),
+                         encode_checked(false)
 {
     dict = NULL;
     if(!(db_ptr->GetDBOptions() & CONSTS::ACCESS_MODE_WRITER))
@@ -86,6 +100,8 @@ AsyncWriter::AsyncWriter(DB *db_ptr)
 
     is_rc_running = false;
     rc_backup_dir = NULL;
+    last_expire_check = 0;
+    pthread_mutex_init(&codec_mutex, NULL);
     // start the thread
     if(pthread_create(&tid, NULL, async_thread_wrapper, this) != 0)
     {
@@ -137,6 +153,11 @@ int AsyncWriter::StopAsyncThread()
     if(queue != NULL)
         delete [] queue;
 
+    for(size_t i = 0; i < codecs.size(); i++)
+        delete codecs[i];
+    codecs.clear();
+    pthread_mutex_destroy(&codec_mutex);
+
     return MBError::SUCCESS;
 }
 
@@ -176,17 +197,36 @@ int AsyncWriter::PrepareSlot(AsyncNode *node_ptr) const
 }
 
 int AsyncWriter::Add(const char *key, int key_len, const char *data,
-                     int data_len, bool overwrite)
+                     int data_len, bool overwrite, uint32_t expire_time)
 {
     if(stop_processing)
         return MBError::DB_CLOSED;
 
+    // Encode the value before taking the slot so that values from
+    // concurrent callers are encoded in parallel.
+    EncodedData enc;
+    uint8_t *enc_data = NULL;
+    bool encoded = false;
+    if(encode_ready.load(std::memory_order_acquire) && data_len > 0 &&
+       data_len <= CONSTS::MAX_DATA_SIZE)
+    {
+        int rval = EncodeValue(data, data_len, expire_time, enc, enc_data);
+        if(rval != MBError::SUCCESS)
+            return rval;
+        encoded = true;
+    }
+
     AsyncNode *node_ptr = AcquireSlot();
     if(node_ptr == NULL)
+    {
+        if(enc_data != NULL)
+            free(enc_data);
         return MBError::MUTEX_ERROR;
+    }
 
     node_ptr->key = (char *) malloc(key_len);
     node_ptr->data = (char *) malloc(data_len);
+    node_ptr->enc_data = enc_data;
     if(node_ptr->key == NULL || node_ptr->data == NULL)
     {
         pthread_mutex_unlock(&node_ptr->mutex);
@@ -198,6 +238,17 @@ int AsyncWriter::Add(const char *key, int key_len, const char *data,
     node_ptr->key_len = key_len;
     node_ptr->data_len = data_len;
     node_ptr->overwrite = overwrite;
+    node_ptr->expire_time = expire_time;
+    node_ptr->encoded = encoded;
+    if(encoded)
+    {
+        node_ptr->enc = enc;
+        // Values not compressed are stored from the copy of the value.
+        if(enc_data != NULL)
+            node_ptr->enc.buff = enc_data;
+        else
+            node_ptr->enc.buff = (const uint8_t *) node_ptr->data;
+    }
 
     node_ptr->type = MABAIN_ASYNC_TYPE_ADD;
 
@@ -228,7 +279,7 @@ int AsyncWriter::Remove(const char *key, int len)
     return PrepareSlot(node_ptr);
 }
 
-int AsyncWriter::Backup(const char *backup_dir)
+int AsyncWriter::Backup(const char *backup_dir, bool incremental)
 {
     if(backup_dir == NULL)
         return MBError::INVALID_ARG;
@@ -247,10 +298,48 @@ int AsyncWriter::Backup(const char *backup_dir)
         free_async_node(node_ptr);
         return MBError::NO_MEMORY;
     }
-    node_ptr->type = MABAIN_ASYNC_TYPE_BACKUP;
+    if(incremental)
+        node_ptr->type = MABAIN_ASYNC_TYPE_INCR_BACKUP;
+    else
+        node_ptr->type = MABAIN_ASYNC_TYPE_BACKUP;
     return PrepareSlot(node_ptr);
 }
 
+int AsyncWriter::Snapshot(const char *snapshot_dir)
+{
+    if(snapshot_dir == NULL)
+        return MBError::INVALID_ARG;
+
+    if(stop_processing)
+        return MBError::DB_CLOSED;
+
+    AsyncNode *node_ptr = AcquireSlot();
+    if(node_ptr == NULL)
+        return MBError::MUTEX_ERROR;
+
+    node_ptr->data = (char *) strdup(snapshot_dir);
+    if(node_ptr->data == NULL)
+    {
+        pthread_mutex_unlock(&node_ptr->mutex);
+        free_async_node(node_ptr);
+        return MBError::NO_MEMORY;
+    }
+    node_ptr->type = MABAIN_ASYNC_TYPE_SNAPSHOT;
+    return PrepareSlot(node_ptr);
+}
+
+// Wait for the queued snapshot task to be started and then
+// for the snapshot copy to finish.
+int AsyncWriter::WaitSnapshot()
+{
+    while(Busy() && !stop_processing)
+        usleep(100);
+
+    if(db->snapshot == NULL)
+        return MBError::NOT_EXIST;
+    return db->snapshot->Wait();
+}
+
 int AsyncWriter::RemoveAll()
 {
     if(stop_processing)
@@ -317,8 +406,10 @@ int AsyncWriter::ProcessTask(int ntasks, bool rc_mode)
                         mbd.options = CONSTS::OPTION_RC_MODE;
                     mbd.buff = (uint8_t *) node_ptr->data;
                     mbd.data_len = node_ptr->data_len;
+                    mbd.expire_time = node_ptr->expire_time;
                     try {
-                        rval = dict->Add((uint8_t *)node_ptr->key, node_ptr->key_len, mbd, node_ptr->overwrite);
+                        rval = dict->Add((uint8_t *)node_ptr->key, node_ptr->key_len, mbd, node_ptr->overwrite,
+                                         node_ptr->encoded ? &node_ptr->enc : NULL);
                     } catch (int err) {
                         rval = err;
                         Logger::Log(LOG_LEVEL_ERROR, "dict->Add throws error %s",
@@ -367,6 +458,11 @@ int AsyncWriter::ProcessTask(int ntasks, bool rc_mode)
                     node_ptr->data = NULL;
                     rval = MBError::SUCCESS;
                     break;
+                case MABAIN_ASYNC_TYPE_INCR_BACKUP:
+                case MABAIN_ASYNC_TYPE_SNAPSHOT:
+                    // Buffers are being moved by rc; caller should retry later.
+                    rval = MBError::TRY_AGAIN;
+                    break;
                 default:
                     rval = MBError::INVALID_ARG;
                     break;
@@ -427,7 +523,19 @@ void* AsyncWriter::async_writer_thread()
         {
             if(stop_processing)
                 break;
-            pthread_cond_wait(&node_ptr->cond, &node_ptr->mutex);
+            if(dict->GetHeaderPtr()->has_expire_key)
+            {
+                // Wake up periodically to remove expired entries when idle.
+                struct timespec ts;
+                clock_gettime(CLOCK_REALTIME, &ts);
+                ts.tv_sec++;
+                if(pthread_cond_timedwait(&node_ptr->cond, &node_ptr->mutex, &ts) == ETIMEDOUT)
+                    ReclaimExpired();
+            }
+            else
+            {
+                pthread_cond_wait(&node_ptr->cond, &node_ptr->mutex);
+            }
         }
 
         if(stop_processing && !node_ptr->in_use.load(std::memory_order_consume))
@@ -442,14 +550,18 @@ void* AsyncWriter::async_writer_thread()
             case MABAIN_ASYNC_TYPE_ADD:
                 mbd.buff = (uint8_t *) node_ptr->data;
                 mbd.data_len = node_ptr->data_len;
+                mbd.expire_time = node_ptr->expire_time;
                 try {
                     rval = dict->Add((uint8_t *)node_ptr->key, node_ptr->key_len, mbd,
-                                     node_ptr->overwrite);
+                                     node_ptr->overwrite,
+                                     node_ptr->encoded ? &node_ptr->enc : NULL);
                 } catch (int err) {
                     Logger::Log(LOG_LEVEL_ERROR, "dict->Add throws error %s",
                                 MBError::get_error_str(err));
                     rval = err;
                 }
+                if(!encode_checked)
+                    CheckEncodeReady();
                 break;
             case MABAIN_ASYNC_TYPE_REMOVE:
                 mbd.options |= CONSTS::OPTION_FIND_AND_STORE_PARENT;
@@ -493,6 +605,17 @@ void* AsyncWriter::async_writer_thread()
                     rval = error;
                 }
                     break;
+            case MABAIN_ASYNC_TYPE_INCR_BACKUP:
+                try {
+                    DBBackup mbbk(*db);
+                    rval = mbbk.IncrementalBackup((const char*) node_ptr->data);
+                } catch (int error) {
+                    rval = error;
+                }
+                break;
+            case MABAIN_ASYNC_TYPE_SNAPSHOT:
+                rval = db->StartSnapshot((const char*) node_ptr->data);
+                break;
             default:
                 rval = MBError::INVALID_ARG;
                 break;
@@ -515,6 +638,7 @@ void* AsyncWriter::async_writer_thread()
 
         writer_index++;
         mbd.Clear();
+        ReclaimExpired();
 
         if(is_rc_running)
         {
@@ -545,6 +669,103 @@ void* AsyncWriter::async_writer_thread()
     return NULL;
 }
 
+// Remove a bounded batch of expired entries at most once per second.
+void AsyncWriter::ReclaimExpired()
+{
+    time_t now = time(NULL);
+    if(now == last_expire_check)
+        return;
+    last_expire_check = now;
+
+    try {
+        int cnt = db->SweepExpired(MABAIN_ASYNC_EXPIRE_BATCH);
+        if(cnt > 0)
+            Logger::Log(LOG_LEVEL_DEBUG, "removed %d expired entries", cnt);
+    } catch (int err) {
+        Logger::Log(LOG_LEVEL_WARN, "failed to remove expired entries: %s",
+                    MBError::get_error_str(err));
+    }
+}
+
+// Let the calling threads encode values once the dictionary is trained.
+// Nothing is encoded outside the async thread if values are neither
+// compressed nor checksummed.
+void AsyncWriter::CheckEncodeReady()
+{
+    const uint8_t *comp_dict;
+    int dict_len;
+    if(!dict->GetEncodeDictionary(comp_dict, dict_len))
+        return;
+
+    encode_checked = true;
+    if(dict_len == 0 && !(db->GetDBOptions() & CONSTS::DATA_CHECKSUM))
+        return;
+    encode_dict.assign((const char *) comp_dict, dict_len);
+    encode_ready.store(true, std::memory_order_release);
+}
+
+// Build the data record of the value in the calling thread. enc_data is set
+// to the compressed value if the value is compressed.
+int AsyncWriter::EncodeValue(const char *data, int data_len, uint32_t expire_time,
+                             EncodedData &enc, uint8_t* &enc_data)
+{
+    MBCodec *enc_codec = NULL;
+    enc_data = NULL;
+    if(!encode_dict.empty())
+    {
+        enc_codec = AcquireCodec();
+        // Compressed values are always smaller than the raw values.
+        enc_data = (uint8_t *) malloc(data_len);
+        if(enc_codec == NULL || enc_data == NULL)
+        {
+            ReleaseCodec(enc_codec);
+            if(enc_data != NULL)
+                free(enc_data);
+            enc_data = NULL;
+            return MBError::NO_MEMORY;
+        }
+    }
+
+    dict->EncodeData((const uint8_t *) data, data_len, expire_time, enc_codec,
+                     enc_data, enc);
+    ReleaseCodec(enc_codec);
+    if(enc_data != NULL && enc.buff != enc_data)
+    {
+        free(enc_data);
+        enc_data = NULL;
+    }
+    return MBError::SUCCESS;
+}
+
+MBCodec* AsyncWriter::AcquireCodec()
+{
+    MBCodec *enc_codec = NULL;
+    pthread_mutex_lock(&codec_mutex);
+    if(!codecs.empty())
+    {
+        enc_codec = codecs.back();
+        codecs.pop_back();
+    }
+    pthread_mutex_unlock(&codec_mutex);
+
+    if(enc_codec == NULL)
+    {
+        enc_codec = new (std::nothrow) MBCodec();
+        if(enc_codec != NULL)
+            enc_codec->SetDictionary((const uint8_t *) encode_dict.data(), encode_dict.size());
+    }
+    return enc_codec;
+}
+
+void AsyncWriter::ReleaseCodec(MBCodec *enc_codec)
+{
+    if(enc_codec == NULL)
+        return;
+    pthread_mutex_lock(&codec_mutex);
+    codecs.push_back(enc_codec);
+    pthread_mutex_unlock(&codec_mutex);
+}
+
 void* AsyncWriter::async_thread_wrapper(void *context)
 {
     AsyncWriter *instance_ptr = static_cast<AsyncWriter *>(context);
@@ -20,6 +20,8 @@
 #define __ASYNC_WRITER_H__
 
 #include <pthread.h>
+#include <string>
+#include <vector>
 
 #include "db.h"
 //#include "mb_rc.h"
@@ -28,12 +30,19 @@
 
 namespace mabain {
 
+class MBCodec;
+
 #define MABAIN_ASYNC_TYPE_NONE       0
 #define MABAIN_ASYNC_TYPE_ADD        1
 #define MABAIN_ASYNC_TYPE_REMOVE     2
 #define MABAIN_ASYNC_TYPE_REMOVE_ALL 3
 #define MABAIN_ASYNC_TYPE_RC         4
 #define MABAIN_ASYNC_TYPE_BACKUP     5
+#define MABAIN_ASYNC_TYPE_INCR_BACKUP 6
+#define MABAIN_ASYNC_TYPE_SNAPSHOT   7
+
+// maximum number of expired entries removed per second by async writer
+#define MABAIN_ASYNC_EXPIRE_BATCH    1024
     
 typedef struct _AsyncNode
 {
@@ -47,6 +56,12 @@ typedef struct _AsyncNode
     int data_len;
     bool overwrite;
     char type;
+    uint32_t expire_time;
+
+    // data record encoded by the thread that queued the value
+    bool encoded;
+    EncodedData enc;
+    uint8_t *enc_data;
 } AsyncNode;
 
 class AsyncWriter
@@ -57,10 +72,13 @@ public:
     ~AsyncWriter();
 
     void UpdateNumUsers(int delta);
-    int  Add(const char *key, int key_len, const char *data, int data_len, bool overwrite);
+    int  Add(const char *key, int key_len, const char *data, int data_len, bool overwrite,
+             uint32_t expire_time = 0);
     int  Remove(const char *key, int len);
     int  RemoveAll();
-    int  Backup(const char *backup_dir);
+    int  Backup(const char *backup_dir, bool incremental = false);
+    int  Snapshot(const char *snapshot_dir);
+    int  WaitSnapshot();
     int  CollectResource(int64_t m_index_rc_size, int64_t m_data_rc_size, 
                          int64_t max_dbsz, int64_t max_dbcnt);
     int  StopAsyncThread();
@@ -72,6 +90,12 @@ private:
     AsyncNode* AcquireSlot();
     int PrepareSlot(AsyncNode *node_ptr) const;
     void* async_writer_thread();
+    void ReclaimExpired();
+    void CheckEncodeReady();
+    int  EncodeValue(const char *data, int data_len, uint32_t expire_time,
+                     EncodedData &enc, uint8_t* &enc_data);
+    MBCodec* AcquireCodec();
+    void ReleaseCodec(MBCodec *enc_codec);
 
     static const int max_num_queue_node;
 
@@ -91,6 +115,19 @@ private:
 
     bool is_rc_running;
     char *rc_backup_dir;
+
+    // last time expired entries were reclaimed
+    time_t last_expire_check;
+
+    // Values are compressed and checksummed by the threads calling Add once
+    // the writer has trained the compression dictionary. The async thread
+    // only stores the encoded records.
+    std::atomic<bool> encode_ready;
+    bool encode_checked;
+    std::string encode_dict;
+    // idle codecs for the calling threads
+    pthread_mutex_t codec_mutex;
+    std::vector<MBCodec*> codecs;
 };
 
 }
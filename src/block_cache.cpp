@@ -0,0 +1,157 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+
+#include "block_cache.h"
+#include "error.h"
+#include "logger.h"
+
+namespace mabain {
+
+BlockCache::BlockCache(size_t cache_size, size_t psize)
+                     : page_size(psize),
+                       pages(NULL),
+                       frames(NULL),
+                       clock_hand(0),
+                       hits(0),
+                       misses(0)
+{
+    num_frames = static_cast<int>(cache_size / page_size);
+    if(num_frames <= 0)
+        throw (int) MBError::INVALID_SIZE;
+
+    pages = (uint8_t *) malloc(num_frames * page_size);
+    frames = (CacheFrame *) calloc(num_frames, sizeof(CacheFrame));
+    if(pages == NULL || frames == NULL)
+    {
+        if(pages != NULL)
+            free(pages);
+        if(frames != NULL)
+            free(frames);
+        throw (int) MBError::NO_MEMORY;
+    }
+
+    page_map.reserve(num_frames);
+    Logger::Log(LOG_LEVEL_INFO, "block cache created with %d pages", num_frames);
+}
+
+BlockCache::~BlockCache()
+{
+    free(pages);
+    free(frames);
+}
+
+uint8_t* BlockCache::Lookup(size_t page_off, uint32_t epoch)
+{
+    auto search = page_map.find(page_off);
+    if(search == page_map.end())
+    {
+        misses++;
+        return NULL;
+    }
+
+    CacheFrame &frame = frames[search->second];
+    if(!frame.valid || frame.epoch != epoch)
+    {
+        // The page may have been modified by writer.
+        frame.valid = false;
+        misses++;
+        return NULL;
+    }
+
+    frame.referenced = true;
+    hits++;
+    return pages + search->second * page_size;
+}
+
+uint8_t* BlockCache::Allocate(size_t page_off)
+{
+    int index;
+    auto search = page_map.find(page_off);
+    if(search != page_map.end())
+    {
+        // Reuse the frame of the stale page.
+        index = search->second;
+    }
+    else
+    {
+        // CLOCK replacement: referenced frames get a second chance.
+        while(true)
+        {
+            index = clock_hand;
+            clock_hand = (clock_hand + 1) % num_frames;
+            if(frames[index].referenced)
+            {
+                frames[index].referenced = false;
+                continue;
+            }
+            break;
+        }
+        if(frames[index].in_use)
+            page_map.erase(frames[index].page_off);
+        page_map[page_off] = index;
+    }
+
+    frames[index].page_off = page_off;
+    frames[index].in_use = true;
+    frames[index].valid = false;
+    frames[index].referenced = false;
+    return pages + index * page_size;
+}
+
+void BlockCache::Commit(size_t page_off, uint32_t epoch)
+{
+    auto search = page_map.find(page_off);
+    if(search == page_map.end())
+        return;
+
+    CacheFrame &frame = frames[search->second];
+    frame.epoch = epoch;
+    frame.valid = true;
+    frame.referenced = true;
+}
+
+void BlockCache::Clear()
+{
+    page_map.clear();
+    memset(frames, 0, num_frames * sizeof(CacheFrame));
+    clock_hand = 0;
+}
+
+size_t BlockCache::GetPageSize() const
+{
+    return page_size;
+}
+
+uint64_t BlockCache::GetHits() const
+{
+    return hits;
+}
+
+uint64_t BlockCache::GetMisses() const
+{
+    return misses;
+}
+
+size_t BlockCache::GetCacheSize() const
+{
+    return num_frames * page_size;
+}
+
+}
@@ -0,0 +1,94 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __BLOCK_CACHE_H__
+#define __BLOCK_CACHE_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include <unordered_map>
+
+namespace mabain {
+
+// Default number of epoch counters kept in shared memory for each
+// rollable file. The number is a power of two and can be set by
+// MBConfig::cache_epoch_slots when the DB is created.
+#define BLOCK_CACHE_EPOCH_SLOTS     65536
+#define BLOCK_CACHE_MIN_EPOCH_SLOTS 1024
+#define BLOCK_CACHE_MAX_EPOCH_SLOTS (1 << 24)
+
+// Epoch counter of a page using Fibonacci hashing of the page number.
+// Consecutive pages map to distinct counters. slot_bits is log2 of the
+// number of counters.
+inline uint32_t BlockCacheEpochSlot(size_t page, int slot_bits)
+{
+    return static_cast<uint32_t>((static_cast<uint64_t>(page) * 0x9E3779B97F4A7C15ULL) >>
+                                 (64 - slot_bits));
+}
+
+// Userspace page cache for blocks that are not memory mapped.
+// Pages are replaced using CLOCK (second chance) algorithm.
+// Cache coherence is maintained using epoch counters in shared memory.
+// Writer increments the epoch of a page slot after writing to an unmapped
+// block. A cached page is only valid if the epoch of its slot has not
+// changed since the page was loaded.
+// This class is not thread-safe; each DB handle has its own cache.
+class BlockCache
+{
+public:
+    BlockCache(size_t cache_size, size_t page_size);
+    ~BlockCache();
+
+    // Return the cached page at page_off if it is still valid. Otherwise NULL.
+    uint8_t* Lookup(size_t page_off, uint32_t epoch);
+    // Allocate a frame for page_off. Caller must fill the page and then
+    // call Commit.
+    uint8_t* Allocate(size_t page_off);
+    void     Commit(size_t page_off, uint32_t epoch);
+    void     Clear();
+
+    size_t   GetPageSize() const;
+    uint64_t GetHits() const;
+    uint64_t GetMisses() const;
+    size_t   GetCacheSize() const;
+
+private:
+    typedef struct _CacheFrame
+    {
+        size_t   page_off;
+        uint32_t epoch;
+        bool     in_use;
+        bool     valid;
+        bool     referenced;
+    } CacheFrame;
+
+    size_t page_size;
+    int num_frames;
+    uint8_t *pages;
+    CacheFrame *frames;
+    std::unordered_map<size_t, int> page_map;
+    int clock_hand;
+
+    uint64_t hits;
+    uint64_t misses;
+};
+
+}
+
+#endif
@@ -17,10 +17,13 @@
 // @author Changxue Deng <chadeng@cisco.com>
 
 #include <iostream>
+#include <string.h>
 #include <unistd.h>
 #include <sys/syscall.h>
+#include <time.h>
 
 #include <errno.h>
+#include <sys/mman.h>
 
 #include "dict.h"
 #include "db.h"
@@ -32,7 +35,15 @@
 #include "integer_4b_5b.h"
 #include "async_writer.h"
 #include "mb_backup.h"
+#include "mb_warmup.h"
+#include "mb_snapshot.h"
+#include "mb_repl.h"
+#include "mb_notify.h"
+#include "mb_stats.h"
+#include "mb_slow_log.h"
+#include "mb_hot_keys.h"
 #include "resource_pool.h"
+#include "file_io.h"
 #include "util/utils.h"
 
 namespace mabain {
@@ -40,6 +51,16 @@ namespace mabain {
 // Current mabain version 1.1.0
 uint16_t version[4] = {1, 1, 0, 0};
 
+// Number of entries checked by the expiry sweep for each entry removed
+#define MB_EXPIRE_SCAN_FACTOR 16
+
+// Expired entries are treated as misses by lookup.
+static inline bool entry_expired(const MBData &mdata)
+{
+    return mdata.expire_time != 0 &&
+           mdata.expire_time <= static_cast<uint32_t>(time(NULL));
+}
+
 DB::~DB()
 {
     if(status != MBError::DB_CLOSED)
@@ -50,6 +71,12 @@ int DB::Close()
 {
     int rval = MBError::SUCCESS;
 
+    if(warmup != NULL)
+    {
+        delete warmup;
+        warmup = NULL;
+    }
+
     if((options & CONSTS::ACCESS_MODE_WRITER) && async_writer != NULL)
     {
         rval = async_writer->StopAsyncThread();
@@ -63,6 +90,21 @@ int DB::Close()
         async_writer = NULL;
     }
 
+    if(repl_master != NULL)
+    {
+        dict->SetReplicationLog(NULL);
+        repl_master->Stop();
+        delete repl_master;
+        repl_master = NULL;
+    }
+
+    // Snapshot thread has to finish before dict is closed.
+    if(snapshot != NULL)
+    {
+        delete snapshot;
+        snapshot = NULL;
+    }
+
     if(dict != NULL)
     {
         if(options & CONSTS::ACCESS_MODE_WRITER)
@@ -153,6 +195,8 @@ int DB::ValidateConfig(MBConfig &config)
             return MBError::INVALID_ARG;
         }
     }
+    if(config.options & CONSTS::SHARED_MEMORY_MODE)
+        config.options |= CONSTS::MEMORY_ONLY_MODE;
     if(config.options & CONSTS::USE_SLIDING_WINDOW)
     {
         std::cout << "sliding window support is deprecated\n";
@@ -182,6 +226,9 @@ void DB::InitDB(MBConfig &config)
 {
     dict = NULL;
     async_writer = NULL;
+    warmup = NULL;
+    snapshot = NULL;
+    repl_master = NULL;
 
     if(ValidateConfig(config) != MBError::SUCCESS)
         return;
@@ -200,7 +247,19 @@ void DB::InitDB(MBConfig &config)
     options = config.options;
 
     bool init_header = false;
-    if(config.options & CONSTS::MEMORY_ONLY_MODE)
+    if(config.options & CONSTS::SHARED_MEMORY_MODE)
+    {
+        // Shared memory objects are checked the same way as the files
+        // since they outlive the writer process.
+        if(!FileIO::ShmExists(mb_dir + "_mabain_h"))
+        {
+            if(config.options & CONSTS::ACCESS_MODE_WRITER)
+                init_header = true;
+            else
+                status = MBError::NO_DB;
+        }
+    }
+    else if(config.options & CONSTS::MEMORY_ONLY_MODE)
     {
         if(config.options & CONSTS::ACCESS_MODE_WRITER)
         {
@@ -267,6 +326,27 @@ void DB::InitDB(MBConfig &config)
         return;
     }
 
+    if(config.options & CONSTS::ACCESS_MODE_WRITER)
+    {
+        int rval = dict->InitCacheEpoch(config.cache_epoch_slots);
+        if(rval != MBError::SUCCESS)
+            Logger::Log(LOG_LEVEL_WARN, "failed to initialize cache epochs: %s",
+                        MBError::get_error_str(rval));
+    }
+    else if(config.cache_size_index > 0 || config.cache_size_data > 0)
+    {
+        int rval = dict->InitBlockCache(config.cache_size_index, config.cache_size_data);
+        if(rval != MBError::SUCCESS)
+            Logger::Log(LOG_LEVEL_WARN, "failed to initialize block cache: %s",
+                        MBError::get_error_str(rval));
+    }
+    if(config.slow_op_threshold_us > 0)
+        dict->InitSlowOpLog(config.slow_op_threshold_us);
+    // Readers count hot keys if writer enabled them before readers are opened.
+    if(!(config.options & CONSTS::ACCESS_MODE_WRITER) ||
+       (config.options & CONSTS::HOT_KEY_STATS))
+        dict->InitHotKeys(config.hot_key_sample_rate);
+
     lock.Init(dict->GetShmLockPtrs());
     UpdateNumHandlers(config.options, 1);
 
@@ -277,10 +357,12 @@ void DB::InitDB(MBConfig &config)
         status = ResourcePool::getInstance().AddResourceByPath(lock_file, NULL);
         if(status == MBError::SUCCESS)
         {
-            if(!(config.options & CONSTS::MEMORY_ONLY_MODE))
+            if(!(config.options & CONSTS::MEMORY_ONLY_MODE) ||
+               (config.options & CONSTS::SHARED_MEMORY_MODE))
             {
                 // process check by file lock
-                writer_lock_fd = acquire_writer_lock(lock_file);
+                writer_lock_fd = acquire_writer_lock(lock_file,
+                                     config.options & CONSTS::SHARED_MEMORY_MODE);
                 if(writer_lock_fd < 0)
                     status = MBError::WRITER_EXIST;
             }
@@ -295,8 +377,6 @@ void DB::InitDB(MBConfig &config)
                         MBError::get_error_str(status));
             return;
         }
-        if(config.options & CONSTS::ASYNC_WRITER_MODE)
-            async_writer = new AsyncWriter(this);
     }
 
     Logger::Log(LOG_LEVEL_INFO, "connector %u successfully opened DB %s for %s",
@@ -304,14 +384,44 @@ void DB::InitDB(MBConfig &config)
                 (config.options & CONSTS::ACCESS_MODE_WRITER) ? "writing":"reading");
     status = MBError::SUCCESS;
 
+    if((config.warmup_options & (CONSTS::WARMUP_INDEX | CONSTS::WARMUP_DATA)) &&
+       !(config.options & CONSTS::MEMORY_ONLY_MODE))
+        StartWarmup(config);
+
     if(config.options & CONSTS::ACCESS_MODE_WRITER)
     {
         // Run rc exception recovery
         ResourceCollection rc(*this);
         rc.ExceptionRecovery();
+
+        if(config.options & CONSTS::ASYNC_WRITER_MODE)
+            async_writer = new AsyncWriter(this);
+
+        if(config.repl_endpoint != NULL)
+            StartReplication(config);
     }
 }
 
+void DB::StartReplication(const MBConfig &config)
+{
+    size_t log_size = config.repl_log_size;
+    if(log_size == 0)
+        log_size = MB_REPL_DEFAULT_LOG_SIZE;
+
+    IndexHeader *header = dict->GetHeaderPtr();
+    repl_master = new ReplicationMaster(config.repl_endpoint, header->repl_seq + 1, log_size);
+    int rval = repl_master->Start();
+    if(rval != MBError::SUCCESS)
+    {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to start replication on %s: %s",
+                    config.repl_endpoint, MBError::get_error_str(rval));
+        delete repl_master;
+        repl_master = NULL;
+        return;
+    }
+    dict->SetReplicationLog(repl_master->GetLog());
+}
+
 int DB::Status() const
 {
     return status;
@@ -362,7 +472,23 @@ int DB::Find(const char* key, int len, MBData &mdata) const
     if(options & CONSTS::ASYNC_WRITER_MODE)
         return MBError::NOT_ALLOWED;
 
-    return dict->Find(reinterpret_cast<const uint8_t*>(key), len, mdata);
+    OpStats *op_stats = dict->GetOpStats();
+    SlowOpLog *slow_op_log = dict->GetSlowOpLog();
+    uint64_t start_ns = (op_stats != NULL || slow_op_log != NULL) ? OpStats::Now() : 0;
+    if(slow_op_log != NULL)
+        SlowOpLog::Start();
+    HotKeys *hot_keys = dict->GetHotKeys();
+    if(hot_keys != NULL && !(options & CONSTS::ACCESS_MODE_WRITER))
+        hot_keys->Sample(reinterpret_cast<const uint8_t*>(key), len);
+    int rval = dict->Find(reinterpret_cast<const uint8_t*>(key), len, mdata);
+    if(rval == MBError::SUCCESS && entry_expired(mdata))
+        rval = MBError::NOT_EXIST;
+    if(op_stats != NULL)
+        op_stats->Record(MB_STATS_OP_FIND, start_ns);
+    if(slow_op_log != NULL)
+        slow_op_log->Record(MB_STATS_OP_FIND, reinterpret_cast<const uint8_t*>(key),
+                            len, start_ns);
+    return rval;
 }
 
 int DB::Find(const std::string &key, MBData &mdata) const
@@ -385,9 +511,19 @@ int DB::FindPrefix(const char* key, int len, MBData &data) const
     if(data.match_len >= len)
         return MBError::OUT_OF_BOUND;
 
+    OpStats *op_stats = dict->GetOpStats();
+    SlowOpLog *slow_op_log = dict->GetSlowOpLog();
+    uint64_t start_ns = (op_stats != NULL || slow_op_log != NULL) ? OpStats::Now() : 0;
+    if(slow_op_log != NULL)
+        SlowOpLog::Start();
     int rval;
     rval = dict->FindPrefix(reinterpret_cast<const uint8_t*>(key+data.match_len),
                             len-data.match_len, data);
+    if(op_stats != NULL)
+        op_stats->Record(MB_STATS_OP_FIND_PREFIX, start_ns);
+    if(slow_op_log != NULL)
+        slow_op_log->Record(MB_STATS_OP_FIND_PREFIX, reinterpret_cast<const uint8_t*>(key),
+                            len, start_ns);
 
     return rval;
 }
@@ -405,7 +541,20 @@ int DB::FindLongestPrefix(const char* key, int len, MBData &data) const
 
     data.match_len = 0;
 
-    return dict->FindPrefix(reinterpret_cast<const uint8_t*>(key), len, data);
+    OpStats *op_stats = dict->GetOpStats();
+    SlowOpLog *slow_op_log = dict->GetSlowOpLog();
+    uint64_t start_ns = (op_stats != NULL || slow_op_log != NULL) ? OpStats::Now() : 0;
+    if(slow_op_log != NULL)
+        SlowOpLog::Start();
+    int rval = dict->FindPrefix(reinterpret_cast<const uint8_t*>(key), len, data);
+    if(rval == MBError::SUCCESS && entry_expired(data))
+        rval = MBError::NOT_EXIST;
+    if(op_stats != NULL)
+        op_stats->Record(MB_STATS_OP_FIND_PREFIX, start_ns);
+    if(slow_op_log != NULL)
+        slow_op_log->Record(MB_STATS_OP_FIND_PREFIX, reinterpret_cast<const uint8_t*>(key),
+                            len, start_ns);
+    return rval;
 }
 
 int DB::FindLongestPrefix(const std::string &key, MBData &data) const
@@ -413,6 +562,47 @@ int DB::FindLongestPrefix(const std::string &key, MBData &data) const
     return FindLongestPrefix(key.data(), key.size(), data);
 }
 
+int DB::WaitForKey(const std::string &key, MBData &data, int timeout_ms) const
+{
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+
+    // Feed is created before the lookup so that the add is not missed
+    // if it happens right after the lookup.
+    ChangeFeed feed(*this);
+    if(feed.Status() != MBError::SUCCESS)
+        return feed.Status();
+    int rval = Find(key, data);
+    if(rval != MBError::NOT_EXIST)
+        return rval;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t deadline = static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000 +
+                       timeout_ms;
+    ChangeRecord rec;
+    while(true)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        int64_t remaining = deadline - (static_cast<int64_t>(ts.tv_sec) * 1000 +
+                                        ts.tv_nsec / 1000000);
+        if(remaining <= 0)
+            break;
+        rval = feed.Next(rec, static_cast<int>(remaining));
+        if(rval == MBError::TRY_AGAIN)
+            break;
+        // Look up again if the change of the key may have been lost.
+        if(rval == MBError::BUFFER_LOST || (rec.op == MB_REPL_OP_ADD && rec.key == key))
+        {
+            rval = Find(key, data);
+            if(rval != MBError::NOT_EXIST)
+                return rval;
+        }
+    }
+
+    return MBError::NOT_EXIST;
+}
+
 // Add a key-value pair
 int DB::Add(const char* key, int len, MBData &mbdata, bool overwrite)
 {
@@ -423,7 +613,7 @@ int DB::Add(const char* key, int len, MBData &mbdata, bool overwrite)
 
     if(async_writer != NULL)
         return async_writer->Add(key, len, reinterpret_cast<const char *>(mbdata.buff),
-                                 mbdata.data_len, overwrite);
+                                 mbdata.data_len, overwrite, mbdata.expire_time);
 
     int rval;
     rval = dict->Add(reinterpret_cast<const uint8_t*>(key), len, mbdata, overwrite);
@@ -452,6 +642,35 @@ int DB::Add(const char* key, int len, const char* data, int data_len, bool overw
     return rval;
 }
 
+// Add a key-value pair which expires ttl seconds from now.
+// The entry never expires if ttl is zero.
+int DB::AddWithTTL(const char* key, int len, const char* data, int data_len,
+                   uint32_t ttl, bool overwrite)
+{
+    if(key == NULL || data == NULL)
+        return MBError::INVALID_ARG;
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+
+    uint32_t expire_time = 0;
+    if(ttl > 0)
+        expire_time = static_cast<uint32_t>(time(NULL)) + ttl;
+
+    if(async_writer != NULL)
+        return async_writer->Add(key, len, data, data_len, overwrite, expire_time);
+
+    MBData mbdata;
+    mbdata.data_len = data_len;
+    mbdata.buff = (uint8_t*) data;
+    mbdata.expire_time = expire_time;
+
+    int rval;
+    rval = dict->Add(reinterpret_cast<const uint8_t*>(key), len, mbdata, overwrite);
+
+    mbdata.buff = NULL;
+    return rval;
+}
+
 int DB::Add(const std::string &key, const std::string &value, bool overwrite)
 {
     return Add(key.data(), key.size(), value.data(), value.size(), overwrite);
@@ -491,6 +710,98 @@ int DB::RemoveAll()
     return rval;
 }
 
+// Remove at most max_batch expired entries. This is done by the async
+// writer thread automatically if async writer is enabled.
+int DB::ReclaimExpired(int max_batch)
+{
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    if(!(options & CONSTS::ACCESS_MODE_WRITER))
+        return MBError::NOT_ALLOWED;
+    if(async_writer != NULL)
+        return MBError::SUCCESS;
+
+    int rval = MBError::SUCCESS;
+    try {
+        int cnt = SweepExpired(max_batch);
+        if(cnt > 0)
+            Logger::Log(LOG_LEVEL_DEBUG, "removed %d expired entries", cnt);
+    } catch (int error) {
+        Logger::Log(LOG_LEVEL_WARN, "failed to remove expired entries: %s",
+                    MBError::get_error_str(error));
+        rval = error;
+    }
+    return rval;
+}
+
+// Expired entries are found by checking the entries in key order. At most
+// max_batch * MB_EXPIRE_SCAN_FACTOR entries are checked in each call so that
+// the writer is not blocked for too long. The next call starts after the last
+// key checked, which is kept in the header. Returns the number of entries
+// removed.
+int DB::SweepExpired(int max_batch)
+{
+    IndexHeader *header = dict->GetHeaderPtr();
+    if(!header->has_expire_key || max_batch <= 0)
+        return 0;
+    // Removing entries during rc is not supported.
+    if(header->rc_root_offset.load(std::memory_order_relaxed) != 0)
+        return 0;
+
+    uint32_t now = static_cast<uint32_t>(time(NULL));
+    std::string start_key(reinterpret_cast<const char *>(header->expire_cursor),
+                          header->expire_cursor_len);
+    std::string cursor = start_key;
+    std::vector<std::string> keys;
+    int64_t max_scan = static_cast<int64_t>(max_batch) * MB_EXPIRE_SCAN_FACTOR;
+    int64_t num_scan = 0;
+    bool stop = false;
+
+    // The second round starts from the first key and stops after start_key.
+    for(int round = 0; round < 2 && !stop; round++)
+    {
+        for(iterator iter = begin_after(cursor); iter != end(); ++iter)
+        {
+            if(round > 0 && iter.key.compare(start_key) > 0)
+            {
+                stop = true;
+                break;
+            }
+            cursor = iter.key;
+            if(iter.value.expire_time != 0 && iter.value.expire_time <= now)
+                keys.push_back(iter.key);
+            if(++num_scan >= max_scan || static_cast<int>(keys.size()) >= max_batch)
+            {
+                stop = true;
+                break;
+            }
+        }
+        if(!stop)
+        {
+            cursor.clear();
+            if(start_key.empty())
+                break;
+        }
+    }
+
+    size_t cursor_len = std::min(cursor.size(), static_cast<size_t>(MB_EXPIRE_CURSOR_SIZE));
+    memcpy(header->expire_cursor, cursor.data(), cursor_len);
+    header->expire_cursor_len = static_cast<uint16_t>(cursor_len);
+
+    int count = 0;
+    int rval;
+    for(size_t i = 0; i < keys.size(); i++)
+    {
+        rval = dict->Remove(reinterpret_cast<const uint8_t *>(keys[i].data()), keys[i].size());
+        if(rval == MBError::SUCCESS)
+            count++;
+        else
+            Logger::Log(LOG_LEVEL_DEBUG, "failed to remove expired entry: %s",
+                        MBError::get_error_str(rval));
+    }
+    return count;
+}
+
 int DB::Backup(const char *bk_dir)
 {
     if(bk_dir == NULL)
@@ -514,6 +825,88 @@ int DB::Backup(const char *bk_dir)
     return rval;
 }
 
+int DB::IncrementalBackup(const char *bk_dir)
+{
+    if(bk_dir == NULL)
+        return MBError::INVALID_ARG;
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    if(options & MMAP_ANONYMOUS_MODE)
+        return MBError::NOT_ALLOWED;
+
+    if(async_writer != NULL)
+        return async_writer->Backup(bk_dir, true);
+
+    int rval;
+    try {
+        DBBackup bk(*this);
+        rval = bk.IncrementalBackup(bk_dir);
+    } catch  (int error) {
+        Logger::Log(LOG_LEVEL_WARN, "Incremental backup failed :%s",
+                    MBError::get_error_str(error));
+        rval = error;
+    }
+    return rval;
+}
+
+int DB::Snapshot(const char *snapshot_dir)
+{
+    if(snapshot_dir == NULL)
+        return MBError::INVALID_ARG;
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    // Anonymous memory cannot be read by the snapshot thread.
+    if((options & CONSTS::MEMORY_ONLY_MODE) && !(options & CONSTS::SHARED_MEMORY_MODE))
+        return MBError::NOT_ALLOWED;
+
+    if(async_writer != NULL)
+        return async_writer->Snapshot(snapshot_dir);
+
+    if(!(options & CONSTS::ACCESS_MODE_WRITER))
+        return MBError::NOT_ALLOWED;
+    return StartSnapshot(snapshot_dir);
+}
+
+// Called by the writer thread
+int DB::StartSnapshot(const char *snapshot_dir)
+{
+    if(snapshot != NULL)
+    {
+        if(!snapshot->Done())
+            return MBError::TRY_AGAIN;
+        delete snapshot;
+        snapshot = NULL;
+    }
+
+    int rval;
+    try {
+        snapshot = new DBSnapshot(*this);
+        rval = snapshot->Start(snapshot_dir);
+    } catch (int error) {
+        Logger::Log(LOG_LEVEL_WARN, "Snapshot failed :%s", MBError::get_error_str(error));
+        if(snapshot != NULL)
+        {
+            delete snapshot;
+            snapshot = NULL;
+        }
+        rval = error;
+    }
+    return rval;
+}
+
+int DB::WaitSnapshot()
+{
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+
+    if(async_writer != NULL)
+        return async_writer->WaitSnapshot();
+
+    if(snapshot == NULL)
+        return MBError::NOT_EXIST;
+    return snapshot->Wait();
+}
+
 void DB::Flush() const
 {
     if(status != MBError::SUCCESS)
@@ -561,6 +954,102 @@ void DB::PrintStats(std::ostream &out_stream) const
     dict->PrintStats(out_stream);
 }
 
+int DB::GetLatencyStats(int op, LatencyStats &stats) const
+{
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    if(op < 0 || op >= MB_STATS_NUM_OPS)
+        return MBError::INVALID_ARG;
+
+    OpStats *op_stats = dict->GetOpStats();
+    if(op_stats == NULL)
+        return MBError::NOT_EXIST;
+    op_stats->Get(op, stats);
+    return MBError::SUCCESS;
+}
+
+int DB::GetWriterLatencyStats(int op, LatencyStats &stats) const
+{
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    if(op < 0 || op >= MB_STATS_NUM_OPS)
+        return MBError::INVALID_ARG;
+
+    OpStats *op_stats = dict->GetWriterOpStats();
+    if(op_stats == NULL)
+        return MBError::NOT_EXIST;
+    op_stats->Get(op, stats);
+    return MBError::SUCCESS;
+}
+
+int DB::GetSlowOps(std::vector<SlowOp> &slow_ops) const
+{
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+
+    SlowOpLog *slow_op_log = dict->GetSlowOpLog();
+    if(slow_op_log == NULL)
+        return MBError::NOT_EXIST;
+    slow_op_log->Get(slow_ops);
+    return MBError::SUCCESS;
+}
+
+int DB::GetResourceUsage(ResourceUsage &usage) const
+{
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+
+    dict->GetResourceUsage(usage);
+    return MBError::SUCCESS;
+}
+
+int DB::GetHotKeys(std::vector<HotKey> &hot_keys) const
+{
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+
+    HotKeys *dict_hot_keys = dict->GetHotKeys();
+    if(dict_hot_keys == NULL)
+        return MBError::NOT_EXIST;
+    dict_hot_keys->Get(hot_keys);
+    return MBError::SUCCESS;
+}
+
+void DB::PrintLatencyStats(std::ostream &out_stream) const
+{
+    const char *op_names[MB_STATS_NUM_OPS] = {"find", "findPrefix", "add", "remove", "rc"};
+    const char *sources[2] = {"this handle", "writer"};
+    LatencyStats stats;
+
+    for(int n = 0; n < 2; n++)
+    {
+        // Writer handle records to the writer histograms.
+        if(n == 0 && (options & CONSTS::ACCESS_MODE_WRITER))
+            continue;
+        if(n == 0 && GetLatencyStats(MB_STATS_OP_FIND, stats) != MBError::SUCCESS)
+            continue;
+        if(n == 1 && GetWriterLatencyStats(MB_STATS_OP_FIND, stats) != MBError::SUCCESS)
+        {
+            out_stream << "Writer latency stats not enabled\n";
+            continue;
+        }
+
+        out_stream << "Latency stats of " << sources[n] << " (us):\n";
+        out_stream << "\top\t\tcount\tmean\tp50\tp99\tp999\tmax\n";
+        for(int op = 0; op < MB_STATS_NUM_OPS; op++)
+        {
+            if(n == 0)
+                GetLatencyStats(op, stats);
+            else
+                GetWriterLatencyStats(op, stats);
+            out_stream << "\t" << op_names[op] << (strlen(op_names[op]) < 8 ? "\t\t" : "\t")
+                       << stats.count << "\t" << stats.mean_ns/1000. << "\t"
+                       << stats.p50_ns/1000. << "\t" << stats.p99_ns/1000. << "\t"
+                       << stats.p999_ns/1000. << "\t" << stats.max_ns/1000. << std::endl;
+        }
+    }
+}
+
 void DB::PrintHeader(std::ostream &out_stream) const
 {
     if(dict != NULL)
@@ -683,6 +1172,30 @@ bool DB::AsyncWriterBusy() const
     return false;
 }
 
+void DB::StartWarmup(const MBConfig &config)
+{
+    std::vector<std::pair<uint8_t*, size_t>> regions;
+    dict->GetMappedRegions(config.warmup_options & CONSTS::WARMUP_INDEX,
+                           config.warmup_options & CONSTS::WARMUP_DATA,
+                           regions);
+
+    warmup = new DBWarmup(config.warmup_options, config.warmup_threads);
+    for(auto it = regions.begin(); it != regions.end(); ++it)
+        warmup->AddRegion(it->first, it->second);
+    if(warmup->Start() != MBError::SUCCESS)
+    {
+        delete warmup;
+        warmup = NULL;
+    }
+}
+
+int DB::GetWarmupProgress() const
+{
+    if(warmup != NULL)
+        return warmup->GetProgress();
+    return 100;
+}
+
 void DB::SetLogFile(const std::string &log_file)
 {
     Logger::InitLogFile(log_file);
@@ -698,4 +1211,52 @@ void DB::ClearResources(const std::string &path)
     ResourcePool::getInstance().RemoveResourceByDB(path);
 }
 
+int DB::RestoreSharedMemory(const char *src_dir, const char *mbdir)
+{
+    if(src_dir == NULL || mbdir == NULL)
+        return MBError::INVALID_ARG;
+
+    int rval;
+    try {
+        rval = DBBackup::RestoreSharedMemory(src_dir, mbdir);
+    } catch (int error) {
+        rval = error;
+    }
+    return rval;
+}
+
+// Remove the header first so that the DB cannot be opened while the
+// blocks are being removed. Handles still open keep their mappings.
+int DB::RemoveSharedMemory(const char *mbdir)
+{
+    if(mbdir == NULL)
+        return MBError::INVALID_ARG;
+
+    std::string dir = mbdir;
+    if(dir.empty() || dir[dir.length()-1] != '/')
+        dir += "/";
+    ClearResources(dir);
+
+    int rval = MBError::NOT_EXIST;
+    if(shm_unlink(FileIO::ShmName(dir + "_mabain_h").c_str()) == 0)
+        rval = MBError::SUCCESS;
+    shm_unlink(FileIO::ShmName(dir + "_mabain_notify").c_str());
+    shm_unlink(FileIO::ShmName(dir + "_mabain_stats").c_str());
+    shm_unlink(FileIO::ShmName(dir + "_mabain_hotkeys").c_str());
+    shm_unlink(FileIO::ShmName(dir + "_mabain_epoch").c_str());
+    shm_unlink(FileIO::ShmName(dir + "_lock").c_str());
+    // Blocks are created in order.
+    const char *block_prefix[] = {"_mabain_i", "_mabain_d"};
+    for(int n = 0; n < 2; n++)
+    {
+        for(int i = 0; ; i++)
+        {
+            std::string block_path = dir + block_prefix[n] + std::to_string(i);
+            if(shm_unlink(FileIO::ShmName(block_path).c_str()) != 0)
+                break;
+        }
+    }
+    return rval;
+}
+
 } // namespace mabain
@@ -21,6 +21,7 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "mb_data.h"
 #include "error.h"
@@ -33,8 +34,114 @@ class Dict;
 class MBlsq;
 class LockFree;
 class AsyncWriter;
+class DBWarmup;
+class DBSnapshot;
+class ReplicationMaster;
 struct _DBTraverseNode;
 
+// Operations with latency histograms
+#define MB_STATS_OP_FIND         0
+#define MB_STATS_OP_FIND_PREFIX  1
+#define MB_STATS_OP_ADD          2
+#define MB_STATS_OP_REMOVE       3
+#define MB_STATS_OP_RC           4
+#define MB_STATS_NUM_OPS         5
+
+// Latencies in nanoseconds
+typedef struct _LatencyStats
+{
+    uint64_t count;
+    uint64_t mean_ns;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t max_ns;
+} LatencyStats;
+
+// Cost of a lookup. Counters are only gathered if the library is built
+// with __SLOW_OP_LOG__.
+typedef struct _OpCost
+{
+    // edges visited
+    uint32_t hops;
+    // lock-free reader retries after the writer modified the edges read
+    uint32_t retries;
+    // edge strings read from out of the edges
+    uint32_t edge_reads;
+    // pread calls on blocks that are not memory mapped
+    uint32_t sys_reads;
+    uint64_t sys_read_bytes;
+    // value bytes copied to MBData
+    uint64_t copy_bytes;
+    // time slept before the retries
+    uint64_t sleep_ns;
+} OpCost;
+
+// Number of slow operations kept by each handle
+#define MB_SLOW_OP_LOG_SIZE      64
+
+typedef struct _SlowOp
+{
+    // MB_STATS_OP_FIND or MB_STATS_OP_FIND_PREFIX
+    int op;
+    // crc32c of the key
+    uint32_t key_hash;
+    uint64_t latency_ns;
+    OpCost cost;
+} SlowOp;
+
+// Number of hot keys tracked
+#define MB_HOT_KEY_TOP_K                   32
+#define MB_HOT_KEY_DEFAULT_SAMPLE_RATE     100
+
+typedef struct _HotKey
+{
+    // Only the first 64 bytes are kept for longer keys.
+    std::string key;
+    int key_len;
+    // estimated number of finds by all reader handles
+    uint64_t count;
+} HotKey;
+
+// Free buffers are counted in power of two size classes up to 64K.
+#define MB_USAGE_NUM_SIZE_CLASS  17
+
+// Usage of the index or data blocks by a DB handle
+typedef struct _FileUsage
+{
+    // block files opened
+    int num_block;
+    // blocks mapped in full; other blocks are read using pread unless
+    // they are in the sliding window.
+    int num_mapped_block;
+    // bytes of the blocks mapped, the sliding window and the hot blocks of
+    // adaptive mmap
+    size_t mapped_bytes;
+    // memory used by the reader block cache
+    size_t cache_bytes;
+} FileUsage;
+
+typedef struct _ResourceUsage
+{
+    FileUsage index;
+    FileUsage data;
+    // Bytes in the free lists of writer. Size class n holds the buffers
+    // of sizes from 2^n to 2^(n+1)-1. Always zero for readers.
+    int64_t index_free_bytes[MB_USAGE_NUM_SIZE_CLASS];
+    int64_t data_free_bytes[MB_USAGE_NUM_SIZE_CLASS];
+    // released buffers, including those not in the free lists
+    int64_t pending_index_buff_size;
+    int64_t pending_data_buff_size;
+    // Resource collection builds a new index under rc_root_offset. Bytes
+    // used by resource collection are those added since it started.
+    size_t  rc_root_offset;
+    int64_t rc_count;
+    size_t  rc_index_bytes;
+    size_t  rc_data_bytes;
+    // live key count
+    int64_t count;
+} ResourceUsage;
+
 typedef struct _MBConfig
 {
     const char *mbdir;
@@ -51,26 +158,72 @@ typedef struct _MBConfig
     // For automatic eviction
     // All entries in the oldest buckets will be pruned.
     int num_entry_per_bucket;
+
+    // Reader page cache sizes for index and data blocks that are not
+    // memory mapped. Zero disables the cache.
+    size_t cache_size_index;
+    size_t cache_size_data;
+    // Number of epoch counters used by readers to validate the cached pages.
+    // Every write invalidates the cached pages sharing a counter with the
+    // modified pages. Rounded up to a power of two and only used when the
+    // DB is created. Zero uses the default (BLOCK_CACHE_EPOCH_SLOTS).
+    uint32_t cache_epoch_slots;
+
+    // Prefault memory mapped blocks in background after DB is opened.
+    // See CONSTS::WARMUP_* for the options. Zero disables warmup.
+    int warmup_options;
+    int warmup_threads;
+
+    // Ship mutations done by writer to followers connected to the endpoint,
+    // a Unix domain socket path or host:port. NULL disables replication.
+    const char *repl_endpoint;
+    // Size of mutation records kept in memory for followers to resume.
+    // Default is MB_REPL_DEFAULT_LOG_SIZE if zero.
+    size_t repl_log_size;
+
+    // Log lookups taking longer than the threshold in microseconds with
+    // their cost. Zero disables the slow operation log.
+    uint32_t slow_op_threshold_us;
+
+    // Readers count one in hot_key_sample_rate finds for hot key detection
+    // if writer is opened with CONSTS::HOT_KEY_STATS. Default is
+    // MB_HOT_KEY_DEFAULT_SAMPLE_RATE if zero. Only used by writer.
+    uint32_t hot_key_sample_rate;
 } MBConfig;
 
 // Database handle class
 class DB
 {
+    // Verifier and analyzer need dict of reader handles.
+    friend class DBVerifier;
+    friend class DBAnalyzer;
+    // Snapshot is started by the async writer thread.
+    friend class AsyncWriter;
+    // Change feed reads the change ring of reader handles.
+    friend class ChangeFeed;
+
 public:
     // DB iterator class as an inner class
     class iterator
     {
     friend class DBTraverseBase;
+    friend class DBVerifier;
 
     public:
         std::string key;
         MBData value;
         int match;
 
-        iterator(const DB &db, int iter_state);
+        iterator(const DB &db, int iter_state, bool include_expired = false);
         // Copy constructor
         iterator(const iterator &rhs);
         void init(bool check_async_mode = true);
+        // Initialize the iterator over entries starting with the prefix.
+        // These entries are returned in key order.
+        void init_prefix(const std::string &prefix);
+        // Initialize the iterator over entries with keys greater than
+        // start_key. These entries are returned in key order.
+        void init_after(const std::string &start_key);
         int init_no_next();
         ~iterator();
 
@@ -84,6 +237,7 @@ public:
         int  load_node(const std::string &curr_node_key, size_t &parent_edge_off);
         int  load_kv_for_node(const std::string &curr_node_key);
         int  load_kvs(const std::string &curr_node_key, MBlsq *chid_node_list);
+        void push_in_order(MBlsq *child_node_list);
         void iter_obj_init();
         bool next_dbt_buffer(struct _DBTraverseNode *dbt_n);
         void add_node_offset(size_t node_offset);
@@ -97,6 +251,15 @@ public:
         MBlsq *node_stack;
         MBlsq *kv_per_node;
         LockFree *lfree;
+        // Expired entries are returned only if set. Used by the writer for
+        // eviction and for removing expired entries.
+        bool include_expired;
+        // If set, entries and child nodes are both kept in node_stack in
+        // key order, and only the ones matching prefix and greater than
+        // start_key are kept.
+        bool in_order;
+        std::string prefix;
+        std::string start_key;
     };
 
     // db_path: database directory
@@ -117,6 +280,12 @@ public:
     int Add(const char* key, int len, const char* data, int data_len, bool overwrite = false);
     int Add(const char* key, int len, MBData &data, bool overwrite = false);
     int Add(const std::string &key, const std::string &value, bool overwrite = false);
+    // Add a key-value pair that expires after ttl seconds. Expired entries
+    // are treated as misses by lookup and iterator, and are removed by the
+    // writer in the background (async writer) or by calling ReclaimExpired.
+    // Expiry time can also be set using MBData::expire_time.
+    int AddWithTTL(const char* key, int len, const char* data, int data_len,
+                   uint32_t ttl, bool overwrite = false);
     // Find an entry by exact match using a key
     int Find(const char* key, int len, MBData &mdata) const;
     int Find(const std::string &key, MBData &mdata) const;
@@ -126,17 +295,38 @@ public:
     // Find the longest prefix match using a key
     int FindLongestPrefix(const char* key, int len, MBData &data) const;
     int FindLongestPrefix(const std::string &key, MBData &data) const;
+    // Wait at most timeout_ms for the key to be added. NOT_EXIST is returned
+    // on timeout. Writer must be opened with CONSTS::CHANGE_NOTIFY.
+    int WaitForKey(const std::string &key, MBData &data, int timeout_ms) const;
     // Remove an entry using a key
     int Remove(const char *key, int len);
     int Remove(const std::string &key);
     int RemoveAll();
+    // Remove at most max_batch expired entries. Entries are checked in key
+    // order starting after the key where the last call stopped, which is
+    // kept in the DB header so that a new writer handle resumes from there.
+    int ReclaimExpired(int max_batch = 1024);
     // DB Backup
     int Backup(const char *backup_dir);
+    // Copy the ranges modified since the last backup to backup_dir,
+    // which must hold the last backup of this DB.
+    int IncrementalBackup(const char *backup_dir);
+    // Copy the DB image at the time of the call to snapshot_dir in a
+    // background thread while writer keeps running. This is also how a
+    // CONSTS::SHARED_MEMORY_MODE DB is persisted to disk.
+    int Snapshot(const char *snapshot_dir);
+    // Wait for the last snapshot to finish and return its status.
+    int WaitSnapshot();
 
     // Close the DB handle
     int  Close();
     void Flush() const;
     static void ClearResources(const std::string &path);
+    // Copy a DB on disk, e.g., a snapshot, to the shared memory objects of
+    // mbdir so that it can be opened with CONSTS::SHARED_MEMORY_MODE.
+    static int  RestoreSharedMemory(const char *src_dir, const char *mbdir);
+    // Remove the shared memory objects of mbdir.
+    static int  RemoveSharedMemory(const char *mbdir);
 
     // Garbage collection
     // min_index_rc_size and min_data_rc_size are the threshold for trigering garbage
@@ -155,6 +345,10 @@ public:
     bool AsyncWriterEnabled() const;
     bool AsyncWriterBusy() const;
 
+    // Percentage of mapped memory prefaulted by warmup at open.
+    // 100 if warmup is done or not enabled.
+    int  GetWarmupProgress() const;
+
     // multi-thread or multi-process locking for DB management
     int WrLock();
     int RdLock();
@@ -175,7 +369,24 @@ public:
 
     // Print database stats
     void PrintStats(std::ostream &out_stream = std::cout) const;
+    // Latency of the operation (MB_STATS_OP_*) done by this handle. The
+    // handle must be opened with CONSTS::LATENCY_STATS.
+    int  GetLatencyStats(int op, LatencyStats &stats) const;
+    // Latency of the operation done by writer, which must be opened with
+    // CONSTS::LATENCY_STATS. This can be called by any handle of the DB.
+    int  GetWriterLatencyStats(int op, LatencyStats &stats) const;
+    void PrintLatencyStats(std::ostream &out_stream = std::cout) const;
+    // The last MB_SLOW_OP_LOG_SIZE slow lookups of this handle, oldest
+    // first. MBConfig::slow_op_threshold_us must be set.
+    int  GetSlowOps(std::vector<SlowOp> &slow_ops) const;
+    // The MB_HOT_KEY_TOP_K keys found most often by readers of all
+    // processes, in descending order of the estimated count. Writer must be
+    // opened with CONSTS::HOT_KEY_STATS.
+    int  GetHotKeys(std::vector<HotKey> &hot_keys) const;
     void PrintHeader(std::ostream &out_stream = std::cout) const;
+    // Memory and space used by this handle. Only reads values already
+    // tracked so that it can be polled frequently.
+    int  GetResourceUsage(ResourceUsage &usage) const;
     // current count of key-value pair
     int64_t Count() const;
     // DB status
@@ -192,12 +403,21 @@ public:
     void GetDBConfig(MBConfig &config) const;
 
     //iterator
-    const iterator begin(bool check_async_mode = true, bool rc_mode = false) const;
+    const iterator begin(bool check_async_mode = true, bool rc_mode = false,
+                         bool include_expired = false) const;
+    // Only entries starting with the prefix are returned, in key order.
+    // Nodes not leading to the prefix are not visited.
+    const iterator begin_prefix(const std::string &prefix) const;
     const iterator end() const;
 
 private:
     void InitDB(MBConfig &config);
     static int ValidateConfig(MBConfig &config);
+    void StartWarmup(const MBConfig &config);
+    int  StartSnapshot(const char *snapshot_dir);
+    void StartReplication(const MBConfig &config);
+    const iterator begin_after(const std::string &start_key) const;
+    int  SweepExpired(int max_batch);
 
     // DB directory
     std::string mb_dir;
@@ -213,6 +433,9 @@ private:
     MBConfig dbConfig;
 
     AsyncWriter *async_writer;
+    DBWarmup *warmup;
+    DBSnapshot *snapshot;
+    ReplicationMaster *repl_master;
 
     int writer_lock_fd;
 };
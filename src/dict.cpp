@@ -19,6 +19,8 @@
 #include <stdlib.h>
 #include <iostream>
 #include <errno.h>
+#include <unistd.h>
+#include <time.h>
 
 #include "mabain_consts.h"
 #include "db.h"
@@ -26,6 +28,13 @@
 #include "dict_mem.h"
 #include "error.h"
 #include "integer_4b_5b.h"
+#include "crc32c.h"
+#include "mb_repl.h"
+#include "mb_notify.h"
+#include "mb_stats.h"
+#include "mb_slow_log.h"
+#include "mb_hot_keys.h"
+#include "resource_pool.h"
 
 #define MAX_DATA_BUFFER_RESERVE_SIZE    0xFFFF
 #define NUM_DATA_BUFFER_RESERVE         MAX_DATA_BUFFER_RESERVE_SIZE/DATA_BUFFER_ALIGNMENT
@@ -49,10 +58,22 @@ Dict::Dict(const std::string &mbdir, bool init_header, int datasize,
            int max_num_index_blk, int max_num_data_blk,
            int64_t entry_per_bucket)
          : options(db_options),
-           mm(mbdir, init_header, memsize_index, db_options, block_sz_idx, max_num_index_blk)
+           mm(mbdir, init_header, memsize_index, db_options, block_sz_idx, max_num_index_blk),
+           stats_path(mbdir + "_mabain_stats"),
+           hot_keys_path(mbdir + "_mabain_hotkeys"),
+           epoch_path(mbdir + "_mabain_epoch")
 {
     status = MBError::NOT_INITIALIZED;
     reader_rc_off = 0;
+    codec = NULL;
+    compress_buff = NULL;
+    repl_log = NULL;
+    change_ring = NULL;
+    op_stats = NULL;
+    writer_stats = NULL;
+    slow_op_log = NULL;
+    hot_keys = NULL;
+    train_size = 0;
 
     header = mm.GetHeaderPtr();
     if(header == NULL)
@@ -80,11 +101,15 @@ Dict::Dict(const std::string &mbdir, bool init_header, int datasize,
     mm.InitLockFreePtr(&lfree);
 
     // Open data file
+    if(mm.IsCompactIndex())
+        max_num_data_blk = CompactMaxNumBlock(max_num_data_blk, header->data_block_size);
     kv_file = new RollableFile(mbdir + "_mabain_d",
                                static_cast<size_t>(header->data_block_size),
                                memsize_data, db_options, max_num_data_blk);
 
     kv_file->InitShmSlidingAddr(&header->shm_data_sliding_start);
+    if((db_options & CONSTS::ACCESS_MODE_WRITER) && !(db_options & CONSTS::MEMORY_ONLY_MODE))
+        kv_file->InitDirtyMap(mbdir + "_dbdirty");
     // If init_header is false, we can set the dict status to SUCCESS.
     // Otherwise, the status will be set in the Init.
     if(init_header)
@@ -131,6 +156,13 @@ Dict::Dict(const std::string &mbdir, bool init_header, int datasize,
                 status = MBError::SUCCESS;
         }
     }
+
+    if((options & CONSTS::ACCESS_MODE_WRITER) && (options & CONSTS::COMPRESS_DATA))
+        InitCodec();
+    if(!(options & CONSTS::ACCESS_MODE_WRITER) || (options & CONSTS::CHANGE_NOTIFY))
+        InitChangeRing(mbdir + "_mabain_notify");
+    if(options & CONSTS::LATENCY_STATS)
+        InitOpStats();
 }
 
 Dict::~Dict()
@@ -189,6 +221,26 @@ void Dict::Destroy()
 
     if(kv_file != NULL)
         delete kv_file;
+
+    if(codec != NULL)
+        delete codec;
+    if(compress_buff != NULL)
+        free(compress_buff);
+    if(change_ring != NULL)
+        delete change_ring;
+    change_ring = NULL;
+    if(writer_stats != NULL && writer_stats != op_stats)
+        delete writer_stats;
+    writer_stats = NULL;
+    if(op_stats != NULL)
+        delete op_stats;
+    op_stats = NULL;
+    if(slow_op_log != NULL)
+        delete slow_op_log;
+    slow_op_log = NULL;
+    if(hot_keys != NULL)
+        delete hot_keys;
+    hot_keys = NULL;
 }
 
 int Dict::Status() const
@@ -199,7 +251,39 @@ int Dict::Status() const
 // Add a key-value pair
 // if overwrite is true and an entry with input key already exists, the old data will
 // be overwritten. Otherwise, IN_DICT will be returned.
-int Dict::Add(const uint8_t *key, int len, MBData &data, bool overwrite)
+// data always has the original value, which is used for replication.
+int Dict::Add(const uint8_t *key, int len, MBData &data, bool overwrite,
+              const EncodedData *enc)
+{
+    uint64_t start_ns = (op_stats != NULL) ? OpStats::Now() : 0;
+    int rval = CALL_EDGE_FORMAT(mm.IsCompactIndex(), Add_Internal, key, len, data, overwrite,
+                                enc);
+    if(rval == MBError::SUCCESS && !(data.options & CONSTS::OPTION_SKIP_REPL_LOG))
+        LogMutation(MB_REPL_OP_ADD, key, len, data.buff, data.data_len, data.expire_time);
+    if(op_stats != NULL)
+        op_stats->Record(MB_STATS_OP_ADD, start_ns);
+    return rval;
+}
+
+// Return false if values cannot be encoded outside Add since the writer
+// is still collecting samples for the compression dictionary. dict_len is
+// set to 0 if values are not compressed.
+bool Dict::GetEncodeDictionary(const uint8_t* &comp_dict, int &dict_len) const
+{
+    comp_dict = NULL;
+    dict_len = 0;
+    if(codec == NULL)
+        return true;
+    if(header->compress_dict_len == 0)
+        return false;
+    comp_dict = header->compress_dict;
+    dict_len = header->compress_dict_len;
+    return true;
+}
+
+template<typename EF>
+int Dict::Add_Internal(const uint8_t *key, int len, MBData &data, bool overwrite,
+                       const EncodedData *enc)
 {
     if(!(options & CONSTS::ACCESS_MODE_WRITER))
         return MBError::NOT_ALLOWED;
@@ -211,15 +295,17 @@ int Dict::Add(const uint8_t *key, int len, MBData &data, bool overwrite)
     size_t data_offset = 0;
     int rval;
 
-    rval = mm.GetRootEdge_Writer(data.options & CONSTS::OPTION_RC_MODE, key[0], edge_ptrs);
+    rval = mm.GetRootEdge_Writer<EF>(data.options & CONSTS::OPTION_RC_MODE, key[0], edge_ptrs);
     if(rval != MBError::SUCCESS)
         return rval;
 
     if(edge_ptrs.len_ptr[0] == 0)
     {
-        ReserveData(data.buff, data.data_len, data_offset);
+        ReserveData(data.buff, data.data_len, data_offset, data.expire_time, enc);
         // Add the first edge along this edge
-        mm.AddRootEdge(edge_ptrs, key, len, data_offset);
+        mm.AddRootEdge<EF>(edge_ptrs, key, len, data_offset);
+        if(data.expire_time != 0)
+            header->has_expire_key = 1;
         if(data.options & CONSTS::OPTION_RC_MODE)
         {
             header->rc_count++;
@@ -239,9 +325,9 @@ int Dict::Add(const uint8_t *key, int len, MBData &data, bool overwrite)
     uint8_t tmp_key_buff[NUM_ALPHABET];
     const uint8_t *p = key;
     int edge_len = edge_ptrs.len_ptr[0];
-    if(edge_len > LOCAL_EDGE_LEN)
+    if(edge_len > EF::local_edge_len)
     {
-        if(mm.ReadData(tmp_key_buff, edge_len-1, Get5BInteger(edge_ptrs.ptr)) != edge_len-1)
+        if(mm.ReadData(tmp_key_buff, edge_len-1, EF::GetStrOffset(edge_ptrs.ptr)) != edge_len-1)
             return MBError::READ_ERROR;
         key_buff = tmp_key_buff;
     }
@@ -262,7 +348,7 @@ int Dict::Add(const uint8_t *key, int len, MBData &data, bool overwrite)
             bool next;
             p += edge_len;
             len -= edge_len;
-            while((next = mm.FindNext(p, len, match_len, edge_ptrs, tmp_key_buff)))
+            while((next = mm.FindNext<EF>(p, len, match_len, edge_ptrs, tmp_key_buff)))
             {
                 if(match_len < edge_ptrs.len_ptr[0])
                     break;
@@ -274,32 +360,33 @@ int Dict::Add(const uint8_t *key, int len, MBData &data, bool overwrite)
             }
             if(!next)
             {
-                ReserveData(data.buff, data.data_len, data_offset);
-                rval = mm.UpdateNode(edge_ptrs, p, len, data_offset);
+                ReserveData(data.buff, data.data_len, data_offset, data.expire_time, enc);
+                rval = mm.UpdateNode<EF>(edge_ptrs, p, len, data_offset);
             }
             else if(match_len < static_cast<int>(edge_ptrs.len_ptr[0]))
             {
                 if(len > match_len)
                 {
-                    ReserveData(data.buff, data.data_len, data_offset);
-                    rval = mm.AddLink(edge_ptrs, match_len, p+match_len, len-match_len,
+                    ReserveData(data.buff, data.data_len, data_offset, data.expire_time, enc);
+                    rval = mm.AddLink<EF>(edge_ptrs, match_len, p+match_len, len-match_len,
                                       data_offset, data);
                 }
                 else if(len == match_len)
                 {
-                    ReserveData(data.buff, data.data_len, data_offset);
-                    rval = mm.InsertNode(edge_ptrs, match_len, data_offset, data);
+                    ReserveData(data.buff, data.data_len, data_offset, data.expire_time, enc);
+                    rval = mm.InsertNode<EF>(edge_ptrs, match_len, data_offset, data);
                 }
             }
             else if(len == 0)
             {
-                rval = UpdateDataBuffer(edge_ptrs, overwrite, data.buff, data.data_len, inc_count);
+                rval = UpdateDataBuffer<EF>(edge_ptrs, overwrite, data.buff, data.data_len, inc_count,
+                                        data.expire_time, enc);
             }
         }
         else
         {
-            ReserveData(data.buff, data.data_len, data_offset);
-            rval = mm.AddLink(edge_ptrs, i, p+i, len-i, data_offset, data);
+            ReserveData(data.buff, data.data_len, data_offset, data.expire_time, enc);
+            rval = mm.AddLink<EF>(edge_ptrs, i, p+i, len-i, data_offset, data);
         }
     }
     else
@@ -311,19 +398,20 @@ int Dict::Add(const uint8_t *key, int len, MBData &data, bool overwrite)
         }
         if(i < len)
         {
-            ReserveData(data.buff, data.data_len, data_offset);
-            rval = mm.AddLink(edge_ptrs, i, p+i, len-i, data_offset, data);
+            ReserveData(data.buff, data.data_len, data_offset, data.expire_time, enc);
+            rval = mm.AddLink<EF>(edge_ptrs, i, p+i, len-i, data_offset, data);
         }
         else
         {
             if(edge_ptrs.len_ptr[0] > len)
             {
-                ReserveData(data.buff, data.data_len, data_offset);
-                rval = mm.InsertNode(edge_ptrs, i, data_offset, data);
+                ReserveData(data.buff, data.data_len, data_offset, data.expire_time, enc);
+                rval = mm.InsertNode<EF>(edge_ptrs, i, data_offset, data);
             }
             else
             {
-                rval = UpdateDataBuffer(edge_ptrs, overwrite, data.buff, data.data_len, inc_count);
+                rval = UpdateDataBuffer<EF>(edge_ptrs, overwrite, data.buff, data.data_len, inc_count,
+                                        data.expire_time, enc);
             }
         }
     }
@@ -340,45 +428,30 @@ int Dict::Add(const uint8_t *key, int len, MBData &data, bool overwrite)
         if(inc_count)
             header->count++;
     }
+    if(rval == MBError::SUCCESS && data.expire_time != 0)
+        header->has_expire_key = 1;
     return rval;
 }
 
+template<typename EF>
 int Dict::ReadDataFromEdge(MBData &data, const EdgePtrs &edge_ptrs) const
 {
     size_t data_off;
     if(edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF)
     {
-        data_off = Get6BInteger(edge_ptrs.offset_ptr);
+        data_off = EF::GetOffset(edge_ptrs.offset_ptr);
     }
     else
     {
         uint8_t node_buff[NODE_EDGE_KEY_FIRST];
-        if(mm.ReadData(node_buff, NODE_EDGE_KEY_FIRST, Get6BInteger(edge_ptrs.offset_ptr))
+        if(mm.ReadData(node_buff, NODE_EDGE_KEY_FIRST, EF::GetOffset(edge_ptrs.offset_ptr))
                       != NODE_EDGE_KEY_FIRST)
             return MBError::READ_ERROR;
         if(!(node_buff[0] & FLAG_NODE_MATCH))
             return MBError::NOT_EXIST;
         data_off = Get6BInteger(node_buff+2);
     }
-    data.data_offset = data_off;
-
-    uint16_t data_len[2];
-    // Read data length first
-    if(ReadData(reinterpret_cast<uint8_t*>(&data_len[0]), DATA_HDR_BYTE, data_off)
-               != DATA_HDR_BYTE)
-        return MBError::READ_ERROR;
-    data_off += DATA_HDR_BYTE;
-    if(data.buff_len < data_len[0] + 1)
-    {
-        if(data.Resize(data_len[0]) != MBError::SUCCESS)
-            return MBError::NO_MEMORY;
-    }
-    if(ReadData(data.buff, data_len[0], data_off) != data_len[0])
-        return MBError::READ_ERROR;
-
-    data.data_len = data_len[0];
-    data.bucket_index = data_len[1];
-    return MBError::SUCCESS;
+    return ReadDataBuffer(data, data_off);
 }
 
 // Delete operations:
@@ -388,18 +461,16 @@ int Dict::DeleteDataFromEdge(MBData &data, EdgePtrs &edge_ptrs)
 {
     int rval = MBError::SUCCESS;
     size_t data_off;
-    uint16_t data_len;
     int rel_size;
 
     // Check if this is a leaf node first by using the EDGE_FLAG_DATA_OFF bit
     if(edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF)
     {
-        data_off = Get6BInteger(edge_ptrs.offset_ptr);
-        if(ReadData(reinterpret_cast<uint8_t*>(&data_len), DATA_SIZE_BYTE, data_off)
-                   != DATA_SIZE_BYTE)
+        data_off = mm.GetLink(edge_ptrs.offset_ptr);
+        if(GetDataRecordSize(data_off, rel_size) != MBError::SUCCESS)
             return MBError::READ_ERROR;
 
-        rel_size = free_lists->GetAlignmentSize(data_len + DATA_HDR_BYTE);
+        rel_size = free_lists->GetAlignmentSize(rel_size);
         header->pending_data_buff_size += rel_size;
         free_lists->ReleaseBuffer(data_off, rel_size);
 
@@ -412,7 +483,7 @@ int Dict::DeleteDataFromEdge(MBData &data, EdgePtrs &edge_ptrs)
         header->excep_offset = 0;
 
         uint8_t node_buff[NODE_EDGE_KEY_FIRST];
-        size_t node_off = Get6BInteger(edge_ptrs.offset_ptr);
+        size_t node_off = mm.GetLink(edge_ptrs.offset_ptr);
 
         // Read node header
         if(mm.ReadData(node_buff, NODE_EDGE_KEY_FIRST, node_off) != NODE_EDGE_KEY_FIRST)
@@ -426,11 +497,10 @@ int Dict::DeleteDataFromEdge(MBData &data, EdgePtrs &edge_ptrs)
 
             // Release data buffer
             data_off = Get6BInteger(node_buff+2);
-            if(ReadData(reinterpret_cast<uint8_t*>(&data_len), DATA_SIZE_BYTE, data_off)
-                       != DATA_SIZE_BYTE)
+            if(GetDataRecordSize(data_off, rel_size) != MBError::SUCCESS)
                 return MBError::READ_ERROR;
 
-            rel_size = free_lists->GetAlignmentSize(data_len + DATA_HDR_BYTE);
+            rel_size = free_lists->GetAlignmentSize(rel_size);
             header->pending_data_buff_size += rel_size;
             free_lists->ReleaseBuffer(data_off, rel_size);
         }
@@ -449,25 +519,214 @@ int Dict::ReadDataFromNode(MBData &data, const uint8_t *node_ptr) const
     if(data_off == 0)
         return MBError::NOT_EXIST;
 
-    data.data_offset = data_off;
+    return ReadDataBuffer(data, data_off);
+}
+
+// Copy the extension fields present in the flags of the unpacked header
+// to ext. Return the size of the stored extension.
+static int pack_data_ext(const uint16_t *data_hdr, uint8_t *ext)
+{
+    int ext_size = DATA_EXT_FLAGS_BYTE;
+    memcpy(ext, &data_hdr[4], DATA_EXT_FLAGS_BYTE);
+    if(data_hdr[4] & DATA_EXT_EXPIRE)
+    {
+        memcpy(ext + ext_size, &data_hdr[2], DATA_EXPIRE_BYTE);
+        ext_size += DATA_EXPIRE_BYTE;
+    }
+    if(data_hdr[4] & DATA_EXT_COMPRESSED)
+    {
+        memcpy(ext + ext_size, &data_hdr[5], DATA_RAW_LEN_BYTE);
+        ext_size += DATA_RAW_LEN_BYTE;
+    }
+    if(data_hdr[4] & DATA_EXT_CHECKSUM)
+    {
+        memcpy(ext + ext_size, &data_hdr[6], DATA_CRC_BYTE);
+        ext_size += DATA_CRC_BYTE;
+    }
+    return ext_size;
+}
+
+static void unpack_data_ext(const uint8_t *ext, uint16_t *data_hdr)
+{
+    int pos = DATA_EXT_FLAGS_BYTE;
+    if(data_hdr[4] & DATA_EXT_EXPIRE)
+    {
+        memcpy(&data_hdr[2], ext + pos, DATA_EXPIRE_BYTE);
+        pos += DATA_EXPIRE_BYTE;
+    }
+    if(data_hdr[4] & DATA_EXT_COMPRESSED)
+    {
+        memcpy(&data_hdr[5], ext + pos, DATA_RAW_LEN_BYTE);
+        pos += DATA_RAW_LEN_BYTE;
+    }
+    if(data_hdr[4] & DATA_EXT_CHECKSUM)
+        memcpy(&data_hdr[6], ext + pos, DATA_CRC_BYTE);
+}
 
-    // Read data length first
-    uint16_t data_len[2];
-    if(ReadData(reinterpret_cast<uint8_t *>(&data_len[0]), DATA_HDR_BYTE, data_off)
+// Read the data header and the extension if there is one. The header is
+// unpacked to fixed positions: expiry time at data_hdr[2], extension flags
+// at data_hdr[4], uncompressed length at data_hdr[5] and checksum at
+// data_hdr[6]. Fields not stored are set to zero.
+int Dict::ReadDataHeader(uint16_t *data_hdr, size_t &data_off) const
+{
+    if(ReadData(reinterpret_cast<uint8_t *>(&data_hdr[0]), DATA_HDR_BYTE, data_off)
                != DATA_HDR_BYTE)
         return MBError::READ_ERROR;
     data_off += DATA_HDR_BYTE;
+    memset(&data_hdr[2], 0, DATA_EXT_MAX_BYTE);
+    if(!(data_hdr[0] & DATA_EXT_FLAG))
+        return MBError::SUCCESS;
+
+    uint8_t ext[DATA_EXT_MAX_BYTE];
+    if(ReadData(ext, DATA_EXT_FLAGS_BYTE, data_off) != DATA_EXT_FLAGS_BYTE)
+        return MBError::READ_ERROR;
+    memcpy(&data_hdr[4], ext, DATA_EXT_FLAGS_BYTE);
+    int ext_size = DATA_EXT_SIZE(data_hdr[4]);
+    if(ext_size > DATA_EXT_FLAGS_BYTE)
+    {
+        int len = ext_size - DATA_EXT_FLAGS_BYTE;
+        if(ReadData(ext + DATA_EXT_FLAGS_BYTE, len, data_off + DATA_EXT_FLAGS_BYTE) != len)
+            return MBError::READ_ERROR;
+        unpack_data_ext(ext, data_hdr);
+    }
+    data_off += ext_size;
+    return MBError::SUCCESS;
+}
+
+// Read the data record (header, optional extension and value)
+// at the given offset.
+int Dict::ReadDataBuffer(MBData &data, size_t data_off) const
+{
+    data.data_offset = data_off;
+
+    uint16_t data_hdr[(DATA_HDR_BYTE+DATA_EXT_MAX_BYTE)/2];
+    if(ReadDataHeader(data_hdr, data_off) != MBError::SUCCESS)
+        return MBError::READ_ERROR;
+    data.bucket_index = data_hdr[1];
+    memcpy(&data.expire_time, &data_hdr[2], sizeof(data.expire_time));
+    if(data_hdr[4] & DATA_EXT_COMPRESSED)
+        return ReadCompressedData(data, data_off, data_hdr);
 
-    if(data.buff_len < data_len[0] + 1)
+    int data_len = data_hdr[0] & DATA_LEN_MASK;
+    if(data.buff_len < data_len + 1)
     {
-        if(data.Resize(data_len[0]) != MBError::SUCCESS)
+        if(data.Resize(data_len) != MBError::SUCCESS)
             return MBError::NO_MEMORY;
     }
-    if(ReadData(data.buff, data_len[0], data_off) != data_len[0])
+    if(ReadData(data.buff, data_len, data_off) != data_len)
         return MBError::READ_ERROR;
+    MB_OP_COST_ADD(copy_bytes, data_len);
+    if((options & CONSTS::DATA_CHECKSUM) &&
+       VerifyChecksum(data_hdr, data.buff, data_len) != MBError::SUCCESS)
+        return MBError::CHECKSUM_ERROR;
 
-    data.data_len = data_len[0];
-    data.bucket_index = data_len[1];
+    data.data_len = data_len;
+    return MBError::SUCCESS;
+}
+
+int Dict::GetDataRecordSize(size_t data_off, int &record_size) const
+{
+    uint16_t data_hdr[(DATA_HDR_BYTE+DATA_EXT_MAX_BYTE)/2];
+    size_t value_off = data_off;
+    if(ReadDataHeader(data_hdr, value_off) != MBError::SUCCESS)
+        return MBError::READ_ERROR;
+    record_size = static_cast<int>(value_off - data_off) + (data_hdr[0] & DATA_LEN_MASK);
+    return MBError::SUCCESS;
+}
+
+// Read the compressed value after the space reserved for the uncompressed
+// value in the same buffer and then decompress it.
+int Dict::ReadCompressedData(MBData &data, size_t data_off, const uint16_t *data_hdr) const
+{
+    int len = data_hdr[0] & DATA_LEN_MASK;
+    int raw_len = data_hdr[5];
+    if(data.buff_len < raw_len + len + 1)
+    {
+        if(data.Resize(raw_len + len) != MBError::SUCCESS)
+            return MBError::NO_MEMORY;
+    }
+    uint8_t *compressed = data.buff + raw_len;
+    if(ReadData(compressed, len, data_off) != len)
+        return MBError::READ_ERROR;
+    MB_OP_COST_ADD(copy_bytes, len);
+    if((options & CONSTS::DATA_CHECKSUM) &&
+       VerifyChecksum(data_hdr, compressed, len) != MBError::SUCCESS)
+        return MBError::CHECKSUM_ERROR;
+
+    int rval = MBCodec::Decompress(compressed, len, data.buff, raw_len,
+                                   header->compress_dict, header->compress_dict_len);
+    if(rval != MBError::SUCCESS)
+        return rval;
+    data.data_len = raw_len;
+    return MBError::SUCCESS;
+}
+
+// The checksum covers the data length, the stored extension except the
+// checksum itself, which is the last field, and the stored data. The bucket
+// index is not included.
+static uint32_t data_checksum(const uint16_t *data_hdr, const uint8_t *buff, int len)
+{
+    uint8_t ext[DATA_EXT_MAX_BYTE];
+    int ext_size = pack_data_ext(data_hdr, ext);
+    uint32_t crc = crc32c(0, &data_hdr[0], DATA_SIZE_BYTE);
+    crc = crc32c(crc, ext, ext_size - DATA_CRC_BYTE);
+    return crc32c(crc, buff, len);
+}
+
+int Dict::VerifyChecksum(const uint16_t *data_hdr, const uint8_t *buff, int len) const
+{
+    if(!(data_hdr[4] & DATA_EXT_CHECKSUM))
+        return MBError::SUCCESS;
+
+    uint32_t crc;
+    memcpy(&crc, &data_hdr[6], DATA_CRC_BYTE);
+    if(crc != data_checksum(data_hdr, buff, len))
+        return MBError::CHECKSUM_ERROR;
+    return MBError::SUCCESS;
+}
+
+// Check the stored data record at the given offset without decompressing it.
+// checked is set to false if the record has no checksum.
+int Dict::VerifyData(size_t data_off, MBData &data, bool &checked) const
+{
+    checked = false;
+    if(data_off < GetStartDataOffset() || data_off + DATA_HDR_BYTE > header->m_data_offset)
+        return MBError::OUT_OF_BOUND;
+
+    uint16_t data_hdr[(DATA_HDR_BYTE+DATA_EXT_MAX_BYTE)/2];
+    if(ReadDataHeader(data_hdr, data_off) != MBError::SUCCESS)
+        return MBError::READ_ERROR;
+    int data_len = data_hdr[0] & DATA_LEN_MASK;
+    if(data_off + data_len > header->m_data_offset)
+        return MBError::OUT_OF_BOUND;
+    if(!(data_hdr[4] & DATA_EXT_CHECKSUM))
+        return MBError::SUCCESS;
+
+    if(data.buff_len < data_len + 1)
+    {
+        if(data.Resize(data_len) != MBError::SUCCESS)
+            return MBError::NO_MEMORY;
+    }
+    if(ReadData(data.buff, data_len, data_off) != data_len)
+        return MBError::READ_ERROR;
+    checked = true;
+    return VerifyChecksum(data_hdr, data.buff, data_len);
+}
+
+int Dict::ReadDataRecordSize(size_t data_off, int &record_size, int &value_len,
+                             bool &compressed) const
+{
+    if(data_off < GetStartDataOffset() || data_off + DATA_HDR_BYTE > header->m_data_offset)
+        return MBError::OUT_OF_BOUND;
+
+    uint16_t data_hdr[(DATA_HDR_BYTE+DATA_EXT_MAX_BYTE)/2];
+    size_t value_off = data_off;
+    if(ReadDataHeader(data_hdr, value_off) != MBError::SUCCESS)
+        return MBError::READ_ERROR;
+    int data_len = data_hdr[0] & DATA_LEN_MASK;
+    record_size = static_cast<int>(value_off - data_off) + data_len;
+    compressed = (data_hdr[4] & DATA_EXT_COMPRESSED);
+    value_len = compressed ? data_hdr[5] : data_len;
     return MBError::SUCCESS;
 }
 
@@ -479,13 +738,15 @@ int Dict::FindPrefix(const uint8_t *key, int len, MBData &data)
     if(rc_root_offset != 0)
     {
         reader_rc_off = rc_root_offset;
-        rval = FindPrefix_Internal(rc_root_offset, key, len, data_rc);
+        rval = CALL_EDGE_FORMAT(mm.IsCompactIndex(), FindPrefix_Internal, rc_root_offset, key,
+                                len, data_rc);
 #ifdef __LOCK_FREE__
         while(rval == MBError::TRY_AGAIN)
         {
-            nanosleep((const struct timespec[]){{0, 10L}}, NULL);
+            MB_READER_BACKOFF();
             data_rc.Clear();
-            rval = FindPrefix_Internal(rc_root_offset, key, len, data_rc);
+            rval = CALL_EDGE_FORMAT(mm.IsCompactIndex(), FindPrefix_Internal, rc_root_offset, key,
+                                len, data_rc);
         }
 #endif
         if(rval != MBError::NOT_EXIST && rval != MBError::SUCCESS)
@@ -502,13 +763,13 @@ int Dict::FindPrefix(const uint8_t *key, int len, MBData &data)
         }
     }
 
-    rval = FindPrefix_Internal(0, key, len, data);
+    rval = CALL_EDGE_FORMAT(mm.IsCompactIndex(), FindPrefix_Internal, 0, key, len, data);
 #ifdef __LOCK_FREE__
     while(rval == MBError::TRY_AGAIN)
     {
-        nanosleep((const struct timespec[]){{0, 10L}}, NULL);
+        MB_READER_BACKOFF();
         data.Clear();
-        rval = FindPrefix_Internal(0, key, len, data);
+        rval = CALL_EDGE_FORMAT(mm.IsCompactIndex(), FindPrefix_Internal, 0, key, len, data);
     }
 #endif
 
@@ -516,12 +777,14 @@ int Dict::FindPrefix(const uint8_t *key, int len, MBData &data)
     if(data_rc.match_len > data.match_len)
     {
         data_rc.TransferValueTo(data.buff, data.data_len);
+        data.expire_time = data_rc.expire_time;
         rval = MBError::SUCCESS;
     }
     return rval;
 
 }
 
+template<typename EF>
 int Dict::FindPrefix_Internal(size_t root_off, const uint8_t *key, int len, MBData &data)
 {
     int rval;
@@ -533,7 +796,8 @@ int Dict::FindPrefix_Internal(size_t root_off, const uint8_t *key, int len, MBDa
 
     if(data.match_len == 0)
     {
-        rval = mm.GetRootEdge(data.options & CONSTS::OPTION_RC_MODE, key[0], edge_ptrs);
+        rval = mm.GetRootEdge<EF>(data.options & CONSTS::OPTION_RC_MODE, key[0], edge_ptrs);
+        MB_OP_COST_ADD(hops, 1);
         if(rval != MBError::SUCCESS)
             return MBError::READ_ERROR;
 
@@ -552,9 +816,10 @@ int Dict::FindPrefix_Internal(size_t root_off, const uint8_t *key, int len, MBDa
     const uint8_t *p = key;
     int edge_len = edge_ptrs.len_ptr[0];
     int edge_len_m1 = edge_len - 1;
-    if(edge_len > LOCAL_EDGE_LEN)
+    if(edge_len > EF::local_edge_len)
     {
-        if(mm.ReadData(node_buff, edge_len_m1, Get5BInteger(edge_ptrs.ptr))
+        MB_OP_COST_ADD(edge_reads, 1);
+        if(mm.ReadData(node_buff, edge_len_m1, EF::GetStrOffset(edge_ptrs.ptr))
                       != edge_len_m1)
         {
 #ifdef __LOCK_FREE__
@@ -590,7 +855,7 @@ int Dict::FindPrefix_Internal(size_t root_off, const uint8_t *key, int len, MBDa
             READER_LOCK_FREE_STOP(edge_ptrs.offset, data)
 #endif
             data.match_len = p - key;
-            return ReadDataFromEdge(data, edge_ptrs);
+            return ReadDataFromEdge<EF>(data, edge_ptrs);
         }
 
         uint8_t last_node_buffer[NODE_EDGE_KEY_FIRST];
@@ -600,7 +865,8 @@ int Dict::FindPrefix_Internal(size_t root_off, const uint8_t *key, int len, MBDa
         int last_prefix_rval = MBError::NOT_EXIST;
         while(true)
         {
-            rval = mm.NextEdge(p, edge_ptrs, node_buff, data);
+            rval = mm.NextEdge<EF>(p, edge_ptrs, node_buff, data);
+            MB_OP_COST_ADD(hops, 1);
             if(rval != MBError::READ_ERROR)
             {
                 if(node_buff[0] & FLAG_NODE_MATCH)
@@ -630,9 +896,10 @@ int Dict::FindPrefix_Internal(size_t root_off, const uint8_t *key, int len, MBDa
             edge_len = edge_ptrs.len_ptr[0];
             edge_len_m1 = edge_len - 1;
             // match edge string
-            if(edge_len > LOCAL_EDGE_LEN)
+            if(edge_len > EF::local_edge_len)
             {
-                if(mm.ReadData(node_buff, edge_len_m1, Get5BInteger(edge_ptrs.ptr))
+                MB_OP_COST_ADD(edge_reads, 1);
+                if(mm.ReadData(node_buff, edge_len_m1, EF::GetStrOffset(edge_ptrs.ptr))
                               != edge_len_m1)
                 {
                     rval = MBError::READ_ERROR;
@@ -656,7 +923,7 @@ int Dict::FindPrefix_Internal(size_t root_off, const uint8_t *key, int len, MBDa
             if(len <= 0 || (edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF))
             {
                 data.match_len = p - key;
-                rval = ReadDataFromEdge(data, edge_ptrs);
+                rval = ReadDataFromEdge<EF>(data, edge_ptrs);
                 break;
             }
 #ifdef __LOCK_FREE__
@@ -672,7 +939,7 @@ int Dict::FindPrefix_Internal(size_t root_off, const uint8_t *key, int len, MBDa
         if(edge_len_m1 == 0 || memcmp(key_buff, key+1, edge_len_m1) == 0)
         {
             data.match_len = len;
-            rval = ReadDataFromEdge(data, edge_ptrs);
+            rval = ReadDataFromEdge<EF>(data, edge_ptrs);
         }
     }
 
@@ -690,12 +957,14 @@ int Dict::Find(const uint8_t *key, int len, MBData &data)
     if(rc_root_offset != 0)
     {
         reader_rc_off = rc_root_offset;
-        rval = Find_Internal(rc_root_offset, key, len, data);
+        rval = CALL_EDGE_FORMAT(mm.IsCompactIndex(), Find_Internal, rc_root_offset, key, len,
+                                data);
 #ifdef __LOCK_FREE__
         while(rval == MBError::TRY_AGAIN)
         {
-            nanosleep((const struct timespec[]){{0, 10L}}, NULL);
-            rval = Find_Internal(rc_root_offset, key, len, data);
+            MB_READER_BACKOFF();
+            rval = CALL_EDGE_FORMAT(mm.IsCompactIndex(), Find_Internal, rc_root_offset, key, len,
+                                data);
         }
 #endif
         if(rval == MBError::SUCCESS)
@@ -717,12 +986,12 @@ int Dict::Find(const uint8_t *key, int len, MBData &data)
         }
     }
 
-    rval = Find_Internal(0, key, len, data);
+    rval = CALL_EDGE_FORMAT(mm.IsCompactIndex(), Find_Internal, 0, key, len, data);
 #ifdef __LOCK_FREE__
     while(rval == MBError::TRY_AGAIN)
     {
-        nanosleep((const struct timespec[]){{0, 10L}}, NULL);
-        rval = Find_Internal(0, key, len, data);
+        MB_READER_BACKOFF();
+        rval = CALL_EDGE_FORMAT(mm.IsCompactIndex(), Find_Internal, 0, key, len, data);
     }
 #endif
     if(rval == MBError::SUCCESS)
@@ -731,6 +1000,7 @@ int Dict::Find(const uint8_t *key, int len, MBData &data)
     return rval;
 }
 
+template<typename EF>
 int Dict::Find_Internal(size_t root_off, const uint8_t *key, int len, MBData &data)
 {
     EdgePtrs &edge_ptrs = data.edge_ptrs;
@@ -738,7 +1008,8 @@ int Dict::Find_Internal(size_t root_off, const uint8_t *key, int len, MBData &da
     READER_LOCK_FREE_START
 #endif
     int rval;
-    rval = mm.GetRootEdge(root_off, key[0], edge_ptrs);
+    rval = mm.GetRootEdge<EF>(root_off, key[0], edge_ptrs);
+    MB_OP_COST_ADD(hops, 1);
 
     if(rval != MBError::SUCCESS)
         return MBError::READ_ERROR;
@@ -758,9 +1029,10 @@ int Dict::Find_Internal(size_t root_off, const uint8_t *key, int len, MBData &da
     int edge_len_m1 = edge_len - 1;
 
     rval = MBError::NOT_EXIST;
-    if(edge_len > LOCAL_EDGE_LEN)
+    if(edge_len > EF::local_edge_len)
     {
-        size_t edge_str_off_lf = Get5BInteger(edge_ptrs.ptr);
+        MB_OP_COST_ADD(edge_reads, 1);
+        size_t edge_str_off_lf = EF::GetStrOffset(edge_ptrs.ptr);
         if(mm.ReadData(node_buff, edge_len_m1, edge_str_off_lf) != edge_len_m1)
         {
 #ifdef __LOCK_FREE__
@@ -794,7 +1066,8 @@ int Dict::Find_Internal(size_t root_off, const uint8_t *key, int len, MBData &da
 #endif
         while(true)
         {
-            rval = mm.NextEdge(p, edge_ptrs, node_buff, data);
+            rval = mm.NextEdge<EF>(p, edge_ptrs, node_buff, data);
+            MB_OP_COST_ADD(hops, 1);
             if(rval != MBError::SUCCESS)
                 break;
 
@@ -804,9 +1077,10 @@ int Dict::Find_Internal(size_t root_off, const uint8_t *key, int len, MBData &da
             edge_len = edge_ptrs.len_ptr[0];
             edge_len_m1 = edge_len - 1;
             // match edge string
-            if(edge_len > LOCAL_EDGE_LEN)
+            if(edge_len > EF::local_edge_len)
             {
-                size_t edge_str_off_lf = Get5BInteger(edge_ptrs.ptr);
+                MB_OP_COST_ADD(edge_reads, 1);
+                size_t edge_str_off_lf = EF::GetStrOffset(edge_ptrs.ptr);
                 if(mm.ReadData(node_buff, edge_len_m1, edge_str_off_lf) != edge_len_m1)
                 {
                     rval = MBError::READ_ERROR;
@@ -832,7 +1106,7 @@ int Dict::Find_Internal(size_t root_off, const uint8_t *key, int len, MBData &da
                 if(data.options & CONSTS::OPTION_FIND_AND_STORE_PARENT)
                     rval = MBError::IN_DICT;
                 else
-                    rval = ReadDataFromEdge(data, edge_ptrs);
+                    rval = ReadDataFromEdge<EF>(data, edge_ptrs);
                 break;
             }
             else
@@ -869,7 +1143,7 @@ int Dict::Find_Internal(size_t root_off, const uint8_t *key, int len, MBData &da
             }
             else
             {
-                rval = ReadDataFromEdge(data, edge_ptrs);
+                rval = ReadDataFromEdge<EF>(data, edge_ptrs);
             }
         }
     }
@@ -938,6 +1212,7 @@ void Dict::PrintHeader(std::ostream &out_stream) const
     out_stream << "number of updates: "  << header->num_update << std::endl;
     out_stream << "entry count per bucket: "  << header->entry_per_bucket << std::endl;
     out_stream << "eviction bucket index: "  << header->eviction_bucket_index << std::endl;
+    out_stream << "compression dictionary length: " << header->compress_dict_len << std::endl;
     out_stream << "exception data: " << std::endl;
     out_stream << "\tupdating status: " << header->excep_updating_status << std::endl;
     out_stream << "\texception data buffer: ";
@@ -977,21 +1252,22 @@ int Dict::ReadNextEdge(const uint8_t *node_buff, EdgePtrs &edge_ptrs,
     if(edge_ptrs.curr_nt > static_cast<int>(node_buff[1]))
         return MBError::OUT_OF_BOUND;
 
-    if(mm.ReadData(edge_ptrs.edge_buff, EDGE_SIZE, edge_ptrs.offset) != EDGE_SIZE)
+    int edge_size = mm.GetEdgeSize();
+    if(mm.ReadData(edge_ptrs.edge_buff, edge_size, edge_ptrs.offset) != edge_size)
         return MBError::READ_ERROR;
 
     node_off = 0;
     match_str = "";
 
     int rval = MBError::SUCCESS;
-    InitTempEdgePtrs(edge_ptrs);
+    CALL_EDGE_FORMAT(mm.IsCompactIndex(), InitTempEdgePtrs, edge_ptrs);
     if(edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF)
     {
         // match of leaf node
         match = MATCH_EDGE;
         if(rd_kv)
         {
-            rval = ReadDataFromEdge(data, edge_ptrs);
+            rval = CALL_EDGE_FORMAT(mm.IsCompactIndex(), ReadDataFromEdge, data, edge_ptrs);
             if(rval != MBError::SUCCESS)
                 return rval;
         }
@@ -1001,7 +1277,7 @@ int Dict::ReadNextEdge(const uint8_t *node_buff, EdgePtrs &edge_ptrs,
         match = MATCH_NONE;
         if(edge_ptrs.len_ptr[0] > 0)
         {
-            node_off = Get6BInteger(edge_ptrs.offset_ptr);
+            node_off = mm.GetLink(edge_ptrs.offset_ptr);
             if(rd_kv)
                 rval = ReadNodeMatch(node_off, match, data);
         }
@@ -1011,9 +1287,9 @@ int Dict::ReadNextEdge(const uint8_t *node_buff, EdgePtrs &edge_ptrs,
     {
         int edge_len_m1 = edge_ptrs.len_ptr[0] - 1;
         match_str = std::string(1, (const char)node_buff[NODE_EDGE_KEY_FIRST+edge_ptrs.curr_nt]);
-        if(edge_len_m1 > LOCAL_EDGE_LEN_M1)
+        if(edge_len_m1 >= mm.GetLocalEdgeLen())
         {
-            if(mm.ReadData(data.node_buff, edge_len_m1, Get5BInteger(edge_ptrs.ptr)) != edge_len_m1)
+            if(mm.ReadData(data.node_buff, edge_len_m1, mm.GetEdgeStrLink(edge_ptrs.ptr)) != edge_len_m1)
                 return MBError::READ_ERROR;
             match_str += std::string(reinterpret_cast<char*>(data.node_buff), edge_len_m1);
         }
@@ -1024,7 +1300,7 @@ int Dict::ReadNextEdge(const uint8_t *node_buff, EdgePtrs &edge_ptrs,
     }
 
     edge_ptrs.curr_nt++;
-    edge_ptrs.offset += EDGE_SIZE;
+    edge_ptrs.offset += mm.GetEdgeSlotSize();
     return rval;
 }
 
@@ -1037,12 +1313,11 @@ int Dict::ReadNode(size_t node_off, uint8_t *node_buff, EdgePtrs &edge_ptrs,
 
     edge_ptrs.curr_nt = 0;
     int nt = node_buff[1] + 1;
-    node_off += NODE_EDGE_KEY_FIRST;
-    if(mm.ReadData(node_buff + NODE_EDGE_KEY_FIRST, nt, node_off) != nt)
+    if(mm.ReadData(node_buff + NODE_EDGE_KEY_FIRST, nt, node_off + NODE_EDGE_KEY_FIRST) != nt)
         return MBError::READ_ERROR;
 
     int rval = MBError::SUCCESS;
-    edge_ptrs.offset = node_off + nt;
+    edge_ptrs.offset = mm.GetEdgeOffset(node_off, nt, 0);
     if(node_buff[0] & FLAG_NODE_MATCH)
     {
         // match of non-leaf node
@@ -1066,7 +1341,8 @@ void Dict::ReadNodeHeader(size_t node_off, int &node_size, int &match,
     if(mm.ReadData(node_buff, NODE_EDGE_KEY_FIRST, node_off) != NODE_EDGE_KEY_FIRST)
         throw (int) MBError::READ_ERROR;
 
-    node_size = mm.GetNodeSizePtr()[ node_buff[1] ];
+    // Node size table is only available for writer.
+    node_size = mm.GetNodeSize(node_buff[1] + 1);
     if(node_buff[0] & FLAG_NODE_MATCH)
     {
         match = MATCH_NODE;
@@ -1130,6 +1406,8 @@ int Dict::Remove(const uint8_t *key, int len, MBData &data)
     if(!(data.options & CONSTS::OPTION_FIND_AND_STORE_PARENT))
         return MBError::INVALID_ARG;
 
+    uint64_t start_ns = (op_stats != NULL) ? OpStats::Now() : 0;
+    const int key_len = len;
     int rval;
     rval = Find(key, len, data);
     if(rval == MBError::IN_DICT)
@@ -1152,17 +1430,27 @@ int Dict::Remove(const uint8_t *key, int len, MBData &data)
 
     if(rval == MBError::SUCCESS)
     {
+        LogMutation(MB_REPL_OP_REMOVE, key, key_len, NULL, 0, 0);
         header->count--;
         if(header->count == 0)
         {
-            RemoveAll();
+            RemoveAll_Internal();
         }
     }
 
+    if(op_stats != NULL)
+        op_stats->Record(MB_STATS_OP_REMOVE, start_ns);
     return rval;
 }
 
 int Dict::RemoveAll()
+{
+    int rval = RemoveAll_Internal();
+    LogMutation(MB_REPL_OP_REMOVE_ALL, NULL, 0, NULL, 0, 0);
+    return rval;
+}
+
+int Dict::RemoveAll_Internal()
 {
     int rval = MBError::SUCCESS;;
     for(int c = 0; c < NUM_ALPHABET; c++)
@@ -1183,9 +1471,107 @@ int Dict::RemoveAll()
 
     header->eviction_bucket_index = 0;
     header->num_update = 0;
+    header->expire_cursor_len = 0;
     return rval;
 }
 
+void Dict::SetReplicationLog(ReplicationLog *log)
+{
+    repl_log = log;
+}
+
+// Readers use the ring only if writer has created it.
+void Dict::InitChangeRing(const std::string &ring_path)
+{
+    change_ring = new ChangeRing(ring_path, options);
+    if(change_ring->Status() != MBError::SUCCESS)
+    {
+        delete change_ring;
+        change_ring = NULL;
+    }
+}
+
+ChangeRing* Dict::GetChangeRing() const
+{
+    return change_ring;
+}
+
+void Dict::InitOpStats()
+{
+    if(options & CONSTS::ACCESS_MODE_WRITER)
+    {
+        op_stats = new OpStats(stats_path, options);
+        if(op_stats->Status() != MBError::SUCCESS)
+        {
+            delete op_stats;
+            op_stats = NULL;
+        }
+        writer_stats = op_stats;
+    }
+    else
+    {
+        op_stats = new OpStats();
+    }
+}
+
+OpStats* Dict::GetOpStats() const
+{
+    return op_stats;
+}
+
+OpStats* Dict::GetWriterOpStats()
+{
+    if(writer_stats == NULL && !(options & CONSTS::ACCESS_MODE_WRITER))
+    {
+        writer_stats = new OpStats(stats_path, options);
+        if(writer_stats->Status() != MBError::SUCCESS)
+        {
+            delete writer_stats;
+            writer_stats = NULL;
+        }
+    }
+    return writer_stats;
+}
+
+void Dict::InitSlowOpLog(uint32_t threshold_us)
+{
+    if(slow_op_log != NULL)
+        delete slow_op_log;
+    slow_op_log = new SlowOpLog(threshold_us);
+}
+
+SlowOpLog* Dict::GetSlowOpLog() const
+{
+    return slow_op_log;
+}
+
+void Dict::InitHotKeys(uint32_t sample_rate)
+{
+    hot_keys = new HotKeys(hot_keys_path, options, sample_rate);
+    if(hot_keys->Status() != MBError::SUCCESS)
+    {
+        delete hot_keys;
+        hot_keys = NULL;
+    }
+}
+
+HotKeys* Dict::GetHotKeys() const
+{
+    return hot_keys;
+}
+
+// Every mutation gets the next sequence number even if no follower is
+// attached so that followers restored from a backup can resume from it.
+void Dict::LogMutation(int op, const uint8_t *key, int len, const uint8_t *buff,
+                       int data_len, uint32_t expire_time)
+{
+    header->repl_seq++;
+    if(repl_log != NULL)
+        repl_log->Append(header->repl_seq, op, key, len, buff, data_len, expire_time);
+    if(change_ring != NULL)
+        change_ring->Publish(op, key, len);
+}
+
 pthread_rwlock_t* Dict::GetShmLockPtrs() const
 {
     return &header->mb_rw_lock;
@@ -1227,17 +1613,94 @@ int Dict::InitShmMutex()
     return MBError::SUCCESS;
 }
 
-// Reserve buffer and write to it
-void Dict::ReserveData(const uint8_t* buff, int size, size_t &offset)
+// Build the data header and encode the value. The value is compressed if
+// enc_codec is not NULL. Compressed bytes are written to enc_buff.
+// If any extension field is needed, the extension is stored right after
+// the data header and DATA_EXT_FLAG is set in the data length.
+void Dict::EncodeData(const uint8_t *buff, int size, uint32_t expire_time,
+                      MBCodec *enc_codec, uint8_t *enc_buff, EncodedData &enc) const
 {
 #ifdef __DEBUG__
     assert(size <= CONSTS::MAX_DATA_SIZE);
 #endif
 
-    int buf_size  = free_lists->GetAlignmentSize(size + DATA_HDR_BYTE);
+    uint16_t data_hdr[(DATA_HDR_BYTE+DATA_EXT_MAX_BYTE)/2];
+    uint16_t ext_flags = 0;
+    int raw_size = size;
+    if(expire_time != 0)
+        ext_flags |= DATA_EXT_EXPIRE;
+    if(options & CONSTS::DATA_CHECKSUM)
+        ext_flags |= DATA_EXT_CHECKSUM;
+    if(enc_codec != NULL && size >= MB_CODEC_MIN_DATA_SIZE)
+    {
+        // Compression must also save the extension fields it needs.
+        int max_size = size - 1 - DATA_RAW_LEN_BYTE;
+        if(ext_flags == 0)
+            max_size -= DATA_EXT_FLAGS_BYTE;
+        int compressed_size = enc_codec->Compress(buff, size, enc_buff, max_size);
+        if(compressed_size > 0)
+        {
+            buff = enc_buff;
+            size = compressed_size;
+            ext_flags |= DATA_EXT_COMPRESSED;
+        }
+    }
+
+    enc.hdr_size = DATA_HDR_BYTE;
+    enc.hdr[0] = static_cast<uint16_t>(size);
+    enc.hdr[1] = 0;
+    if(ext_flags != 0)
+    {
+        enc.hdr[0] |= DATA_EXT_FLAG;
+        data_hdr[0] = enc.hdr[0];
+        memcpy(&data_hdr[2], &expire_time, sizeof(expire_time));
+        data_hdr[4] = ext_flags;
+        data_hdr[5] = static_cast<uint16_t>(raw_size);
+        uint32_t crc = 0;
+        if(ext_flags & DATA_EXT_CHECKSUM)
+            crc = data_checksum(data_hdr, buff, size);
+        memcpy(&data_hdr[6], &crc, DATA_CRC_BYTE);
+        enc.hdr_size += pack_data_ext(data_hdr, reinterpret_cast<uint8_t*>(&enc.hdr[2]));
+    }
+    enc.buff = buff;
+    enc.size = size;
+}
+
+// Reserve buffer and write to it
+// The value is encoded here unless enc is the record encoded by the caller.
+void Dict::ReserveData(const uint8_t* buff, int size, size_t &offset,
+                       uint32_t expire_time, const EncodedData *enc)
+{
+    EncodedData data_enc;
+    if(enc != NULL)
+    {
+        data_enc = *enc;
+    }
+    else
+    {
+        MBCodec *enc_codec = NULL;
+        if(codec != NULL)
+        {
+            // Values added before the dictionary is trained are stored uncompressed.
+            if(header->compress_dict_len == 0)
+                TrainCodec(buff, size);
+            else
+                enc_codec = codec;
+        }
+        EncodeData(buff, size, expire_time, enc_codec, compress_buff, data_enc);
+    }
+    StoreData(data_enc, offset);
+}
+
+void Dict::StoreData(EncodedData &enc, size_t &offset)
+{
+    uint16_t *dsize = enc.hdr;
+    int hdr_size = enc.hdr_size;
+    const uint8_t *buff = enc.buff;
+    int size = enc.size;
+
+    int buf_size  = free_lists->GetAlignmentSize(size + hdr_size);
     int buf_index = free_lists->GetBufferIndex(buf_size);
-    uint16_t dsize[2];
-    dsize[0] = static_cast<uint16_t>(size);
     // store bucket index for LRU eviction
     dsize[1] = (header->num_update / header->entry_per_bucket) % 0xFFFF;
     if(dsize[1] == header->eviction_bucket_index &&
@@ -1246,11 +1709,12 @@ void Dict::ReserveData(const uint8_t* buff, int size, size_t &offset)
         header->eviction_bucket_index++;
     }
 
-    if(free_lists->GetBufferCountByIndex(buf_index) > 0)
+    // Released buffers are not reused while a snapshot is being copied.
+    if(!SnapshotActive() && free_lists->GetBufferCountByIndex(buf_index) > 0)
     {
         offset = free_lists->RemoveBufferByIndex(buf_index);
-        WriteData(reinterpret_cast<const uint8_t*>(&dsize[0]), DATA_HDR_BYTE, offset);
-        WriteData(buff, size, offset+DATA_HDR_BYTE);
+        WriteData(reinterpret_cast<const uint8_t*>(&dsize[0]), hdr_size, offset);
+        WriteData(buff, size, offset+hdr_size);
         header->pending_data_buff_size -= buf_size;
     }
     else
@@ -1273,32 +1737,72 @@ void Dict::ReserveData(const uint8_t* buff, int size, size_t &offset)
         header->m_data_offset += buf_size;
         if(ptr != NULL)
         {
-            memcpy(ptr, &dsize[0], DATA_HDR_BYTE);
-            memcpy(ptr+DATA_HDR_BYTE, buff, size);
+            memcpy(ptr, &dsize[0], hdr_size);
+            memcpy(ptr+hdr_size, buff, size);
+            IncCacheEpoch(offset, hdr_size + size);
         }
         else
         {
-            WriteData(reinterpret_cast<const uint8_t*>(&dsize[0]), DATA_HDR_BYTE, offset);
-            WriteData(buff, size, offset+DATA_HDR_BYTE);
+            WriteData(reinterpret_cast<const uint8_t*>(&dsize[0]), hdr_size, offset);
+            WriteData(buff, size, offset+hdr_size);
         }
     }
 }
 
+void Dict::InitCodec()
+{
+    codec = new MBCodec();
+    compress_buff = static_cast<uint8_t*>(malloc(CONSTS::MAX_DATA_SIZE));
+    if(compress_buff == NULL)
+        throw (int) MBError::NO_MEMORY;
+    if(header->compress_dict_len > 0)
+        codec->SetDictionary(header->compress_dict, header->compress_dict_len);
+}
+
+// Collect sample values until there are enough for training the dictionary.
+// Values added before the dictionary is trained are stored uncompressed.
+void Dict::TrainCodec(const uint8_t *buff, int size)
+{
+    train_samples.push_back(std::string(reinterpret_cast<const char*>(buff), size));
+    train_size += size;
+    if(train_size < MB_CODEC_TRAIN_SIZE && train_samples.size() < MB_CODEC_TRAIN_COUNT)
+        return;
+
+    int dict_len = MBCodec::TrainDictionary(train_samples, header->compress_dict,
+                                            MB_CODEC_MAX_DICT_SIZE);
+    train_samples.clear();
+    train_size = 0;
+    if(dict_len == 0)
+    {
+        Logger::Log(LOG_LEVEL_INFO, "no repeated data found for compression dictionary");
+        delete codec;
+        codec = NULL;
+        return;
+    }
+
+    codec->SetDictionary(header->compress_dict, dict_len);
+    // Readers only use the dictionary for values added after this point.
+    std::atomic_thread_fence(std::memory_order_release);
+    header->compress_dict_len = dict_len;
+    Logger::Log(LOG_LEVEL_INFO, "trained compression dictionary of %d bytes", dict_len);
+}
+
 int Dict::ReleaseBuffer(size_t offset)
 {
-    uint16_t data_size;
+    int rel_size;
 
-    if(ReadData(reinterpret_cast<uint8_t*>(&data_size), DATA_SIZE_BYTE, offset)
-               != DATA_SIZE_BYTE)
+    if(GetDataRecordSize(offset, rel_size) != MBError::SUCCESS)
         return MBError::READ_ERROR;
 
-    int rel_size = free_lists->GetAlignmentSize(data_size + DATA_HDR_BYTE);
+    rel_size = free_lists->GetAlignmentSize(rel_size);
     header->pending_data_buff_size += rel_size;
     return free_lists->ReleaseBuffer(offset, rel_size);
 }
 
+template<typename EF>
 int Dict::UpdateDataBuffer(EdgePtrs &edge_ptrs, bool overwrite, const uint8_t *buff,
-                           int len, bool &inc_count)
+                           int len, bool &inc_count, uint32_t expire_time,
+                           const EncodedData *enc)
 {
     size_t data_off;
 
@@ -1309,19 +1813,19 @@ int Dict::UpdateDataBuffer(EdgePtrs &edge_ptrs, bool overwrite, const uint8_t *b
         if(!overwrite)
             return MBError::IN_DICT;
 
-        data_off = Get6BInteger(edge_ptrs.offset_ptr);
+        data_off = EF::GetOffset(edge_ptrs.offset_ptr);
         if(ReleaseBuffer(data_off) != MBError::SUCCESS)
             Logger::Log(LOG_LEVEL_WARN, "failed to release data buffer: %llu", data_off);
-        ReserveData(buff, len, data_off);
-        Write6BInteger(edge_ptrs.offset_ptr, data_off);
+        ReserveData(buff, len, data_off, expire_time, enc);
+        EF::WriteOffset(edge_ptrs.offset_ptr, data_off);
 
         header->excep_lf_offset = edge_ptrs.offset;
-        memcpy(header->excep_buff, edge_ptrs.offset_ptr, OFFSET_SIZE);
+        memcpy(header->excep_buff, edge_ptrs.offset_ptr, EF::offset_size);
 #ifdef __LOCK_FREE__
         lfree.WriterLockFreeStart(edge_ptrs.offset);
 #endif
         header->excep_updating_status = EXCEP_STATUS_ADD_DATA_OFF;
-        mm.WriteData(edge_ptrs.offset_ptr, OFFSET_SIZE, edge_ptrs.offset+EDGE_NODE_LEADING_POS);
+        mm.WriteData(edge_ptrs.offset_ptr, EF::offset_size, edge_ptrs.offset+EF::offset_pos);
 #ifdef __LOCK_FREE__
         lfree.WriterLockFreeStop();
 #endif
@@ -1330,7 +1834,7 @@ int Dict::UpdateDataBuffer(EdgePtrs &edge_ptrs, bool overwrite, const uint8_t *b
     else
     {
         uint8_t *node_buff = header->excep_buff;
-        size_t node_off = Get6BInteger(edge_ptrs.offset_ptr);
+        size_t node_off = EF::GetOffset(edge_ptrs.offset_ptr);
 
         if(mm.ReadData(node_buff, NODE_EDGE_KEY_FIRST, node_off) != NODE_EDGE_KEY_FIRST)
             return MBError::READ_ERROR;
@@ -1355,7 +1859,7 @@ int Dict::UpdateDataBuffer(EdgePtrs &edge_ptrs, bool overwrite, const uint8_t *b
             node_buff[NODE_EDGE_KEY_FIRST] = 1;
         }
 
-        ReserveData(buff, len, data_off);
+        ReserveData(buff, len, data_off, expire_time, enc);
         Write6BInteger(node_buff+2, data_off);
 
         header->excep_offset = node_off;
@@ -1429,6 +1933,108 @@ void Dict::ResetSlidingWindow() const
         header->shm_data_sliding_start.store(0, std::memory_order_relaxed);
 }
 
+// Enable page cache for index and data blocks that are not memory mapped.
+int Dict::InitBlockCache(size_t index_cache_size, size_t data_cache_size)
+{
+    int rval = InitCacheEpoch(0);
+    if(rval != MBError::SUCCESS)
+        return rval;
+    rval = mm.InitBlockCache(index_cache_size);
+    if(rval != MBError::SUCCESS)
+        return rval;
+    return kv_file->InitBlockCache(data_cache_size);
+}
+
+// Map the epoch counters of the cached pages. Writer sets the number of
+// counters when the DB is created. num_slots is ignored afterwards and by
+// readers.
+int Dict::InitCacheEpoch(uint32_t num_slots)
+{
+    bool writer = (options & CONSTS::ACCESS_MODE_WRITER);
+    if(writer && header->cache_epoch_slots == 0)
+    {
+        if(num_slots == 0)
+            num_slots = BLOCK_CACHE_EPOCH_SLOTS;
+        else if(num_slots < BLOCK_CACHE_MIN_EPOCH_SLOTS)
+            num_slots = BLOCK_CACHE_MIN_EPOCH_SLOTS;
+        else if(num_slots > BLOCK_CACHE_MAX_EPOCH_SLOTS)
+            num_slots = BLOCK_CACHE_MAX_EPOCH_SLOTS;
+        uint32_t slots = BLOCK_CACHE_MIN_EPOCH_SLOTS;
+        while(slots < num_slots)
+            slots <<= 1;
+        header->cache_epoch_slots = slots;
+    }
+    num_slots = header->cache_epoch_slots;
+    if(num_slots == 0)
+        return MBError::NOT_INITIALIZED;
+    if(epoch_file != NULL)
+        return MBError::SUCCESS;
+
+    bool anon_mode = (options & CONSTS::MEMORY_ONLY_MODE) &&
+                     !(options & CONSTS::SHARED_MEMORY_MODE);
+    bool new_file;
+    if(options & CONSTS::SHARED_MEMORY_MODE)
+        new_file = !FileIO::ShmExists(epoch_path);
+    else
+        new_file = (access(epoch_path.c_str(), F_OK) != 0);
+    if(!writer && new_file && !anon_mode)
+        return MBError::NOT_EXIST;
+
+    bool map_file = true;
+    epoch_file = ResourcePool::getInstance().OpenFile(epoch_path, options,
+                     2 * num_slots * sizeof(std::atomic<uint32_t>), map_file, writer);
+    if(!map_file || epoch_file->GetMapAddr() == NULL)
+    {
+        Logger::Log(LOG_LEVEL_WARN, "failed to map cache epoch file %s", epoch_path.c_str());
+        epoch_file = NULL;
+        return MBError::MMAP_FAILED;
+    }
+
+    std::atomic<uint32_t> *epoch = reinterpret_cast<std::atomic<uint32_t> *>(
+                                       epoch_file->GetMapAddr());
+    mm.InitCacheEpoch(epoch, num_slots);
+    kv_file->InitShmCacheEpoch(epoch + num_slots, num_slots);
+    return MBError::SUCCESS;
+}
+
+void Dict::GetResourceUsage(ResourceUsage &usage) const
+{
+    memset(&usage, 0, sizeof(usage));
+    mm.GetFileUsage(usage.index);
+    kv_file->GetUsage(usage.data);
+    if(options & CONSTS::ACCESS_MODE_WRITER)
+    {
+        FreeList *index_free_lists = mm.GetFreeList();
+        if(index_free_lists != NULL)
+            index_free_lists->GetSizeClassBytes(usage.index_free_bytes,
+                                                MB_USAGE_NUM_SIZE_CLASS);
+        if(free_lists != NULL)
+            free_lists->GetSizeClassBytes(usage.data_free_bytes, MB_USAGE_NUM_SIZE_CLASS);
+    }
+
+    usage.pending_index_buff_size = header->pending_index_buff_size;
+    usage.pending_data_buff_size = header->pending_data_buff_size;
+    usage.rc_root_offset = header->rc_root_offset.load(MEMORY_ORDER_READER);
+    if(usage.rc_root_offset != 0)
+    {
+        usage.rc_count = header->rc_count;
+        if(header->m_index_offset > header->rc_m_index_off_pre)
+            usage.rc_index_bytes = header->m_index_offset - header->rc_m_index_off_pre;
+        if(header->m_data_offset > header->rc_m_data_off_pre)
+            usage.rc_data_bytes = header->m_data_offset - header->rc_m_data_off_pre;
+    }
+    usage.count = header->count;
+}
+
+void Dict::GetMappedRegions(bool index, bool data,
+                            std::vector<std::pair<uint8_t*, size_t>> &regions)
+{
+    if(index)
+        mm.GetMappedRegions(regions);
+    if(data)
+        kv_file->GetMappedRegions(header->m_data_offset, regions);
+}
+
 LockFree* Dict::GetLockFreePtr()
 {
     return &lfree;
@@ -1477,15 +2083,15 @@ int Dict::ExceptionRecovery()
 #ifdef __LOCK_FREE__
             lfree.WriterLockFreeStart(header->excep_lf_offset);
 #endif
-            mm.WriteData(header->excep_buff, EDGE_SIZE, header->excep_lf_offset);
+            mm.WriteData(header->excep_buff, mm.GetEdgeSize(), header->excep_lf_offset);
             header->count++;
 	    break;
         case EXCEP_STATUS_ADD_DATA_OFF:
 #ifdef __LOCK_FREE__
             lfree.WriterLockFreeStart(header->excep_lf_offset);
 #endif
-            mm.WriteData(header->excep_buff, OFFSET_SIZE,
-                         header->excep_lf_offset+EDGE_NODE_LEADING_POS);
+            mm.WriteData(header->excep_buff, mm.GetLinkSize(),
+                         header->excep_lf_offset+mm.GetEdgeLinkPos());
             break;
         case EXCEP_STATUS_ADD_NODE:
 #ifdef __LOCK_FREE__
@@ -1499,29 +2105,38 @@ int Dict::ExceptionRecovery()
 #ifdef __LOCK_FREE__
             lfree.WriterLockFreeStart(header->excep_lf_offset);
 #endif
-            Write6BInteger(header->excep_buff, header->excep_offset);
-            mm.WriteData(header->excep_buff, OFFSET_SIZE,
-                         header->excep_lf_offset+EDGE_NODE_LEADING_POS);
+            mm.WriteLink(header->excep_buff, header->excep_offset);
+            mm.WriteData(header->excep_buff, mm.GetLinkSize(),
+                         header->excep_lf_offset+mm.GetEdgeLinkPos());
             break;
         case EXCEP_STATUS_CLEAR_EDGE:
 #ifdef __LOCK_FREE__
             lfree.WriterLockFreeStart(header->excep_lf_offset);
 #endif
-            mm.WriteData(DictMem::empty_edge, EDGE_SIZE, header->excep_lf_offset);
+            mm.WriteData(DictMem::empty_edge, mm.GetEdgeSize(), header->excep_lf_offset);
             header->count--;
             break;
         case EXCEP_STATUS_RC_NODE:
+#ifdef __LOCK_FREE__
+            lfree.WriterLockFreeStart(header->excep_lf_offset);
+#endif
+            mm.WriteData(header->excep_buff, mm.GetLinkSize(), header->excep_offset);
+            break;
         case EXCEP_STATUS_RC_DATA:
 #ifdef __LOCK_FREE__
             lfree.WriterLockFreeStart(header->excep_lf_offset);
 #endif
-            mm.WriteData(header->excep_buff, OFFSET_SIZE, header->excep_offset);
+            // The data offset is either in the edge or in the node header.
+            if(header->excep_offset == header->excep_lf_offset + mm.GetEdgeLinkPos())
+                mm.WriteData(header->excep_buff, mm.GetLinkSize(), header->excep_offset);
+            else
+                mm.WriteData(header->excep_buff, OFFSET_SIZE, header->excep_offset);
             break;
         case EXCEP_STATUS_RC_EDGE_STR:
 #ifdef __LOCK_FREE__
             lfree.WriterLockFreeStart(header->excep_lf_offset);
 #endif
-            mm.WriteData(header->excep_buff, OFFSET_SIZE-1, header->excep_offset);
+            mm.WriteData(header->excep_buff, mm.GetEdgeStrLinkSize(), header->excep_offset);
             break;
         default:
             Logger::Log(LOG_LEVEL_ERROR, "unknown exception status: %d",
@@ -21,6 +21,7 @@
 
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #include "drm_base.h"
 #include "dict_mem.h"
@@ -30,6 +31,21 @@
 
 namespace mabain {
 
+class ReplicationLog;
+class ChangeRing;
+class OpStats;
+class SlowOpLog;
+class HotKeys;
+
+// Data header and value bytes of a data record before it is stored
+typedef struct _EncodedData
+{
+    uint16_t hdr[(DATA_HDR_BYTE+DATA_EXT_MAX_BYTE)/2];
+    int hdr_size;
+    const uint8_t *buff;
+    int size;
+} EncodedData;
+
 // dictionary class
 // This is the work horse class for basic db operations (add, find and remove).
 class Dict : public DRMBase
@@ -45,8 +61,10 @@ public:
 
     // Called by writer only
     int Init(uint32_t id);
-    // Add key-value pair
-    int Add(const uint8_t *key, int len, MBData &data, bool overwrite);
+    // Add key-value pair. If enc is not NULL, it is the data record of the
+    // value built by EncodeData.
+    int Add(const uint8_t *key, int len, MBData &data, bool overwrite,
+            const EncodedData *enc = NULL);
     // Find value by key
     int Find(const uint8_t *key, int len, MBData &data);
     // Find value by key using prefix match
@@ -59,7 +77,12 @@ public:
     // Delete all entries
     int RemoveAll();
 
-    void ReserveData(const uint8_t* buff, int size, size_t &offset);
+    void ReserveData(const uint8_t* buff, int size, size_t &offset,
+                     uint32_t expire_time = 0, const EncodedData *enc = NULL);
+    // Encoding does not change the DB and can be done in other threads.
+    void EncodeData(const uint8_t *buff, int size, uint32_t expire_time,
+                    MBCodec *enc_codec, uint8_t *enc_buff, EncodedData &enc) const;
+    bool GetEncodeDictionary(const uint8_t* &comp_dict, int &dict_len) const;
     void WriteData(const uint8_t *buff, unsigned len, size_t offset) const;
 
     // Print dictinary stats
@@ -94,17 +117,65 @@ public:
     int  UpdateNumWriter(int delta) const;
 
     void ResetSlidingWindow() const;
+    int  InitBlockCache(size_t index_cache_size, size_t data_cache_size);
+    int  InitCacheEpoch(uint32_t num_slots);
+    void GetResourceUsage(ResourceUsage &usage) const;
+    void GetMappedRegions(bool index, bool data,
+                          std::vector<std::pair<uint8_t*, size_t>> &regions);
     void Flush() const;
     int  ExceptionRecovery();
+    // Used by DB verifier
+    int  VerifyData(size_t data_off, MBData &data, bool &checked) const;
+    // Used by DB analyzer; record_size includes the data header.
+    int  ReadDataRecordSize(size_t data_off, int &record_size, int &value_len,
+                            bool &compressed) const;
+    // Size of the data record including the data header and the extension
+    int  GetDataRecordSize(size_t data_off, int &record_size) const;
+    // Mutations are appended to the log after being assigned a sequence number.
+    void SetReplicationLog(ReplicationLog *log);
+    // Ring of changed keys; NULL if writer did not enable CONSTS::CHANGE_NOTIFY.
+    ChangeRing* GetChangeRing() const;
+    // Latency histograms of this handle; NULL if not enabled.
+    OpStats* GetOpStats() const;
+    // Latency histograms of writer; NULL if writer did not enable them.
+    OpStats* GetWriterOpStats();
+    // Log of slow lookups; NULL if not enabled.
+    void InitSlowOpLog(uint32_t threshold_us);
+    SlowOpLog* GetSlowOpLog() const;
+    // Hot key counts; NULL if writer did not enable CONSTS::HOT_KEY_STATS.
+    void InitHotKeys(uint32_t sample_rate);
+    HotKeys* GetHotKeys() const;
 
 private:
+    // The lookup and update paths are instantiated for each edge format
+    // (EdgeFormat6B or EdgeFormat4B). The format is checked once per call.
+    template<typename EF>
+    int Add_Internal(const uint8_t *key, int len, MBData &data, bool overwrite,
+                     const EncodedData *enc);
+    int RemoveAll_Internal();
+    void LogMutation(int op, const uint8_t *key, int len, const uint8_t *buff,
+                     int data_len, uint32_t expire_time);
+    template<typename EF>
     int Find_Internal(size_t root_off, const uint8_t *key, int len, MBData &data);
+    template<typename EF>
     int FindPrefix_Internal(size_t root_off, const uint8_t *key, int len, MBData &data);
     int ReleaseBuffer(size_t offset);
+    template<typename EF>
     int UpdateDataBuffer(EdgePtrs &edge_ptrs, bool overwrite, const uint8_t *buff,
-                         int len, bool &inc_count);
+                         int len, bool &inc_count, uint32_t expire_time,
+                         const EncodedData *enc);
+    template<typename EF>
     int ReadDataFromEdge(MBData &data, const EdgePtrs &edge_ptrs) const;
     int ReadDataFromNode(MBData &data, const uint8_t *node_ptr) const;
+    int ReadDataBuffer(MBData &data, size_t data_off) const;
+    int ReadDataHeader(uint16_t *data_hdr, size_t &data_off) const;
+    int ReadCompressedData(MBData &data, size_t data_off, const uint16_t *data_hdr) const;
+    int VerifyChecksum(const uint16_t *data_hdr, const uint8_t *buff, int len) const;
+    void InitCodec();
+    void InitChangeRing(const std::string &ring_path);
+    void InitOpStats();
+    void StoreData(EncodedData &enc, size_t &offset);
+    void TrainCodec(const uint8_t *buff, int size);
     int DeleteDataFromEdge(MBData &data, EdgePtrs &edge_ptrs);
     int ReadNodeMatch(size_t node_off, int &match, MBData &data) const;
 
@@ -119,6 +190,30 @@ private:
     LockFree lfree;
 
     size_t reader_rc_off;
+
+    // Data compression; only used by the writer with CONSTS::COMPRESS_DATA.
+    // Values are sampled for training the dictionary until it is stored
+    // in the header.
+    MBCodec *codec;
+    uint8_t *compress_buff;
+    std::vector<std::string> train_samples;
+    size_t train_size;
+
+    // log of mutations shipped to followers; only set in writer
+    ReplicationLog *repl_log;
+    ChangeRing *change_ring;
+    // Writer histograms are in the stats file; readers attach to it when
+    // writer stats are requested.
+    std::string stats_path;
+    OpStats *op_stats;
+    OpStats *writer_stats;
+    SlowOpLog *slow_op_log;
+    std::string hot_keys_path;
+    HotKeys *hot_keys;
+    // Epochs of index pages followed by epochs of data pages; writer
+    // increments them so that readers can validate the cached pages.
+    std::string epoch_path;
+    std::shared_ptr<MmapFileIO> epoch_file;
 };
 
 }
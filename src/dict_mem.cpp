@@ -28,10 +28,10 @@
 #include "version.h"
 #include "resource_pool.h"
 
-#define OFFSET_SIZE_P1             7
-
 #define MAX_BUFFER_RESERVE_SIZE    8192
 #define NUM_BUFFER_RESERVE         MAX_BUFFER_RESERVE_SIZE/BUFFER_ALIGNMENT
+// Maximum number of unaligned free buffers skipped when reserving a node
+#define MAX_UNALIGNED_NODE_SKIP    8
 
 namespace mabain {
 
@@ -59,6 +59,27 @@ namespace mabain {
 // Since we use 6-byte to store both the index and data offset, the maximum size for
 // data and index is 281474976710655 bytes (or 255T).
 /////////////////////////////////////////////////////////////////////////////////////
+// ALIGNED NODE MEMORY LAYOUT (CONSTS::ALIGNED_INDEX)
+// Nodes start at 64-byte boundaries and the node size is rounded up to 64 bytes.
+// The header and the first characters of the edges are the same as above and
+// are followed by padding to a 16-byte boundary. Each edge is stored in a 16-byte
+// slot so that no edge crosses a cache line. A lookup hop reads the first cache
+// line for the header and the first characters (nodes with up to 56 edges) and
+// one cache line for the matched edge.
+// The edge is kept as one 13-byte unit since writer updates it with a single
+// lock-free write.
+/////////////////////////////////////////////////////////////////////////////////////
+// COMPACT EDGE MEMORY LAYOUT (CONSTS::COMPACT_INDEX)
+// Edge size is 10 bytes.
+// X*********    leading byte of edge key offset
+// *XXX******    edge key string or edge key offset
+// ****X*****    edge key length
+// *****X****    flag
+// ******X***    leading byte of next node offset or data offset
+// *******xxX    next node offset of data offset
+// The node data offset is still stored in 6 bytes, the two highest bytes are zero.
+// Index and data files are limited to 4294967296 bytes (or 4G) each.
+/////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////
 
@@ -101,7 +122,14 @@ DictMem::DictMem(const std::string &mbdir, bool init_header, size_t memsize,
     {
         memset(header, 0, sizeof(IndexHeader));
         header->index_block_size = block_size;
+        if(mode & CONSTS::ALIGNED_INDEX)
+            header->index_format |= INDEX_FORMAT_ALIGNED;
+        if(mode & CONSTS::COMPACT_INDEX)
+            header->index_format |= INDEX_FORMAT_COMPACT;
     }
+    InitNodeLayout();
+    if(compact_index)
+        max_num_blk = CompactMaxNumBlock(max_num_blk, header->index_block_size);
     kv_file = new RollableFile(mbdir + "_mabain_i",
                                static_cast<size_t>(header->index_block_size),
                                memsize, mode, max_num_blk);
@@ -123,12 +151,13 @@ DictMem::DictMem(const std::string &mbdir, bool init_header, size_t memsize,
 
     for(int i = 0; i < NUM_ALPHABET; i++)
     {
-        int nt = i + 1;
-        node_size[i] = 1 + 1 + OFFSET_SIZE + nt + nt*EDGE_SIZE;
+        node_size[i] = GetNodeSize(i + 1);
     }
 
     node_ptr = new uint8_t[ node_size[NUM_ALPHABET-1] ];
     free_lists = new FreeList(mbdir+"_ibfl", BUFFER_ALIGNMENT, NUM_BUFFER_RESERVE);
+    if(!(mode & CONSTS::MEMORY_ONLY_MODE))
+        kv_file->InitDirtyMap(mbdir + "_ibdirty");
 
     if(init_header)
     {
@@ -151,6 +180,28 @@ DictMem::DictMem(const std::string &mbdir, bool init_header, size_t memsize,
 // The whole edge is initizlized to zero.
 const uint8_t DictMem::empty_edge[] = {0};
 
+void DictMem::InitNodeLayout()
+{
+    compact_index = (header->index_format & INDEX_FORMAT_COMPACT);
+    if(compact_index)
+        edge_size = EdgeFormat4B::edge_size;
+    else
+        edge_size = EdgeFormat6B::edge_size;
+
+    if(header->index_format & INDEX_FORMAT_ALIGNED)
+    {
+        edge_alignment = ALIGNED_EDGE_SLOT;
+        edge_slot_size = ALIGNED_EDGE_SLOT;
+        node_alignment = ALIGNED_NODE_SIZE;
+    }
+    else
+    {
+        edge_alignment = 1;
+        edge_slot_size = edge_size;
+        node_alignment = 1;
+    }
+}
+
 void DictMem::InitRootNode()
 {
 #ifdef __DEBUG__
@@ -175,6 +226,8 @@ void DictMem::InitRootNode()
 
     if(node_move)
         WriteData(root_node, node_size[NUM_ALPHABET-1], root_offset);
+    else
+        IncCacheEpoch(root_offset, node_size[NUM_ALPHABET-1]);
 
     // Everything is running fine if reaching this point.
     is_valid = true;
@@ -203,16 +256,69 @@ bool DictMem::IsValid() const
     return is_valid;
 }
 
+void DictMem::AddRootEdge(EdgePtrs &edge_ptrs, const uint8_t *key,
+                          int len, size_t data_offset)
+{
+    CALL_EDGE_FORMAT(compact_index, AddRootEdge, edge_ptrs, key, len, data_offset);
+}
+
+int DictMem::InsertNode(EdgePtrs &edge_ptrs, int match_len,
+                        size_t data_offset, MBData &data)
+{
+    return CALL_EDGE_FORMAT(compact_index, InsertNode, edge_ptrs, match_len, data_offset, data);
+}
+
+int DictMem::AddLink(EdgePtrs &edge_ptrs, int match_len, const uint8_t *key,
+                     int key_len, size_t data_off, MBData &data)
+{
+    return CALL_EDGE_FORMAT(compact_index, AddLink, edge_ptrs, match_len, key, key_len,
+                            data_off, data);
+}
+
+int DictMem::UpdateNode(EdgePtrs &edge_ptrs, const uint8_t *key, int key_len,
+                        size_t data_off)
+{
+    return CALL_EDGE_FORMAT(compact_index, UpdateNode, edge_ptrs, key, key_len, data_off);
+}
+
+bool DictMem::FindNext(const unsigned char *key, int keylen, int &match_len,
+                       EdgePtrs &edge_ptr, uint8_t *key_tmp) const
+{
+    return CALL_EDGE_FORMAT(compact_index, FindNext, key, keylen, match_len, edge_ptr, key_tmp);
+}
+
+int DictMem::GetRootEdge(size_t rc_off, int nt, EdgePtrs &edge_ptrs) const
+{
+    return CALL_EDGE_FORMAT(compact_index, GetRootEdge, rc_off, nt, edge_ptrs);
+}
+
+int DictMem::GetRootEdge_Writer(bool rc_mode, int nt, EdgePtrs &edge_ptrs) const
+{
+    return CALL_EDGE_FORMAT(compact_index, GetRootEdge_Writer, rc_mode, nt, edge_ptrs);
+}
+
+int DictMem::NextEdge(const uint8_t *key, EdgePtrs &edge_ptrs, uint8_t *node_buff,
+                      MBData &mbdata) const
+{
+    return CALL_EDGE_FORMAT(compact_index, NextEdge, key, edge_ptrs, node_buff, mbdata);
+}
+
+int DictMem::RemoveEdgeByIndex(const EdgePtrs &edge_ptrs, MBData &data)
+{
+    return CALL_EDGE_FORMAT(compact_index, RemoveEdgeByIndex, edge_ptrs, data);
+}
+
 // Add root edge
+template<typename EF>
 void DictMem::AddRootEdge(EdgePtrs &edge_ptrs, const uint8_t *key,
                          int len, size_t data_offset)
 {
     edge_ptrs.len_ptr[0] = len;
-    if(len > LOCAL_EDGE_LEN)
+    if(len > EF::local_edge_len)
     {
         size_t edge_str_off;
         ReserveData(key+1, len-1, edge_str_off);
-        Write5BInteger(edge_ptrs.ptr, edge_str_off);
+        EF::WriteStrOffset(edge_ptrs.ptr, edge_str_off);
     }
     else
     {
@@ -220,32 +326,33 @@ void DictMem::AddRootEdge(EdgePtrs &edge_ptrs, const uint8_t *key,
     }
 
     edge_ptrs.flag_ptr[0] = EDGE_FLAG_DATA_OFF;
-    Write6BInteger(edge_ptrs.offset_ptr, data_offset);
+    EF::WriteOffset(edge_ptrs.offset_ptr, data_offset);
 
 #ifdef __LOCK_FREE__
     header->excep_lf_offset = edge_ptrs.offset;
     header->excep_updating_status = EXCEP_STATUS_ADD_EDGE;
     lfree->WriterLockFreeStart(edge_ptrs.offset);
 #endif
-    WriteEdge(edge_ptrs);
+    WriteEdge<EF>(edge_ptrs);
 #ifdef __LOCK_FREE__
     lfree->WriterLockFreeStop();
     header->excep_updating_status = EXCEP_STATUS_NONE;
 #endif
 }
 
+template<typename EF>
 void DictMem::UpdateTailEdge(EdgePtrs &edge_ptrs, int match_len, MBData &data,
                              EdgePtrs &tail_edge, uint8_t &new_key_first,
                              bool &map_new_sliding)
 {
     int edge_len = edge_ptrs.len_ptr[0] - match_len;
     tail_edge.len_ptr[0] = edge_len;
-    if(edge_len > LOCAL_EDGE_LEN)
+    if(edge_len > EF::local_edge_len)
     {
-        // Old key len must be greater than LOCAL_EDGE_LEN too.
+        // Old key len must be greater than the local edge length too.
         // Load the string with length edge_len.
         size_t new_key_off;
-        size_t edge_str_off = Get5BInteger(edge_ptrs.ptr);
+        size_t edge_str_off = EF::GetStrOffset(edge_ptrs.ptr);
         if(ReadData(data.node_buff, edge_len, edge_str_off + match_len - 1)
                    != edge_len)
             throw (int) MBError::READ_ERROR;          
@@ -254,13 +361,13 @@ void DictMem::UpdateTailEdge(EdgePtrs &edge_ptrs, int match_len, MBData &data,
         // Reserve the key buffer
         ReserveData(data.node_buff+1, edge_len-1, new_key_off, map_new_sliding);
         map_new_sliding = false;
-        Write5BInteger(tail_edge.ptr, new_key_off);
+        EF::WriteStrOffset(tail_edge.ptr, new_key_off);
     }
     else
     {
-        if(edge_ptrs.len_ptr[0] > LOCAL_EDGE_LEN)
+        if(edge_ptrs.len_ptr[0] > EF::local_edge_len)
         {
-            if(ReadData(data.node_buff, edge_len, Get5BInteger(edge_ptrs.ptr)+match_len-1)
+            if(ReadData(data.node_buff, edge_len, EF::GetStrOffset(edge_ptrs.ptr)+match_len-1)
                        != edge_len)
                 throw (int) MBError::READ_ERROR;
             new_key_first = data.node_buff[0];
@@ -276,21 +383,22 @@ void DictMem::UpdateTailEdge(EdgePtrs &edge_ptrs, int match_len, MBData &data,
         }
     }
 
-    // 7 = 1 + OFFSET_SIZE
-    memcpy(tail_edge.flag_ptr, edge_ptrs.flag_ptr, OFFSET_SIZE_P1);
+    // flag and node or data offset
+    memcpy(tail_edge.flag_ptr, edge_ptrs.flag_ptr, EF::offset_size+1);
 }
 
 //The old edge becomes head edge.
+template<typename EF>
 void DictMem::UpdateHeadEdge(EdgePtrs &edge_ptrs, int match_len,
                              MBData &data, int &release_buffer_size,
                              size_t &edge_str_off, bool &map_new_sliding)
 {
     int match_len_m1 = match_len - 1;
-    if(edge_ptrs.len_ptr[0] > LOCAL_EDGE_LEN)
+    if(edge_ptrs.len_ptr[0] > EF::local_edge_len)
     {
-        if(match_len <= LOCAL_EDGE_LEN)
+        if(match_len <= EF::local_edge_len)
         {
-            edge_str_off = Get5BInteger(edge_ptrs.ptr);
+            edge_str_off = EF::GetStrOffset(edge_ptrs.ptr);
             release_buffer_size = edge_ptrs.len_ptr[0] - 1;
             // Old key is remote but new key is local. Need to read the old key.
             if(match_len_m1 > 0)
@@ -301,7 +409,7 @@ void DictMem::UpdateHeadEdge(EdgePtrs &edge_ptrs, int match_len,
         }
         else
         {
-            edge_str_off = Get5BInteger(edge_ptrs.ptr);
+            edge_str_off = EF::GetStrOffset(edge_ptrs.ptr);
             release_buffer_size = edge_ptrs.len_ptr[0] - 1;
             // Load the string with length edge_len - 1
             if(ReadData(data.node_buff, match_len_m1, edge_str_off) != match_len_m1)
@@ -310,7 +418,7 @@ void DictMem::UpdateHeadEdge(EdgePtrs &edge_ptrs, int match_len,
             size_t new_key_off;
             ReserveData(data.node_buff, match_len_m1, new_key_off, map_new_sliding);
             map_new_sliding = false;
-            Write5BInteger(edge_ptrs.ptr, new_key_off);
+            EF::WriteStrOffset(edge_ptrs.ptr, new_key_off);
         }
     }
 
@@ -320,6 +428,7 @@ void DictMem::UpdateHeadEdge(EdgePtrs &edge_ptrs, int match_len,
 
 // Insert a new node on the current edge
 // The old edge becomes two edges.
+template<typename EF>
 int DictMem::InsertNode(EdgePtrs &edge_ptrs, int match_len,
                         size_t data_offset, MBData &data)
 {
@@ -336,17 +445,17 @@ int DictMem::InsertNode(EdgePtrs &edge_ptrs, int match_len,
 
     InitNodePtrs(node, 0, node_ptrs);
     node[1] = 0;
-    InitEdgePtrs(node_ptrs, 0, new_edge_ptrs);
+    InitEdgePtrs<EF>(node_ptrs, 0, new_edge_ptrs);
 
     uint8_t new_key_first;
-    UpdateTailEdge(edge_ptrs, match_len, data, new_edge_ptrs, new_key_first,
+    UpdateTailEdge<EF>(edge_ptrs, match_len, data, new_edge_ptrs, new_key_first,
                    map_new_sliding);
 
     int release_buffer_size = 0;
     size_t edge_str_off = 0;
-    UpdateHeadEdge(edge_ptrs, match_len, data, release_buffer_size, edge_str_off,
+    UpdateHeadEdge<EF>(edge_ptrs, match_len, data, release_buffer_size, edge_str_off,
                    map_new_sliding);
-    Write6BInteger(edge_ptrs.offset_ptr, node_ptrs.offset);
+    EF::WriteOffset(edge_ptrs.offset_ptr, node_ptrs.offset);
 
     // Update the new node
     // match found for the new node
@@ -358,6 +467,8 @@ int DictMem::InsertNode(EdgePtrs &edge_ptrs, int match_len,
 
     if(node_move)
         WriteData(node, node_size[0], node_ptrs.offset);
+    else
+        IncCacheEpoch(node_ptrs.offset, node_size[0]);
 
     if(release_buffer_size > 0)
         ReleaseBuffer(edge_str_off, release_buffer_size);
@@ -366,7 +477,7 @@ int DictMem::InsertNode(EdgePtrs &edge_ptrs, int match_len,
     header->excep_updating_status = EXCEP_STATUS_ADD_EDGE;
     lfree->WriterLockFreeStart(edge_ptrs.offset);
 #endif
-    WriteEdge(edge_ptrs);
+    WriteEdge<EF>(edge_ptrs);
 #ifdef __LOCK_FREE__
     lfree->WriterLockFreeStop();
     header->excep_updating_status = EXCEP_STATUS_NONE;
@@ -379,6 +490,7 @@ int DictMem::InsertNode(EdgePtrs &edge_ptrs, int match_len,
 // Insert a new node on the current edge.
 // Add a new edge to the new node. The new node will have two edges.
 // The old edge becomes two edges.
+template<typename EF>
 int DictMem::AddLink(EdgePtrs &edge_ptrs, int match_len, const uint8_t *key,
                      int key_len, size_t data_off, MBData &data)
 {
@@ -395,18 +507,18 @@ int DictMem::AddLink(EdgePtrs &edge_ptrs, int match_len, const uint8_t *key,
     InitNodePtrs(node, 1, node_ptrs);
     node[0] = FLAG_NODE_NONE;
     node[1] = 1;
-    InitEdgePtrs(node_ptrs, 0, new_edge_ptrs[0]);
-    InitEdgePtrs(node_ptrs, 1, new_edge_ptrs[1]);
+    InitEdgePtrs<EF>(node_ptrs, 0, new_edge_ptrs[0]);
+    InitEdgePtrs<EF>(node_ptrs, 1, new_edge_ptrs[1]);
 
     uint8_t new_key_first;
-    UpdateTailEdge(edge_ptrs, match_len, data, new_edge_ptrs[0], new_key_first,
+    UpdateTailEdge<EF>(edge_ptrs, match_len, data, new_edge_ptrs[0], new_key_first,
                    map_new_sliding);
 
     int release_buffer_size = 0;
     size_t edge_str_off;
-    UpdateHeadEdge(edge_ptrs, match_len, data, release_buffer_size, edge_str_off,
+    UpdateHeadEdge<EF>(edge_ptrs, match_len, data, release_buffer_size, edge_str_off,
                    map_new_sliding);
-    Write6BInteger(edge_ptrs.offset_ptr, node_ptrs.offset);
+    EF::WriteOffset(edge_ptrs.offset_ptr, node_ptrs.offset);
 
     // Update the new node
     // match not found for the new node, should not set node[1] and data offset
@@ -415,11 +527,11 @@ int DictMem::AddLink(EdgePtrs &edge_ptrs, int match_len, const uint8_t *key,
 
     // Update the new edge
     new_edge_ptrs[1].len_ptr[0] = key_len;
-    if(key_len > LOCAL_EDGE_LEN)
+    if(key_len > EF::local_edge_len)
     {
         size_t new_key_off;
         ReserveData(key+1, key_len-1, new_key_off, map_new_sliding);
-        Write5BInteger(new_edge_ptrs[1].ptr, new_key_off);
+        EF::WriteStrOffset(new_edge_ptrs[1].ptr, new_key_off);
     }
     else
     {
@@ -429,10 +541,12 @@ int DictMem::AddLink(EdgePtrs &edge_ptrs, int match_len, const uint8_t *key,
     }
     // Indicate this new edge holds a data offset
     new_edge_ptrs[1].flag_ptr[0] = EDGE_FLAG_DATA_OFF;
-    Write6BInteger(new_edge_ptrs[1].offset_ptr, data_off);
+    EF::WriteOffset(new_edge_ptrs[1].offset_ptr, data_off);
 
     if(node_move)
         WriteData(node, node_size[1], node_ptrs.offset);
+    else
+        IncCacheEpoch(node_ptrs.offset, node_size[1]);
 
     // Update the parent edge
     if(release_buffer_size > 0)
@@ -442,7 +556,7 @@ int DictMem::AddLink(EdgePtrs &edge_ptrs, int match_len, const uint8_t *key,
     header->excep_updating_status = EXCEP_STATUS_ADD_EDGE;
     lfree->WriterLockFreeStart(edge_ptrs.offset);
 #endif
-    WriteEdge(edge_ptrs);
+    WriteEdge<EF>(edge_ptrs);
 #ifdef __LOCK_FREE__
     lfree->WriterLockFreeStop();
     header->excep_updating_status = EXCEP_STATUS_NONE;
@@ -455,6 +569,7 @@ int DictMem::AddLink(EdgePtrs &edge_ptrs, int match_len, const uint8_t *key,
 // Add a new edge in current node
 // This invloves creating a new node and copying data from old node to the new node
 // and updating the child node offset in edge_ptrs (parent edge).
+template<typename EF>
 int DictMem::UpdateNode(EdgePtrs &edge_ptrs, const uint8_t *key, int key_len,
                         size_t data_off)
 {
@@ -470,7 +585,7 @@ int DictMem::UpdateNode(EdgePtrs &edge_ptrs, const uint8_t *key, int key_len,
     InitNodePtrs(node, nt, node_ptrs);
 
     // Load the old node
-    size_t old_node_off = Get6BInteger(edge_ptrs.offset_ptr);
+    size_t old_node_off = EF::GetOffset(edge_ptrs.offset_ptr);
     int release_node_index = -1;
     if(nt == 0)
     {
@@ -493,8 +608,8 @@ int DictMem::UpdateNode(EdgePtrs &edge_ptrs, const uint8_t *key, int key_len,
         int copy_size = NODE_EDGE_KEY_FIRST + nt;
         if(ReadData(node_ptrs.ptr, copy_size, old_node_off) != copy_size)
             return MBError::READ_ERROR;
-        if(ReadData(node_ptrs.ptr+copy_size+1, EDGE_SIZE*nt, old_node_off+copy_size) !=
-                    EDGE_SIZE*nt)
+        copy_size = edge_slot_size * nt;
+        if(ReadData(node_ptrs.edge_ptr, copy_size, old_node_off+GetEdgeStart(nt)) != copy_size)
             return MBError::READ_ERROR;
 
         release_node_index = nt - 1;
@@ -505,17 +620,17 @@ int DictMem::UpdateNode(EdgePtrs &edge_ptrs, const uint8_t *key, int key_len,
     // Update the first edge key character for the new edge
     node_ptrs.edge_key_ptr[nt] = key[0];
 
-    Write6BInteger(edge_ptrs.offset_ptr, node_ptrs.offset);
+    EF::WriteOffset(edge_ptrs.offset_ptr, node_ptrs.offset);
 
     // Create the new edge
     EdgePtrs new_edge_ptrs;
-    InitEdgePtrs(node_ptrs, nt, new_edge_ptrs);
+    InitEdgePtrs<EF>(node_ptrs, nt, new_edge_ptrs);
     new_edge_ptrs.len_ptr[0] = key_len;
-    if(key_len > LOCAL_EDGE_LEN)
+    if(key_len > EF::local_edge_len)
     {
         size_t new_key_off;
         ReserveData(key+1, key_len-1, new_key_off, map_new_sliding);
-        Write5BInteger(new_edge_ptrs.ptr, new_key_off);
+        EF::WriteStrOffset(new_edge_ptrs.ptr, new_key_off);
     }
     else
     {
@@ -526,10 +641,12 @@ int DictMem::UpdateNode(EdgePtrs &edge_ptrs, const uint8_t *key, int key_len,
 
     // Indicate this new edge holds a data offset
     new_edge_ptrs.flag_ptr[0] = EDGE_FLAG_DATA_OFF;
-    Write6BInteger(new_edge_ptrs.offset_ptr, data_off);
+    EF::WriteOffset(new_edge_ptrs.offset_ptr, data_off);
 
     if(node_move)
         WriteData(node, node_size[nt], node_ptrs.offset);
+    else
+        IncCacheEpoch(node_ptrs.offset, node_size[nt]);
 
     if(release_node_index >= 0)
         ReleaseNode(old_node_off, release_node_index);
@@ -538,7 +655,7 @@ int DictMem::UpdateNode(EdgePtrs &edge_ptrs, const uint8_t *key, int key_len,
     header->excep_updating_status = EXCEP_STATUS_ADD_EDGE;
     lfree->WriterLockFreeStart(edge_ptrs.offset);
 #endif
-    WriteEdge(edge_ptrs);
+    WriteEdge<EF>(edge_ptrs);
 #ifdef __LOCK_FREE__
     lfree->WriterLockFreeStop();
     header->excep_updating_status = EXCEP_STATUS_NONE;
@@ -548,6 +665,7 @@ int DictMem::UpdateNode(EdgePtrs &edge_ptrs, const uint8_t *key, int key_len,
     return MBError::SUCCESS;
 }
 
+template<typename EF>
 bool DictMem::FindNext(const unsigned char *key, int keylen, int &match_len,
                        EdgePtrs &edge_ptr, uint8_t *key_tmp) const
 {
@@ -557,7 +675,7 @@ bool DictMem::FindNext(const unsigned char *key, int keylen, int &match_len,
         return false;
     }
 
-    size_t node_off = Get6BInteger(edge_ptr.offset_ptr);
+    size_t node_off = EF::GetOffset(edge_ptr.offset_ptr);
 #ifdef __DEBUG__
     assert(node_off != 0);
 #endif
@@ -567,8 +685,7 @@ bool DictMem::FindNext(const unsigned char *key, int keylen, int &match_len,
     edge_ptr.curr_nt = nt;
     nt++;
     // Load edge key first
-    node_off += NODE_EDGE_KEY_FIRST;
-    if(ReadData(key_tmp, nt, node_off) != nt)
+    if(ReadData(key_tmp, nt, node_off+NODE_EDGE_KEY_FIRST) != nt)
         return false;
     int i;
     for(i = 0; i < nt; i++)
@@ -583,14 +700,14 @@ bool DictMem::FindNext(const unsigned char *key, int keylen, int &match_len,
     match_len = 1;
 
     // Load the new edge
-    edge_ptr.offset = node_off + nt + i*EDGE_SIZE;
-    if(ReadData(header->excep_buff, EDGE_SIZE, edge_ptr.offset) != EDGE_SIZE)
+    edge_ptr.offset = GetEdgeOffset(node_off, nt, i);
+    if(ReadData(header->excep_buff, EF::edge_size, edge_ptr.offset) != EF::edge_size)
         return false;
     uint8_t *key_string_ptr;
     int len = edge_ptr.len_ptr[0] - 1;
-    if(len > LOCAL_EDGE_LEN_M1)
+    if(len > EF::local_edge_len - 1)
     {
-        if(ReadData(key_tmp, len, Get5BInteger(edge_ptr.ptr)) != len)
+        if(ReadData(key_tmp, len, EF::GetStrOffset(edge_ptr.ptr)) != len)
             return false;
         key_string_ptr = key_tmp;
     }
@@ -625,28 +742,40 @@ bool DictMem::ReserveNode(int nt, size_t &offset, uint8_t* &ptr)
     int buf_index = free_lists->GetBufferIndex(buf_size);
 
     header->n_states++;
+    // Each buffer in the list is checked at most once.
+    int max_skip = static_cast<int>(std::min(free_lists->GetBufferCountByIndex(buf_index),
+                                             static_cast<uint64_t>(MAX_UNALIGNED_NODE_SKIP)));
+    int num_skip = 0;
+    // Released buffers are not reused while a snapshot is being copied.
 #ifdef __LOCK_FREE__
-    if(free_lists->GetBufferByIndex(buf_index, offset))
-    {
-        ptr = node_ptr;
-        memset(ptr, 0, buf_size); 
-        header->pending_index_buff_size -= buf_size;
-        return true;
-    }
+    while(num_skip < max_skip && !SnapshotActive() &&
+          free_lists->GetBufferByIndex(buf_index, offset))
 #else
-    if(free_lists->GetBufferCountByIndex(buf_index) > 0)
+    while(num_skip < max_skip && !SnapshotActive() &&
+          free_lists->GetBufferCountByIndex(buf_index) > 0)
+#endif
     {
+#ifndef __LOCK_FREE__
         offset = free_lists->RemoveBufferByIndex(buf_index);
+#endif
+        if(offset != AlignNodeOffset(offset))
+        {
+            // Edge string buffer of the same size; put it back to the tail
+            // of the list so that it can be reused for edge strings.
+            free_lists->AddBufferByIndex(buf_index, offset);
+            num_skip++;
+            continue;
+        }
         ptr = node_ptr;
         memset(ptr, 0, buf_size); 
         header->pending_index_buff_size -= buf_size;
         return true;
     }
-#endif
 
     ptr = NULL;
     size_t old_off = header->m_index_offset;
     bool node_move = false;
+    header->m_index_offset = AlignNodeOffset(header->m_index_offset);
     int rval = kv_file->Reserve(header->m_index_offset, buf_size, ptr);
     if(rval != MBError::SUCCESS)
         throw rval;
@@ -677,13 +806,13 @@ void DictMem::ReserveData(const uint8_t* key, int size, size_t &offset,
     int buf_size  = free_lists->GetAlignmentSize(size);
 
 #ifdef __LOCK_FREE__
-    if(free_lists->GetBufferByIndex(buf_index, offset))
+    if(!SnapshotActive() && free_lists->GetBufferByIndex(buf_index, offset))
     {
         WriteData(key, size, offset);
         header->pending_index_buff_size -= buf_size;
     }
 #else
-    if(free_lists->GetBufferCountByIndex(buf_index) > 0)
+    if(!SnapshotActive() && free_lists->GetBufferCountByIndex(buf_index) > 0)
     {
         offset = free_lists->RemoveBufferByIndex(buf_index);
         WriteData(key, size, offset);
@@ -710,9 +839,14 @@ void DictMem::ReserveData(const uint8_t* key, int size, size_t &offset,
         offset = header->m_index_offset;
         header->m_index_offset += buf_size;
         if(ptr != NULL)
+        {
             memcpy(ptr, key, size);
+            IncCacheEpoch(offset, size);
+        }
         else
+        {
             WriteData(key, size, offset);
+        }
     }
 
     header->edge_str_size += buf_size;
@@ -744,40 +878,42 @@ void DictMem::ReleaseBuffer(size_t offset, int size)
     header->pending_index_buff_size += free_lists->GetAlignmentSize(size);
 }
 
+template<typename EF>
 int DictMem::GetRootEdge(size_t rc_off, int nt, EdgePtrs &edge_ptrs) const
 {
     if(rc_off != 0)
-        edge_ptrs.offset = rc_off + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + nt*EDGE_SIZE;
+        edge_ptrs.offset = GetEdgeOffset(rc_off, NUM_ALPHABET, nt);
     else
-        edge_ptrs.offset = root_offset + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + nt*EDGE_SIZE;
-    if(ReadData(edge_ptrs.edge_buff, EDGE_SIZE, edge_ptrs.offset) != EDGE_SIZE)
+        edge_ptrs.offset = GetEdgeOffset(root_offset, NUM_ALPHABET, nt);
+    if(ReadData(edge_ptrs.edge_buff, EF::edge_size, edge_ptrs.offset) != EF::edge_size)
         return MBError::READ_ERROR;
 
-    InitTempEdgePtrs(edge_ptrs);
+    InitTempEdgePtrs<EF>(edge_ptrs);
     return MBError::SUCCESS;
 }
 
 // The temp edge is written to shared memory for handling segfault situations.
 // When writer restarts from segfault, it will retry WriteEdge so that the DB is
 // maintained consistently.
+template<typename EF>
 int DictMem::GetRootEdge_Writer(bool rc_mode, int nt, EdgePtrs &edge_ptrs) const
 {
     if(rc_mode)
     {
         if(root_offset_rc == 0)
             throw (int) MBError::UNKNOWN_ERROR;
-        edge_ptrs.offset = root_offset_rc + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + nt*EDGE_SIZE;
+        edge_ptrs.offset = GetEdgeOffset(root_offset_rc, NUM_ALPHABET, nt);
     }
     else
     {
-        edge_ptrs.offset = root_offset + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + nt*EDGE_SIZE;
+        edge_ptrs.offset = GetEdgeOffset(root_offset, NUM_ALPHABET, nt);
     }
-    if(ReadData(header->excep_buff, EDGE_SIZE, edge_ptrs.offset) != EDGE_SIZE)
+    if(ReadData(header->excep_buff, EF::edge_size, edge_ptrs.offset) != EF::edge_size)
         return MBError::READ_ERROR;
 
     edge_ptrs.ptr = header->excep_buff;
-    edge_ptrs.len_ptr = edge_ptrs.ptr + EDGE_LEN_POS;
-    edge_ptrs.flag_ptr = edge_ptrs.ptr + EDGE_FLAG_POS;
+    edge_ptrs.len_ptr = edge_ptrs.ptr + EF::len_pos;
+    edge_ptrs.flag_ptr = edge_ptrs.ptr + EF::flag_pos;
     edge_ptrs.offset_ptr = edge_ptrs.flag_ptr + 1;
     return MBError::SUCCESS;
 }
@@ -800,6 +936,8 @@ size_t DictMem::InitRootNode_RC()
 
     if(node_move)
         WriteData(root_node, node_size[NUM_ALPHABET-1], root_offset_rc);
+    else
+        IncCacheEpoch(root_offset_rc, node_size[NUM_ALPHABET-1]);
 
     return root_offset_rc;
 }
@@ -809,13 +947,13 @@ size_t DictMem::InitRootNode_RC()
 // considering the full DB is deleted.
 int DictMem::ClearRootEdge(int nt) const
 {
-    size_t offset = root_offset + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + nt*EDGE_SIZE;
+    size_t offset = GetEdgeOffset(root_offset, NUM_ALPHABET, nt);
 #ifdef __LOCK_FREE__
     header->excep_lf_offset = offset;
     header->excep_updating_status = EXCEP_STATUS_CLEAR_EDGE;
     lfree->WriterLockFreeStart(offset);
 #endif
-    WriteData(DictMem::empty_edge, EDGE_SIZE, offset);
+    WriteData(DictMem::empty_edge, edge_size, offset);
 #ifdef __LOCK_FREE__
     lfree->WriterLockFreeStop();
     header->excep_updating_status = EXCEP_STATUS_NONE;
@@ -832,13 +970,13 @@ int DictMem::ClearRootEdges_RC() const
     size_t offset;
     for(int i = 0; i < NUM_ALPHABET; i++)
     {
-        offset = root_offset_rc + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + i*EDGE_SIZE;
+        offset = GetEdgeOffset(root_offset_rc, NUM_ALPHABET, i);
 #ifdef __LOCK_FREE__
         header->excep_lf_offset = offset;
         header->excep_updating_status = EXCEP_STATUS_CLEAR_EDGE;
         lfree->WriterLockFreeStart(offset);
 #endif
-        DRMBase::WriteData(DictMem::empty_edge, EDGE_SIZE, offset);
+        DRMBase::WriteData(DictMem::empty_edge, edge_size, offset);
 #ifdef __LOCK_FREE__
         lfree->WriterLockFreeStop();
         header->excep_updating_status = EXCEP_STATUS_NONE;
@@ -859,15 +997,16 @@ void DictMem::ClearMem() const
     header->pending_index_buff_size = 0;
 }
 
+template<typename EF>
 int DictMem::NextEdge(const uint8_t *key, EdgePtrs &edge_ptrs, uint8_t *node_buff,
                       MBData &mbdata) const
 {
     size_t node_off;
     // Check if need to read saved edge
     if((mbdata.options & CONSTS::OPTION_READ_SAVED_EDGE) && edge_ptrs.offset == mbdata.edge_ptrs.offset)
-        node_off = Get6BInteger(mbdata.edge_ptrs.offset_ptr);
+        node_off = EF::GetOffset(mbdata.edge_ptrs.offset_ptr);
     else
-        node_off = Get6BInteger(edge_ptrs.offset_ptr);
+        node_off = EF::GetOffset(edge_ptrs.offset_ptr);
 
     int byte_read;
     byte_read = ReadData(node_buff, NODE_EDGE_KEY_FIRST, node_off);
@@ -892,9 +1031,9 @@ int DictMem::NextEdge(const uint8_t *key, EdgePtrs &edge_ptrs, uint8_t *node_buf
                 edge_ptrs.parent_offset = edge_ptrs.offset;
                 edge_ptrs.curr_node_offset = node_off;
             }
-            size_t offset_new = node_off + NODE_EDGE_KEY_FIRST + nt + i*EDGE_SIZE;
-            byte_read = ReadData(edge_ptrs.edge_buff, EDGE_SIZE, offset_new);
-            if(byte_read != EDGE_SIZE)
+            size_t offset_new = GetEdgeOffset(node_off, nt, i);
+            byte_read = ReadData(edge_ptrs.edge_buff, EF::edge_size, offset_new);
+            if(byte_read != EF::edge_size)
             {
                 ret = MBError::READ_ERROR;
                 break;
@@ -909,24 +1048,26 @@ int DictMem::NextEdge(const uint8_t *key, EdgePtrs &edge_ptrs, uint8_t *node_buf
     return ret;
 }
 
+template<typename EF>
 void DictMem::RemoveRootEdge(const EdgePtrs &edge_ptrs)
 {
     // Clear the edge
     // Root node needs special handling.
-    if(edge_ptrs.len_ptr[0] > LOCAL_EDGE_LEN)
-        ReleaseBuffer(Get5BInteger(edge_ptrs.ptr), edge_ptrs.len_ptr[0]-1);
+    if(edge_ptrs.len_ptr[0] > EF::local_edge_len)
+        ReleaseBuffer(EF::GetStrOffset(edge_ptrs.ptr), edge_ptrs.len_ptr[0]-1);
 #ifdef __LOCK_FREE__
     header->excep_lf_offset = edge_ptrs.offset;
     header->excep_updating_status = EXCEP_STATUS_CLEAR_EDGE;
     lfree->WriterLockFreeStart(edge_ptrs.offset);
 #endif
-    WriteData(DictMem::empty_edge, EDGE_SIZE, edge_ptrs.offset);
+    WriteData(DictMem::empty_edge, EF::edge_size, edge_ptrs.offset);
 #ifdef __LOCK_FREE__
     lfree->WriterLockFreeStop();
     header->excep_updating_status = EXCEP_STATUS_NONE;
 #endif
 }
 
+template<typename EF>
 int DictMem::RemoveEdgeSizeN(const EdgePtrs &edge_ptrs,
                              int nt,
                              size_t node_offset,
@@ -945,47 +1086,49 @@ int DictMem::RemoveEdgeSizeN(const EdgePtrs &edge_ptrs,
 
     // Copy data from old node
     uint8_t *first_key_ptr = node + NODE_EDGE_KEY_FIRST;
-    uint8_t *edge_ptr = first_key_ptr + nt - 1;
+    uint8_t *edge_ptr = node + GetEdgeStart(nt - 1);
     uint8_t old_edge_buff[16];
-    size_t old_edge_offset = node_offset + NODE_EDGE_KEY_FIRST + nt;
+    size_t old_edge_offset = GetEdgeOffset(node_offset, nt, 0);
     memcpy(node, old_node_buffer, NODE_EDGE_KEY_FIRST);
     node[1] = nt - 2;
     for(int i = 0; i < nt; i++)
     {
         // load the edge
-        if(ReadData(old_edge_buff, EDGE_SIZE, old_edge_offset) != EDGE_SIZE)
+        if(ReadData(old_edge_buff, EF::edge_size, old_edge_offset) != EF::edge_size)
             return MBError::READ_ERROR;
 
         if(i == edge_ptrs.curr_edge_index)
         {
             // Need to release this edge string buffer
-            if(old_edge_buff[EDGE_LEN_POS] > LOCAL_EDGE_LEN)
+            if(old_edge_buff[EF::len_pos] > EF::local_edge_len)
             {
-                str_off_rel = Get5BInteger(old_edge_buff);
-                str_size_rel = old_edge_buff[EDGE_LEN_POS]-1;
+                str_off_rel = EF::GetStrOffset(old_edge_buff);
+                str_size_rel = old_edge_buff[EF::len_pos]-1;
             }
         }
         else
         {
             first_key_ptr[0] = old_node_buffer[NODE_EDGE_KEY_FIRST+i];
-            memcpy(edge_ptr, old_edge_buff, EDGE_SIZE);
+            memcpy(edge_ptr, old_edge_buff, EF::edge_size);
 
             first_key_ptr++;
-            edge_ptr += EDGE_SIZE;
+            edge_ptr += edge_slot_size;
         }
-        old_edge_offset += EDGE_SIZE;
+        old_edge_offset += edge_slot_size;
     }
 
     // Write the new node before free
     if(node_move)
         WriteData(node, node_size[nt-2], new_node_offset);
+    else
+        IncCacheEpoch(new_node_offset, node_size[nt-2]);
 
     // Update the link from parent edge to the new node offset
-    Write6BInteger(header->excep_buff, new_node_offset);
+    EF::WriteOffset(header->excep_buff, new_node_offset);
 #ifdef __LOCK_FREE__
     lfree->WriterLockFreeStart(parent_edge_offset);
 #endif
-    WriteData(header->excep_buff, OFFSET_SIZE, parent_edge_offset+EDGE_NODE_LEADING_POS);
+    WriteData(header->excep_buff, EF::offset_size, parent_edge_offset+EF::offset_pos);
 #ifdef __LOCK_FREE__
     lfree->WriterLockFreeStop();
 #endif
@@ -993,6 +1136,7 @@ int DictMem::RemoveEdgeSizeN(const EdgePtrs &edge_ptrs,
     return MBError::SUCCESS;
 }
 
+template<typename EF>
 int DictMem::RemoveEdgeSizeOne(uint8_t *old_node_buffer,
                                size_t parent_edge_offset,
                                size_t node_offset,
@@ -1007,12 +1151,12 @@ int DictMem::RemoveEdgeSizeOne(uint8_t *old_node_buffer,
         uint8_t *parent_edge_buff = header->excep_buff;
         size_t data_offset = Get6BInteger(old_node_buffer+2);
         parent_edge_buff[0] = EDGE_FLAG_DATA_OFF;
-        Write6BInteger(parent_edge_buff+1, data_offset);
+        EF::WriteOffset(parent_edge_buff+1, data_offset);
 #ifdef __LOCK_FREE__
         lfree->WriterLockFreeStart(parent_edge_offset);
 #endif
-        // Write the one-byte flag and 6-byte offset
-        WriteData(parent_edge_buff, OFFSET_SIZE_P1, parent_edge_offset+EDGE_FLAG_POS);
+        // Write the one-byte flag and the data offset
+        WriteData(parent_edge_buff, EF::offset_size+1, parent_edge_offset+EF::flag_pos);
 #ifdef __LOCK_FREE__
         lfree->WriterLockFreeStop();
 #endif
@@ -1024,25 +1168,26 @@ int DictMem::RemoveEdgeSizeOne(uint8_t *old_node_buffer,
     }
 
     uint8_t old_edge_buff[16];
-    size_t old_edge_offset = node_offset + NODE_EDGE_KEY_FIRST + nt;
-    if(ReadData(old_edge_buff, EDGE_SIZE, old_edge_offset) != EDGE_SIZE)
+    size_t old_edge_offset = GetEdgeOffset(node_offset, nt, 0);
+    if(ReadData(old_edge_buff, EF::edge_size, old_edge_offset) != EF::edge_size)
         return MBError::READ_ERROR;
-    if(old_edge_buff[EDGE_LEN_POS] > LOCAL_EDGE_LEN)
+    if(old_edge_buff[EF::len_pos] > EF::local_edge_len)
     {
-        str_off_rel = Get5BInteger(old_edge_buff);
-        str_size_rel = old_edge_buff[EDGE_LEN_POS]-1;
+        str_off_rel = EF::GetStrOffset(old_edge_buff);
+        str_size_rel = old_edge_buff[EF::len_pos]-1;
     }
 
     return rval;
 }
 
+template<typename EF>
 int DictMem::RemoveEdgeByIndex(const EdgePtrs &edge_ptrs, MBData &data)
 {
     header->excep_offset = edge_ptrs.curr_node_offset;
 
     if(header->excep_offset == root_offset)
     {
-        RemoveRootEdge(edge_ptrs);
+        RemoveRootEdge<EF>(edge_ptrs);
         return MBError::SUCCESS;
     }
 
@@ -1063,12 +1208,12 @@ int DictMem::RemoveEdgeByIndex(const EdgePtrs &edge_ptrs, MBData &data)
     header->excep_updating_status = EXCEP_STATUS_REMOVE_EDGE;
     if(nt > 1)
     {
-        rval = RemoveEdgeSizeN(edge_ptrs, nt, header->excep_offset, old_node_buffer,
+        rval = RemoveEdgeSizeN<EF>(edge_ptrs, nt, header->excep_offset, old_node_buffer,
                                str_off_rel, str_size_rel, header->excep_lf_offset);
     }
     else
     {
-        rval = DictMem::RemoveEdgeSizeOne(old_node_buffer, header->excep_lf_offset,
+        rval = DictMem::RemoveEdgeSizeOne<EF>(old_node_buffer, header->excep_lf_offset,
                                header->excep_offset, nt, str_off_rel, str_size_rel);
     }
     header->excep_updating_status = EXCEP_STATUS_NONE;
@@ -1084,7 +1229,7 @@ int DictMem::RemoveEdgeByIndex(const EdgePtrs &edge_ptrs, MBData &data)
     header->excep_updating_status = EXCEP_STATUS_CLEAR_EDGE;
     lfree->WriterLockFreeStart(edge_ptrs.offset);
 #endif
-    WriteData(DictMem::empty_edge, EDGE_SIZE, edge_ptrs.offset);
+    WriteData(DictMem::empty_edge, EF::edge_size, edge_ptrs.offset);
 #ifdef __LOCK_FREE__
     lfree->WriterLockFreeStop();
     header->excep_updating_status = EXCEP_STATUS_NONE;
@@ -1102,10 +1247,13 @@ void DictMem::PrintStats(std::ostream &out_stream) const
     out_stream << "Dict Memory Stats:" << std::endl;
     out_stream << "\tIndex size: " << header->m_index_offset << std::endl;
     out_stream << "\tIndex block size: " << header->index_block_size << std::endl;
+    out_stream << "\tIndex format: " << ((header->index_format & INDEX_FORMAT_ALIGNED) ?
+                                         "aligned" : "packed")
+               << (compact_index ? " compact" : "") << std::endl;
     out_stream << "\tNumber of edges: " << header->n_edges << std::endl;
     out_stream << "\tNumber of nodes: " << header->n_states << std::endl;
     out_stream << "\tEdge string size: " << header->edge_str_size << std::endl;
-    out_stream << "\tEdge size: " << header->n_edges*EDGE_SIZE << std::endl;
+    out_stream << "\tEdge size: " << header->n_edges*edge_size << std::endl;
     out_stream << "\tException flag: " << header->excep_updating_status << std::endl;
     out_stream << "\tPending Buffer Size: " << header->pending_index_buff_size << std::endl;
     if(free_lists != NULL)
@@ -1125,6 +1273,26 @@ void DictMem::ResetSlidingWindow() const
         header->shm_index_sliding_start.store(0, std::memory_order_relaxed);
 }
 
+int DictMem::InitBlockCache(size_t cache_size)
+{
+    return kv_file->InitBlockCache(cache_size);
+}
+
+void DictMem::InitCacheEpoch(std::atomic<uint32_t> *epoch, uint32_t num_slots)
+{
+    kv_file->InitShmCacheEpoch(epoch, num_slots);
+}
+
+void DictMem::GetMappedRegions(std::vector<std::pair<uint8_t*, size_t>> &regions)
+{
+    kv_file->GetMappedRegions(header->m_index_offset, regions);
+}
+
+void DictMem::GetFileUsage(FileUsage &usage) const
+{
+    kv_file->GetUsage(usage);
+}
+
 void DictMem::InitLockFreePtr(LockFree *lf)
 {
     lfree = lf;
@@ -1151,4 +1319,22 @@ void DictMem::WriteData(const uint8_t *buff, unsigned len, size_t offset) const
         throw (int) MBError::WRITE_ERROR;
 }
 
+// Instances of the edge operations called by Dict
+#define INSTANTIATE_EDGE_FORMAT(EF)                                                      \
+    template void DictMem::AddRootEdge<EF>(EdgePtrs&, const uint8_t*, int, size_t);     \
+    template int  DictMem::InsertNode<EF>(EdgePtrs&, int, size_t, MBData&);             \
+    template int  DictMem::AddLink<EF>(EdgePtrs&, int, const uint8_t*, int, size_t,     \
+                                       MBData&);                                        \
+    template int  DictMem::UpdateNode<EF>(EdgePtrs&, const uint8_t*, int, size_t);      \
+    template bool DictMem::FindNext<EF>(const unsigned char*, int, int&, EdgePtrs&,     \
+                                        uint8_t*) const;                                \
+    template int  DictMem::GetRootEdge<EF>(size_t, int, EdgePtrs&) const;               \
+    template int  DictMem::GetRootEdge_Writer<EF>(bool, int, EdgePtrs&) const;          \
+    template int  DictMem::NextEdge<EF>(const uint8_t*, EdgePtrs&, uint8_t*,            \
+                                        MBData&) const;                                 \
+    template int  DictMem::RemoveEdgeByIndex<EF>(const EdgePtrs&, MBData&);
+
+INSTANTIATE_EDGE_FORMAT(EdgeFormat6B)
+INSTANTIATE_EDGE_FORMAT(EdgeFormat4B)
+
 }
@@ -60,6 +60,7 @@ public:
     void PrintStats(std::ostream &out_stream) const;
 
     void InitNodePtrs(uint8_t *ptr, int nt, NodePtrs &node_ptrs);
+    template<typename EF>
     void InitEdgePtrs(const NodePtrs &node_ptrs, int index,
                   EdgePtrs &edge_ptrs);
     void AddRootEdge(EdgePtrs &edge_ptrs, const uint8_t *key, int len,
@@ -80,16 +81,70 @@ public:
     int  NextEdge(const uint8_t *key, EdgePtrs &edge_ptrs,
                   uint8_t *tmp_buff, MBData &mbdata) const;
     int  RemoveEdgeByIndex(const EdgePtrs &edge_ptrs, MBData &data);
+
+    // The edge operations above check the index format in each call.
+    // Dict calls the instances for the format (EdgeFormat6B or EdgeFormat4B)
+    // directly.
+    template<typename EF>
+    void AddRootEdge(EdgePtrs &edge_ptrs, const uint8_t *key, int len,
+                  size_t data_offset);
+    template<typename EF>
+    int  InsertNode(EdgePtrs &edge_ptrs, int match_len, size_t data_offset,
+                  MBData &data);
+    template<typename EF>
+    int  AddLink(EdgePtrs &edge_ptrs, int match_len, const uint8_t *key,
+                  int key_len, size_t data_off, MBData &data);
+    template<typename EF>
+    int  UpdateNode(EdgePtrs &edge_ptrs, const uint8_t *key, int key_len,
+                  size_t data_off);
+    template<typename EF>
+    bool FindNext(const unsigned char *key, int keylen, int &match_len,
+                  EdgePtrs &edge_ptr, uint8_t *key_tmp) const;
+    template<typename EF>
+    int  GetRootEdge(size_t rc_off, int nt, EdgePtrs &edge_ptrs) const;
+    template<typename EF>
+    int  GetRootEdge_Writer(bool rc_mode, int nt, EdgePtrs &edge_ptrs) const;
+    template<typename EF>
+    int  NextEdge(const uint8_t *key, EdgePtrs &edge_ptrs,
+                  uint8_t *tmp_buff, MBData &mbdata) const;
+    template<typename EF>
+    int  RemoveEdgeByIndex(const EdgePtrs &edge_ptrs, MBData &data);
+
     void InitRootNode();
     inline void WriteEdge(const EdgePtrs &edge_ptrs) const;
+    template<typename EF>
+    inline void WriteEdge(const EdgePtrs &edge_ptrs) const;
     void WriteData(const uint8_t *buff, unsigned len, size_t offset) const;
     inline size_t GetRootOffset() const;
     void ClearMem() const;
     const int* GetNodeSizePtr() const;
     void ResetSlidingWindow() const;
+    int  InitBlockCache(size_t cache_size);
+    void InitCacheEpoch(std::atomic<uint32_t> *epoch, uint32_t num_slots);
+    void GetMappedRegions(std::vector<std::pair<uint8_t*, size_t>> &regions);
+    void GetFileUsage(FileUsage &usage) const;
 
     void InitLockFreePtr(LockFree *lf);
 
+    // Node layout of the index format; nt is the number of edges.
+    inline int    GetNodeSize(int nt) const;
+    inline size_t GetEdgeOffset(size_t node_off, int nt, int index) const;
+    inline int    GetEdgeSlotSize() const;
+    inline size_t AlignNodeOffset(size_t offset) const;
+
+    // Edge format of the index for the code that is not instantiated
+    // for each format. A link is a node or data offset stored in an edge.
+    inline bool   IsCompactIndex() const;
+    inline int    GetEdgeSize() const;
+    inline int    GetLocalEdgeLen() const;
+    inline int    GetEdgeLinkPos() const;
+    inline int    GetLinkSize() const;
+    inline int    GetEdgeStrLinkSize() const;
+    inline size_t GetLink(const uint8_t *buff) const;
+    inline void   WriteLink(uint8_t *buff, size_t offset) const;
+    inline size_t GetEdgeStrLink(const uint8_t *buff) const;
+    inline void   WriteEdgeStrLink(uint8_t *buff, size_t offset) const;
+
     void Flush() const;
 
     // Updates in RC mode
@@ -103,16 +158,23 @@ private:
     bool     ReserveNode(int nt, size_t &offset, uint8_t* &ptr);
     void     ReleaseNode(size_t offset, int nt);
     void     ReleaseBuffer(size_t offset, int size);
+    void     InitNodeLayout();
+    inline int GetEdgeStart(int nt) const;
+    template<typename EF>
     void     UpdateTailEdge(EdgePtrs &edge_ptrs, int match_len, MBData &data,
                             EdgePtrs &tail_edge, uint8_t &new_key_first,
                             bool &map_new_sliding);
+    template<typename EF>
     void     UpdateHeadEdge(EdgePtrs &edge_ptrs, int match_len,
                             MBData &data, int &release_buffer_size,
                             size_t &edge_str_off, bool &map_new_sliding);
+    template<typename EF>
     void     RemoveRootEdge(const EdgePtrs &edge_ptrs);
+    template<typename EF>
     int      RemoveEdgeSizeN(const EdgePtrs &edge_ptrs, int nt, size_t node_offset,
                             uint8_t *old_node_buffer, size_t &str_off_rel,
                             int &str_size_rel, size_t parent_edge_offset);
+    template<typename EF>
     int      RemoveEdgeSizeOne(uint8_t *old_node_buffer, size_t parent_edge_offset,
                             size_t node_offset, int nt, size_t &str_off_rel,
                             int &str_size_rel);
@@ -120,6 +182,15 @@ private:
     int *node_size;
     bool is_valid;
 
+    // INDEX_FORMAT_PACKED: 1, edge size, 1
+    // INDEX_FORMAT_ALIGNED: ALIGNED_EDGE_SLOT, ALIGNED_EDGE_SLOT, ALIGNED_NODE_SIZE
+    int edge_alignment;
+    int edge_slot_size;
+    int node_alignment;
+    // INDEX_FORMAT_COMPACT: EdgeFormat4B; otherwise EdgeFormat6B
+    bool compact_index;
+    int  edge_size;
+
     size_t root_offset;
     uint8_t *node_ptr;
 
@@ -134,14 +205,20 @@ private:
 
 inline void DictMem::WriteEdge(const EdgePtrs &edge_ptrs) const
 {
-    if(edge_ptrs.offset + EDGE_SIZE > header->m_index_offset)
+    CALL_EDGE_FORMAT(compact_index, WriteEdge, edge_ptrs);
+}
+
+template<typename EF>
+inline void DictMem::WriteEdge(const EdgePtrs &edge_ptrs) const
+{
+    if(edge_ptrs.offset + EF::edge_size > header->m_index_offset)
     {
-        std::cerr << "invalid edge write: " << edge_ptrs.offset << " " << EDGE_SIZE
+        std::cerr << "invalid edge write: " << edge_ptrs.offset << " " << EF::edge_size
                   << " " << header->m_index_offset << "\n";
         throw (int) MBError::OUT_OF_BOUND;
     }
 
-    if(kv_file->RandomWrite(edge_ptrs.ptr, EDGE_SIZE, edge_ptrs.offset) != EDGE_SIZE)
+    if(kv_file->RandomWrite(edge_ptrs.ptr, EF::edge_size, edge_ptrs.offset) != EF::edge_size)
         throw (int) MBError::WRITE_ERROR;
 }
 
@@ -150,23 +227,108 @@ inline size_t DictMem::GetRootOffset() const
     return root_offset;
 }
 
+inline int DictMem::GetEdgeStart(int nt) const
+{
+    int edge_start = NODE_EDGE_KEY_FIRST + nt;
+    return (edge_start + edge_alignment - 1) / edge_alignment * edge_alignment;
+}
+
+inline int DictMem::GetNodeSize(int nt) const
+{
+    int size = GetEdgeStart(nt) + nt*edge_slot_size;
+    return (size + node_alignment - 1) / node_alignment * node_alignment;
+}
+
+inline size_t DictMem::GetEdgeOffset(size_t node_off, int nt, int index) const
+{
+    return node_off + GetEdgeStart(nt) + index*edge_slot_size;
+}
+
+inline int DictMem::GetEdgeSlotSize() const
+{
+    return edge_slot_size;
+}
+
+inline size_t DictMem::AlignNodeOffset(size_t offset) const
+{
+    return (offset + node_alignment - 1) / node_alignment * node_alignment;
+}
+
+inline bool DictMem::IsCompactIndex() const
+{
+    return compact_index;
+}
+
+inline int DictMem::GetEdgeSize() const
+{
+    return edge_size;
+}
+
+inline int DictMem::GetLocalEdgeLen() const
+{
+    return compact_index ? COMPACT_LOCAL_EDGE_LEN : LOCAL_EDGE_LEN;
+}
+
+inline int DictMem::GetEdgeLinkPos() const
+{
+    return compact_index ? COMPACT_EDGE_NODE_LEADING_POS : EDGE_NODE_LEADING_POS;
+}
+
+inline int DictMem::GetLinkSize() const
+{
+    return compact_index ? COMPACT_OFFSET_SIZE : OFFSET_SIZE;
+}
+
+inline int DictMem::GetEdgeStrLinkSize() const
+{
+    return compact_index ? COMPACT_OFFSET_SIZE : OFFSET_SIZE - 1;
+}
+
+inline size_t DictMem::GetLink(const uint8_t *buff) const
+{
+    return compact_index ? EdgeFormat4B::GetOffset(buff) : EdgeFormat6B::GetOffset(buff);
+}
+
+inline void DictMem::WriteLink(uint8_t *buff, size_t offset) const
+{
+    if(compact_index)
+        EdgeFormat4B::WriteOffset(buff, offset);
+    else
+        EdgeFormat6B::WriteOffset(buff, offset);
+}
+
+inline size_t DictMem::GetEdgeStrLink(const uint8_t *buff) const
+{
+    return compact_index ? EdgeFormat4B::GetStrOffset(buff) : EdgeFormat6B::GetStrOffset(buff);
+}
+
+inline void DictMem::WriteEdgeStrLink(uint8_t *buff, size_t offset) const
+{
+    if(compact_index)
+        EdgeFormat4B::WriteStrOffset(buff, offset);
+    else
+        EdgeFormat6B::WriteStrOffset(buff, offset);
+}
+
 // update the edge pointers for fast access
 // node_ptrs.offset and node_ptrs.ptr[1] must already be populated before calling this function
+template<typename EF>
 inline void DictMem::InitEdgePtrs(const NodePtrs &node_ptrs, int index, EdgePtrs &edge_ptrs)
 {
-    int edge_off = NODE_EDGE_KEY_FIRST + node_ptrs.ptr[1] + 1  + index*EDGE_SIZE;
+    int edge_off = GetEdgeStart(node_ptrs.ptr[1] + 1) + index*edge_slot_size;
     edge_ptrs.offset = node_ptrs.offset + edge_off;
     edge_ptrs.ptr = node_ptrs.ptr + edge_off;
-    edge_ptrs.len_ptr = edge_ptrs.ptr + EDGE_LEN_POS;
-    edge_ptrs.flag_ptr = edge_ptrs.ptr + EDGE_FLAG_POS;
+    edge_ptrs.len_ptr = edge_ptrs.ptr + EF::len_pos;
+    edge_ptrs.flag_ptr = edge_ptrs.ptr + EF::flag_pos;
     edge_ptrs.offset_ptr = edge_ptrs.flag_ptr + 1;
 }
 
+template<typename EF>
 inline void InitTempEdgePtrs(EdgePtrs &edge_ptrs)
 {
     edge_ptrs.ptr = edge_ptrs.edge_buff;
-    edge_ptrs.len_ptr = edge_ptrs.ptr + EDGE_LEN_POS;
-    edge_ptrs.flag_ptr = edge_ptrs.ptr + EDGE_FLAG_POS;
+    edge_ptrs.len_ptr = edge_ptrs.ptr + EF::len_pos;
+    edge_ptrs.flag_ptr = edge_ptrs.ptr + EF::flag_pos;
     edge_ptrs.offset_ptr = edge_ptrs.flag_ptr + 1;
 }
 
@@ -176,7 +338,7 @@ inline void DictMem::InitNodePtrs(uint8_t *ptr, int nt, NodePtrs &node_ptrs)
     node_ptrs.ptr = ptr;
     nt++;
     node_ptrs.edge_key_ptr = ptr + NODE_EDGE_KEY_FIRST;
-    node_ptrs.edge_ptr = node_ptrs.edge_key_ptr + nt;
+    node_ptrs.edge_ptr = ptr + GetEdgeStart(nt);
 }
 
 }
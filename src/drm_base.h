@@ -21,10 +21,33 @@
 
 #include "rollable_file.h"
 #include "free_list.h"
+#include "mb_codec.h"
+#include "integer_4b_5b.h"
 
 #define DATA_BUFFER_ALIGNMENT      1
 #define DATA_SIZE_BYTE             2
 #define DATA_HDR_BYTE              4
+// The highest bit of the data length indicates an extension follows the
+// data header. The extension starts with uint16_t flags. Only the fields
+// whose flags are set follow, in this order:
+//     uint32_t expiry timestamp in seconds since epoch (DATA_EXT_EXPIRE)
+//     uint16_t length of the uncompressed data (DATA_EXT_COMPRESSED)
+//     uint32_t CRC32C of the data length, the extension and the data
+//              (DATA_EXT_CHECKSUM)
+#define DATA_EXT_FLAG              0x8000
+#define DATA_LEN_MASK              0x7FFF
+#define DATA_EXT_FLAGS_BYTE        2
+#define DATA_EXPIRE_BYTE           4
+#define DATA_RAW_LEN_BYTE          2
+#define DATA_CRC_BYTE              4
+#define DATA_EXT_MAX_BYTE          12
+#define DATA_EXT_EXPIRE            0x0001
+#define DATA_EXT_COMPRESSED        0x0002
+#define DATA_EXT_CHECKSUM          0x0004
+#define DATA_EXT_SIZE(flags)       (DATA_EXT_FLAGS_BYTE +                                   \
+                                   (((flags) & DATA_EXT_EXPIRE) ? DATA_EXPIRE_BYTE : 0) +    \
+                                   (((flags) & DATA_EXT_COMPRESSED) ? DATA_RAW_LEN_BYTE : 0) + \
+                                   (((flags) & DATA_EXT_CHECKSUM) ? DATA_CRC_BYTE : 0))
 #define OFFSET_SIZE                6
 #define EDGE_SIZE                  13
 #define EDGE_LEN_POS               5
@@ -36,6 +59,19 @@
 #define LOCAL_EDGE_LEN             6
 #define LOCAL_EDGE_LEN_M1          5
 #define EDGE_NODE_LEADING_POS      7
+// Index node formats. See NODE MEMORY LAYOUT in dict_mem.cpp.
+#define INDEX_FORMAT_PACKED        0
+#define INDEX_FORMAT_ALIGNED       0x01
+#define INDEX_FORMAT_COMPACT       0x02
+#define ALIGNED_NODE_SIZE          64
+#define ALIGNED_EDGE_SLOT          16
+// Edges of the compact format use 4-byte offsets.
+#define COMPACT_OFFSET_SIZE        4
+#define COMPACT_EDGE_SIZE          10
+#define COMPACT_EDGE_LEN_POS       4
+#define COMPACT_EDGE_FLAG_POS      5
+#define COMPACT_LOCAL_EDGE_LEN     5
+#define COMPACT_EDGE_NODE_LEADING_POS 6
 #define EXCEP_STATUS_NONE          0
 #define EXCEP_STATUS_ADD_EDGE      1
 #define EXCEP_STATUS_ADD_DATA_OFF  2
@@ -47,6 +83,7 @@
 #define EXCEP_STATUS_RC_DATA       8
 #define EXCEP_STATUS_RC_TREE       9
 #define MB_EXCEPTION_BUFF_SIZE     16
+#define MB_EXPIRE_CURSOR_SIZE      256
 
 namespace mabain {
 
@@ -95,8 +132,113 @@ typedef struct _IndexHeader
     size_t               rc_m_data_off_pre;
     std::atomic<size_t>  rc_root_offset;
     int64_t              rc_count;
+
+    // number of epochs for validating pages cached by readers in block
+    // cache; the epochs are in a separate shared file
+    uint32_t cache_epoch_slots;
+
+    // dictionary for data compression; never changed once trained
+    int     compress_dict_len;
+    uint8_t compress_dict[MB_CODEC_MAX_DICT_SIZE];
+
+    // id of the last backup; incremental backup requires the same id
+    // in the backup directory
+    uint64_t backup_id;
+
+    // sequence number of the last mutation shipped to followers
+    uint64_t repl_seq;
+
+    // INDEX_FORMAT_* bits; fixed when the DB is created
+    int      index_format;
+
+    // set once an entry with expiry time is added
+    int      has_expire_key;
+    // last key visited by the expiry sweep; longer keys are truncated
+    uint16_t expire_cursor_len;
+    uint8_t  expire_cursor[MB_EXPIRE_CURSOR_SIZE];
 } IndexHeader;
 
+// Edge fields of the index formats. The lookup and update paths are
+// instantiated for each format so that no format check is done per edge.
+struct EdgeFormat6B
+{
+    enum
+    {
+        edge_size       = EDGE_SIZE,
+        offset_size     = OFFSET_SIZE,
+        str_offset_size = OFFSET_SIZE - 1,
+        len_pos         = EDGE_LEN_POS,
+        flag_pos        = EDGE_FLAG_POS,
+        offset_pos      = EDGE_NODE_LEADING_POS,
+        local_edge_len  = LOCAL_EDGE_LEN
+    };
+
+    // node or data offset
+    static inline size_t GetOffset(const uint8_t *buff)
+    {
+        return Get6BInteger(buff);
+    }
+    static inline void WriteOffset(uint8_t *buff, size_t offset)
+    {
+        Write6BInteger(buff, offset);
+    }
+    // edge string offset
+    static inline size_t GetStrOffset(const uint8_t *buff)
+    {
+        return Get5BInteger(buff);
+    }
+    static inline void WriteStrOffset(uint8_t *buff, size_t offset)
+    {
+        Write5BInteger(buff, offset);
+    }
+};
+
+// The index and data files of the compact format are limited to 4GB.
+struct EdgeFormat4B
+{
+    enum
+    {
+        edge_size       = COMPACT_EDGE_SIZE,
+        offset_size     = COMPACT_OFFSET_SIZE,
+        str_offset_size = COMPACT_OFFSET_SIZE,
+        len_pos         = COMPACT_EDGE_LEN_POS,
+        flag_pos        = COMPACT_EDGE_FLAG_POS,
+        offset_pos      = COMPACT_EDGE_NODE_LEADING_POS,
+        local_edge_len  = COMPACT_LOCAL_EDGE_LEN
+    };
+
+    static inline size_t GetOffset(const uint8_t *buff)
+    {
+        return Get4BInteger(buff);
+    }
+    static inline void WriteOffset(uint8_t *buff, size_t offset)
+    {
+        Write4BInteger(buff, offset);
+    }
+    static inline size_t GetStrOffset(const uint8_t *buff)
+    {
+        return Get4BInteger(buff);
+    }
+    static inline void WriteStrOffset(uint8_t *buff, size_t offset)
+    {
+        Write4BInteger(buff, offset);
+    }
+};
+
+// Call the instance of a function template for the edge format.
+#define CALL_EDGE_FORMAT(compact, func, ...)                 \
+    ((compact) ? func<EdgeFormat4B>(__VA_ARGS__) :           \
+                 func<EdgeFormat6B>(__VA_ARGS__))
+
+// Maximal number of blocks that can be addressed by the compact format
+inline int CompactMaxNumBlock(int max_num_blk, size_t block_size)
+{
+    long max_compact = static_cast<long>((MAX_4B_OFFSET + 1ULL) / block_size);
+    if(max_num_blk <= 0 || max_num_blk > max_compact)
+        return static_cast<int>(max_compact);
+    return max_num_blk;
+}
+
 // An abstract interface class for Dict and DictMem
 class DRMBase
 {
@@ -119,6 +261,14 @@ public:
     inline int ReadData(uint8_t *buff, unsigned len, size_t offset) const;
     inline size_t GetResourceCollectionOffset() const;
     inline void RemoveUnused(size_t max_size, bool writer_mode = false);
+    inline void MarkDirty(size_t offset, int size) const;
+    inline void IncCacheEpoch(size_t offset, int size) const;
+    inline void GetDirtyRanges(size_t end_offset,
+                               std::vector<std::pair<size_t, size_t>> &ranges) const;
+    inline void ClearDirtyMap() const;
+    inline void StartSnapshot(size_t end_offset);
+    inline void StopSnapshot(std::map<size_t, std::string> &pages);
+    inline bool SnapshotActive() const;
 
     FreeList *GetFreeList() const
     {
@@ -172,6 +322,42 @@ inline void DRMBase::RemoveUnused(size_t max_size, bool writer_mode)
     return kv_file->RemoveUnused(max_size, writer_mode); 
 }
 
+inline void DRMBase::MarkDirty(size_t offset, int size) const
+{
+    kv_file->MarkDirty(offset, size);
+}
+
+inline void DRMBase::IncCacheEpoch(size_t offset, int size) const
+{
+    kv_file->IncCacheEpoch(offset, size);
+}
+
+inline void DRMBase::GetDirtyRanges(size_t end_offset,
+                                    std::vector<std::pair<size_t, size_t>> &ranges) const
+{
+    kv_file->GetDirtyRanges(end_offset, ranges);
+}
+
+inline void DRMBase::ClearDirtyMap() const
+{
+    kv_file->ClearDirtyMap();
+}
+
+inline void DRMBase::StartSnapshot(size_t end_offset)
+{
+    kv_file->StartSnapshot(end_offset);
+}
+
+inline void DRMBase::StopSnapshot(std::map<size_t, std::string> &pages)
+{
+    kv_file->StopSnapshot(pages);
+}
+
+inline bool DRMBase::SnapshotActive() const
+{
+    return kv_file->SnapshotActive();
+}
+
 }
 
 #endif
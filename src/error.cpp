@@ -45,6 +45,9 @@ const char* MBError::error_str[] = {
     "buffer discarded", // buffer will be reclaimed by shrink
     "failed to create thread",
     "rc skipped",
+    "decompression failed",
+    "checksum mismatch",
+    "network error",
 
     ///////////////////////////////////
     "DB not exist",
@@ -52,6 +52,9 @@ public:
         BUFFER_LOST = 20,
         THREAD_FAILED = 21,
         RC_SKIPPED = 22,
+        DECOMPRESS_FAILED = 23,
+        CHECKSUM_ERROR = 24,
+        NETWORK_ERROR = 25,
 
         // NO_DB should be the last enum.
         NO_DB
@@ -20,6 +20,7 @@
 #include <errno.h>
 
 #include "file_io.h"
+#include "mb_slow_log.h"
 
 namespace mabain {
 
@@ -41,7 +42,10 @@ FileIO::~FileIO()
 int FileIO::Open()
 {
     mode_t prev_mask = umask(0);
-    fd = open(path.c_str(), options, mode);
+    if(options & MMAP_SHM_MODE)
+        fd = shm_open(ShmName(path).c_str(), options & ~MMAP_SHM_MODE, mode);
+    else
+        fd = open(path.c_str(), options, mode);
     umask(prev_mask);
 
     return fd;
@@ -116,6 +120,8 @@ size_t FileIO::RandomRead(void *buff, size_t size, off_t offset)
     if(fd > 0)
     {
         bytes_read = pread(fd, buff, size, offset);
+        MB_OP_COST_ADD(sys_reads, 1);
+        MB_OP_COST_ADD(sys_read_bytes, bytes_read);
     }
     else
     {
@@ -125,6 +131,30 @@ size_t FileIO::RandomRead(void *buff, size_t size, off_t offset)
     return bytes_read;
 }
 
+// Shared memory object names cannot have slashes except the leading one.
+// The DB path /var/tmp/db/_mabain_h is mapped to /mabain%var%tmp%db%_mabain_h.
+std::string FileIO::ShmName(const std::string &fpath)
+{
+    std::string name = "/mabain";
+    for(size_t i = 0; i < fpath.size(); i++)
+    {
+        if(fpath[i] != '/')
+            name += fpath[i];
+        else if(name[name.size()-1] != '%')
+            name += '%';
+    }
+    return name;
+}
+
+bool FileIO::ShmExists(const std::string &fpath)
+{
+    int shm_fd = shm_open(ShmName(fpath).c_str(), O_RDONLY, 0);
+    if(shm_fd < 0)
+        return false;
+    close(shm_fd);
+    return true;
+}
+
 void* FileIO::MapFile(size_t size, int prot, int flags, off_t offset)
 {
     return mmap(NULL, size, prot, flags, fd, offset);
@@ -157,6 +187,24 @@ int FileIO::TruncateFile(off_t filesize)
     return 1;
 }
 
+// Allocate disk space for the whole file so that later writes to the
+// file or its memory mapping do not need to allocate blocks.
+int FileIO::AllocateFile(off_t filesize)
+{
+    if(fd > 0)
+    {
+        if(fallocate(fd, 0, 0, filesize) == 0)
+            return 0;
+        // Not supported by the file system; other errors such as ENOSPC
+        // are returned to the caller.
+        if(errno == EOPNOTSUPP || errno == ENOSYS)
+            return ftruncate(fd, filesize);
+        return -1;
+    }
+
+    return 1;
+}
+
 void FileIO::Flush()
 {
     if(fd > 0)
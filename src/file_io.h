@@ -30,6 +30,7 @@
 namespace mabain {
 
 #define MMAP_ANONYMOUS_MODE 0x80000000 // This bit should not be used in fcntl.h.
+#define MMAP_SHM_MODE       0x40000000 // File is a POSIX shared memory object.
 
 // This is the basic file io class
 class FileIO
@@ -40,6 +41,7 @@ public:
 
     int  Open();
     int  TruncateFile(off_t filesize);
+    int  AllocateFile(off_t filesize);
     bool IsOpen() const;
     void Close();
 
@@ -53,6 +55,10 @@ public:
 
     const std::string& GetFilePath() const;
 
+    // Name of the POSIX shared memory object used for the file path
+    static std::string ShmName(const std::string &fpath);
+    static bool ShmExists(const std::string &fpath);
+
 protected:
     std::string path;
     int options;
@@ -136,6 +136,24 @@ int64_t FreeList::Count() const
     return count;
 }
 
+void FreeList::GetSizeClassBytes(int64_t *bytes, int num_class) const
+{
+    if(buffer_free_list == NULL)
+        return;
+
+    for(int i = 0; i < max_num_buffer; i++)
+    {
+        int64_t num_buffer = GetBufferCountByIndex(i);
+        if(num_buffer == 0)
+            continue;
+        int buf_size = GetBufferSizeByIndex(i);
+        int size_class = 0;
+        for(int size = buf_size; size > 1 && size_class < num_class - 1; size >>= 1)
+            size_class++;
+        bytes[size_class] += num_buffer * buf_size;
+    }
+}
+
 int FreeList::StoreListOnDisk()
 {
     if(buffer_free_list == NULL)
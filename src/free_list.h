@@ -63,6 +63,8 @@ public:
     int64_t Count() const;
     // Get total freed buffer size in the list
     size_t GetTotSize() const;
+    // Add the bytes of freed buffers to power of two size classes
+    void   GetSizeClassBytes(int64_t *bytes, int num_class) const;
 
     inline int      AddBufferByIndex(int buf_index, size_t offset);
     inline size_t   RemoveBufferByIndex(int buf_index);
@@ -28,9 +28,39 @@ namespace mabain {
 #define MAX_5B_OFFSET      0xFFFFFFFFFF
 #define MAX_6B_OFFSET    0xFFFFFFFFFFFF
 
-// write and read 5-byte 6-byte unsigned integer
+// write and read 4-byte 5-byte 6-byte unsigned integer
 // Note this is based on engianness.
 
+inline void Write4BInteger(uint8_t *buffer, size_t offset)
+{
+#ifdef __DEBUG__
+    if(offset > MAX_4B_OFFSET)
+    {
+        std::cerr << "OFFSET " << offset << " TOO LARGE FOR 4 BYTES\n";
+        abort();
+    }
+#endif
+
+    uint8_t *src = reinterpret_cast<uint8_t*>(&offset);
+#ifndef __BIG__ENDIAN__
+    memcpy(buffer, src, 4);
+#else
+    memcpy(buffer, src+4, 4);
+#endif
+}
+
+inline size_t Get4BInteger(const uint8_t *buffer)
+{
+    size_t offset = 0;
+    uint8_t *target = reinterpret_cast<uint8_t*>(&offset);
+#ifndef __BIG__ENDIAN__
+    memcpy(target, buffer, 4);
+#else
+    memcpy(target+4, buffer, 4);
+#endif
+    return offset;
+}
+
 inline void Write5BInteger(uint8_t *buffer, size_t offset)
 {
 #ifdef __DEBUG__
@@ -16,6 +16,10 @@
 
 // @author Changxue Deng <chadeng@cisco.com>
 
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
 #include "db.h"
 #include "dict.h"
 #include "integer_4b_5b.h"
@@ -29,6 +33,7 @@ typedef struct _iterator_node
     uint8_t     *data;
     int          data_len;
     uint16_t     bucket_index;
+    uint32_t     expire_time;
 } iterator_node;
 
 static void free_iterator_node(void *n)
@@ -45,6 +50,16 @@ static void free_iterator_node(void *n)
     free(inode);
 }
 
+// Entries are returned before the nodes with the same key since all keys
+// in the subtree of the node are longer.
+static bool iterator_node_less(const iterator_node *lhs, const iterator_node *rhs)
+{
+    int cmp = lhs->key->compare(*rhs->key);
+    if(cmp != 0)
+        return cmp < 0;
+    return lhs->data != NULL && rhs->data == NULL;
+}
+
 static iterator_node* new_iterator_node(const std::string &key, MBData *mbdata)
 {
     iterator_node *inode = (iterator_node *) malloc(sizeof(*inode));
@@ -55,6 +70,7 @@ static iterator_node* new_iterator_node(const std::string &key, MBData *mbdata)
     if(mbdata != NULL)
     {
 	inode->bucket_index = mbdata->bucket_index;
+        inode->expire_time = mbdata->expire_time;
         mbdata->TransferValueTo(inode->data, inode->data_len);
         if(inode->data == NULL || inode->data_len <= 0)
         {
@@ -66,6 +82,7 @@ static iterator_node* new_iterator_node(const std::string &key, MBData *mbdata)
     {
         inode->data = NULL;
         inode->data_len = 0;
+        inode->expire_time = 0;
     }
 
     return inode;
@@ -79,15 +96,34 @@ static iterator_node* new_iterator_node(const std::string &key, MBData *mbdata)
 // }
 /////////////////////////////////////////////////////////////////////
 
-const DB::iterator DB::begin(bool check_async_mode, bool rc_mode) const
+const DB::iterator DB::begin(bool check_async_mode, bool rc_mode,
+                             bool include_expired) const
 {
-    DB::iterator iter = iterator(*this, DB_ITER_STATE_INIT);
+    DB::iterator iter = iterator(*this, DB_ITER_STATE_INIT, include_expired);
     if(rc_mode) iter.value.options |= CONSTS::OPTION_RC_MODE;
     iter.init(check_async_mode);
 
     return iter;
 }
 
+const DB::iterator DB::begin_prefix(const std::string &prefix) const
+{
+    DB::iterator iter = iterator(*this, DB_ITER_STATE_INIT);
+    iter.init_prefix(prefix);
+
+    return iter;
+}
+
+// Expired entries are included. This is only used by the writer for
+// removing expired entries.
+const DB::iterator DB::begin_after(const std::string &start_key) const
+{
+    DB::iterator iter = iterator(*this, DB_ITER_STATE_INIT, true);
+    iter.init_after(start_key);
+
+    return iter;
+}
+
 const DB::iterator DB::end() const
 {
     return iterator(*this, DB_ITER_STATE_DONE);
@@ -110,14 +146,18 @@ void DB::iterator::iter_obj_init()
         state = DB_ITER_STATE_MORE;
 }
 
-DB::iterator::iterator(const DB &db, int iter_state)
-                     : db_ref(db), state(iter_state)
+DB::iterator::iterator(const DB &db, int iter_state, bool incl_expired)
+                     : db_ref(db), state(iter_state), include_expired(incl_expired),
+                       in_order(false)
 {
     iter_obj_init();
 }
 
 DB::iterator::iterator(const iterator &rhs)
-                     : db_ref(rhs.db_ref), state(rhs.state)
+                     : db_ref(rhs.db_ref), state(rhs.state),
+                       include_expired(rhs.include_expired),
+                       in_order(rhs.in_order), prefix(rhs.prefix),
+                       start_key(rhs.start_key)
 {
     iter_obj_init();
 }
@@ -148,6 +188,36 @@ void DB::iterator::init(bool check_async_mode)
         state = DB_ITER_STATE_DONE;
 }
 
+void DB::iterator::init_prefix(const std::string &key_prefix)
+{
+    if(db_ref.options & CONSTS::ASYNC_WRITER_MODE)
+    {
+        state = DB_ITER_STATE_DONE;
+        return;
+    }
+
+    in_order = true;
+    prefix = key_prefix;
+    node_stack = new MBlsq(free_iterator_node);
+    kv_per_node = new MBlsq(free_iterator_node);
+
+    load_kv_for_node("");
+    if(next() == NULL)
+        state = DB_ITER_STATE_DONE;
+}
+
+void DB::iterator::init_after(const std::string &key)
+{
+    in_order = true;
+    start_key = key;
+    node_stack = new MBlsq(free_iterator_node);
+    kv_per_node = new MBlsq(free_iterator_node);
+
+    load_kv_for_node("");
+    if(next() == NULL)
+        state = DB_ITER_STATE_DONE;
+}
+
 // Initialize the iterator, but do not get the first key-value pair.
 // This is used for resource collection.
 int DB::iterator::init_no_next()
@@ -195,7 +265,7 @@ int DB::iterator::get_node_offset(const std::string &node_key,
     if(rval == MBError::IN_DICT)
     {
         parent_edge_off = edge_ptrs.parent_offset;
-        node_offset = Get6BInteger(value.edge_ptrs.offset_ptr);
+        node_offset = db_ref.dict->GetMM()->GetLink(value.edge_ptrs.offset_ptr);
         rval = MBError::SUCCESS;
     }
     return rval;
@@ -345,6 +415,11 @@ int DB::iterator::load_kv_for_node(const std::string &curr_node_key)
     if(rval == MBError::SUCCESS)
     {
         iterator_node *inode;
+        if(in_order)
+        {
+            push_in_order(&child_node_list);
+            return rval;
+        }
         while((inode = (iterator_node *) child_node_list.RemoveFromHead()))
         {
             node_stack->AddToHead(inode);
@@ -359,30 +434,95 @@ int DB::iterator::load_kv_for_node(const std::string &curr_node_key)
     return rval;
 }
 
+// Move the entries and child nodes of the node just loaded to the head of
+// node_stack in key order. Child nodes whose keys and the prefix are not
+// prefixes of each other cannot lead to any entry with the prefix. Child
+// nodes whose keys are less than start_key and not its prefixes cannot lead
+// to any entry greater than start_key.
+void DB::iterator::push_in_order(MBlsq *child_node_list)
+{
+    std::vector<iterator_node*> inodes;
+    iterator_node *inode;
+    while((inode = (iterator_node *) kv_per_node->RemoveFromHead()))
+    {
+        if(inode->key->compare(0, prefix.size(), prefix) == 0 &&
+           (start_key.empty() || inode->key->compare(start_key) > 0))
+            inodes.push_back(inode);
+        else
+            free_iterator_node(inode);
+    }
+    while((inode = (iterator_node *) child_node_list->RemoveFromHead()))
+    {
+        size_t len = std::min(inode->key->size(), prefix.size());
+        if(inode->key->compare(0, len, prefix, 0, len) == 0 &&
+           (start_key.empty() || inode->key->compare(start_key) > 0 ||
+            start_key.compare(0, inode->key->size(), *inode->key) == 0))
+            inodes.push_back(inode);
+        else
+            free_iterator_node(inode);
+    }
+
+    std::sort(inodes.begin(), inodes.end(), iterator_node_less);
+    for(size_t i = inodes.size(); i > 0; i--)
+        node_stack->AddToHead(inodes[i-1]);
+}
+
 // Find next iterator match
 DB::iterator* DB::iterator::next()
 {
     iterator_node *inode;
+    uint32_t now = 0;
 
-    while(kv_per_node->Count() == 0)
+    while(true)
     {
-        inode = (iterator_node *) node_stack->RemoveFromHead();
-        if(inode == NULL)
-            return NULL;
+        if(in_order)
+        {
+            // Entries have data while nodes do not.
+            inode = (iterator_node *) node_stack->RemoveFromHead();
+            if(inode == NULL)
+                return NULL;
+            if(inode->data == NULL)
+            {
+                int rval = load_kv_for_node(*inode->key);
+                free_iterator_node(inode);
+                if(rval != MBError::SUCCESS)
+                    return NULL;
+                continue;
+            }
+        }
+        else
+        {
+            while(kv_per_node->Count() == 0)
+            {
+                inode = (iterator_node *) node_stack->RemoveFromHead();
+                if(inode == NULL)
+                    return NULL;
 
-        int rval = load_kv_for_node(*inode->key);
-        free_iterator_node(inode);
-        if(rval != MBError::SUCCESS)
-            return NULL;
-    }
+                int rval = load_kv_for_node(*inode->key);
+                free_iterator_node(inode);
+                if(rval != MBError::SUCCESS)
+                    return NULL;
+            }
+
+            inode = (iterator_node *) kv_per_node->RemoveFromHead();
+        }
+        if(inode->expire_time != 0 && !include_expired)
+        {
+            // Expired entries are not visible to the iterator.
+            if(now == 0)
+                now = (uint32_t) time(NULL);
+            if(inode->expire_time <= now)
+            {
+                free_iterator_node(inode);
+                continue;
+            }
+        }
 
-    if(kv_per_node->Count() > 0)
-    {
-        inode = (iterator_node *) kv_per_node->RemoveFromHead();
         match = MATCH_NODE_OR_EDGE;
         key = *inode->key;
         value.TransferValueFrom(inode->data, inode->data_len);
 	value.bucket_index = inode->bucket_index;
+        value.expire_time = inode->expire_time;
         free_iterator_node(inode);
         return this;
     }
@@ -398,6 +538,7 @@ bool DB::iterator::next_dbt_buffer(struct _DBTraverseNode *dbt_n)
     size_t node_off;
     size_t curr_edge_off;
     std::string match_str;
+    const DictMem *dmm = db_ref.dict->GetMM();
 
     memset(dbt_n, 0, sizeof(*dbt_n));
     do {
@@ -405,9 +546,9 @@ bool DB::iterator::next_dbt_buffer(struct _DBTraverseNode *dbt_n)
         while((rval = db_ref.dict->ReadNextEdge(node_buff, edge_ptrs, match,
                       value, match_str, node_off, false)) == MBError::SUCCESS)
         {
-            if(edge_ptrs.len_ptr[0] > LOCAL_EDGE_LEN)
+            if(edge_ptrs.len_ptr[0] > dmm->GetLocalEdgeLen())
             {
-                dbt_n->edgestr_offset       = Get5BInteger(edge_ptrs.ptr);
+                dbt_n->edgestr_offset       = dmm->GetEdgeStrLink(edge_ptrs.ptr);
                 dbt_n->edgestr_size         = edge_ptrs.len_ptr[0] - 1;
                 dbt_n->edgestr_link_offset  = curr_edge_off;
                 dbt_n->buffer_type         |= BUFFER_TYPE_EDGE_STR;
@@ -416,7 +557,7 @@ bool DB::iterator::next_dbt_buffer(struct _DBTraverseNode *dbt_n)
             if(node_off > 0)
             {
                 dbt_n->node_offset         = node_off;
-                dbt_n->node_link_offset    = curr_edge_off + EDGE_NODE_LEADING_POS;
+                dbt_n->node_link_offset    = curr_edge_off + dmm->GetEdgeLinkPos();
                 dbt_n->buffer_type        |= BUFFER_TYPE_NODE;
                 db_ref.dict->ReadNodeHeader(node_off, dbt_n->node_size, match, dbt_n->data_offset,
                                             dbt_n->data_link_offset);
@@ -425,8 +566,8 @@ bool DB::iterator::next_dbt_buffer(struct _DBTraverseNode *dbt_n)
             }
             else if(match == MATCH_EDGE)
             {
-                dbt_n->data_offset      = Get6BInteger(edge_ptrs.offset_ptr);
-                dbt_n->data_link_offset = curr_edge_off + EDGE_NODE_LEADING_POS;
+                dbt_n->data_offset      = dmm->GetLink(edge_ptrs.offset_ptr);
+                dbt_n->data_link_offset = curr_edge_off + dmm->GetEdgeLinkPos();
                 dbt_n->buffer_type     |= BUFFER_TYPE_DATA;
             }
 
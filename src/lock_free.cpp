@@ -106,7 +106,8 @@ int LockFree::ReaderLockFreeStop(const LockFreeData &snapshot, size_t reader_off
         }
         if(mbdata.edge_ptrs.offset == reader_offset)
         {
-            InitTempEdgePtrs(mbdata.edge_ptrs);
+            CALL_EDGE_FORMAT(header->index_format & INDEX_FORMAT_COMPACT, InitTempEdgePtrs,
+                             mbdata.edge_ptrs);
         }
         else
         {
@@ -26,11 +26,26 @@ const int CONSTS::ASYNC_WRITER_MODE            = 0x2;
 const int CONSTS::SYNC_ON_WRITE                = 0x4;
 const int CONSTS::USE_SLIDING_WINDOW           = 0x8;
 const int CONSTS::MEMORY_ONLY_MODE             = 0x10;
+const int CONSTS::ADAPTIVE_MMAP                = 0x20;
+const int CONSTS::COMPRESS_DATA                = 0x40;
+const int CONSTS::DATA_CHECKSUM                = 0x80;
+const int CONSTS::CHANGE_NOTIFY                = 0x100;
+const int CONSTS::SHARED_MEMORY_MODE           = 0x200;
+const int CONSTS::LATENCY_STATS                = 0x400;
+const int CONSTS::HOT_KEY_STATS                = 0x800;
+const int CONSTS::ALIGNED_INDEX                = 0x1000;
+const int CONSTS::COMPACT_INDEX                = 0x2000;
 
 const int CONSTS::OPTION_ALL_PREFIX            = 0x1;
 const int CONSTS::OPTION_FIND_AND_STORE_PARENT = 0x2;
 const int CONSTS::OPTION_RC_MODE               = 0x4;
 const int CONSTS::OPTION_READ_SAVED_EDGE       = 0x8;
+const int CONSTS::OPTION_SKIP_REPL_LOG         = 0x10;
+
+const int CONSTS::WARMUP_INDEX                 = 0x1;
+const int CONSTS::WARMUP_DATA                  = 0x2;
+const int CONSTS::WARMUP_MLOCK                 = 0x4;
+const int CONSTS::WARMUP_HUGEPAGE              = 0x8;
 
 const int CONSTS::MAX_KEY_LENGHTH              = 256;
 const int CONSTS::MAX_DATA_SIZE                = 0x7FFF;
@@ -30,11 +30,41 @@ public:
     static const int SYNC_ON_WRITE;
     static const int USE_SLIDING_WINDOW;
     static const int MEMORY_ONLY_MODE;
+    // Reader only: memcap is a budget for mapping the most accessed blocks.
+    // The budget applies to each reader handle; N handles using the option
+    // may map up to N times memcap in total.
+    static const int ADAPTIVE_MMAP;
+    static const int COMPRESS_DATA;
+    static const int DATA_CHECKSUM;
+    static const int CHANGE_NOTIFY;
+    // Memory-only DB in named POSIX shared memory that can be opened by
+    // other processes. Implies MEMORY_ONLY_MODE.
+    static const int SHARED_MEMORY_MODE;
+    // Record latency histograms of DB operations. See DB::GetLatencyStats.
+    static const int LATENCY_STATS;
+    // Count the keys found by readers to detect hot keys. See
+    // DB::GetHotKeys.
+    static const int HOT_KEY_STATS;
+    // Create the index with nodes aligned to cache lines. Only used by
+    // writer when the DB is created; the format is kept in the header.
+    static const int ALIGNED_INDEX;
+    // Create the index with 4-byte offsets in edges. Index and data files
+    // are then limited to 4GB each. Only used by writer when the DB is
+    // created; the format is kept in the header.
+    static const int COMPACT_INDEX;
     static const int OPTION_ALL_PREFIX;
     static const int OPTION_FIND_AND_STORE_PARENT;
     static const int OPTION_RC_MODE;
     static const int OPTION_READ_SAVED_EDGE; // Used internally only
+    static const int OPTION_SKIP_REPL_LOG;   // Used internally only
     // not init shared memory ptr, not update db counter
+
+    // warmup options in MBConfig
+    static const int WARMUP_INDEX;
+    static const int WARMUP_DATA;
+    static const int WARMUP_MLOCK;
+    static const int WARMUP_HUGEPAGE;
+
     static const int MAX_KEY_LENGHTH;
     static const int MAX_DATA_SIZE;
 
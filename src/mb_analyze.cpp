@@ -0,0 +1,470 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+#include <unistd.h>
+#include <fstream>
+
+#include "mb_analyze.h"
+#include "dict.h"
+#include "integer_4b_5b.h"
+#include "error.h"
+#include "logger.h"
+
+namespace mabain {
+
+DBAnalyzer::DBAnalyzer(const MBConfig &config, int nthreads)
+                     : mbdir(config.mbdir == NULL ? "" : config.mbdir),
+                       num_threads(nthreads),
+                       next_root_edge(0),
+                       root_fanout(0)
+{
+    memcpy(&db_config, &config, sizeof(db_config));
+    db_config.mbdir = NULL;
+    // Analyzer never modifies the DB.
+    db_config.options &= ~(CONSTS::ACCESS_MODE_WRITER | CONSTS::ASYNC_WRITER_MODE);
+    db_config.warmup_options = 0;
+    if(!mbdir.empty() && mbdir[mbdir.length()-1] != '/')
+        mbdir += "/";
+
+    if(num_threads <= 0)
+        num_threads = 1;
+    else if(num_threads > MB_ANALYZE_MAX_THREADS)
+        num_threads = MB_ANALYZE_MAX_THREADS;
+
+    memset(&trie_shape, 0, sizeof(trie_shape));
+    memset(&index_free_list, 0, sizeof(index_free_list));
+    memset(&data_free_list, 0, sizeof(data_free_list));
+    count = 0;
+    num_writer = 0;
+    index_size = 0;
+    data_size = 0;
+    pending_index_size = 0;
+    pending_data_size = 0;
+    index_block_size = 0;
+    data_block_size = 0;
+}
+
+DBAnalyzer::~DBAnalyzer()
+{
+}
+
+int DBAnalyzer::Analyze()
+{
+    MBConfig config = db_config;
+    config.mbdir = mbdir.c_str();
+    DB db(config);
+    if(!db.is_open())
+        return db.Status();
+
+    memset(&trie_shape, 0, sizeof(trie_shape));
+    next_root_edge = 0;
+    root_fanout = 0;
+
+    IndexHeader *header = db.dict->GetHeaderPtr();
+    count = header->count;
+    num_writer = header->num_writer;
+    index_size = header->m_index_offset;
+    data_size = header->m_data_offset;
+    pending_index_size = header->pending_index_buff_size;
+    pending_data_size = header->pending_data_buff_size;
+    index_block_size = header->index_block_size;
+    data_block_size = header->data_block_size;
+
+    int rval = MBError::SUCCESS;
+    std::vector<AnalyzeContext> contexts(num_threads);
+    for(int i = 0; i < num_threads; i++)
+    {
+        contexts[i].analyzer = this;
+        contexts[i].running = false;
+        memset(&contexts[i].shape, 0, sizeof(contexts[i].shape));
+        contexts[i].db = new DB(config);
+        if(!contexts[i].db->is_open())
+        {
+            rval = contexts[i].db->Status();
+            break;
+        }
+    }
+    if(rval == MBError::SUCCESS)
+    {
+        for(int i = 0; i < num_threads; i++)
+        {
+            if(pthread_create(&contexts[i].tid, NULL, AnalyzeThread, &contexts[i]) != 0)
+            {
+                Logger::Log(LOG_LEVEL_ERROR, "failed to create analyzer thread");
+                rval = MBError::THREAD_FAILED;
+                break;
+            }
+            contexts[i].running = true;
+        }
+    }
+
+    for(int i = 0; i < num_threads; i++)
+    {
+        if(contexts[i].running)
+        {
+            pthread_join(contexts[i].tid, NULL);
+            MergeShape(trie_shape, contexts[i].shape);
+        }
+        if(contexts[i].db != NULL)
+            delete contexts[i].db;
+    }
+    if(rval != MBError::SUCCESS)
+        return rval;
+
+    // root node
+    trie_shape.num_node++;
+    trie_shape.node_bytes += db.dict->GetMM()->GetNodeSize(NUM_ALPHABET);
+    trie_shape.fanout[root_fanout.load()]++;
+
+    LoadFreeList(mbdir + "_ibfl", index_free_list);
+    LoadFreeList(mbdir + "_dbfl", data_free_list);
+
+    Logger::Log(LOG_LEVEL_INFO, "analyzed %lld nodes and %lld keys: %lld errors",
+                (long long) trie_shape.num_node, (long long) trie_shape.num_key,
+                (long long) trie_shape.num_error);
+    return MBError::SUCCESS;
+}
+
+const TrieShape& DBAnalyzer::GetTrieShape() const
+{
+    return trie_shape;
+}
+
+const FreeListShape& DBAnalyzer::GetIndexFreeList() const
+{
+    return index_free_list;
+}
+
+const FreeListShape& DBAnalyzer::GetDataFreeList() const
+{
+    return data_free_list;
+}
+
+void* DBAnalyzer::AnalyzeThread(void *context)
+{
+    AnalyzeContext *ctx = static_cast<AnalyzeContext *>(context);
+    ctx->analyzer->WalkRootEdges(ctx->db, ctx->shape);
+    return NULL;
+}
+
+// Root edges are taken by the threads one at a time so that large subtrees
+// do not keep other threads idle.
+void DBAnalyzer::WalkRootEdges(DB *db, TrieShape &shape)
+{
+    Dict *dict = db->dict;
+    uint8_t node_buff[NUM_ALPHABET+NODE_EDGE_KEY_FIRST];
+    EdgePtrs edge_ptrs;
+    MBData data;
+    std::string match_str;
+    std::vector<NodeEntry> nodes;
+    int match;
+    size_t node_off;
+
+    int rval = dict->ReadNode(dict->GetRootOffset(), node_buff, edge_ptrs, match,
+                              data, false);
+    if(rval != MBError::SUCCESS)
+    {
+        shape.num_error++;
+        return;
+    }
+    size_t root_edge_offset = edge_ptrs.offset;
+    int num_root_edge = node_buff[1] + 1;
+
+    NodeEntry root;
+    root.node_off = dict->GetRootOffset();
+    root.depth = 0;
+    root.key_len = 0;
+    while(true)
+    {
+        int edge_index = next_root_edge.fetch_add(1);
+        if(edge_index >= num_root_edge)
+            break;
+
+        edge_ptrs.curr_nt = edge_index;
+        edge_ptrs.offset = root_edge_offset + edge_index * dict->GetMM()->GetEdgeSlotSize();
+        rval = dict->ReadNextEdge(node_buff, edge_ptrs, match, data, match_str,
+                                  node_off, false);
+        if(rval != MBError::SUCCESS)
+        {
+            shape.num_error++;
+            continue;
+        }
+        if(edge_ptrs.len_ptr[0] == 0)
+            continue;
+
+        root_fanout.fetch_add(1);
+        AddEdge(dict, edge_ptrs, match, node_off, root, nodes, shape);
+        WalkNodes(dict, nodes, shape);
+    }
+}
+
+// Depth-first walk of the nodes on the stack
+void DBAnalyzer::WalkNodes(Dict *dict, std::vector<NodeEntry> &nodes, TrieShape &shape)
+{
+    uint8_t node_buff[NUM_ALPHABET+NODE_EDGE_KEY_FIRST];
+    EdgePtrs edge_ptrs;
+    MBData data;
+    std::string match_str;
+    int match;
+    size_t node_off;
+    int rval;
+
+    while(!nodes.empty())
+    {
+        NodeEntry entry = nodes.back();
+        nodes.pop_back();
+
+        rval = dict->ReadNode(entry.node_off, node_buff, edge_ptrs, match, data, false);
+        if(rval != MBError::SUCCESS)
+        {
+            shape.num_error++;
+            continue;
+        }
+        int nt = node_buff[1] + 1;
+        shape.num_node++;
+        shape.node_bytes += dict->GetMM()->GetNodeSize(nt);
+        shape.fanout[nt]++;
+        if(match == MATCH_NODE)
+            AddRecord(dict, Get6BInteger(node_buff + 2), entry.depth, entry.key_len, shape);
+
+        while((rval = dict->ReadNextEdge(node_buff, edge_ptrs, match, data, match_str,
+                                         node_off, false)) == MBError::SUCCESS)
+        {
+            AddEdge(dict, edge_ptrs, match, node_off, entry, nodes, shape);
+        }
+        if(rval != MBError::OUT_OF_BOUND)
+            shape.num_error++;
+    }
+}
+
+void DBAnalyzer::AddEdge(Dict *dict, const EdgePtrs &edge_ptrs, int match, size_t node_off,
+                         const NodeEntry &parent, std::vector<NodeEntry> &nodes,
+                         TrieShape &shape)
+{
+    int edge_len = edge_ptrs.len_ptr[0];
+    shape.num_edge++;
+    if(edge_len > dict->GetMM()->GetLocalEdgeLen())
+    {
+        shape.num_edge_str++;
+        shape.edge_str_bytes += edge_len - 1;
+    }
+
+    NodeEntry child;
+    child.depth = parent.depth + 1;
+    child.key_len = parent.key_len + edge_len;
+    if(match == MATCH_EDGE)
+    {
+        AddRecord(dict, dict->GetMM()->GetLink(edge_ptrs.offset_ptr), child.depth, child.key_len, shape);
+    }
+    else if(node_off > 0)
+    {
+        child.node_off = node_off;
+        nodes.push_back(child);
+    }
+}
+
+void DBAnalyzer::AddRecord(Dict *dict, size_t data_off, int depth, int key_len,
+                           TrieShape &shape)
+{
+    shape.num_key++;
+    shape.key_bytes += key_len;
+    if(depth > MB_ANALYZE_MAX_DEPTH)
+        depth = MB_ANALYZE_MAX_DEPTH;
+    shape.depth[depth]++;
+
+    int record_size;
+    int value_len;
+    bool compressed;
+    if(dict->ReadDataRecordSize(data_off, record_size, value_len, compressed) != MBError::SUCCESS)
+    {
+        shape.num_error++;
+        return;
+    }
+    shape.num_record++;
+    if(compressed)
+        shape.num_compressed++;
+    shape.record_bytes += record_size;
+    shape.value_bytes += value_len;
+    shape.record_size[SizeClass(record_size)]++;
+}
+
+// Read the free list saved by writer at close without removing it.
+void DBAnalyzer::LoadFreeList(const std::string &list_path, FreeListShape &free_list)
+{
+    memset(&free_list, 0, sizeof(free_list));
+    std::ifstream list_file(list_path.c_str(), std::fstream::in | std::fstream::binary);
+    if(!list_file.is_open())
+    {
+        // Free lists are only saved when StoreListOnDisk is called.
+        return;
+    }
+
+    free_list.available = true;
+    while(true)
+    {
+        int buf_index;
+        int64_t buf_count;
+        list_file.read((char *) &buf_index, sizeof(int));
+        list_file.read((char *) &buf_count, sizeof(int64_t));
+        if(!list_file)
+            break;
+        // Free buffers of both index and data are aligned to one byte.
+        int64_t buf_size = buf_index + 1;
+        free_list.num_buffer += buf_count;
+        free_list.buffer_bytes += buf_count * buf_size;
+        free_list.buffer_size[SizeClass(buf_size)] += buf_count;
+        list_file.seekg(buf_count * sizeof(size_t), std::ios_base::cur);
+    }
+}
+
+int DBAnalyzer::SizeClass(int64_t size)
+{
+    int size_class = 0;
+    while(size > 1 && size_class < MB_ANALYZE_NUM_SIZE_CLASS - 1)
+    {
+        size >>= 1;
+        size_class++;
+    }
+    return size_class;
+}
+
+void DBAnalyzer::MergeShape(TrieShape &dst, const TrieShape &src)
+{
+    const int64_t *src_val = reinterpret_cast<const int64_t *>(&src);
+    int64_t *dst_val = reinterpret_cast<int64_t *>(&dst);
+    for(size_t i = 0; i < sizeof(TrieShape) / sizeof(int64_t); i++)
+        dst_val[i] += src_val[i];
+}
+
+static double analyze_ratio(double num, double den)
+{
+    if(den <= 0)
+        return 0;
+    return num / den;
+}
+
+// Size classes are written as the lower bound of the class.
+void DBAnalyzer::WriteSizeHist(std::ostream &out_stream, const int64_t *hist)
+{
+    bool first = true;
+    out_stream << "{";
+    for(int i = 0; i < MB_ANALYZE_NUM_SIZE_CLASS; i++)
+    {
+        if(hist[i] == 0)
+            continue;
+        out_stream << (first ? "" : ", ") << "\"" << (1LL << i) << "\": " << hist[i];
+        first = false;
+    }
+    out_stream << "}";
+}
+
+void DBAnalyzer::WriteFreeList(std::ostream &out_stream, const FreeListShape &free_list)
+{
+    out_stream << "{\"available\": " << (free_list.available ? "true" : "false")
+               << ", \"buffers\": " << free_list.num_buffer
+               << ", \"bytes\": " << free_list.buffer_bytes
+               << ", \"size_hist\": ";
+    WriteSizeHist(out_stream, free_list.buffer_size);
+    out_stream << "}";
+}
+
+void DBAnalyzer::WriteJSON(std::ostream &out_stream) const
+{
+    const TrieShape &ts = trie_shape;
+    int64_t index_live = ts.node_bytes + ts.edge_str_bytes;
+    int max_depth = 0;
+    double depth_sum = 0;
+    for(int i = 0; i <= MB_ANALYZE_MAX_DEPTH; i++)
+    {
+        if(ts.depth[i] > 0)
+            max_depth = i;
+        depth_sum += static_cast<double>(i) * ts.depth[i];
+    }
+
+    out_stream << "{\n";
+    out_stream << "  \"mbdir\": \"" << mbdir << "\",\n";
+    out_stream << "  \"count\": " << count << ",\n";
+    out_stream << "  \"writer_running\": " << (num_writer > 0 ? "true" : "false") << ",\n";
+    out_stream << "  \"errors\": " << ts.num_error << ",\n";
+
+    out_stream << "  \"index\": {\"size\": " << index_size
+               << ", \"block_size\": " << index_block_size
+               << ", \"node_bytes\": " << ts.node_bytes
+               << ", \"edge_str_bytes\": " << ts.edge_str_bytes
+               << ", \"live_bytes\": " << index_live
+               << ", \"pending_bytes\": " << pending_index_size
+               << ", \"pending_ratio\": " << analyze_ratio(pending_index_size, index_size)
+               << ", \"free_list\": ";
+    WriteFreeList(out_stream, index_free_list);
+    out_stream << "},\n";
+
+    out_stream << "  \"data\": {\"size\": " << data_size
+               << ", \"block_size\": " << data_block_size
+               << ", \"live_bytes\": " << ts.record_bytes
+               << ", \"pending_bytes\": " << pending_data_size
+               << ", \"pending_ratio\": " << analyze_ratio(pending_data_size, data_size)
+               << ", \"free_list\": ";
+    WriteFreeList(out_stream, data_free_list);
+    out_stream << "},\n";
+
+    out_stream << "  \"nodes\": {\"count\": " << ts.num_node
+               << ", \"mean_fanout\": " << analyze_ratio(ts.num_edge, ts.num_node)
+               << ", \"fanout_hist\": {";
+    bool first = true;
+    for(int i = 0; i <= NUM_ALPHABET; i++)
+    {
+        if(ts.fanout[i] == 0)
+            continue;
+        out_stream << (first ? "" : ", ") << "\"" << i << "\": " << ts.fanout[i];
+        first = false;
+    }
+    out_stream << "}},\n";
+
+    out_stream << "  \"edges\": {\"count\": " << ts.num_edge
+               << ", \"out_of_line\": " << ts.num_edge_str
+               << ", \"out_of_line_ratio\": " << analyze_ratio(ts.num_edge_str, ts.num_edge)
+               << ", \"out_of_line_bytes\": " << ts.edge_str_bytes << "},\n";
+
+    out_stream << "  \"keys\": {\"count\": " << ts.num_key
+               << ", \"mean_length\": " << analyze_ratio(ts.key_bytes, ts.num_key)
+               << ", \"mean_depth\": " << analyze_ratio(depth_sum, ts.num_key)
+               << ", \"max_depth\": " << max_depth
+               << ", \"depth_hist\": {";
+    first = true;
+    for(int i = 0; i <= MB_ANALYZE_MAX_DEPTH; i++)
+    {
+        if(ts.depth[i] == 0)
+            continue;
+        out_stream << (first ? "" : ", ") << "\"" << i << "\": " << ts.depth[i];
+        first = false;
+    }
+    out_stream << "}},\n";
+
+    out_stream << "  \"records\": {\"count\": " << ts.num_record
+               << ", \"compressed\": " << ts.num_compressed
+               << ", \"bytes\": " << ts.record_bytes
+               << ", \"value_bytes\": " << ts.value_bytes
+               << ", \"mean_size\": " << analyze_ratio(ts.record_bytes, ts.num_record)
+               << ", \"size_hist\": ";
+    WriteSizeHist(out_stream, ts.record_size);
+    out_stream << "}\n";
+    out_stream << "}\n";
+}
+
+}
@@ -0,0 +1,147 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __MB_ANALYZE_H__
+#define __MB_ANALYZE_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "db.h"
+
+namespace mabain {
+
+#define MB_ANALYZE_MAX_THREADS     64
+// Keys are at most CONSTS::MAX_KEY_LENGHTH bytes and every edge has at
+// least one byte.
+#define MB_ANALYZE_MAX_DEPTH       257
+// Sizes are counted in power of two classes up to 64K.
+#define MB_ANALYZE_NUM_SIZE_CLASS  17
+
+typedef struct _TrieShape
+{
+    int64_t num_node;
+    int64_t node_bytes;
+    // number of nodes by the number of edges
+    int64_t fanout[NUM_ALPHABET+1];
+
+    int64_t num_edge;
+    // edges longer than LOCAL_EDGE_LEN store the key string out of line
+    int64_t num_edge_str;
+    int64_t edge_str_bytes;
+
+    int64_t num_key;
+    int64_t key_bytes;
+    // number of keys by the number of edges from the root
+    int64_t depth[MB_ANALYZE_MAX_DEPTH+1];
+
+    int64_t num_record;
+    int64_t num_compressed;
+    int64_t record_bytes;
+    int64_t value_bytes;
+    int64_t record_size[MB_ANALYZE_NUM_SIZE_CLASS];
+
+    int64_t num_error;
+} TrieShape;
+
+typedef struct _FreeListShape
+{
+    // Free lists are only reported if they were saved to disk.
+    bool    available;
+    int64_t num_buffer;
+    int64_t buffer_bytes;
+    int64_t buffer_size[MB_ANALYZE_NUM_SIZE_CLASS];
+} FreeListShape;
+
+// Report the shape of the index and the fragmentation of index and data
+// blocks. Root edges are divided among a pool of threads, each walking
+// the subtrees with its own reader handle. Results are approximate if
+// writer is running.
+class DBAnalyzer
+{
+public:
+    DBAnalyzer(const MBConfig &config, int num_threads);
+    ~DBAnalyzer();
+
+    int Analyze();
+
+    const TrieShape& GetTrieShape() const;
+    const FreeListShape& GetIndexFreeList() const;
+    const FreeListShape& GetDataFreeList() const;
+    void WriteJSON(std::ostream &out_stream) const;
+
+private:
+    typedef struct _AnalyzeContext
+    {
+        DBAnalyzer *analyzer;
+        DB *db;
+        pthread_t tid;
+        bool running;
+        TrieShape shape;
+    } AnalyzeContext;
+
+    typedef struct _NodeEntry
+    {
+        size_t node_off;
+        // number of edges from the root and the key length at the node
+        int depth;
+        int key_len;
+    } NodeEntry;
+
+    static void* AnalyzeThread(void *context);
+    void WalkRootEdges(DB *db, TrieShape &shape);
+    void WalkNodes(Dict *dict, std::vector<NodeEntry> &nodes, TrieShape &shape);
+    void AddEdge(Dict *dict, const EdgePtrs &edge_ptrs, int match, size_t node_off,
+                 const NodeEntry &parent, std::vector<NodeEntry> &nodes,
+                 TrieShape &shape);
+    void AddRecord(Dict *dict, size_t data_off, int depth, int key_len,
+                   TrieShape &shape);
+    void LoadFreeList(const std::string &list_path, FreeListShape &free_list);
+    static int  SizeClass(int64_t size);
+    static void MergeShape(TrieShape &dst, const TrieShape &src);
+    static void WriteSizeHist(std::ostream &out_stream, const int64_t *hist);
+    static void WriteFreeList(std::ostream &out_stream, const FreeListShape &free_list);
+
+    MBConfig db_config;
+    std::string mbdir;
+    int num_threads;
+
+    std::atomic<int> next_root_edge;
+    std::atomic<int> root_fanout;
+
+    TrieShape trie_shape;
+    FreeListShape index_free_list;
+    FreeListShape data_free_list;
+    // copied from the DB header
+    int64_t count;
+    int     num_writer;
+    size_t  index_size;
+    size_t  data_size;
+    int64_t pending_index_size;
+    int64_t pending_data_size;
+    uint32_t index_block_size;
+    uint32_t data_block_size;
+};
+
+}
+
+#endif
@@ -20,10 +20,22 @@
 #include <fstream>
 #include <limits.h>
 #include <sstream>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
 
 #include "mb_backup.h"
 #include "mb_data.h"
 #include "integer_4b_5b.h"
+#include "file_io.h"
 
 namespace mabain {
 
@@ -32,7 +44,7 @@ DBBackup::DBBackup(const DB &db) : db_ref(db)
     if(!(db.GetDBOptions() & CONSTS::ACCESS_MODE_WRITER))
         throw (int) MBError::NOT_ALLOWED;
 
-    Dict *dict = db_ref.GetDictPtr();
+    dict = db_ref.GetDictPtr();
     if(dict == NULL)
         throw (int) MBError::NOT_INITIALIZED;
     
@@ -46,65 +58,183 @@ DBBackup::~DBBackup()
 {
 }
 
+// Copy size bytes at offset from fd_src to fd_dest. copy_file_range does
+// the copy in kernel and shares the extents on filesystems that support it.
+// Fall back to read/write if it is not supported for the files.
+int DBBackup::copy_range(int fd_src, int fd_dest, off_t offset, size_t size,
+                         char *buffer, int buffer_size)
+{
+#if defined(__linux__) && defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+    while(size > 0)
+    {
+        loff_t off_src = offset;
+        loff_t off_dest = offset;
+        ssize_t count = copy_file_range(fd_src, &off_src, fd_dest, &off_dest, size, 0);
+        if(count > 0)
+        {
+            offset += count;
+            size -= count;
+            continue;
+        }
+        if(count == 0)
+            return MBError::READ_ERROR;
+        if(errno == EINTR)
+            continue;
+        if(errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)
+            break;
+        return MBError::WRITE_ERROR;
+    }
+#endif
+
+    while(size > 0)
+    {
+        size_t len = std::min(size, static_cast<size_t>(buffer_size));
+        ssize_t count = pread(fd_src, buffer, len, offset);
+        if(count <= 0)
+            return MBError::READ_ERROR;
+        if(pwrite(fd_dest, buffer, count, offset) != count)
+            return MBError::WRITE_ERROR;
+        offset += count;
+        size -= count;
+    }
+    return MBError::SUCCESS;
+}
 
 void DBBackup::copy_file (const std::string &src_path, const std::string &dest_path,
-                          char *buffer, int buffer_size)
+                          char *buffer, int buffer_size, bool shm_src, bool shm_dest)
 {
-    FILE *fp_read, *fp_write;
+    int fd_src, fd_dest;
 
-    if ((fp_read = fopen (src_path.c_str(),"rb")) == NULL)
+    if(shm_src)
+        fd_src = shm_open(FileIO::ShmName(src_path).c_str(), O_RDONLY, 0);
+    else
+        fd_src = open(src_path.c_str(), O_RDONLY);
+    if (fd_src < 0)
     {
         Logger::Log(LOG_LEVEL_ERROR, "Backup failed: Could not open file %s", src_path.c_str()); 
-        throw MBError::OPEN_FAILURE;
+        throw (int) MBError::OPEN_FAILURE;
     }
-    if ((fp_write = fopen(dest_path.c_str(),"wb")) == NULL)
+    if(shm_dest)
+        fd_dest = shm_open(FileIO::ShmName(dest_path).c_str(), O_RDWR | O_CREAT | O_TRUNC,
+                           S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    else
+        fd_dest = open(dest_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                       S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fd_dest < 0)
     {
-        fclose(fp_read);
+        close(fd_src);
         Logger::Log(LOG_LEVEL_ERROR, "Backup failed: Could not open file %s", dest_path.c_str()); 
-        throw MBError::OPEN_FAILURE;
+        throw (int) MBError::OPEN_FAILURE;
     }
     
     int rval = MBError::SUCCESS;
-    int read_count, write_count;
-
-    while(true)
+    struct stat st;
+    if(fstat(fd_src, &st) != 0)
+    {
+        rval = MBError::READ_ERROR;
+    }
+#ifdef FICLONE
+    // Share the data blocks with the source file if the filesystem
+    // supports reflink.
+    else if(ioctl(fd_dest, FICLONE, fd_src) == 0)
+    {
+    }
+#endif
+    else
+    {
+        rval = copy_range(fd_src, fd_dest, 0, st.st_size, buffer, buffer_size);
+    }
+    close(fd_src);
+    close(fd_dest);
+    
+    if(rval != MBError::SUCCESS)
     {
-        read_count = fread(buffer, buffer_size, 1, fp_read);
+        Logger::Log(LOG_LEVEL_ERROR, "Backup failed %s", MBError::get_error_str(rval)); 
+        throw rval;
+    }
+}
 
-        if(feof(fp_read) && read_count == 0)
-             break;
-        if (read_count != 1)
-        {
-            rval = MBError::READ_ERROR;
+// Copy the dirty ranges of the block files. Blocks not found in the
+// backup directory are copied in full.
+void DBBackup::copy_dirty_ranges(const std::string &src_path_base,
+                                 const std::string &dest_path_base,
+                                 int num_files, size_t block_size,
+                                 const std::vector<std::pair<size_t, size_t>> &ranges,
+                                 char *buffer, int buffer_size)
+{
+    std::vector<bool> new_file(num_files, false);
+    for (int i = 0; i < num_files; i++)
+    {
+        std::string dest_path = dest_path_base + std::to_string(i);
+        if(access(dest_path.c_str(), F_OK) == 0)
+            continue;
+        copy_file(src_path_base + std::to_string(i), dest_path, buffer, buffer_size);
+        new_file[i] = true;
+    }
+    // Remove the blocks that were removed from DB after last backup.
+    for (int i = num_files; ; i++)
+    {
+        if(unlink((dest_path_base + std::to_string(i)).c_str()) != 0)
             break;
-        }
+    }
 
-        write_count = fwrite(buffer,buffer_size, 1, fp_write);
-        if(write_count != 1)
+    int rval = MBError::SUCCESS;
+    int fd_src = -1;
+    int fd_dest = -1;
+    int curr_order = -1;
+    for (auto it = ranges.begin(); it != ranges.end() && rval == MBError::SUCCESS; ++it)
+    {
+        size_t offset = it->first;
+        size_t size = it->second;
+        while(size > 0)
         {
-            rval = MBError::WRITE_ERROR;
-            break;
+            int order = offset / block_size;
+            if(order >= num_files)
+                break;
+
+            size_t block_offset = offset % block_size;
+            size_t len = std::min(size, block_size - block_offset);
+            if(!new_file[order])
+            {
+                if(order != curr_order)
+                {
+                    if(fd_src >= 0)
+                        close(fd_src);
+                    if(fd_dest >= 0)
+                        close(fd_dest);
+                    curr_order = order;
+                    fd_src = open((src_path_base + std::to_string(order)).c_str(), O_RDONLY);
+                    fd_dest = open((dest_path_base + std::to_string(order)).c_str(), O_WRONLY);
+                    if(fd_src < 0 || fd_dest < 0)
+                    {
+                        rval = MBError::OPEN_FAILURE;
+                        break;
+                    }
+                }
+                rval = copy_range(fd_src, fd_dest, block_offset, len, buffer, buffer_size);
+                if(rval != MBError::SUCCESS)
+                    break;
+            }
+            offset += len;
+            size -= len;
         }
     }
-    fclose(fp_read);
-    fclose(fp_write);
-    
+    if(fd_src >= 0)
+        close(fd_src);
+    if(fd_dest >= 0)
+        close(fd_dest);
+
     if(rval != MBError::SUCCESS)
     {
-        Logger::Log(LOG_LEVEL_ERROR, "Backup failed %s", MBError::get_error_str(rval)); 
+        Logger::Log(LOG_LEVEL_ERROR, "Incremental backup failed for %s: %s",
+                    dest_path_base.c_str(), MBError::get_error_str(rval));
         throw rval;
     }
 }
 
-int DBBackup::Backup(const char * bk_dir)
+void DBBackup::CheckHeader() const
 {
-    if(bk_dir == NULL)
-        throw (int) MBError::INVALID_ARG;
-
-    std::string bk_header_path = std::string(bk_dir) + "/_mabain_h";
-    if(access(bk_header_path.c_str(), R_OK) == 0)
-        throw (int) MBError::OPEN_FAILURE;
-    
     if(!db_ref.is_open())
         throw (int) db_ref.Status();
    
@@ -114,7 +244,33 @@ int DBBackup::Backup(const char * bk_dir)
         throw (int) MBError::INVALID_SIZE;
     if(header->index_block_size == 0 || header->index_block_size % BLOCK_SIZE_ALIGN != 0)
         throw (int) MBError::INVALID_SIZE;
+}
+
+//reset number readers/writers in backed up DB.
+void DBBackup::ResetNumHandlers(const char *bk_dir, int options)
+{
+    int rval;
+    DB db = DB(bk_dir, options, 0, 0);
+    rval = db.UpdateNumHandlers(CONSTS::ACCESS_MODE_WRITER, -1);
+    if(rval != MBError::SUCCESS)
+        Logger::Log(LOG_LEVEL_WARN,"failed to reset number of writer for DB %s", bk_dir);
     
+    rval = db.UpdateNumHandlers(CONSTS::ACCESS_MODE_READER, INT_MIN);
+    if(rval != MBError::SUCCESS)
+        Logger::Log(LOG_LEVEL_WARN,"failed to reset number of writer for DB %s", bk_dir);
+    db.Close();
+}
+
+int DBBackup::Backup(const char * bk_dir)
+{
+    if(bk_dir == NULL)
+        throw (int) MBError::INVALID_ARG;
+
+    std::string bk_header_path = std::string(bk_dir) + "/_mabain_h";
+    if(access(bk_header_path.c_str(), R_OK) == 0)
+        throw (int) MBError::OPEN_FAILURE;
+    
+    CheckHeader();
     db_ref.Flush();
 
     int num_data_files, num_index_files;
@@ -133,40 +289,169 @@ int DBBackup::Backup(const char * bk_dir)
     std::string read_file_path;
     std::string write_file_path;
     
-    for (int i = 0; i < num_data_files; i++)
-    {
-        read_file_path = read_file_path_base + std::to_string(i);
-        write_file_path = write_file_path_base + std::to_string(i);
-        copy_file(read_file_path, write_file_path, buffer, BLOCK_SIZE_ALIGN);
-    }
+    try {
+        for (int i = 0; i < num_data_files; i++)
+        {
+            read_file_path = read_file_path_base + std::to_string(i);
+            write_file_path = write_file_path_base + std::to_string(i);
+            copy_file(read_file_path, write_file_path, buffer, BLOCK_SIZE_ALIGN);
+        }
     
-    read_file_path_base = orig_dir + "/_mabain_i";
-    write_file_path_base = std::string(bk_dir) + "/_mabain_i";
-    for (int i = 0; i < num_index_files; i++)
-    {
-        read_file_path = read_file_path_base + std::to_string(i);
-        write_file_path = write_file_path_base + std::to_string(i);
-        copy_file(read_file_path, write_file_path, buffer, BLOCK_SIZE_ALIGN);
-    }
+        read_file_path_base = orig_dir + "/_mabain_i";
+        write_file_path_base = std::string(bk_dir) + "/_mabain_i";
+        for (int i = 0; i < num_index_files; i++)
+        {
+            read_file_path = read_file_path_base + std::to_string(i);
+            write_file_path = write_file_path_base + std::to_string(i);
+            copy_file(read_file_path, write_file_path, buffer, BLOCK_SIZE_ALIGN);
+        }
     
-    read_file_path = orig_dir + "/_mabain_h";
-    write_file_path = std::string(bk_dir) + "/_mabain_h";
-    //header is size of page_size
-    copy_file(read_file_path, write_file_path, buffer, RollableFile::page_size);
+        // New backup id invalidates the previous backups for incremental backup.
+        header->backup_id++;
+        read_file_path = orig_dir + "/_mabain_h";
+        write_file_path = std::string(bk_dir) + "/_mabain_h";
+        //header is size of page_size
+        copy_file(read_file_path, write_file_path, buffer, RollableFile::page_size);
+    } catch (int error) {
+        free(buffer);
+        throw error;
+    }
     
     free(buffer);
+    dict->GetMM()->ClearDirtyMap();
+    dict->ClearDirtyMap();
     
-    //reset number readers/writers in backed up DB.
-    int rval;
-    DB db = DB(bk_dir, CONSTS::ACCESS_MODE_READER, 0, 0);
-    rval = db.UpdateNumHandlers(CONSTS::ACCESS_MODE_WRITER, -1);
-    if(rval != MBError::SUCCESS)
-        Logger::Log(LOG_LEVEL_WARN,"failed to reset number of writer for DB %s", bk_dir);
-    
-    rval = db.UpdateNumHandlers(CONSTS::ACCESS_MODE_READER, INT_MIN);
+    ResetNumHandlers(bk_dir);
+    return MBError::SUCCESS;
+}
+
+int DBBackup::IncrementalBackup(const char * bk_dir)
+{
+    if(bk_dir == NULL)
+        throw (int) MBError::INVALID_ARG;
+
+    CheckHeader();
+
+    char *buffer = (char *) malloc(BLOCK_SIZE_ALIGN);
+    if(buffer == NULL)
+        throw (int) MBError::NO_MEMORY;
+
+    // The backup directory must hold the last backup of this DB.
+    std::string bk_header_path = std::string(bk_dir) + "/_mabain_h";
+    int fd = open(bk_header_path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        free(buffer);
+        throw (int) MBError::OPEN_FAILURE;
+    }
+    ssize_t count = pread(fd, buffer, RollableFile::page_size, 0);
+    close(fd);
+    const IndexHeader *bk_header = reinterpret_cast<const IndexHeader *>(buffer);
+    if(count != RollableFile::page_size || header->backup_id == 0 ||
+       bk_header->backup_id != header->backup_id ||
+       bk_header->index_block_size != header->index_block_size ||
+       bk_header->data_block_size != header->data_block_size)
+    {
+        free(buffer);
+        Logger::Log(LOG_LEVEL_WARN, "%s is not the last backup, full backup is required",
+                    bk_dir);
+        throw (int) MBError::NOT_ALLOWED;
+    }
+
+    db_ref.Flush();
+
+    int num_data_files = (header->m_data_offset/header->data_block_size) + 1; 
+    int num_index_files = (header->m_index_offset/header->index_block_size) + 1;
+    std::vector<std::pair<size_t, size_t>> data_ranges;
+    std::vector<std::pair<size_t, size_t>> index_ranges;
+    dict->GetDirtyRanges(header->m_data_offset, data_ranges);
+    dict->GetMM()->GetDirtyRanges(header->m_index_offset, index_ranges);
+
+    const std::string &orig_dir = db_ref.GetDBDir();
+    try {
+        copy_dirty_ranges(orig_dir + "/_mabain_d", std::string(bk_dir) + "/_mabain_d",
+                          num_data_files, header->data_block_size, data_ranges,
+                          buffer, BLOCK_SIZE_ALIGN);
+        copy_dirty_ranges(orig_dir + "/_mabain_i", std::string(bk_dir) + "/_mabain_i",
+                          num_index_files, header->index_block_size, index_ranges,
+                          buffer, BLOCK_SIZE_ALIGN);
+
+        // The header is copied last. The dirty ranges are copied again
+        // if the backup fails before the header is copied.
+        header->backup_id++;
+        copy_file(orig_dir + "/_mabain_h", bk_header_path, buffer, RollableFile::page_size);
+    } catch (int error) {
+        free(buffer);
+        throw error;
+    }
+
+    free(buffer);
+    dict->GetMM()->ClearDirtyMap();
+    dict->ClearDirtyMap();
+
+    size_t bytes_copied = 0;
+    for(auto it = data_ranges.begin(); it != data_ranges.end(); ++it)
+        bytes_copied += it->second;
+    for(auto it = index_ranges.begin(); it != index_ranges.end(); ++it)
+        bytes_copied += it->second;
+    Logger::Log(LOG_LEVEL_INFO, "incremental backup to %s copied %llu bytes", bk_dir,
+                (unsigned long long) bytes_copied);
+
+    ResetNumHandlers(bk_dir);
+    return MBError::SUCCESS;
+}
+
+// The header is copied last since readers check it for the existence
+// of the DB.
+int DBBackup::RestoreSharedMemory(const std::string &src_dir, const std::string &mbdir)
+{
+    std::string dir = mbdir;
+    if(dir.empty() || dir[dir.length()-1] != '/')
+        dir += "/";
+    std::string src_header_path = src_dir + "/_mabain_h";
+    if(access(src_header_path.c_str(), R_OK) != 0)
+        return MBError::NO_DB;
+    if(FileIO::ShmExists(dir + "_mabain_h"))
+        return MBError::NOT_ALLOWED;
+
+    char *buffer = (char *) malloc(BLOCK_SIZE_ALIGN);
+    if(buffer == NULL)
+        return MBError::NO_MEMORY;
+    int rval = MBError::SUCCESS;
+    try {
+        const char *block_prefix[] = {"_mabain_i", "_mabain_d"};
+        for(int n = 0; n < 2; n++)
+        {
+            for(int i = 0; ; i++)
+            {
+                std::string block_name = block_prefix[n] + std::to_string(i);
+                if(access((src_dir + "/" + block_name).c_str(), R_OK) != 0)
+                    break;
+                copy_file(src_dir + "/" + block_name, dir + block_name, buffer,
+                          BLOCK_SIZE_ALIGN, false, true);
+            }
+        }
+        copy_file(src_header_path, dir + "_mabain_h", buffer, BLOCK_SIZE_ALIGN,
+                  false, true);
+    } catch (int error) {
+        rval = error;
+    }
+    free(buffer);
+
     if(rval != MBError::SUCCESS)
-        Logger::Log(LOG_LEVEL_WARN,"failed to reset number of writer for DB %s", bk_dir);
-    db.Close();
+    {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to restore %s to shared memory: %s",
+                    src_dir.c_str(), MBError::get_error_str(rval));
+        DB::RemoveSharedMemory(dir.c_str());
+        return rval;
+    }
+
+    ResetNumHandlers(dir.c_str(), CONSTS::ACCESS_MODE_READER | CONSTS::SHARED_MEMORY_MODE);
+    // Drop the files opened by the reader above so that they are not
+    // reused without mapping by a writer in this process.
+    DB::ClearResources(dir);
+    Logger::Log(LOG_LEVEL_INFO, "restored %s to shared memory %s", src_dir.c_str(),
+                dir.c_str());
     return MBError::SUCCESS;
 }
 
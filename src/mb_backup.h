@@ -20,6 +20,7 @@
 #define __DBBackup_H__
 
 #include <string>
+#include <vector>
 
 #include "db.h"
 #include "dict.h"
@@ -28,17 +29,37 @@ namespace mabain {
 
 class DBBackup
 {
+    // Snapshot uses the same file copy routines.
+    friend class DBSnapshot;
+
 public:
 	DBBackup(const DB &db);
 	~DBBackup();
 	int Backup(const char* bkup_dir);
+	// Copy the ranges modified since the last backup. bkup_dir must
+	// hold the last backup of the DB.
+	int IncrementalBackup(const char* bkup_dir);
+    // Copy the DB files in src_dir to shared memory objects of mbdir.
+    static int RestoreSharedMemory(const std::string &src_dir, const std::string &mbdir);
 
 private:
+    // shm_src and shm_dest are set if the file is a shared memory object.
     static void copy_file (const std::string &src_path,
-        const std::string &dest_path, char *buffer, int buffer_size);
+        const std::string &dest_path, char *buffer, int buffer_size,
+        bool shm_src = false, bool shm_dest = false);
+    static int copy_range(int fd_src, int fd_dest, off_t offset, size_t size,
+        char *buffer, int buffer_size);
+    static void copy_dirty_ranges(const std::string &src_path_base,
+        const std::string &dest_path_base, int num_files, size_t block_size,
+        const std::vector<std::pair<size_t, size_t>> &ranges,
+        char *buffer, int buffer_size);
+    void CheckHeader() const;
+    static void ResetNumHandlers(const char *bk_dir,
+        int options = CONSTS::ACCESS_MODE_READER);
     
     const DB &db_ref;
-    const IndexHeader *header;
+    IndexHeader *header;
+    Dict *dict;
 };
 
 }
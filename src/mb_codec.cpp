@@ -0,0 +1,294 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+#include <unordered_map>
+
+#include "mb_codec.h"
+#include "error.h"
+
+// length of byte sequences counted in dictionary training
+#define MB_CODEC_DICT_GRAM          8
+// length of segments copied into the dictionary
+#define MB_CODEC_DICT_SEGMENT       32
+
+namespace mabain {
+
+// Write the remaining length using 255 as continuation bytes.
+static inline void write_length(uint8_t *&op, int len)
+{
+    while(len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = static_cast<uint8_t>(len);
+}
+
+static inline bool read_length(const uint8_t *&ip, const uint8_t *ip_end, int &len)
+{
+    uint8_t byte;
+    do
+    {
+        if(ip >= ip_end)
+            return false;
+        byte = *ip++;
+        len += byte;
+    } while(byte == 255);
+    return true;
+}
+
+// Write one sequence. Match length is zero for the last sequence.
+static bool write_sequence(uint8_t *&op, const uint8_t *op_end, const uint8_t *literal,
+                           int lit_len, int offset, int match_len)
+{
+    int match_code = (match_len > 0) ? match_len - MB_CODEC_MIN_MATCH : 0;
+    // worst case size of the sequence
+    if(op + 1 + lit_len/255 + 1 + lit_len + 2 + match_code/255 + 1 > op_end)
+        return false;
+
+    uint8_t *token = op++;
+    *token = static_cast<uint8_t>(((lit_len < 15 ? lit_len : 15) << 4) |
+                                  (match_code < 15 ? match_code : 15));
+    if(lit_len >= 15)
+        write_length(op, lit_len - 15);
+    memcpy(op, literal, lit_len);
+    op += lit_len;
+
+    if(match_len > 0)
+    {
+        op[0] = static_cast<uint8_t>(offset & 0xFF);
+        op[1] = static_cast<uint8_t>(offset >> 8);
+        op += 2;
+        if(match_code >= 15)
+            write_length(op, match_code - 15);
+    }
+    return true;
+}
+
+MBCodec::MBCodec() : dict_size(0)
+{
+    memset(dict_table, 0xFF, sizeof(dict_table));
+}
+
+MBCodec::~MBCodec()
+{
+}
+
+inline uint32_t MBCodec::Hash(const uint8_t *ptr)
+{
+    uint32_t val;
+    memcpy(&val, ptr, sizeof(val));
+    return (val * 2654435761U) >> (32 - MB_CODEC_HASH_BITS);
+}
+
+void MBCodec::SetDictionary(const uint8_t *dict, int dict_len)
+{
+    dict_size = dict_len;
+    work_buff.resize(dict_size);
+    if(dict_size > 0)
+        memcpy(work_buff.data(), dict, dict_size);
+
+    memset(dict_table, 0xFF, sizeof(dict_table));
+    for(int pos = 0; pos + MB_CODEC_MIN_MATCH <= dict_size; pos++)
+        dict_table[Hash(work_buff.data() + pos)] = pos;
+}
+
+int MBCodec::GetDictionaryLength() const
+{
+    return dict_size;
+}
+
+int MBCodec::Compress(const uint8_t *src, int len, uint8_t *dst, int max_len)
+{
+    if(len <= 0 || max_len <= 0)
+        return 0;
+
+    // Append the value to the dictionary so that matches can cross
+    // from the value into the dictionary.
+    if(static_cast<int>(work_buff.size()) < dict_size + len)
+        work_buff.resize(dict_size + len);
+    memcpy(work_buff.data() + dict_size, src, len);
+    memcpy(hash_table, dict_table, sizeof(hash_table));
+
+    const uint8_t *base = work_buff.data();
+    const uint8_t *op_end = dst + max_len;
+    uint8_t *op = dst;
+    int end = dict_size + len;
+    int pos = dict_size;
+    int anchor = pos;
+
+    while(pos + MB_CODEC_MIN_MATCH <= end)
+    {
+        uint32_t hval = Hash(base + pos);
+        int ref = hash_table[hval];
+        hash_table[hval] = pos;
+        if(ref < 0 || pos - ref > MB_CODEC_MAX_OFFSET ||
+           memcmp(base + ref, base + pos, MB_CODEC_MIN_MATCH) != 0)
+        {
+            pos++;
+            continue;
+        }
+
+        int match_len = MB_CODEC_MIN_MATCH;
+        while(pos + match_len < end && base[ref + match_len] == base[pos + match_len])
+            match_len++;
+        if(!write_sequence(op, op_end, base + anchor, pos - anchor, pos - ref, match_len))
+            return 0;
+        pos += match_len;
+        anchor = pos;
+    }
+
+    if(!write_sequence(op, op_end, base + anchor, end - anchor, 0, 0))
+        return 0;
+    return static_cast<int>(op - dst);
+}
+
+int MBCodec::Decompress(const uint8_t *src, int len, uint8_t *dst, int raw_len,
+                        const uint8_t *dict, int dict_len)
+{
+    const uint8_t *ip = src;
+    const uint8_t *ip_end = src + len;
+    int out = 0;
+
+    while(ip < ip_end)
+    {
+        int token = *ip++;
+        int lit_len = token >> 4;
+        if(lit_len == 15 && !read_length(ip, ip_end, lit_len))
+            return MBError::DECOMPRESS_FAILED;
+        if(lit_len > ip_end - ip || lit_len > raw_len - out)
+            return MBError::DECOMPRESS_FAILED;
+        memcpy(dst + out, ip, lit_len);
+        ip += lit_len;
+        out += lit_len;
+        if(ip == ip_end)
+            break;
+
+        if(ip_end - ip < 2)
+            return MBError::DECOMPRESS_FAILED;
+        int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        int match_len = (token & 0x0F);
+        if(match_len == 15 && !read_length(ip, ip_end, match_len))
+            return MBError::DECOMPRESS_FAILED;
+        match_len += MB_CODEC_MIN_MATCH;
+        if(offset == 0 || offset > out + dict_len || match_len > raw_len - out)
+            return MBError::DECOMPRESS_FAILED;
+
+        int ref = out - offset;
+        if(ref >= 0 && offset >= match_len)
+        {
+            memcpy(dst + out, dst + ref, match_len);
+            out += match_len;
+            continue;
+        }
+        // Overlapped match or match starting in the dictionary
+        for(int i = 0; i < match_len; i++, ref++)
+            dst[out++] = (ref < 0) ? dict[dict_len + ref] : dst[ref];
+    }
+
+    if(out != raw_len)
+        return MBError::DECOMPRESS_FAILED;
+    return MBError::SUCCESS;
+}
+
+typedef struct _GramStat
+{
+    // number of samples containing the byte sequence
+    int count;
+    // index+1 of the last sample counted
+    int last_sample;
+} GramStat;
+
+int MBCodec::TrainDictionary(const std::vector<std::string> &samples,
+                             uint8_t *dict, int max_dict_len)
+{
+    std::unordered_map<uint64_t, GramStat> grams;
+    std::vector<std::vector<GramStat*>> sample_grams(samples.size());
+
+    // Count byte sequences once per sample so that sequences repeated
+    // across values are preferred over repetitions within one value.
+    for(size_t i = 0; i < samples.size(); i++)
+    {
+        const std::string &sample = samples[i];
+        for(size_t pos = 0; pos + MB_CODEC_DICT_GRAM <= sample.size(); pos++)
+        {
+            uint64_t key;
+            memcpy(&key, sample.data() + pos, sizeof(key));
+            GramStat &stat = grams[key];
+            if(stat.last_sample != static_cast<int>(i) + 1)
+            {
+                stat.count++;
+                stat.last_sample = static_cast<int>(i) + 1;
+            }
+            sample_grams[i].push_back(&stat);
+        }
+    }
+
+    // Greedily pick the segment that covers the most repeated sequences
+    // not yet in the dictionary. Best segments are placed at the end.
+    int dict_pos = max_dict_len;
+    while(dict_pos >= MB_CODEC_DICT_GRAM)
+    {
+        int seg_len = (dict_pos < MB_CODEC_DICT_SEGMENT) ? dict_pos : MB_CODEC_DICT_SEGMENT;
+        int num_gram = seg_len - MB_CODEC_DICT_GRAM + 1;
+        int64_t best_score = 0;
+        size_t best_sample = 0;
+        size_t best_start = 0;
+
+        for(size_t i = 0; i < samples.size(); i++)
+        {
+            const std::vector<GramStat*> &gram_ptrs = sample_grams[i];
+            int64_t score = 0;
+            for(size_t pos = 0; pos < gram_ptrs.size(); pos++)
+            {
+                if(gram_ptrs[pos]->count > 1)
+                    score += gram_ptrs[pos]->count;
+                if(pos >= static_cast<size_t>(num_gram) &&
+                   gram_ptrs[pos - num_gram]->count > 1)
+                    score -= gram_ptrs[pos - num_gram]->count;
+                if(score > best_score)
+                {
+                    best_score = score;
+                    best_sample = i;
+                    best_start = (pos + 1 > static_cast<size_t>(num_gram)) ?
+                                 pos + 1 - num_gram : 0;
+                }
+            }
+        }
+        if(best_score == 0)
+            break;
+
+        const std::string &sample = samples[best_sample];
+        if(best_start + seg_len > sample.size())
+            seg_len = static_cast<int>(sample.size() - best_start);
+        dict_pos -= seg_len;
+        memcpy(dict + dict_pos, sample.data() + best_start, seg_len);
+        // Sequences in the dictionary do not need to be covered again.
+        for(size_t pos = best_start; pos + MB_CODEC_DICT_GRAM <= best_start + seg_len; pos++)
+            sample_grams[best_sample][pos]->count = 0;
+    }
+
+    int dict_len = max_dict_len - dict_pos;
+    if(dict_len > 0 && dict_pos > 0)
+        memmove(dict, dict + dict_pos, dict_len);
+    return dict_len;
+}
+
+}
@@ -0,0 +1,82 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __MB_CODEC_H__
+#define __MB_CODEC_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace mabain {
+
+// maximum size of the compression dictionary stored in the DB header
+#define MB_CODEC_MAX_DICT_SIZE      2048
+// values shorter than this are never compressed
+#define MB_CODEC_MIN_DATA_SIZE      32
+// sample size collected by writer before training the dictionary
+#define MB_CODEC_TRAIN_SIZE         32*1024
+#define MB_CODEC_TRAIN_COUNT        1024
+#define MB_CODEC_MIN_MATCH          4
+#define MB_CODEC_MAX_OFFSET         0xFFFF
+#define MB_CODEC_HASH_BITS          12
+#define MB_CODEC_HASH_SIZE          (1 << MB_CODEC_HASH_BITS)
+
+// LZ77 value compressor using a preset dictionary.
+// The dictionary is treated as the history preceding each value so that
+// byte sequences shared by many small values can be referenced from the
+// first byte of every value. The output is a sequence of
+//     token | literal length ext | literals | offset (2 bytes) | match length ext
+// where the high and low 4 bits of the token are the literal length and
+// match length minus MB_CODEC_MIN_MATCH. The last sequence has literals only.
+class MBCodec
+{
+public:
+    MBCodec();
+    ~MBCodec();
+
+    // Set the dictionary used by Compress. The dictionary is copied.
+    void SetDictionary(const uint8_t *dict, int dict_len);
+    int  GetDictionaryLength() const;
+    // Compress src to dst. Return the compressed size, or 0 if the
+    // compressed size is greater than max_len.
+    int  Compress(const uint8_t *src, int len, uint8_t *dst, int max_len);
+
+    // Decompress exactly raw_len bytes to dst.
+    static int Decompress(const uint8_t *src, int len, uint8_t *dst, int raw_len,
+                          const uint8_t *dict, int dict_len);
+    // Build a dictionary from sample values by picking the segments that
+    // cover most byte sequences repeated across samples.
+    // Return the dictionary length.
+    static int TrainDictionary(const std::vector<std::string> &samples,
+                               uint8_t *dict, int max_dict_len);
+
+private:
+    static inline uint32_t Hash(const uint8_t *ptr);
+
+    int dict_size;
+    // dictionary followed by the value being compressed
+    std::vector<uint8_t> work_buff;
+    // hash table with dictionary positions only
+    int32_t dict_table[MB_CODEC_HASH_SIZE];
+    int32_t hash_table[MB_CODEC_HASH_SIZE];
+};
+
+}
+
+#endif
@@ -33,6 +33,7 @@ MBData::MBData()
     next = false;
     options = 0;
     free_buffer = false;
+    expire_time = 0;
 }
 
 MBData::MBData(int size, int match_options)
@@ -56,6 +57,7 @@ MBData::MBData(int size, int match_options)
     match_len = 0;
     next = false;
     options = match_options;
+    expire_time = 0;
 }
 
 // Caller must free data.
@@ -117,6 +119,7 @@ void MBData::Clear()
     match_len = 0;
     data_len = 0;
     next = false;
+    expire_time = 0;
 }
 
 int MBData::Resize(int size)
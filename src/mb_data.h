@@ -89,6 +89,8 @@ public:
     // data offset
     size_t data_offset;
     uint16_t bucket_index;
+    // expiry timestamp in seconds since epoch; zero means never expire.
+    uint32_t expire_time;
 
     // Search options
     int options;
@@ -0,0 +1,259 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sched.h>
+#include <algorithm>
+
+#include "mb_hot_keys.h"
+#include "rollable_file.h"
+#include "resource_pool.h"
+#include "mabain_consts.h"
+#include "error.h"
+#include "logger.h"
+#include "crc32c.h"
+
+namespace mabain {
+
+HotKeys::HotKeys(const std::string &hot_keys_path, int mode, uint32_t sample_rate)
+               : header(NULL),
+                 sketch(NULL),
+                 heap(NULL),
+                 num_find(0),
+                 status(MBError::NOT_INITIALIZED)
+{
+    size_t sketch_size = MB_HOT_KEY_SKETCH_DEPTH * MB_HOT_KEY_SKETCH_WIDTH *
+                         sizeof(std::atomic<uint32_t>);
+    size_t file_size = RollableFile::page_size + sketch_size +
+                       MB_HOT_KEY_TOP_K * sizeof(HotKeyEntry);
+    bool writer = (mode & CONSTS::ACCESS_MODE_WRITER);
+    bool anon_mode = (mode & CONSTS::MEMORY_ONLY_MODE) &&
+                     !(mode & CONSTS::SHARED_MEMORY_MODE);
+    bool new_file;
+    if(mode & CONSTS::SHARED_MEMORY_MODE)
+        new_file = !FileIO::ShmExists(hot_keys_path);
+    else
+        new_file = (access(hot_keys_path.c_str(), F_OK) != 0);
+    if(!writer && new_file && !anon_mode)
+    {
+        status = MBError::NOT_EXIST;
+        return;
+    }
+
+    bool map_file = true;
+    hot_keys_file = ResourcePool::getInstance().OpenFile(hot_keys_path, mode, file_size,
+                                                         map_file, writer);
+    if(!map_file || hot_keys_file->GetMapAddr() == NULL)
+    {
+        Logger::Log(LOG_LEVEL_WARN, "failed to map hot key file %s", hot_keys_path.c_str());
+        hot_keys_file = NULL;
+        status = MBError::MMAP_FAILED;
+        return;
+    }
+
+    header = reinterpret_cast<HotKeyHeader *>(hot_keys_file->GetMapAddr());
+    sketch = reinterpret_cast<std::atomic<uint32_t> *>(hot_keys_file->GetMapAddr() +
+                                                       RollableFile::page_size);
+    heap = reinterpret_cast<HotKeyEntry *>(hot_keys_file->GetMapAddr() +
+                                           RollableFile::page_size + sketch_size);
+    if(writer)
+    {
+        // Counts start from zero every time writer is opened.
+        header->top_k = 0;
+        memset(hot_keys_file->GetMapAddr() + RollableFile::page_size, 0,
+               file_size - RollableFile::page_size);
+        header->sample_rate = (sample_rate > 0) ? sample_rate : MB_HOT_KEY_DEFAULT_SAMPLE_RATE;
+        header->heap_lock.store(0, std::memory_order_relaxed);
+        header->num_heap_entry = 0;
+        header->num_sample.store(0, std::memory_order_relaxed);
+        header->sketch_depth = MB_HOT_KEY_SKETCH_DEPTH;
+        header->sketch_width = MB_HOT_KEY_SKETCH_WIDTH;
+        header->top_k = MB_HOT_KEY_TOP_K;
+    }
+    else if(header->top_k != MB_HOT_KEY_TOP_K ||
+            header->sketch_depth != MB_HOT_KEY_SKETCH_DEPTH ||
+            header->sketch_width != MB_HOT_KEY_SKETCH_WIDTH)
+    {
+        // Writer has not initialized the file.
+        header = NULL;
+        status = MBError::NOT_EXIST;
+        return;
+    }
+    status = MBError::SUCCESS;
+}
+
+HotKeys::~HotKeys()
+{
+}
+
+int HotKeys::Status() const
+{
+    return status;
+}
+
+// Count the key in every row of the sketch. The estimated count is the
+// minimum of the counters since other keys may share some of them.
+void HotKeys::Add(const uint8_t *key, int len)
+{
+    uint32_t hash = crc32c(0, key, len);
+    uint32_t hash2 = crc32c(hash, key, len) | 1;
+    uint64_t count = UINT64_MAX;
+    for(int i = 0; i < MB_HOT_KEY_SKETCH_DEPTH; i++)
+    {
+        uint32_t index = (hash + i * hash2) % MB_HOT_KEY_SKETCH_WIDTH;
+        uint64_t c = sketch[i * MB_HOT_KEY_SKETCH_WIDTH + index]
+                         .fetch_add(1, std::memory_order_relaxed) + 1;
+        if(c < count)
+            count = c;
+    }
+    header->num_sample.fetch_add(1, std::memory_order_relaxed);
+
+    if(!TryLockHeap())
+        return;
+    UpdateHeap(hash, key, len, count);
+    header->heap_lock.store(0, std::memory_order_release);
+}
+
+// The lock is taken over if the process holding it no longer exists so that
+// a reader that died while updating the heap does not stop all updates.
+bool HotKeys::TryLockHeap() const
+{
+    uint32_t pid = static_cast<uint32_t>(getpid());
+    uint32_t owner = 0;
+    if(header->heap_lock.compare_exchange_strong(owner, pid, std::memory_order_acquire))
+        return true;
+    if(owner == pid || kill(static_cast<pid_t>(owner), 0) == 0 || errno != ESRCH)
+        return false;
+    Logger::Log(LOG_LEVEL_WARN, "hot key heap lock owner %u no longer exists", owner);
+    return header->heap_lock.compare_exchange_strong(owner, pid, std::memory_order_acquire);
+}
+
+void HotKeys::UpdateHeap(uint32_t hash, const uint8_t *key, int len, uint64_t count)
+{
+    int cmp_len = std::min(len, MB_HOT_KEY_MAX_LEN);
+    int num_entry = header->num_heap_entry;
+    for(int i = 0; i < num_entry; i++)
+    {
+        if(heap[i].hash == hash && heap[i].key_len == len &&
+           memcmp(heap[i].key, key, cmp_len) == 0)
+        {
+            if(count > heap[i].count)
+            {
+                heap[i].count = count;
+                SiftDown(i);
+            }
+            return;
+        }
+    }
+
+    int index;
+    if(num_entry < MB_HOT_KEY_TOP_K)
+    {
+        index = num_entry;
+        header->num_heap_entry = num_entry + 1;
+    }
+    else if(count > heap[0].count)
+    {
+        // Replace the key with the lowest count.
+        index = 0;
+    }
+    else
+    {
+        return;
+    }
+
+    heap[index].count = count;
+    heap[index].hash = hash;
+    heap[index].key_len = len;
+    memcpy(heap[index].key, key, cmp_len);
+    if(index == 0)
+        SiftDown(index);
+    else
+        SiftUp(index);
+}
+
+void HotKeys::SiftDown(int index)
+{
+    int num_entry = header->num_heap_entry;
+    while(true)
+    {
+        int smallest = index;
+        int left = 2 * index + 1;
+        int right = left + 1;
+        if(left < num_entry && heap[left].count < heap[smallest].count)
+            smallest = left;
+        if(right < num_entry && heap[right].count < heap[smallest].count)
+            smallest = right;
+        if(smallest == index)
+            break;
+        std::swap(heap[index], heap[smallest]);
+        index = smallest;
+    }
+}
+
+void HotKeys::SiftUp(int index)
+{
+    while(index > 0)
+    {
+        int parent = (index - 1) / 2;
+        if(heap[parent].count <= heap[index].count)
+            break;
+        std::swap(heap[index], heap[parent]);
+        index = parent;
+    }
+}
+
+void HotKeys::Get(std::vector<HotKey> &hot_keys) const
+{
+    hot_keys.clear();
+    if(header == NULL)
+        return;
+
+    // The heap is copied without the lock after MB_HOT_KEY_LOCK_RETRY tries
+    // so that a stalled reader does not block the query.
+    HotKeyEntry entries[MB_HOT_KEY_TOP_K];
+    bool locked = false;
+    for(int i = 0; i < MB_HOT_KEY_LOCK_RETRY && !locked; i++)
+    {
+        locked = TryLockHeap();
+        if(!locked)
+            sched_yield();
+    }
+    int num_entry = std::min(static_cast<int>(header->num_heap_entry), MB_HOT_KEY_TOP_K);
+    memcpy(entries, heap, num_entry * sizeof(HotKeyEntry));
+    if(locked)
+        header->heap_lock.store(0, std::memory_order_release);
+
+    uint64_t sample_rate = header->sample_rate;
+    for(int i = 0; i < num_entry; i++)
+    {
+        HotKey hot_key;
+        hot_key.key.assign(reinterpret_cast<const char *>(entries[i].key),
+                           std::min(static_cast<int>(entries[i].key_len), MB_HOT_KEY_MAX_LEN));
+        hot_key.key_len = entries[i].key_len;
+        hot_key.count = entries[i].count * sample_rate;
+        hot_keys.push_back(hot_key);
+    }
+    std::sort(hot_keys.begin(), hot_keys.end(),
+              [](const HotKey &a, const HotKey &b) { return a.count > b.count; });
+}
+
+}
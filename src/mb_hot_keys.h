@@ -0,0 +1,103 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __MB_HOT_KEYS_H__
+#define __MB_HOT_KEYS_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+#include "db.h"
+#include "mmap_file.h"
+
+namespace mabain {
+
+#define MB_HOT_KEY_SKETCH_DEPTH     4
+#define MB_HOT_KEY_SKETCH_WIDTH     4096
+#define MB_HOT_KEY_MAX_LEN          64
+#define MB_HOT_KEY_LOCK_RETRY       1000
+
+typedef struct _HotKeyHeader
+{
+    uint32_t sketch_depth;
+    uint32_t sketch_width;
+    uint32_t top_k;
+    // one in sample_rate finds of each reader handle is counted
+    uint32_t sample_rate;
+    // Pid of the process updating the top-K heap; zero if unlocked.
+    // Updates are skipped if it is locked by another live process.
+    std::atomic<uint32_t> heap_lock;
+    uint32_t num_heap_entry;
+    std::atomic<uint64_t> num_sample;
+} HotKeyHeader;
+
+// Keys longer than MB_HOT_KEY_MAX_LEN are identified by the hash and the
+// first MB_HOT_KEY_MAX_LEN bytes.
+typedef struct _HotKeyEntry
+{
+    uint64_t count;
+    uint32_t hash;
+    uint16_t key_len;
+    uint16_t reserved;
+    uint8_t  key[MB_HOT_KEY_MAX_LEN];
+} HotKeyEntry;
+
+// Sampled count-min sketch of the keys looked up by readers and a min-heap
+// of the MB_HOT_KEY_TOP_K keys with the highest estimated counts. Both are
+// in a shared memory file next to the DB header created by writer so that
+// reader handles in all processes contribute to the same counts.
+class HotKeys
+{
+public:
+    HotKeys(const std::string &hot_keys_path, int mode, uint32_t sample_rate);
+    ~HotKeys();
+
+    int  Status() const;
+    // Called by readers on every find
+    inline void Sample(const uint8_t *key, int len)
+    {
+        if(++num_find < header->sample_rate)
+            return;
+        num_find = 0;
+        Add(key, len);
+    }
+    // Hot keys in descending order of the estimated find count
+    void Get(std::vector<HotKey> &hot_keys) const;
+
+private:
+    void Add(const uint8_t *key, int len);
+    bool TryLockHeap() const;
+    void UpdateHeap(uint32_t hash, const uint8_t *key, int len, uint64_t count);
+    void SiftDown(int index);
+    void SiftUp(int index);
+
+    std::shared_ptr<MmapFileIO> hot_keys_file;
+    HotKeyHeader *header;
+    std::atomic<uint32_t> *sketch;
+    HotKeyEntry *heap;
+    // finds since the last sample by this handle
+    uint32_t num_find;
+    int status;
+};
+
+}
+
+#endif
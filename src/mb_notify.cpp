@@ -0,0 +1,238 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "mb_notify.h"
+#include "dict.h"
+#include "rollable_file.h"
+#include "resource_pool.h"
+#include "mabain_consts.h"
+#include "error.h"
+#include "logger.h"
+
+namespace mabain {
+
+static inline int64_t notify_now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+ChangeRing::ChangeRing(const std::string &ring_path, int mode)
+                     : ring_header(NULL),
+                       slots(NULL),
+                       status(MBError::NOT_INITIALIZED)
+{
+    size_t ring_size = RollableFile::page_size +
+                       static_cast<size_t>(MB_NOTIFY_NUM_SLOTS) * sizeof(ChangeSlot);
+    bool writer = (mode & CONSTS::ACCESS_MODE_WRITER);
+    // Anonymous memory-only DB is looked up in the resource pool.
+    bool anon_mode = (mode & CONSTS::MEMORY_ONLY_MODE) &&
+                     !(mode & CONSTS::SHARED_MEMORY_MODE);
+    bool new_ring;
+    if(mode & CONSTS::SHARED_MEMORY_MODE)
+        new_ring = !FileIO::ShmExists(ring_path);
+    else
+        new_ring = (access(ring_path.c_str(), F_OK) != 0);
+    if(!writer && new_ring && !anon_mode)
+    {
+        status = MBError::NOT_EXIST;
+        return;
+    }
+
+    bool map_file = true;
+    ring_file = ResourcePool::getInstance().OpenFile(ring_path, mode, ring_size,
+                                                     map_file, writer);
+    if(!map_file || ring_file->GetMapAddr() == NULL)
+    {
+        Logger::Log(LOG_LEVEL_WARN, "failed to map change ring %s", ring_path.c_str());
+        ring_file = NULL;
+        status = MBError::MMAP_FAILED;
+        return;
+    }
+
+    ring_header = reinterpret_cast<ChangeRingHeader *>(ring_file->GetMapAddr());
+    slots = ring_file->GetMapAddr() + RollableFile::page_size;
+    if(writer && (ring_header->num_slots != MB_NOTIFY_NUM_SLOTS ||
+                  ring_header->slot_size != sizeof(ChangeSlot)))
+    {
+        memset(ring_file->GetMapAddr(), 0, ring_size);
+        ring_header->num_slots = MB_NOTIFY_NUM_SLOTS;
+        ring_header->slot_size = sizeof(ChangeSlot);
+    }
+    else if(ring_header->num_slots != MB_NOTIFY_NUM_SLOTS)
+    {
+        // Writer has not initialized the ring.
+        ring_header = NULL;
+        status = MBError::NOT_EXIST;
+        return;
+    }
+    status = MBError::SUCCESS;
+}
+
+ChangeRing::~ChangeRing()
+{
+}
+
+int ChangeRing::Status() const
+{
+    return status;
+}
+
+inline ChangeSlot* ChangeRing::GetSlot(uint64_t seq) const
+{
+    return reinterpret_cast<ChangeSlot *>(slots + (seq % MB_NOTIFY_NUM_SLOTS) *
+                                          sizeof(ChangeSlot));
+}
+
+void ChangeRing::Publish(int op, const uint8_t *key, int key_len)
+{
+    uint64_t seq = ring_header->write_seq.load(std::memory_order_relaxed) + 1;
+    ChangeSlot *slot = GetSlot(seq);
+
+    // Invalidate the slot before overwriting it.
+    slot->seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    if(key_len > MB_NOTIFY_MAX_KEY)
+        key_len = MB_NOTIFY_MAX_KEY;
+    slot->op = static_cast<uint8_t>(op);
+    slot->key_len = static_cast<uint16_t>(key_len);
+    if(key_len > 0)
+        memcpy(slot->key, key, key_len);
+    slot->seq.store(seq, std::memory_order_release);
+    ring_header->write_seq.store(seq, std::memory_order_release);
+
+    ring_header->futex_word.fetch_add(1);
+    if(ring_header->num_waiters.load() > 0)
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&ring_header->futex_word),
+                FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+int ChangeRing::Read(uint64_t seq, ChangeRecord &rec) const
+{
+    const ChangeSlot *slot = GetSlot(seq);
+    if(slot->seq.load(std::memory_order_acquire) != seq)
+        return MBError::BUFFER_LOST;
+
+    rec.seq = seq;
+    rec.op = slot->op;
+    int key_len = slot->key_len;
+    if(key_len > MB_NOTIFY_MAX_KEY)
+        key_len = MB_NOTIFY_MAX_KEY;
+    rec.key.assign(reinterpret_cast<const char *>(slot->key), key_len);
+
+    // Check if writer overwrote the slot while it was copied.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(slot->seq.load(std::memory_order_relaxed) != seq)
+        return MBError::BUFFER_LOST;
+    return MBError::SUCCESS;
+}
+
+uint64_t ChangeRing::LastSeq() const
+{
+    return ring_header->write_seq.load(std::memory_order_acquire);
+}
+
+uint32_t ChangeRing::NumSlots() const
+{
+    return MB_NOTIFY_NUM_SLOTS;
+}
+
+void ChangeRing::Wait(uint64_t seq, int timeout_ms) const
+{
+    uint32_t val = ring_header->futex_word.load();
+    if(LastSeq() >= seq || timeout_ms <= 0)
+        return;
+
+    // Writer bumps futex_word before checking num_waiters so that the
+    // wakeup is not lost if the record is published right now.
+    struct timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    ring_header->num_waiters.fetch_add(1);
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&ring_header->futex_word),
+            FUTEX_WAIT, val, &ts, NULL, 0);
+    ring_header->num_waiters.fetch_sub(1);
+}
+
+ChangeFeed::ChangeFeed(const DB &db) : ring(NULL),
+                                       next_seq(0),
+                                       status(MBError::NOT_EXIST)
+{
+    if(db.dict == NULL)
+    {
+        status = MBError::NOT_INITIALIZED;
+        return;
+    }
+    ring = db.dict->GetChangeRing();
+    if(ring == NULL)
+        return;
+    next_seq = ring->LastSeq() + 1;
+    status = MBError::SUCCESS;
+}
+
+ChangeFeed::~ChangeFeed()
+{
+}
+
+int ChangeFeed::Status() const
+{
+    return status;
+}
+
+uint64_t ChangeFeed::GetSeq() const
+{
+    return next_seq - 1;
+}
+
+int ChangeFeed::Next(ChangeRecord &rec, int timeout_ms)
+{
+    if(status != MBError::SUCCESS)
+        return status;
+
+    int64_t deadline = notify_now_ms() + timeout_ms;
+    while(true)
+    {
+        uint64_t last_seq = ring->LastSeq();
+        if(next_seq <= last_seq)
+        {
+            int rval = MBError::BUFFER_LOST;
+            if(last_seq - next_seq < ring->NumSlots())
+                rval = ring->Read(next_seq, rec);
+            if(rval == MBError::SUCCESS)
+                next_seq++;
+            else
+                next_seq = ring->LastSeq() + 1;
+            return rval;
+        }
+
+        int64_t remaining = deadline - notify_now_ms();
+        if(remaining <= 0)
+            return MBError::TRY_AGAIN;
+        ring->Wait(next_seq, static_cast<int>(remaining));
+    }
+}
+
+}
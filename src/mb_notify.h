@@ -0,0 +1,120 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __MB_NOTIFY_H__
+#define __MB_NOTIFY_H__
+
+#include <stdint.h>
+#include <string>
+#include <memory>
+#include <atomic>
+
+#include "db.h"
+#include "mmap_file.h"
+#include "mb_repl.h"
+
+namespace mabain {
+
+#define MB_NOTIFY_NUM_SLOTS     4096
+#define MB_NOTIFY_MAX_KEY       256
+
+typedef struct _ChangeRingHeader
+{
+    // sequence number of the last published record
+    std::atomic<uint64_t> write_seq;
+    // incremented for every record; readers wait on it using futex
+    std::atomic<uint32_t> futex_word;
+    std::atomic<uint32_t> num_waiters;
+    uint32_t num_slots;
+    uint32_t slot_size;
+} ChangeRingHeader;
+
+// A slot is valid only if seq does not change while reading it.
+typedef struct _ChangeSlot
+{
+    std::atomic<uint64_t> seq;
+    uint8_t  op;
+    uint8_t  reserved;
+    uint16_t key_len;
+    uint32_t reserved2;
+    uint8_t  key[MB_NOTIFY_MAX_KEY];
+} ChangeSlot;
+
+typedef struct _ChangeRecord
+{
+    uint64_t seq;
+    // MB_REPL_OP_ADD, MB_REPL_OP_REMOVE or MB_REPL_OP_REMOVE_ALL
+    int op;
+    std::string key;
+} ChangeRecord;
+
+// Ring of the keys changed by writer in a shared memory file next to
+// the DB header. Writer overwrites the oldest slot without waiting for
+// readers. Readers sleep on a futex in the ring header until writer
+// publishes new records.
+class ChangeRing
+{
+public:
+    ChangeRing(const std::string &ring_path, int mode);
+    ~ChangeRing();
+
+    int  Status() const;
+    // Called by writer only
+    void Publish(int op, const uint8_t *key, int key_len);
+    // Read the record with seq. Return BUFFER_LOST if it was overwritten.
+    int  Read(uint64_t seq, ChangeRecord &rec) const;
+    uint64_t LastSeq() const;
+    uint32_t NumSlots() const;
+    // Wait at most timeout_ms for the record with seq to be published.
+    void Wait(uint64_t seq, int timeout_ms) const;
+
+private:
+    inline ChangeSlot* GetSlot(uint64_t seq) const;
+
+    std::shared_ptr<MmapFileIO> ring_file;
+    ChangeRingHeader *ring_header;
+    uint8_t *slots;
+    int status;
+};
+
+// Reader cursor over the change ring of a DB. Only changes published
+// after the feed is created are returned.
+class ChangeFeed
+{
+public:
+    ChangeFeed(const DB &db);
+    ~ChangeFeed();
+
+    // NOT_EXIST if writer did not enable CONSTS::CHANGE_NOTIFY
+    int  Status() const;
+    // Get the next change, waiting at most timeout_ms. Return SUCCESS,
+    // TRY_AGAIN on timeout, or BUFFER_LOST if writer overwrote records
+    // not read yet. The feed then continues from the latest change.
+    int  Next(ChangeRecord &rec, int timeout_ms);
+    // sequence number of the last change returned
+    uint64_t GetSeq() const;
+
+private:
+    ChangeRing *ring;
+    uint64_t next_seq;
+    int status;
+};
+
+}
+
+#endif
@@ -22,6 +22,7 @@
 #include "dict.h"
 #include "dict_mem.h"
 #include "integer_4b_5b.h"
+#include "mb_stats.h"
 
 #define MAX_PRUNE_COUNT      3                 // maximum lru eviction attempts
 #define NUM_ASYNC_TASK       10                // number of other tasks to be checked during eviction
@@ -68,7 +69,8 @@ int ResourceCollection::LRUEviction()
     if(prune_diff == 0)
         prune_diff = 1;
 
-    for(DB::iterator iter = db_ref.begin(false); iter != db_ref.end(); ++iter)
+    // Expired entries are evicted as well.
+    for(DB::iterator iter = db_ref.begin(false, false, true); iter != db_ref.end(); ++iter)
     {
         if(CIRCULAR_PRUNE_DIFF(iter.value.bucket_index, header->eviction_bucket_index) < prune_diff)
         {
@@ -118,6 +120,9 @@ void ResourceCollection::ReclaimResource(int64_t min_index_size,
 {
     if(!db_ref.is_open())
         throw db_ref.Status();
+    // Buffers cannot be moved while a snapshot is being copied.
+    if(dict->SnapshotActive() || dmm->SnapshotActive())
+        throw (int) MBError::RC_SKIPPED;
 
     async_writer_ptr = awr;
     timeval start, stop;
@@ -155,11 +160,15 @@ void ResourceCollection::ReclaimResource(int64_t min_index_size,
                 rc_type & RESOURCE_COLLECTION_TYPE_INDEX ? "yes":"no",
                 rc_type & RESOURCE_COLLECTION_TYPE_DATA ? " yes":"no");
         gettimeofday(&start, NULL);
+        OpStats *op_stats = dict->GetOpStats();
+        uint64_t start_ns = (op_stats != NULL) ? OpStats::Now() : 0;
 
         ReorderBuffers();
         CollectBuffers();
         Finish();
 
+        if(op_stats != NULL)
+            op_stats->Record(MB_STATS_OP_RC, start_ns);
         gettimeofday(&stop, NULL);
         async_writer_ptr = NULL;
         timediff = (stop.tv_sec - start.tv_sec)*1000000 + (stop.tv_usec - start.tv_usec);
@@ -314,8 +323,12 @@ void ResourceCollection::Finish()
     dmm->RemoveUnused(header->m_index_offset, true);
 }
 
-bool ResourceCollection::MoveIndexBuffer(int phase, size_t &offset_src, int size)
+bool ResourceCollection::MoveIndexBuffer(int phase, size_t &offset_src, int size,
+                                         bool is_node)
 {
+    // Nodes of the aligned index format must be moved to aligned offsets.
+    if(is_node)
+        index_size = dmm->AlignNodeOffset(index_size);
     index_size = dmm->CheckAlignment(index_size, size);
 
     if(index_size == offset_src)
@@ -332,6 +345,8 @@ bool ResourceCollection::MoveIndexBuffer(int phase, size_t &offset_src, int size
             return false;
 
         offset_dst = header->m_index_offset;
+        if(is_node)
+            offset_dst = dmm->AlignNodeOffset(offset_dst);
         rval = dmm->Reserve(offset_dst, size, ptr_dst);
         if(rval != MBError::SUCCESS)
             throw rval;
@@ -411,15 +426,15 @@ void ResourceCollection::DoTask(int phase, DBTraverseNode &dbt_node)
     {
         if(dbt_node.buffer_type & BUFFER_TYPE_NODE)
         {
-            if(MoveIndexBuffer(phase, dbt_node.node_offset, dbt_node.node_size))
+            if(MoveIndexBuffer(phase, dbt_node.node_offset, dbt_node.node_size, true))
             {
-                Write6BInteger(header->excep_buff, dbt_node.node_offset);
+                dmm->WriteLink(header->excep_buff, dbt_node.node_offset);
 #ifdef __LOCK_FREE__
                 lfree->WriterLockFreeStart(dbt_node.edge_offset);
 #endif
                 header->excep_offset = dbt_node.node_link_offset;
                 header->excep_updating_status = EXCEP_STATUS_RC_NODE;
-                dmm->WriteData(header->excep_buff, OFFSET_SIZE, dbt_node.node_link_offset);
+                dmm->WriteData(header->excep_buff, dmm->GetLinkSize(), dbt_node.node_link_offset);
                 header->excep_updating_status = 0;
 #ifdef __LOCK_FREE__
                 lfree->WriterLockFreeStop();
@@ -433,15 +448,16 @@ void ResourceCollection::DoTask(int phase, DBTraverseNode &dbt_node)
 
         if(dbt_node.buffer_type & BUFFER_TYPE_EDGE_STR)
         {
-            if(MoveIndexBuffer(phase, dbt_node.edgestr_offset, dbt_node.edgestr_size))
+            if(MoveIndexBuffer(phase, dbt_node.edgestr_offset, dbt_node.edgestr_size, false))
             {
-                Write5BInteger(header->excep_buff, dbt_node.edgestr_offset);
+                dmm->WriteEdgeStrLink(header->excep_buff, dbt_node.edgestr_offset);
 #ifdef __LOCK_FREE__
                 lfree->WriterLockFreeStart(dbt_node.edge_offset);
 #endif
                 header->excep_offset = dbt_node.edgestr_link_offset;
                 header->excep_updating_status = EXCEP_STATUS_RC_EDGE_STR;
-                dmm->WriteData(header->excep_buff, OFFSET_SIZE-1, dbt_node.edgestr_link_offset);
+                dmm->WriteData(header->excep_buff, dmm->GetEdgeStrLinkSize(),
+                               dbt_node.edgestr_link_offset);
                 header->excep_updating_status = 0;
 #ifdef __LOCK_FREE__
                 lfree->WriterLockFreeStop();
@@ -457,13 +473,23 @@ void ResourceCollection::DoTask(int phase, DBTraverseNode &dbt_node)
         {
             if(MoveDataBuffer(phase, dbt_node.data_offset, dbt_node.data_size))
             {
-                Write6BInteger(header->excep_buff, dbt_node.data_offset);
+                // Node headers keep 6-byte data offsets in all index formats.
+                int link_size = OFFSET_SIZE;
+                if(dbt_node.buffer_type & BUFFER_TYPE_NODE)
+                {
+                    Write6BInteger(header->excep_buff, dbt_node.data_offset);
+                }
+                else
+                {
+                    dmm->WriteLink(header->excep_buff, dbt_node.data_offset);
+                    link_size = dmm->GetLinkSize();
+                }
 #ifdef __LOCK_FREE__
                 lfree->WriterLockFreeStart(dbt_node.edge_offset);
 #endif
                 header->excep_offset = dbt_node.data_link_offset;;
                 header->excep_updating_status = EXCEP_STATUS_RC_DATA;
-                dmm->WriteData(header->excep_buff, OFFSET_SIZE, dbt_node.data_link_offset);
+                dmm->WriteData(header->excep_buff, link_size, dbt_node.data_link_offset);
                 header->excep_updating_status = 0;
 #ifdef __LOCK_FREE__
                 lfree->WriterLockFreeStop();
@@ -531,7 +557,8 @@ void ResourceCollection::ProcessRCTree()
     int rval;
     for(DB::iterator iter = db_ref.begin(false, true); iter != db_ref.end(); ++iter)
     {
-        iter.value.options = 0;
+        // Entries in the rc tree were logged for followers when added.
+        iter.value.options = CONSTS::OPTION_SKIP_REPL_LOG;
         rval = dict->Add((const uint8_t *)iter.key.data(), iter.key.size(), iter.value, true);
         if(rval != MBError::SUCCESS)
             Logger::Log(LOG_LEVEL_WARN, "failed to add: %s", MBError::get_error_str(rval));
@@ -54,7 +54,7 @@ private:
     void CollectBuffers();
     void ReorderBuffers();
     void Finish();
-    bool MoveIndexBuffer(int phase, size_t &offset_src, int size);
+    bool MoveIndexBuffer(int phase, size_t &offset_src, int size, bool is_node);
     bool MoveDataBuffer(int phase, size_t &offset_src, int size);
     int  LRUEviction();
     void ProcessRCTree();
@@ -0,0 +1,733 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "mb_repl.h"
+#include "mabain_consts.h"
+#include "error.h"
+#include "logger.h"
+
+#define MB_REPL_POLL_MS     100
+
+namespace mabain {
+
+static int repl_socket_addr(const std::string &endpoint, struct sockaddr_storage &addr,
+                            socklen_t &addr_len)
+{
+    memset(&addr, 0, sizeof(addr));
+    if(!endpoint.empty() && endpoint[0] == '/')
+    {
+        struct sockaddr_un *un_addr = reinterpret_cast<struct sockaddr_un *>(&addr);
+        if(endpoint.size() >= sizeof(un_addr->sun_path))
+            return MBError::INVALID_ARG;
+        un_addr->sun_family = AF_UNIX;
+        memcpy(un_addr->sun_path, endpoint.c_str(), endpoint.size() + 1);
+        addr_len = sizeof(struct sockaddr_un);
+        return MBError::SUCCESS;
+    }
+
+    size_t pos = endpoint.rfind(':');
+    if(pos == std::string::npos)
+        return MBError::INVALID_ARG;
+    std::string host = endpoint.substr(0, pos);
+    std::string port = endpoint.substr(pos + 1);
+
+    struct addrinfo hints;
+    struct addrinfo *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if(getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &res) != 0)
+        return MBError::INVALID_ARG;
+    memcpy(&addr, res->ai_addr, res->ai_addrlen);
+    addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return MBError::SUCCESS;
+}
+
+static int repl_send_all(int fd, const uint8_t *buff, size_t len)
+{
+    while(len > 0)
+    {
+        ssize_t nbytes = send(fd, buff, len, MSG_NOSIGNAL);
+        if(nbytes < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return MBError::NETWORK_ERROR;
+        }
+        buff += nbytes;
+        len -= nbytes;
+    }
+    return MBError::SUCCESS;
+}
+
+static void repl_set_nodelay(int fd, const struct sockaddr_storage &addr)
+{
+    if(addr.ss_family == AF_UNIX)
+        return;
+    int flag = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+}
+
+////////////////////////////////////////////////////////////////
+// ReplicationLog
+////////////////////////////////////////////////////////////////
+
+ReplicationLog::ReplicationLog(uint64_t next_seq, size_t max_size)
+                             : first_seq(next_seq),
+                               log_size(0),
+                               max_log_size(max_size),
+                               stopped(false)
+{
+    if(pthread_mutex_init(&mutex, NULL) != 0 ||
+       pthread_cond_init(&cond, NULL) != 0)
+    {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to init replication log mutex");
+        throw (int) MBError::MUTEX_ERROR;
+    }
+}
+
+ReplicationLog::~ReplicationLog()
+{
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&cond);
+}
+
+void ReplicationLog::Append(uint64_t seq, int op, const uint8_t *key, int key_len,
+                            const uint8_t *data, int data_len, uint32_t expire_time)
+{
+    std::string record(MB_REPL_RECORD_HDR_SIZE + key_len + data_len, 0);
+    uint8_t *ptr = reinterpret_cast<uint8_t *>(&record[0]);
+    uint16_t klen = static_cast<uint16_t>(key_len);
+    uint32_t dlen = static_cast<uint32_t>(data_len);
+    memcpy(ptr, &seq, 8);
+    ptr[8] = static_cast<uint8_t>(op);
+    memcpy(ptr + 10, &klen, 2);
+    memcpy(ptr + 12, &dlen, 4);
+    memcpy(ptr + 16, &expire_time, 4);
+    if(key_len > 0)
+        memcpy(ptr + MB_REPL_RECORD_HDR_SIZE, key, key_len);
+    if(data_len > 0)
+        memcpy(ptr + MB_REPL_RECORD_HDR_SIZE + key_len, data, data_len);
+
+    pthread_mutex_lock(&mutex);
+    if(seq != first_seq + records.size())
+    {
+        // Followers behind the gap have to be resynced.
+        Logger::Log(LOG_LEVEL_WARN, "replication log reset at sequence %llu", seq);
+        records.clear();
+        log_size = 0;
+        first_seq = seq;
+    }
+    log_size += record.size();
+    records.push_back(std::move(record));
+    while(log_size > max_log_size && records.size() > 1)
+    {
+        log_size -= records.front().size();
+        records.pop_front();
+        first_seq++;
+    }
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+int ReplicationLog::Read(uint64_t seq, std::string &batch, int &num_records, int timeout_ms)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if(deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    num_records = 0;
+    pthread_mutex_lock(&mutex);
+    while(!stopped && seq >= first_seq + records.size())
+    {
+        if(pthread_cond_timedwait(&cond, &mutex, &deadline) == ETIMEDOUT)
+            break;
+    }
+
+    int rval = MBError::SUCCESS;
+    if(stopped)
+    {
+        rval = MBError::DB_CLOSED;
+    }
+    else if(seq < first_seq)
+    {
+        rval = MBError::NOT_EXIST;
+    }
+    else if(seq >= first_seq + records.size())
+    {
+        rval = MBError::TRY_AGAIN;
+    }
+    else
+    {
+        size_t start = batch.size();
+        for(size_t i = seq - first_seq; i < records.size(); i++)
+        {
+            if(num_records > 0 &&
+               batch.size() - start + records[i].size() > MB_REPL_BATCH_SIZE)
+                break;
+            batch.append(records[i]);
+            num_records++;
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+    return rval;
+}
+
+int ReplicationLog::CheckSeq(uint64_t seq)
+{
+    int rval = MBError::SUCCESS;
+    pthread_mutex_lock(&mutex);
+    if(seq < first_seq)
+        rval = MBError::NOT_EXIST;
+    else if(seq > first_seq + records.size())
+        rval = MBError::INVALID_ARG;
+    pthread_mutex_unlock(&mutex);
+    return rval;
+}
+
+uint64_t ReplicationLog::NextSeq()
+{
+    pthread_mutex_lock(&mutex);
+    uint64_t seq = first_seq + records.size();
+    pthread_mutex_unlock(&mutex);
+    return seq;
+}
+
+void ReplicationLog::Stop()
+{
+    pthread_mutex_lock(&mutex);
+    stopped = true;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+////////////////////////////////////////////////////////////////
+// ReplicationMaster
+////////////////////////////////////////////////////////////////
+
+ReplicationMaster::ReplicationMaster(const std::string &ep, uint64_t next_seq,
+                                     size_t max_log_size)
+                                   : endpoint(ep),
+                                     log(next_seq, max_log_size),
+                                     listen_fd(-1),
+                                     stop_flag(false),
+                                     accept_running(false)
+{
+    if(pthread_mutex_init(&mutex, NULL) != 0)
+    {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to init replication mutex");
+        throw (int) MBError::MUTEX_ERROR;
+    }
+}
+
+ReplicationMaster::~ReplicationMaster()
+{
+    Stop();
+    pthread_mutex_destroy(&mutex);
+}
+
+int ReplicationMaster::Start()
+{
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    int rval = repl_socket_addr(endpoint, addr, addr_len);
+    if(rval != MBError::SUCCESS)
+        return rval;
+
+    listen_fd = socket(addr.ss_family, SOCK_STREAM, 0);
+    if(listen_fd < 0)
+        return MBError::NETWORK_ERROR;
+    if(addr.ss_family == AF_UNIX)
+    {
+        unlink(endpoint.c_str());
+    }
+    else
+    {
+        int flag = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+    }
+    if(bind(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), addr_len) != 0 ||
+       listen(listen_fd, 16) != 0)
+    {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to listen on %s: %s", endpoint.c_str(),
+                    strerror(errno));
+        close(listen_fd);
+        listen_fd = -1;
+        return MBError::NETWORK_ERROR;
+    }
+
+    if(pthread_create(&accept_tid, NULL, AcceptThread, this) != 0)
+    {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to create replication thread");
+        close(listen_fd);
+        listen_fd = -1;
+        return MBError::THREAD_FAILED;
+    }
+    accept_running = true;
+    Logger::Log(LOG_LEVEL_INFO, "replication started on %s from sequence %llu",
+                endpoint.c_str(), log.NextSeq());
+    return MBError::SUCCESS;
+}
+
+void ReplicationMaster::Stop()
+{
+    stop_flag = true;
+    log.Stop();
+    if(accept_running)
+    {
+        pthread_join(accept_tid, NULL);
+        accept_running = false;
+    }
+
+    // Unblock senders waiting on slow followers.
+    pthread_mutex_lock(&mutex);
+    for(std::list<ReplFollowerConn*>::iterator it = followers.begin();
+        it != followers.end(); ++it)
+        shutdown((*it)->fd, SHUT_RDWR);
+    pthread_mutex_unlock(&mutex);
+    JoinFollowers(true);
+
+    if(listen_fd >= 0)
+    {
+        close(listen_fd);
+        listen_fd = -1;
+        if(!endpoint.empty() && endpoint[0] == '/')
+            unlink(endpoint.c_str());
+    }
+}
+
+ReplicationLog* ReplicationMaster::GetLog()
+{
+    return &log;
+}
+
+int ReplicationMaster::NumFollowers()
+{
+    int count = 0;
+    pthread_mutex_lock(&mutex);
+    for(std::list<ReplFollowerConn*>::iterator it = followers.begin();
+        it != followers.end(); ++it)
+    {
+        if(!(*it)->done)
+            count++;
+    }
+    pthread_mutex_unlock(&mutex);
+    return count;
+}
+
+void* ReplicationMaster::AcceptThread(void *context)
+{
+    static_cast<ReplicationMaster *>(context)->AcceptFollowers();
+    return NULL;
+}
+
+void* ReplicationMaster::SenderThread(void *context)
+{
+    ReplFollowerConn *conn = static_cast<ReplFollowerConn *>(context);
+    conn->master->SendRecords(conn);
+    conn->done = true;
+    return NULL;
+}
+
+// Join sender threads that are done, or all of them if all is true.
+void ReplicationMaster::JoinFollowers(bool all)
+{
+    std::list<ReplFollowerConn*> finished;
+    pthread_mutex_lock(&mutex);
+    for(std::list<ReplFollowerConn*>::iterator it = followers.begin();
+        it != followers.end(); )
+    {
+        if(all || (*it)->done)
+        {
+            finished.push_back(*it);
+            it = followers.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+
+    for(std::list<ReplFollowerConn*>::iterator it = finished.begin();
+        it != finished.end(); ++it)
+    {
+        pthread_join((*it)->tid, NULL);
+        close((*it)->fd);
+        delete *it;
+    }
+}
+
+void ReplicationMaster::AcceptFollowers()
+{
+    struct pollfd pfd;
+    pfd.fd = listen_fd;
+    pfd.events = POLLIN;
+
+    while(!stop_flag)
+    {
+        JoinFollowers(false);
+        pfd.revents = 0;
+        if(poll(&pfd, 1, MB_REPL_POLL_MS) <= 0)
+            continue;
+
+        struct sockaddr_storage addr;
+        socklen_t addr_len = sizeof(addr);
+        int fd = accept(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), &addr_len);
+        if(fd < 0)
+            continue;
+        repl_set_nodelay(fd, addr);
+
+        ReplFollowerConn *conn = new ReplFollowerConn();
+        conn->master = this;
+        conn->fd = fd;
+        conn->done = false;
+        pthread_mutex_lock(&mutex);
+        followers.push_back(conn);
+        if(pthread_create(&conn->tid, NULL, SenderThread, conn) != 0)
+        {
+            Logger::Log(LOG_LEVEL_ERROR, "failed to create replication sender thread");
+            followers.pop_back();
+            close(fd);
+            delete conn;
+        }
+        pthread_mutex_unlock(&mutex);
+    }
+}
+
+void ReplicationMaster::SendRecords(ReplFollowerConn *conn)
+{
+    uint8_t handshake[MB_REPL_HANDSHAKE_SIZE];
+    uint32_t magic;
+    uint32_t version;
+    uint64_t seq;
+
+    struct timeval tv;
+    tv.tv_sec = MB_REPL_TIMEOUT_MS / 1000;
+    tv.tv_usec = 0;
+    setsockopt(conn->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if(recv(conn->fd, handshake, sizeof(handshake), MSG_WAITALL) != sizeof(handshake))
+        return;
+    memcpy(&magic, handshake, 4);
+    memcpy(&version, handshake + 4, 4);
+    memcpy(&seq, handshake + 8, 8);
+
+    int32_t status;
+    if(magic != MB_REPL_MAGIC || version != MB_REPL_VERSION)
+        status = MBError::INVALID_ARG;
+    else
+        status = log.CheckSeq(seq);
+    uint64_t next_seq = log.NextSeq();
+    magic = MB_REPL_MAGIC;
+    memcpy(handshake, &magic, 4);
+    memcpy(handshake + 4, &status, 4);
+    memcpy(handshake + 8, &next_seq, 8);
+    if(repl_send_all(conn->fd, handshake, sizeof(handshake)) != MBError::SUCCESS ||
+       status != MBError::SUCCESS)
+    {
+        Logger::Log(LOG_LEVEL_WARN, "rejected follower from sequence %llu: %s", seq,
+                    MBError::get_error_str(status));
+        return;
+    }
+    Logger::Log(LOG_LEVEL_INFO, "follower connected from sequence %llu", seq);
+
+    std::string batch;
+    int num_records;
+    int rval;
+    while(!stop_flag)
+    {
+        // Batch header is filled after the records are copied.
+        batch.assign(MB_REPL_BATCH_HDR_SIZE, 0);
+        rval = log.Read(seq, batch, num_records, MB_REPL_HEARTBEAT_MS);
+        if(rval == MBError::DB_CLOSED)
+            break;
+        if(rval == MBError::NOT_EXIST)
+        {
+            Logger::Log(LOG_LEVEL_WARN, "follower fell behind replication log at %llu", seq);
+            break;
+        }
+
+        // An empty batch is sent as heartbeat.
+        uint32_t nrec = static_cast<uint32_t>(num_records);
+        uint32_t size = static_cast<uint32_t>(batch.size() - MB_REPL_BATCH_HDR_SIZE);
+        memcpy(&batch[0], &nrec, 4);
+        memcpy(&batch[4], &size, 4);
+        if(repl_send_all(conn->fd, reinterpret_cast<const uint8_t *>(batch.data()),
+                         batch.size()) != MBError::SUCCESS)
+            break;
+        seq += num_records;
+    }
+    Logger::Log(LOG_LEVEL_INFO, "follower disconnected at sequence %llu", seq);
+}
+
+////////////////////////////////////////////////////////////////
+// ReplicationFollower
+////////////////////////////////////////////////////////////////
+
+ReplicationFollower::ReplicationFollower(DB &db, const std::string &ep)
+                                       : dict(NULL),
+                                         header(NULL),
+                                         endpoint(ep),
+                                         fd(-1),
+                                         stop_flag(false)
+{
+    // Records are applied by the caller thread.
+    if(db.is_open() && !db.AsyncWriterEnabled())
+        dict = db.GetDictPtr();
+    if(dict != NULL)
+        header = dict->GetHeaderPtr();
+}
+
+ReplicationFollower::~ReplicationFollower()
+{
+    if(fd >= 0)
+        close(fd);
+}
+
+void ReplicationFollower::Stop()
+{
+    stop_flag = true;
+}
+
+uint64_t ReplicationFollower::GetSeq() const
+{
+    if(header == NULL)
+        return 0;
+    return header->repl_seq;
+}
+
+int ReplicationFollower::Connect()
+{
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    int rval = repl_socket_addr(endpoint, addr, addr_len);
+    if(rval != MBError::SUCCESS)
+        return rval;
+
+    fd = socket(addr.ss_family, SOCK_STREAM, 0);
+    if(fd < 0)
+        return MBError::NETWORK_ERROR;
+    if(connect(fd, reinterpret_cast<struct sockaddr *>(&addr), addr_len) != 0)
+    {
+        Logger::Log(LOG_LEVEL_DEBUG, "failed to connect to %s: %s", endpoint.c_str(),
+                    strerror(errno));
+        close(fd);
+        fd = -1;
+        return MBError::NETWORK_ERROR;
+    }
+    repl_set_nodelay(fd, addr);
+    return MBError::SUCCESS;
+}
+
+// Receive len bytes. Stop is checked while waiting.
+int ReplicationFollower::RecvAll(uint8_t *buff, size_t len, int timeout_ms)
+{
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    int waited = 0;
+
+    while(len > 0)
+    {
+        if(stop_flag)
+            return MBError::DB_CLOSED;
+        pfd.revents = 0;
+        int ret = poll(&pfd, 1, MB_REPL_POLL_MS);
+        if(ret == 0)
+        {
+            waited += MB_REPL_POLL_MS;
+            if(waited >= timeout_ms)
+                return MBError::NETWORK_ERROR;
+            continue;
+        }
+        if(ret < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return MBError::NETWORK_ERROR;
+        }
+
+        ssize_t nbytes = recv(fd, buff, len, 0);
+        if(nbytes <= 0)
+        {
+            if(nbytes < 0 && (errno == EINTR || errno == EAGAIN))
+                continue;
+            return MBError::NETWORK_ERROR;
+        }
+        buff += nbytes;
+        len -= nbytes;
+        waited = 0;
+    }
+    return MBError::SUCCESS;
+}
+
+int ReplicationFollower::Run()
+{
+    if(dict == NULL)
+        return MBError::NOT_ALLOWED;
+
+    int rval = Connect();
+    if(rval != MBError::SUCCESS)
+        return rval;
+
+    uint8_t handshake[MB_REPL_HANDSHAKE_SIZE];
+    uint32_t magic = MB_REPL_MAGIC;
+    uint32_t version = MB_REPL_VERSION;
+    uint64_t seq = header->repl_seq + 1;
+    memcpy(handshake, &magic, 4);
+    memcpy(handshake + 4, &version, 4);
+    memcpy(handshake + 8, &seq, 8);
+    rval = repl_send_all(fd, handshake, sizeof(handshake));
+    if(rval == MBError::SUCCESS)
+        rval = RecvAll(handshake, sizeof(handshake), MB_REPL_TIMEOUT_MS);
+    if(rval == MBError::SUCCESS)
+    {
+        int32_t status;
+        memcpy(&magic, handshake, 4);
+        memcpy(&status, handshake + 4, 4);
+        memcpy(&seq, handshake + 8, 8);
+        if(magic != MB_REPL_MAGIC)
+            rval = MBError::NETWORK_ERROR;
+        else
+            rval = status;
+        if(rval != MBError::SUCCESS)
+            Logger::Log(LOG_LEVEL_WARN, "master at sequence %llu rejected follower "
+                        "at sequence %llu: %s", seq, header->repl_seq,
+                        MBError::get_error_str(rval));
+    }
+
+    uint8_t batch_hdr[MB_REPL_BATCH_HDR_SIZE];
+    std::string buff;
+    while(rval == MBError::SUCCESS)
+    {
+        rval = RecvAll(batch_hdr, sizeof(batch_hdr), MB_REPL_TIMEOUT_MS);
+        if(rval != MBError::SUCCESS)
+            break;
+
+        uint32_t num_records;
+        uint32_t size;
+        memcpy(&num_records, batch_hdr, 4);
+        memcpy(&size, batch_hdr + 4, 4);
+        if(size > static_cast<uint32_t>(MB_REPL_BATCH_SIZE + MB_REPL_RECORD_HDR_SIZE +
+                                        CONSTS::MAX_KEY_LENGHTH + CONSTS::MAX_DATA_SIZE))
+        {
+            rval = MBError::NETWORK_ERROR;
+            break;
+        }
+        if(size == 0)
+            continue;
+
+        buff.resize(size);
+        rval = RecvAll(reinterpret_cast<uint8_t *>(&buff[0]), size, MB_REPL_TIMEOUT_MS);
+        if(rval == MBError::SUCCESS)
+            rval = ApplyBatch(reinterpret_cast<const uint8_t *>(buff.data()), size,
+                              num_records);
+    }
+
+    close(fd);
+    fd = -1;
+    return rval;
+}
+
+int ReplicationFollower::ApplyBatch(const uint8_t *buff, size_t len, int num_records)
+{
+    const uint8_t *ptr = buff;
+    const uint8_t *end = buff + len;
+    uint64_t seq;
+    uint16_t key_len;
+    uint32_t data_len;
+    uint32_t expire_time;
+    MBData mbd;
+    int rval;
+
+    for(int i = 0; i < num_records; i++)
+    {
+        if(end - ptr < MB_REPL_RECORD_HDR_SIZE)
+            return MBError::NETWORK_ERROR;
+        memcpy(&seq, ptr, 8);
+        memcpy(&key_len, ptr + 10, 2);
+        memcpy(&data_len, ptr + 12, 4);
+        memcpy(&expire_time, ptr + 16, 4);
+        int op = ptr[8];
+        const uint8_t *key = ptr + MB_REPL_RECORD_HDR_SIZE;
+        if(static_cast<size_t>(end - key) < static_cast<size_t>(key_len) + data_len)
+            return MBError::NETWORK_ERROR;
+        if(seq != header->repl_seq + 1)
+        {
+            Logger::Log(LOG_LEVEL_ERROR, "unexpected replication sequence %llu after %llu",
+                        seq, header->repl_seq);
+            return MBError::INVALID_ARG;
+        }
+
+        // Dict assigns the same sequence number so that this follower can
+        // be the master of other followers.
+        header->repl_seq = seq - 1;
+        try {
+            switch(op)
+            {
+                case MB_REPL_OP_ADD:
+                    mbd.buff = const_cast<uint8_t *>(key + key_len);
+                    mbd.data_len = data_len;
+                    mbd.expire_time = expire_time;
+                    rval = dict->Add(key, key_len, mbd, true);
+                    mbd.buff = NULL;
+                    break;
+                case MB_REPL_OP_REMOVE:
+                    rval = dict->Remove(key, key_len);
+                    break;
+                case MB_REPL_OP_REMOVE_ALL:
+                    rval = dict->RemoveAll();
+                    break;
+                default:
+                    rval = MBError::INVALID_ARG;
+                    break;
+            }
+        } catch (int err) {
+            mbd.buff = NULL;
+            rval = err;
+        }
+        if(rval != MBError::SUCCESS)
+            Logger::Log(LOG_LEVEL_DEBUG, "failed to apply replication record %llu: %s",
+                        seq, MBError::get_error_str(rval));
+        header->repl_seq = seq;
+        ptr = key + key_len + data_len;
+    }
+
+    return MBError::SUCCESS;
+}
+
+}
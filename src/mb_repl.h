@@ -0,0 +1,161 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __MB_REPL_H__
+#define __MB_REPL_H__
+
+#include <stdint.h>
+#include <string>
+#include <deque>
+#include <list>
+#include <atomic>
+#include <pthread.h>
+
+#include "db.h"
+#include "dict.h"
+
+namespace mabain {
+
+#define MB_REPL_MAGIC               0x4D425250
+#define MB_REPL_VERSION             1
+
+#define MB_REPL_OP_ADD              1
+#define MB_REPL_OP_REMOVE           2
+#define MB_REPL_OP_REMOVE_ALL       3
+
+// record header: seq (8), op (1), reserved (1), key length (2),
+// data length (4) and expiry time (4)
+#define MB_REPL_RECORD_HDR_SIZE     20
+// batch header: number of records (4) and size of records (4)
+#define MB_REPL_BATCH_HDR_SIZE      8
+// handshake: magic (4), version or status (4) and sequence number (8)
+#define MB_REPL_HANDSHAKE_SIZE      16
+// records are sent in batches of at most this size
+#define MB_REPL_BATCH_SIZE          (256*1024)
+#define MB_REPL_DEFAULT_LOG_SIZE    (64*1024*1024ul)
+// an empty batch is sent if there is no record in this interval
+#define MB_REPL_HEARTBEAT_MS        1000
+// follower drops the connection if nothing is received in this interval
+#define MB_REPL_TIMEOUT_MS          (5*MB_REPL_HEARTBEAT_MS)
+
+// Records of the mutations done by the writer, kept in memory until the
+// total size exceeds the limit. Followers can resume from any sequence
+// number still in the log. All integers are in host byte order.
+class ReplicationLog
+{
+public:
+    ReplicationLog(uint64_t next_seq, size_t max_size);
+    ~ReplicationLog();
+
+    void Append(uint64_t seq, int op, const uint8_t *key, int key_len,
+                const uint8_t *data, int data_len, uint32_t expire_time);
+    // Copy records starting from seq to batch. Wait at most timeout_ms
+    // for new records. Return SUCCESS, TRY_AGAIN if there is no record,
+    // NOT_EXIST if seq is no longer in the log or DB_CLOSED after Stop.
+    int  Read(uint64_t seq, std::string &batch, int &num_records, int timeout_ms);
+    // Check if a follower can resume from seq.
+    int  CheckSeq(uint64_t seq);
+    uint64_t NextSeq();
+    void Stop();
+
+private:
+    std::deque<std::string> records;
+    // sequence number of the first record in the log
+    uint64_t first_seq;
+    size_t log_size;
+    size_t max_log_size;
+    bool stopped;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+};
+
+class ReplicationMaster;
+
+typedef struct _ReplFollowerConn
+{
+    ReplicationMaster *master;
+    int fd;
+    pthread_t tid;
+    std::atomic<bool> done;
+} ReplFollowerConn;
+
+// Writer side of log-shipping replication. The endpoint is either a Unix
+// domain socket path starting with '/' or host:port for TCP. A thread is
+// started for each follower to send the records after the sequence number
+// in the follower handshake.
+class ReplicationMaster
+{
+public:
+    ReplicationMaster(const std::string &endpoint, uint64_t next_seq, size_t max_log_size);
+    ~ReplicationMaster();
+
+    int  Start();
+    void Stop();
+    ReplicationLog* GetLog();
+    int  NumFollowers();
+
+private:
+    static void* AcceptThread(void *context);
+    static void* SenderThread(void *context);
+    void AcceptFollowers();
+    void SendRecords(ReplFollowerConn *conn);
+    void JoinFollowers(bool all);
+
+    std::string endpoint;
+    ReplicationLog log;
+    int listen_fd;
+    std::atomic<bool> stop_flag;
+    pthread_t accept_tid;
+    bool accept_running;
+    std::list<ReplFollowerConn*> followers;
+    pthread_mutex_t mutex;
+};
+
+// Follower side of log-shipping replication. Records are applied to a DB
+// opened as writer without async writer. The sequence number of the last
+// applied record is saved in the DB header so that the follower resumes
+// from there after restarts. A DB restored from a backup or snapshot of
+// the master resumes from the sequence number at the time of the backup.
+class ReplicationFollower
+{
+public:
+    ReplicationFollower(DB &db, const std::string &endpoint);
+    ~ReplicationFollower();
+
+    // Connect to master and apply records until Stop is called or the
+    // connection fails. Return DB_CLOSED after Stop, NOT_EXIST if the
+    // follower has to be resynced from a backup or snapshot of master.
+    int  Run();
+    void Stop();
+    uint64_t GetSeq() const;
+
+private:
+    int  Connect();
+    int  RecvAll(uint8_t *buff, size_t len, int timeout_ms);
+    int  ApplyBatch(const uint8_t *buff, size_t len, int num_records);
+
+    Dict *dict;
+    IndexHeader *header;
+    std::string endpoint;
+    int fd;
+    std::atomic<bool> stop_flag;
+};
+
+}
+
+#endif
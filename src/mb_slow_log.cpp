@@ -0,0 +1,73 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include "mb_slow_log.h"
+#include "logger.h"
+#include "crc32c.h"
+
+namespace mabain {
+
+thread_local OpCost mb_op_cost;
+
+SlowOpLog::SlowOpLog(uint32_t threshold_us)
+                   : threshold_ns(static_cast<uint64_t>(threshold_us) * 1000),
+                     num_slow_op(0)
+{
+    memset(slow_ops, 0, sizeof(slow_ops));
+}
+
+SlowOpLog::~SlowOpLog()
+{
+}
+
+void SlowOpLog::AddSlowOp(int op, const uint8_t *key, int len, uint64_t latency_ns)
+{
+    SlowOp slow_op;
+    slow_op.op = op;
+    slow_op.key_hash = crc32c(0, key, len);
+    slow_op.latency_ns = latency_ns;
+    slow_op.cost = mb_op_cost;
+
+    log_mutex.lock();
+    slow_ops[num_slow_op % MB_SLOW_OP_LOG_SIZE] = slow_op;
+    num_slow_op++;
+    log_mutex.unlock();
+
+    Logger::Log(LOG_LEVEL_WARN, "slow %s: key hash %08x, %llu us, hops %u, retries %u "
+                "(slept %llu us), edge reads %u, sys reads %u (%llu bytes), copied %llu bytes",
+                (op == MB_STATS_OP_FIND) ? "find" : "findPrefix", slow_op.key_hash,
+                (unsigned long long) (latency_ns / 1000), slow_op.cost.hops,
+                slow_op.cost.retries, (unsigned long long) (slow_op.cost.sleep_ns / 1000),
+                slow_op.cost.edge_reads, slow_op.cost.sys_reads,
+                (unsigned long long) slow_op.cost.sys_read_bytes,
+                (unsigned long long) slow_op.cost.copy_bytes);
+}
+
+void SlowOpLog::Get(std::vector<SlowOp> &ops)
+{
+    ops.clear();
+    log_mutex.lock();
+    uint64_t start = 0;
+    if(num_slow_op > MB_SLOW_OP_LOG_SIZE)
+        start = num_slow_op - MB_SLOW_OP_LOG_SIZE;
+    for(uint64_t i = start; i < num_slow_op; i++)
+        ops.push_back(slow_ops[i % MB_SLOW_OP_LOG_SIZE]);
+    log_mutex.unlock();
+}
+
+}
@@ -0,0 +1,91 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __MB_SLOW_LOG_H__
+#define __MB_SLOW_LOG_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <mutex>
+#include <vector>
+
+#include "db.h"
+#include "mb_stats.h"
+
+namespace mabain {
+
+// Cost of the current lookup of this thread
+extern thread_local OpCost mb_op_cost;
+
+// Counters on the lookup path are compiled out without __SLOW_OP_LOG__.
+#ifdef __SLOW_OP_LOG__
+#define MB_OP_COST_ADD(field, n)  (mabain::mb_op_cost.field += (n))
+#else
+#define MB_OP_COST_ADD(field, n)
+#endif
+
+// Back off before retrying a lookup that raced with writer.
+#ifdef __SLOW_OP_LOG__
+#define MB_READER_BACKOFF()                                                \
+    do {                                                                   \
+        uint64_t backoff_start = OpStats::Now();                           \
+        nanosleep((const struct timespec[]){{0, 10L}}, NULL);              \
+        mabain::mb_op_cost.retries++;                                      \
+        mabain::mb_op_cost.sleep_ns += OpStats::Now() - backoff_start;     \
+    } while(0)
+#else
+#define MB_READER_BACKOFF()  nanosleep((const struct timespec[]){{0, 10L}}, NULL)
+#endif
+
+// Lookups slower than the threshold are logged as warnings together with
+// the cost counted in mb_op_cost. The last MB_SLOW_OP_LOG_SIZE slow
+// lookups are also kept in memory of the handle.
+class SlowOpLog
+{
+public:
+    SlowOpLog(uint32_t threshold_us);
+    ~SlowOpLog();
+
+    // Reset the cost counters of this thread before a lookup.
+    static inline void Start()
+    {
+#ifdef __SLOW_OP_LOG__
+        memset(&mb_op_cost, 0, sizeof(mb_op_cost));
+#endif
+    }
+    // Check the latency of the lookup started at start_ns.
+    inline void Record(int op, const uint8_t *key, int len, uint64_t start_ns)
+    {
+        uint64_t latency_ns = OpStats::Now() - start_ns;
+        if(latency_ns >= threshold_ns)
+            AddSlowOp(op, key, len, latency_ns);
+    }
+    void Get(std::vector<SlowOp> &ops);
+
+private:
+    void AddSlowOp(int op, const uint8_t *key, int len, uint64_t latency_ns);
+
+    uint64_t threshold_ns;
+    std::mutex log_mutex;
+    SlowOp slow_ops[MB_SLOW_OP_LOG_SIZE];
+    uint64_t num_slow_op;
+};
+
+}
+
+#endif
@@ -0,0 +1,245 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "mb_snapshot.h"
+#include "mb_backup.h"
+#include "mb_data.h"
+#include "integer_4b_5b.h"
+#include "logger.h"
+
+namespace mabain {
+
+DBSnapshot::DBSnapshot(const DB &db) : db_ref(db),
+                                       index_offset(0),
+                                       data_offset(0),
+                                       thread_running(false),
+                                       done(false),
+                                       status(MBError::NOT_INITIALIZED)
+{
+    if(!(db.GetDBOptions() & CONSTS::ACCESS_MODE_WRITER))
+        throw (int) MBError::NOT_ALLOWED;
+
+    dict = db_ref.GetDictPtr();
+    if(dict == NULL)
+        throw (int) MBError::NOT_INITIALIZED;
+    dmm = dict->GetMM();
+    header = dict->GetHeaderPtr();
+    if(header == NULL)
+        throw (int) MBError::NOT_INITIALIZED;
+
+    if(pthread_mutex_init(&mutex, NULL) != 0 || pthread_cond_init(&cond, NULL) != 0)
+    {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to init snapshot mutex");
+        throw (int) MBError::MUTEX_ERROR;
+    }
+}
+
+DBSnapshot::~DBSnapshot()
+{
+    if(thread_running)
+        pthread_join(tid, NULL);
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&cond);
+}
+
+int DBSnapshot::Start(const char *dir)
+{
+    if(dir == NULL)
+        throw (int) MBError::INVALID_ARG;
+    if(thread_running || done)
+        throw (int) MBError::NOT_ALLOWED;
+
+    std::string header_path = std::string(dir) + "/_mabain_h";
+    if(access(header_path.c_str(), R_OK) == 0)
+        throw (int) MBError::OPEN_FAILURE;
+    if(!db_ref.is_open())
+        throw (int) db_ref.Status();
+    // Buffers are being moved by rc.
+    if(header->rc_root_offset.load(std::memory_order_relaxed) != 0)
+        throw (int) MBError::TRY_AGAIN;
+    if(header->m_data_offset > MAX_6B_OFFSET || header->m_index_offset > MAX_6B_OFFSET)
+        throw (int) MBError::INVALID_SIZE;
+
+    snapshot_dir = dir;
+    header_page.assign(reinterpret_cast<const char *>(header), RollableFile::page_size);
+    index_offset = header->m_index_offset;
+    data_offset = header->m_data_offset;
+    dmm->StartSnapshot(index_offset);
+    dict->StartSnapshot(data_offset);
+
+    if(pthread_create(&tid, NULL, SnapshotThread, this) != 0)
+    {
+        std::map<size_t, std::string> pages;
+        dmm->StopSnapshot(pages);
+        dict->StopSnapshot(pages);
+        Logger::Log(LOG_LEVEL_ERROR, "failed to create snapshot thread");
+        throw (int) MBError::THREAD_FAILED;
+    }
+    thread_running = true;
+    Logger::Log(LOG_LEVEL_INFO, "snapshot to %s started: index offset %llu data offset %llu",
+                dir, (unsigned long long) index_offset, (unsigned long long) data_offset);
+    return MBError::SUCCESS;
+}
+
+int DBSnapshot::Wait()
+{
+    pthread_mutex_lock(&mutex);
+    while(thread_running && !done)
+        pthread_cond_wait(&cond, &mutex);
+    int rval = status;
+    pthread_mutex_unlock(&mutex);
+    return rval;
+}
+
+bool DBSnapshot::Done() const
+{
+    pthread_mutex_lock(&mutex);
+    bool rval = done;
+    pthread_mutex_unlock(&mutex);
+    return rval;
+}
+
+void* DBSnapshot::SnapshotThread(void *context)
+{
+    DBSnapshot *snapshot = static_cast<DBSnapshot *>(context);
+    int rval = snapshot->CopySnapshot();
+
+    pthread_mutex_lock(&snapshot->mutex);
+    snapshot->status = rval;
+    snapshot->done = true;
+    pthread_cond_broadcast(&snapshot->cond);
+    pthread_mutex_unlock(&snapshot->mutex);
+    return NULL;
+}
+
+void DBSnapshot::RestorePages(const std::string &path_base, size_t block_size,
+                              const std::map<size_t, std::string> &pages) const
+{
+    int fd = -1;
+    int curr_order = -1;
+    int rval = MBError::SUCCESS;
+    for(auto it = pages.begin(); it != pages.end(); ++it)
+    {
+        int order = it->first / block_size;
+        if(order != curr_order)
+        {
+            if(fd >= 0)
+                close(fd);
+            curr_order = order;
+            fd = open((path_base + std::to_string(order)).c_str(), O_WRONLY);
+            if(fd < 0)
+            {
+                rval = MBError::OPEN_FAILURE;
+                break;
+            }
+        }
+        if(pwrite(fd, it->second.data(), it->second.size(), it->first % block_size) !=
+           static_cast<ssize_t>(it->second.size()))
+        {
+            rval = MBError::WRITE_ERROR;
+            break;
+        }
+    }
+    if(fd >= 0)
+        close(fd);
+
+    if(rval != MBError::SUCCESS)
+        throw rval;
+}
+
+int DBSnapshot::CopySnapshot()
+{
+    int num_data_files = (data_offset / header->data_block_size) + 1;
+    int num_index_files = (index_offset / header->index_block_size) + 1;
+    const std::string &orig_dir = db_ref.GetDBDir();
+    std::map<size_t, std::string> index_pages;
+    std::map<size_t, std::string> data_pages;
+
+    // Blocks of a shared memory DB are copied from the shared memory objects.
+    bool shm_src = (db_ref.GetDBOptions() & CONSTS::SHARED_MEMORY_MODE);
+
+    char *buffer = (char *) malloc(BLOCK_SIZE_ALIGN);
+    int rval = MBError::SUCCESS;
+    try {
+        if(buffer == NULL)
+            throw (int) MBError::NO_MEMORY;
+        for(int i = 0; i < num_data_files; i++)
+        {
+            DBBackup::copy_file(orig_dir + "/_mabain_d" + std::to_string(i),
+                                snapshot_dir + "/_mabain_d" + std::to_string(i),
+                                buffer, BLOCK_SIZE_ALIGN, shm_src);
+        }
+        for(int i = 0; i < num_index_files; i++)
+        {
+            DBBackup::copy_file(orig_dir + "/_mabain_i" + std::to_string(i),
+                                snapshot_dir + "/_mabain_i" + std::to_string(i),
+                                buffer, BLOCK_SIZE_ALIGN, shm_src);
+        }
+    } catch (int error) {
+        rval = error;
+    }
+
+    // Pages modified after the files were copied are saved as well.
+    // Writer can reuse released buffers once the pages are taken.
+    dmm->StopSnapshot(index_pages);
+    dict->StopSnapshot(data_pages);
+    if(buffer != NULL)
+        free(buffer);
+
+    if(rval == MBError::SUCCESS)
+    {
+        try {
+            RestorePages(snapshot_dir + "/_mabain_d", header->data_block_size, data_pages);
+            RestorePages(snapshot_dir + "/_mabain_i", header->index_block_size, index_pages);
+
+            std::string header_path = snapshot_dir + "/_mabain_h";
+            int fd = open(header_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                          S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+            if(fd < 0)
+                throw (int) MBError::OPEN_FAILURE;
+            ssize_t count = write(fd, header_page.data(), header_page.size());
+            close(fd);
+            if(count != static_cast<ssize_t>(header_page.size()))
+                throw (int) MBError::WRITE_ERROR;
+        } catch (int error) {
+            rval = error;
+        }
+    }
+
+    if(rval != MBError::SUCCESS)
+    {
+        Logger::Log(LOG_LEVEL_ERROR, "snapshot to %s failed: %s", snapshot_dir.c_str(),
+                    MBError::get_error_str(rval));
+        return rval;
+    }
+
+    DBBackup::ResetNumHandlers(snapshot_dir.c_str());
+    Logger::Log(LOG_LEVEL_INFO, "snapshot to %s finished: %llu index pages and %llu "
+                "data pages restored", snapshot_dir.c_str(),
+                (unsigned long long) index_pages.size(),
+                (unsigned long long) data_pages.size());
+    return MBError::SUCCESS;
+}
+
+}
@@ -0,0 +1,78 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __MB_SNAPSHOT_H__
+#define __MB_SNAPSHOT_H__
+
+#include <string>
+#include <map>
+#include <pthread.h>
+
+#include "db.h"
+#include "dict.h"
+
+namespace mabain {
+
+// Online snapshot of a writer DB. Start freezes the header and the index
+// and data offsets, then a background thread copies the block files while
+// writer keeps running. Writer saves the original content of the pages
+// below the frozen offsets before modifying them and does not reuse
+// released buffers until the copy is done. The saved pages are written
+// over the copied files to restore the image at the time of Start.
+class DBSnapshot
+{
+public:
+    DBSnapshot(const DB &db);
+    ~DBSnapshot();
+
+    // Must be called by the writer thread.
+    int  Start(const char *snapshot_dir);
+    // Wait for the copy to finish and return the snapshot status.
+    // Can be called by any thread.
+    int  Wait();
+    bool Done() const;
+
+private:
+    static void* SnapshotThread(void *context);
+    int  CopySnapshot();
+    void RestorePages(const std::string &path_base, size_t block_size,
+                      const std::map<size_t, std::string> &pages) const;
+
+    const DB &db_ref;
+    Dict *dict;
+    DictMem *dmm;
+    IndexHeader *header;
+
+    std::string snapshot_dir;
+    // header at the time of Start
+    std::string header_page;
+    size_t index_offset;
+    size_t data_offset;
+
+    pthread_t tid;
+    bool thread_running;
+    bool done;
+    int status;
+    mutable pthread_mutex_t mutex;
+    pthread_cond_t cond;
+};
+
+}
+
+#endif
@@ -0,0 +1,188 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "mb_stats.h"
+#include "rollable_file.h"
+#include "resource_pool.h"
+#include "mabain_consts.h"
+#include "error.h"
+#include "logger.h"
+
+namespace mabain {
+
+OpStats::OpStats() : hist(NULL),
+                     status(MBError::SUCCESS)
+{
+    hist = new LatencyHistogram[MB_STATS_NUM_OPS];
+    Reset();
+}
+
+OpStats::OpStats(const std::string &stats_path, int mode)
+               : hist(NULL),
+                 status(MBError::NOT_INITIALIZED)
+{
+    size_t stats_size = RollableFile::page_size +
+                        MB_STATS_NUM_OPS * sizeof(LatencyHistogram);
+    bool writer = (mode & CONSTS::ACCESS_MODE_WRITER);
+    bool anon_mode = (mode & CONSTS::MEMORY_ONLY_MODE) &&
+                     !(mode & CONSTS::SHARED_MEMORY_MODE);
+    bool new_file;
+    if(mode & CONSTS::SHARED_MEMORY_MODE)
+        new_file = !FileIO::ShmExists(stats_path);
+    else
+        new_file = (access(stats_path.c_str(), F_OK) != 0);
+    if(!writer && new_file && !anon_mode)
+    {
+        status = MBError::NOT_EXIST;
+        return;
+    }
+
+    bool map_file = true;
+    stats_file = ResourcePool::getInstance().OpenFile(stats_path, mode, stats_size,
+                                                      map_file, writer);
+    if(!map_file || stats_file->GetMapAddr() == NULL)
+    {
+        Logger::Log(LOG_LEVEL_WARN, "failed to map stats file %s", stats_path.c_str());
+        stats_file = NULL;
+        status = MBError::MMAP_FAILED;
+        return;
+    }
+
+    OpStatsHeader *stats_header = reinterpret_cast<OpStatsHeader *>(stats_file->GetMapAddr());
+    hist = reinterpret_cast<LatencyHistogram *>(stats_file->GetMapAddr() +
+                                                RollableFile::page_size);
+    if(writer)
+    {
+        // Writer histograms start from zero every time writer is opened.
+        stats_header->num_ops = 0;
+        Reset();
+        stats_header->num_buckets = MB_STATS_NUM_BUCKETS;
+        stats_header->num_ops = MB_STATS_NUM_OPS;
+    }
+    else if(stats_header->num_ops != MB_STATS_NUM_OPS ||
+            stats_header->num_buckets != MB_STATS_NUM_BUCKETS)
+    {
+        hist = NULL;
+        status = MBError::NOT_EXIST;
+        return;
+    }
+    status = MBError::SUCCESS;
+}
+
+OpStats::~OpStats()
+{
+    if(stats_file == NULL && hist != NULL)
+        delete [] hist;
+}
+
+int OpStats::Status() const
+{
+    return status;
+}
+
+inline int OpStats::GetBucket(uint64_t ns)
+{
+    if(ns < (1ULL << MB_STATS_SUB_BITS))
+        return static_cast<int>(ns);
+    int shift = 63 - __builtin_clzll(ns) - MB_STATS_SUB_BITS;
+    return ((shift + 1) << MB_STATS_SUB_BITS) +
+           static_cast<int>((ns >> shift) & ((1ULL << MB_STATS_SUB_BITS) - 1));
+}
+
+// highest latency of the bucket
+inline uint64_t OpStats::BucketValue(int bucket)
+{
+    if(bucket < (1 << MB_STATS_SUB_BITS))
+        return static_cast<uint64_t>(bucket);
+    int shift = (bucket >> MB_STATS_SUB_BITS) - 1;
+    uint64_t sub = (1ULL << MB_STATS_SUB_BITS) + (bucket & ((1 << MB_STATS_SUB_BITS) - 1));
+    return (sub << shift) + ((1ULL << shift) - 1);
+}
+
+void OpStats::Record(int op, uint64_t start_ns)
+{
+    uint64_t ns = Now() - start_ns;
+    LatencyHistogram &h = hist[op];
+    h.buckets[GetBucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    h.total_ns.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t max_ns = h.max_ns.load(std::memory_order_relaxed);
+    while(ns > max_ns &&
+          !h.max_ns.compare_exchange_weak(max_ns, ns, std::memory_order_relaxed))
+    {
+    }
+}
+
+void OpStats::Get(int op, LatencyStats &stats) const
+{
+    memset(&stats, 0, sizeof(stats));
+    if(hist == NULL || op < 0 || op >= MB_STATS_NUM_OPS)
+        return;
+
+    // Histogram may be updated while being read. Percentiles are computed
+    // from the bucket counts copied here.
+    const LatencyHistogram &h = hist[op];
+    uint64_t buckets[MB_STATS_NUM_BUCKETS];
+    uint64_t count = 0;
+    for(int i = 0; i < MB_STATS_NUM_BUCKETS; i++)
+    {
+        buckets[i] = h.buckets[i].load(std::memory_order_relaxed);
+        count += buckets[i];
+    }
+    if(count == 0)
+        return;
+
+    stats.count = count;
+    stats.mean_ns = h.total_ns.load(std::memory_order_relaxed) / count;
+    stats.max_ns = h.max_ns.load(std::memory_order_relaxed);
+
+    const double quantiles[] = {0.5, 0.99, 0.999};
+    uint64_t *values[] = {&stats.p50_ns, &stats.p99_ns, &stats.p999_ns};
+    uint64_t sum = 0;
+    int q = 0;
+    for(int i = 0; i < MB_STATS_NUM_BUCKETS && q < 3; i++)
+    {
+        sum += buckets[i];
+        while(q < 3 && sum >= static_cast<uint64_t>(ceil(quantiles[q] * count)))
+        {
+            *values[q] = BucketValue(i);
+            if(*values[q] > stats.max_ns)
+                *values[q] = stats.max_ns;
+            q++;
+        }
+    }
+}
+
+void OpStats::Reset()
+{
+    if(hist == NULL)
+        return;
+    for(int op = 0; op < MB_STATS_NUM_OPS; op++)
+    {
+        LatencyHistogram &h = hist[op];
+        h.total_ns.store(0, std::memory_order_relaxed);
+        h.max_ns.store(0, std::memory_order_relaxed);
+        for(int i = 0; i < MB_STATS_NUM_BUCKETS; i++)
+            h.buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+}
@@ -0,0 +1,88 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __MB_STATS_H__
+#define __MB_STATS_H__
+
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <memory>
+#include <atomic>
+
+#include "db.h"
+#include "mmap_file.h"
+
+namespace mabain {
+
+// Latencies below 2^MB_STATS_SUB_BITS ns have their own bucket. Every
+// power of two above is split into 2^MB_STATS_SUB_BITS buckets so that
+// the reported latency is within 12.5% of the actual one.
+#define MB_STATS_SUB_BITS       3
+#define MB_STATS_NUM_BUCKETS    ((64 - MB_STATS_SUB_BITS + 1) << MB_STATS_SUB_BITS)
+
+typedef struct _LatencyHistogram
+{
+    std::atomic<uint64_t> total_ns;
+    std::atomic<uint64_t> max_ns;
+    std::atomic<uint64_t> buckets[MB_STATS_NUM_BUCKETS];
+} LatencyHistogram;
+
+typedef struct _OpStatsHeader
+{
+    uint32_t num_ops;
+    uint32_t num_buckets;
+} OpStatsHeader;
+
+// Log-bucketed latency histograms of DB operations. Histograms of reader
+// handles are in the memory of the handle. Histograms of writer are in a
+// shared memory file next to the DB header so that they can be read by
+// other processes. Recording only uses relaxed atomic increments.
+class OpStats
+{
+public:
+    // Histograms in the memory of this handle
+    OpStats();
+    // Histograms in the stats file of writer
+    OpStats(const std::string &stats_path, int mode);
+    ~OpStats();
+
+    int  Status() const;
+    static inline uint64_t Now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    }
+    // Record the latency of op started at start_ns.
+    void Record(int op, uint64_t start_ns);
+    void Get(int op, LatencyStats &stats) const;
+    void Reset();
+
+private:
+    static inline int GetBucket(uint64_t ns);
+    static inline uint64_t BucketValue(int bucket);
+
+    std::shared_ptr<MmapFileIO> stats_file;
+    LatencyHistogram *hist;
+    int status;
+};
+
+}
+
+#endif
@@ -0,0 +1,281 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+
+#include "mb_verify.h"
+#include "mbt_base.h"
+#include "error.h"
+#include "logger.h"
+
+namespace mabain {
+
+DBVerifier::DBVerifier(const MBConfig &config, int nthreads)
+                     : mbdir(config.mbdir == NULL ? "" : config.mbdir),
+                       num_threads(nthreads),
+                       traverse_done(false),
+                       num_record(0),
+                       num_checked(0),
+                       num_error(0)
+{
+    memcpy(&db_config, &config, sizeof(db_config));
+    db_config.mbdir = NULL;
+    // Verifier never modifies the DB.
+    db_config.options &= ~(CONSTS::ACCESS_MODE_WRITER | CONSTS::ASYNC_WRITER_MODE);
+    db_config.warmup_options = 0;
+
+    if(num_threads <= 0)
+        num_threads = 1;
+    else if(num_threads > MB_VERIFY_MAX_THREADS)
+        num_threads = MB_VERIFY_MAX_THREADS;
+
+    if(pthread_mutex_init(&mutex, NULL) != 0 ||
+       pthread_cond_init(&cond_batch, NULL) != 0 ||
+       pthread_cond_init(&cond_space, NULL) != 0)
+    {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to init verifier mutex");
+        throw (int) MBError::MUTEX_ERROR;
+    }
+}
+
+DBVerifier::~DBVerifier()
+{
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&cond_batch);
+    pthread_cond_destroy(&cond_space);
+}
+
+int DBVerifier::Verify()
+{
+    MBConfig config = db_config;
+    config.mbdir = mbdir.c_str();
+    DB db(config);
+    if(!db.is_open())
+        return db.Status();
+
+    traverse_done = false;
+    num_record = 0;
+    num_checked = 0;
+    num_error = 0;
+    errors.clear();
+
+    int rval = MBError::SUCCESS;
+    std::vector<VerifyContext> contexts(num_threads);
+    for(int i = 0; i < num_threads; i++)
+    {
+        contexts[i].verifier = this;
+        contexts[i].running = false;
+        contexts[i].db = new DB(config);
+        if(!contexts[i].db->is_open())
+        {
+            rval = contexts[i].db->Status();
+            break;
+        }
+    }
+    if(rval == MBError::SUCCESS)
+    {
+        for(int i = 0; i < num_threads; i++)
+        {
+            if(pthread_create(&contexts[i].tid, NULL, VerifyThread, &contexts[i]) != 0)
+            {
+                Logger::Log(LOG_LEVEL_ERROR, "failed to create verifier thread");
+                rval = MBError::THREAD_FAILED;
+                break;
+            }
+            contexts[i].running = true;
+        }
+    }
+
+    if(rval == MBError::SUCCESS)
+        TraverseIndex(db);
+
+    pthread_mutex_lock(&mutex);
+    traverse_done = true;
+    pthread_cond_broadcast(&cond_batch);
+    pthread_mutex_unlock(&mutex);
+    for(int i = 0; i < num_threads; i++)
+    {
+        if(contexts[i].running)
+            pthread_join(contexts[i].tid, NULL);
+        if(contexts[i].db != NULL)
+            delete contexts[i].db;
+    }
+
+    if(rval != MBError::SUCCESS)
+        return rval;
+
+    Logger::Log(LOG_LEVEL_INFO, "verified %lld data records (%lld with checksum): %lld errors",
+                (long long) num_record.load(), (long long) num_checked.load(),
+                (long long) num_error);
+    if(num_error > 0)
+        return errors[0].error;
+    return MBError::SUCCESS;
+}
+
+int64_t DBVerifier::GetRecordCount() const
+{
+    return num_record.load();
+}
+
+int64_t DBVerifier::GetCheckedCount() const
+{
+    return num_checked.load();
+}
+
+int64_t DBVerifier::GetErrorCount() const
+{
+    return num_error;
+}
+
+const std::vector<VerifyError>& DBVerifier::GetErrors() const
+{
+    return errors;
+}
+
+void* DBVerifier::VerifyThread(void *context)
+{
+    VerifyContext *ctx = static_cast<VerifyContext *>(context);
+    ctx->verifier->VerifyRecords(ctx->db);
+    return NULL;
+}
+
+void DBVerifier::VerifyRecords(DB *db)
+{
+    Dict *dict = db->dict;
+    MBData data;
+    std::vector<size_t> batch;
+    bool checked;
+
+    while(true)
+    {
+        pthread_mutex_lock(&mutex);
+        while(batches.empty() && !traverse_done)
+            pthread_cond_wait(&cond_batch, &mutex);
+        if(batches.empty())
+        {
+            pthread_mutex_unlock(&mutex);
+            break;
+        }
+        batch.swap(batches.front());
+        batches.pop_front();
+        pthread_cond_signal(&cond_space);
+        pthread_mutex_unlock(&mutex);
+
+        for(size_t i = 0; i < batch.size(); i++)
+        {
+            int rval = dict->VerifyData(batch[i], data, checked);
+            num_record.fetch_add(1, std::memory_order_relaxed);
+            if(checked)
+                num_checked.fetch_add(1, std::memory_order_relaxed);
+            if(rval != MBError::SUCCESS)
+                AddError(false, batch[i], rval);
+        }
+        batch.clear();
+    }
+}
+
+// Check that index buffers are within the index size and queue data offsets
+// for verifier threads. Traversal stops if a node cannot be read.
+int DBVerifier::TraverseIndex(DB &db)
+{
+    IndexHeader *header = db.dict->GetHeaderPtr();
+    size_t index_size = header->m_index_offset;
+    size_t edge_offset = 0;
+
+    DB::iterator iter = DB::iterator(db, DB_ITER_STATE_INIT);
+    int rval = iter.init_no_next();
+    if(rval != MBError::SUCCESS)
+    {
+        AddError(true, db.dict->GetRootOffset(), rval);
+        return rval;
+    }
+
+    DBTraverseNode dbt_node;
+    try
+    {
+        while(iter.next_dbt_buffer(&dbt_node))
+        {
+            edge_offset = dbt_node.edge_offset;
+            if((dbt_node.buffer_type & BUFFER_TYPE_EDGE_STR) &&
+               dbt_node.edgestr_offset + dbt_node.edgestr_size > index_size)
+                AddError(true, edge_offset, MBError::OUT_OF_BOUND);
+
+            if(dbt_node.buffer_type & BUFFER_TYPE_NODE)
+            {
+                if(dbt_node.node_offset + dbt_node.node_size > index_size)
+                {
+                    AddError(true, edge_offset, MBError::OUT_OF_BOUND);
+                    continue;
+                }
+                iter.add_node_offset(dbt_node.node_offset);
+            }
+
+            if(dbt_node.buffer_type & BUFFER_TYPE_DATA)
+                AddDataOffset(dbt_node.data_offset);
+        }
+        rval = MBError::SUCCESS;
+    }
+    catch(int error)
+    {
+        Logger::Log(LOG_LEVEL_ERROR, "index traversal stopped at edge %llu: %s",
+                    (unsigned long long) edge_offset, MBError::get_error_str(error));
+        AddError(true, edge_offset, error);
+        rval = error;
+    }
+
+    FlushBatch();
+    return rval;
+}
+
+void DBVerifier::AddDataOffset(size_t data_offset)
+{
+    curr_batch.push_back(data_offset);
+    if(curr_batch.size() >= MB_VERIFY_BATCH_SIZE)
+        FlushBatch();
+}
+
+void DBVerifier::FlushBatch()
+{
+    if(curr_batch.empty())
+        return;
+
+    pthread_mutex_lock(&mutex);
+    while(batches.size() >= MB_VERIFY_MAX_BATCH)
+        pthread_cond_wait(&cond_space, &mutex);
+    batches.push_back(std::vector<size_t>());
+    batches.back().swap(curr_batch);
+    pthread_cond_signal(&cond_batch);
+    pthread_mutex_unlock(&mutex);
+}
+
+void DBVerifier::AddError(bool index, size_t offset, int error)
+{
+    pthread_mutex_lock(&mutex);
+    num_error++;
+    if(errors.size() < MB_VERIFY_MAX_ERRORS)
+    {
+        VerifyError verify_error;
+        verify_error.index = index;
+        verify_error.offset = offset;
+        verify_error.error = error;
+        errors.push_back(verify_error);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+}
@@ -0,0 +1,104 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __MB_VERIFY_H__
+#define __MB_VERIFY_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "db.h"
+
+namespace mabain {
+
+#define MB_VERIFY_BATCH_SIZE      1024
+// maximum number of data offset batches waiting for verification
+#define MB_VERIFY_MAX_BATCH       64
+// maximum number of errors saved
+#define MB_VERIFY_MAX_ERRORS      1000
+#define MB_VERIFY_MAX_THREADS     64
+
+typedef struct _VerifyError
+{
+    // true if the offset is in index blocks
+    bool   index;
+    size_t offset;
+    int    error;
+} VerifyError;
+
+// Verify integrity of index and data blocks.
+// The index is traversed in the calling thread to find all data records.
+// Sizes and checksums of data records are verified by a pool of threads,
+// each with its own reader handle. Records written without checksum are
+// only checked for size. Writer should be stopped during verification;
+// otherwise, records being updated may be reported as errors.
+class DBVerifier
+{
+public:
+    DBVerifier(const MBConfig &config, int num_threads);
+    ~DBVerifier();
+
+    // Return SUCCESS if no error is found.
+    int Verify();
+
+    int64_t GetRecordCount() const;
+    int64_t GetCheckedCount() const;
+    int64_t GetErrorCount() const;
+    // The first MB_VERIFY_MAX_ERRORS errors
+    const std::vector<VerifyError>& GetErrors() const;
+
+private:
+    typedef struct _VerifyContext
+    {
+        DBVerifier *verifier;
+        DB *db;
+        pthread_t tid;
+        bool running;
+    } VerifyContext;
+
+    static void* VerifyThread(void *context);
+    void VerifyRecords(DB *db);
+    int  TraverseIndex(DB &db);
+    void AddDataOffset(size_t data_offset);
+    void FlushBatch();
+    void AddError(bool index, size_t offset, int error);
+
+    MBConfig db_config;
+    std::string mbdir;
+    int num_threads;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond_batch;
+    pthread_cond_t  cond_space;
+    std::deque<std::vector<size_t>> batches;
+    std::vector<size_t> curr_batch;
+    bool traverse_done;
+
+    std::atomic<int64_t> num_record;
+    std::atomic<int64_t> num_checked;
+    int64_t num_error;
+    std::vector<VerifyError> errors;
+};
+
+}
+
+#endif
@@ -0,0 +1,153 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "mb_warmup.h"
+#include "mabain_consts.h"
+#include "rollable_file.h"
+#include "error.h"
+#include "logger.h"
+
+namespace mabain {
+
+DBWarmup::DBWarmup(int warmup_options, int nthreads)
+                 : options(warmup_options),
+                   num_threads(nthreads),
+                   total_size(0),
+                   next_chunk(0),
+                   warmup_size(0),
+                   stop_warmup(false),
+                   mlock_failed(false)
+{
+    if(num_threads <= 0)
+        num_threads = 1;
+    else if(num_threads > MB_WARMUP_MAX_THREADS)
+        num_threads = MB_WARMUP_MAX_THREADS;
+}
+
+DBWarmup::~DBWarmup()
+{
+    Stop();
+}
+
+void DBWarmup::AddRegion(uint8_t *addr, size_t size)
+{
+    if(options & CONSTS::WARMUP_HUGEPAGE)
+    {
+#ifdef MADV_HUGEPAGE
+        // This is only a hint; not all file systems support huge pages.
+        madvise(addr, size, MADV_HUGEPAGE);
+#endif
+    }
+
+    for(size_t off = 0; off < size; off += MB_WARMUP_CHUNK_SIZE)
+    {
+        size_t chunk_size = MB_WARMUP_CHUNK_SIZE;
+        if(off + chunk_size > size)
+            chunk_size = size - off;
+        chunks.push_back(std::make_pair(addr + off, chunk_size));
+    }
+    total_size += size;
+}
+
+int DBWarmup::Start()
+{
+    Logger::Log(LOG_LEVEL_INFO, "warming up %llu bytes using %d threads",
+                (unsigned long long) total_size, num_threads);
+
+    for(int i = 0; i < num_threads; i++)
+    {
+        pthread_t tid;
+        if(pthread_create(&tid, NULL, WarmupThread, this) != 0)
+        {
+            Logger::Log(LOG_LEVEL_WARN, "failed to start warmup thread");
+            break;
+        }
+        tids.push_back(tid);
+    }
+
+    if(tids.empty())
+        return MBError::THREAD_FAILED;
+    return MBError::SUCCESS;
+}
+
+void DBWarmup::Stop()
+{
+    stop_warmup.store(true, std::memory_order_release);
+    for(size_t i = 0; i < tids.size(); i++)
+        pthread_join(tids[i], NULL);
+    tids.clear();
+}
+
+int DBWarmup::GetProgress() const
+{
+    if(total_size == 0)
+        return 100;
+    return static_cast<int>(warmup_size.load(std::memory_order_relaxed) * 100 / total_size);
+}
+
+void* DBWarmup::WarmupThread(void *context)
+{
+    DBWarmup *instance_ptr = static_cast<DBWarmup *>(context);
+    instance_ptr->WarmupChunks();
+    return NULL;
+}
+
+void DBWarmup::WarmupChunks()
+{
+    while(!stop_warmup.load(std::memory_order_acquire))
+    {
+        size_t index = next_chunk.fetch_add(1, std::memory_order_relaxed);
+        if(index >= chunks.size())
+            break;
+
+        WarmupChunk(chunks[index].first, chunks[index].second);
+        warmup_size.fetch_add(chunks[index].second, std::memory_order_relaxed);
+    }
+}
+
+void DBWarmup::WarmupChunk(uint8_t *addr, size_t size)
+{
+    bool populated = false;
+#ifdef MADV_POPULATE_READ
+    populated = (madvise(addr, size, MADV_POPULATE_READ) == 0);
+#endif
+    if(!populated)
+    {
+        madvise(addr, size, MADV_WILLNEED);
+        // Read one byte from each page to map it.
+        volatile uint8_t *ptr = addr;
+        uint8_t sum = 0;
+        for(size_t off = 0; off < size; off += RollableFile::page_size)
+            sum += ptr[off];
+        (void) sum;
+    }
+
+    if(options & CONSTS::WARMUP_MLOCK)
+    {
+        if(mlock(addr, size) != 0 && !mlock_failed.exchange(true))
+        {
+            Logger::Log(LOG_LEVEL_WARN, "failed to lock warmed up memory, errno=%d",
+                        errno);
+        }
+    }
+}
+
+}
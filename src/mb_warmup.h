@@ -0,0 +1,67 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __MB_WARMUP_H__
+#define __MB_WARMUP_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+#include <utility>
+
+namespace mabain {
+
+#define MB_WARMUP_CHUNK_SIZE    4*1024*1024LLU    // 4M
+#define MB_WARMUP_MAX_THREADS   64
+
+// Prefault memory mapped blocks in background threads after DB is opened
+// so that lookups do not suffer from random page faults. Mapped regions
+// are split into chunks and processed by a number of threads in parallel.
+class DBWarmup
+{
+public:
+    DBWarmup(int warmup_options, int num_threads);
+    ~DBWarmup();
+
+    void AddRegion(uint8_t *addr, size_t size);
+    int  Start();
+    void Stop();
+    // Percentage of warmed up memory
+    int  GetProgress() const;
+
+private:
+    static void* WarmupThread(void *context);
+    void WarmupChunks();
+    void WarmupChunk(uint8_t *addr, size_t size);
+
+    int options;
+    int num_threads;
+    std::vector<pthread_t> tids;
+    std::vector<std::pair<uint8_t*, size_t>> chunks;
+    size_t total_size;
+
+    std::atomic<size_t> next_chunk;
+    std::atomic<size_t> warmup_size;
+    std::atomic<bool> stop_warmup;
+    std::atomic<bool> mlock_failed;
+};
+
+}
+
+#endif
@@ -93,11 +93,10 @@ void DBTraverseBase::GetAlignmentSize(DBTraverseNode &dbt_node) const
 
     if(dbt_node.buffer_type & BUFFER_TYPE_DATA)
     {
-        uint16_t data_size[2];
-        if(dict->ReadData((uint8_t *)&data_size[0], DATA_HDR_BYTE, dbt_node.data_offset)
-                 != DATA_HDR_BYTE)
+        int data_size;
+        if(dict->GetDataRecordSize(dbt_node.data_offset, data_size) != MBError::SUCCESS)
             throw (int) MBError::READ_ERROR;
-        dbt_node.data_size = data_free_lists->GetAlignmentSize(data_size[0] + DATA_HDR_BYTE);
+        dbt_node.data_size = data_free_lists->GetAlignmentSize(data_size);
     }
 }
 
@@ -105,11 +104,16 @@ void DBTraverseBase::BufferCopy(size_t offset_dst, uint8_t *ptr_dst,
                                 size_t offset_src, const uint8_t *ptr_src,
                                 int size, DRMBase *drm)
 {
+    // Writes using memory address are not seen by the rollable file.
+    if(ptr_dst != NULL)
+        drm->MarkDirty(offset_dst, size);
+
     if(ptr_src != NULL)
     {
         if(ptr_dst != NULL)
         {
             memcpy(ptr_dst, ptr_src, size);
+            drm->IncCacheEpoch(offset_dst, size);
         }
         else
         {
@@ -126,6 +130,7 @@ void DBTraverseBase::BufferCopy(size_t offset_dst, uint8_t *ptr_dst,
         if(ptr_dst != NULL)
         {
             memcpy(ptr_dst, rw_buffer, size);
+            drm->IncCacheEpoch(offset_dst, size);
         }
         else
         {
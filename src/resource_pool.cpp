@@ -90,7 +90,9 @@ std::shared_ptr<MmapFileIO> ResourcePool::OpenFile(const std::string &fpath,
         int flags = O_RDWR;
         if(create_file)
             flags |= O_CREAT;
-        if(mode & CONSTS::MEMORY_ONLY_MODE)
+        if(mode & CONSTS::SHARED_MEMORY_MODE)
+            flags |= MMAP_SHM_MODE;
+        else if(mode & CONSTS::MEMORY_ONLY_MODE)
             flags |= MMAP_ANONYMOUS_MODE;
 
         mmap_file = std::shared_ptr<MmapFileIO>
@@ -104,7 +106,7 @@ std::shared_ptr<MmapFileIO> ResourcePool::OpenFile(const std::string &fpath,
         {
             if(mmap_file->MapFile(file_size, 0) != NULL)
             {
-                if(!(mode & CONSTS::MEMORY_ONLY_MODE))
+                if(!(flags & MMAP_ANONYMOUS_MODE))
                     mmap_file->Close();
             }
             else
@@ -27,6 +27,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <climits>
+#include <algorithm>
 
 #include "db.h"
 #include "rollable_file.h"
@@ -39,6 +40,7 @@ namespace mabain {
 #define SLIDING_MEM_SIZE     16LLU*1024*1024    // 16M
 #define MAX_NUM_BLOCK        2*1024             // 2K
 #define RC_OFFSET_PERCENTAGE 75                 // default rc offset is placed at 75% of maximum size
+#define ADAPTIVE_MMAP_INTERVAL 65536            // number of reads between hot block remapping
 
 const long RollableFile::page_size = sysconf(_SC_PAGESIZE);
 int RollableFile::ShmSync(uint8_t *addr, int size)
@@ -64,6 +66,21 @@ RollableFile::RollableFile(const std::string &fpath, size_t blocksize, size_t me
     sliding_start = 0;
     sliding_map_off = 0;
     shm_sliding_start_ptr = NULL;
+    block_cache = NULL;
+    shm_cache_epoch = NULL;
+    cache_epoch_slots = 0;
+    cache_epoch_bits = 0;
+    num_access = 0;
+    hot_mem_used = 0;
+    adaptive_mmap = false;
+    prealloc_running = false;
+    prealloc_order = -1;
+    prealloc_map = false;
+    dirty_map = NULL;
+    dirty_map_size = 0;
+    snapshot_active.store(false, std::memory_order_relaxed);
+    snapshot_offset = 0;
+    pthread_mutex_init(&snapshot_mutex, NULL);
 
     if(mode & CONSTS::ACCESS_MODE_WRITER)
     {
@@ -99,7 +116,16 @@ RollableFile::RollableFile(const std::string &fpath, size_t blocksize, size_t me
         }
     }
 
+    if((mode & CONSTS::ADAPTIVE_MMAP) && !(mode & CONSTS::ACCESS_MODE_WRITER) &&
+       !(mode & CONSTS::MEMORY_ONLY_MODE))
+    {
+        adaptive_mmap = true;
+        Logger::Log(LOG_LEVEL_INFO, "adaptive mmap is turned on for " + fpath);
+    }
+
     files.assign(3, NULL);
+    hot_addrs.assign(3, NULL);
+    block_access.assign(3, 0);
     if(mode & CONSTS::SYNC_ON_WRITE)
         Logger::Log(LOG_LEVEL_INFO, "Sync is turned on for " + fpath);
 }
@@ -112,18 +138,232 @@ void RollableFile::InitShmSlidingAddr(std::atomic<size_t> *shm_sliding_addr)
 #endif
 }
 
+// num_slots must be a power of two.
+void RollableFile::InitShmCacheEpoch(std::atomic<uint32_t> *shm_epoch, uint32_t num_slots)
+{
+    shm_cache_epoch = shm_epoch;
+    cache_epoch_slots = num_slots;
+    cache_epoch_bits = 0;
+    while((1u << cache_epoch_bits) < num_slots)
+        cache_epoch_bits++;
+}
+
+// Enable the userspace page cache for blocks that are not memory mapped.
+// Only readers use the cache. Writer increments the page epochs in
+// shared memory after every modification.
+int RollableFile::InitBlockCache(size_t cache_size)
+{
+    if(mode & CONSTS::ACCESS_MODE_WRITER)
+        return MBError::SUCCESS;
+    if(shm_cache_epoch == NULL)
+        return MBError::NOT_INITIALIZED;
+
+    if(block_cache != NULL)
+    {
+        delete block_cache;
+        block_cache = NULL;
+    }
+    if(cache_size == 0)
+        return MBError::SUCCESS;
+
+    try {
+        block_cache = new BlockCache(cache_size, RollableFile::page_size);
+    } catch (int error) {
+        Logger::Log(LOG_LEVEL_WARN, "failed to create block cache for %s: %s",
+                    path.c_str(), MBError::get_error_str(error));
+        return error;
+    }
+
+    Logger::Log(LOG_LEVEL_INFO, "block cache size for %s: %llu", path.c_str(),
+                (unsigned long long) block_cache->GetCacheSize());
+    return MBError::SUCCESS;
+}
+
+void RollableFile::GetCacheStats(uint64_t &hits, uint64_t &misses) const
+{
+    if(block_cache != NULL)
+    {
+        hits = block_cache->GetHits();
+        misses = block_cache->GetMisses();
+    }
+    else
+    {
+        hits = 0;
+        misses = 0;
+    }
+}
+
+// Count the opened blocks and the bytes mapped or cached by this handle.
+void RollableFile::GetUsage(FileUsage &usage) const
+{
+    memset(&usage, 0, sizeof(usage));
+    for(size_t i = 0; i < files.size(); i++)
+    {
+        if(files[i] == NULL)
+            continue;
+        usage.num_block++;
+        if(files[i]->IsMapped() || (i < hot_addrs.size() && hot_addrs[i] != NULL))
+        {
+            usage.num_mapped_block++;
+            usage.mapped_bytes += block_size;
+        }
+    }
+    if(sliding_addr != NULL)
+        usage.mapped_bytes += sliding_size;
+    if(block_cache != NULL)
+        usage.cache_bytes = block_cache->GetCacheSize();
+}
+
+// Open all blocks below end_offset and return the memory mapped ones.
+void RollableFile::GetMappedRegions(size_t end_offset,
+                                    std::vector<std::pair<uint8_t*, size_t>> &regions)
+{
+    int num_block = end_offset / block_size + 1;
+    for(int order = 0; order < num_block; order++)
+    {
+        if(CheckAndOpenFile(order, false) != MBError::SUCCESS)
+            break;
+        if(!files[order]->IsMapped())
+            continue;
+        // The last region ends at end_offset.
+        size_t size = block_size;
+        if(order == num_block - 1)
+            size = end_offset - order * block_size;
+        if(size > 0)
+            regions.push_back(std::make_pair(files[order]->GetMapAddr(), size));
+    }
+}
+
+// Open the dirty map of the writer. A newly created map marks all ranges
+// as dirty since the modifications made before are unknown.
+int RollableFile::InitDirtyMap(const std::string &map_path)
+{
+    if(!(mode & CONSTS::ACCESS_MODE_WRITER) || (mode & CONSTS::MEMORY_ONLY_MODE))
+        return MBError::NOT_ALLOWED;
+
+    size_t num_range = (max_num_block * block_size + DIRTY_RANGE_SIZE - 1) / DIRTY_RANGE_SIZE;
+    size_t map_size = (num_range + 7) / 8;
+    map_size = (map_size + RollableFile::page_size - 1) / RollableFile::page_size *
+               RollableFile::page_size;
+
+    bool new_map = (access(map_path.c_str(), F_OK) != 0);
+    bool map_file = true;
+    dirty_file = ResourcePool::getInstance().OpenFile(map_path, mode, map_size,
+                                                      map_file, true);
+    if(!map_file || dirty_file->GetMapAddr() == NULL)
+    {
+        Logger::Log(LOG_LEVEL_WARN, "failed to map dirty map %s, incremental backup "
+                    "is disabled", map_path.c_str());
+        dirty_file = NULL;
+        return MBError::MMAP_FAILED;
+    }
+
+    dirty_map = dirty_file->GetMapAddr();
+    dirty_map_size = map_size;
+    if(new_map)
+        memset(dirty_map, 0xFF, dirty_map_size);
+    return MBError::SUCCESS;
+}
+
+// Get the dirty ranges below end_offset. Adjacent ranges are merged.
+// Ranges are returned as pairs of offset and size.
+void RollableFile::GetDirtyRanges(size_t end_offset,
+                                  std::vector<std::pair<size_t, size_t>> &ranges) const
+{
+    if(dirty_map == NULL)
+        return;
+
+    size_t num_range = (end_offset + DIRTY_RANGE_SIZE - 1) / DIRTY_RANGE_SIZE;
+    if(num_range > dirty_map_size * 8)
+        num_range = dirty_map_size * 8;
+    for(size_t r = 0; r < num_range; r++)
+    {
+        if(!(dirty_map[r >> 3] & (1 << (r & 7))))
+            continue;
+
+        size_t offset = r * DIRTY_RANGE_SIZE;
+        if(!ranges.empty() && ranges.back().first + ranges.back().second == offset)
+            ranges.back().second += DIRTY_RANGE_SIZE;
+        else
+            ranges.push_back(std::make_pair(offset, DIRTY_RANGE_SIZE));
+    }
+}
+
+void RollableFile::ClearDirtyMap()
+{
+    if(dirty_map != NULL)
+        memset(dirty_map, 0, dirty_map_size);
+}
+
+// Start saving the pages below end_offset before they are modified.
+// Must be called by the writer.
+void RollableFile::StartSnapshot(size_t end_offset)
+{
+    pthread_mutex_lock(&snapshot_mutex);
+    snapshot_pages.clear();
+    snapshot_offset = end_offset;
+    snapshot_active.store(true, std::memory_order_relaxed);
+    pthread_mutex_unlock(&snapshot_mutex);
+}
+
+// Stop saving pages and return the saved pages by offset.
+// Can be called by the snapshot thread.
+void RollableFile::StopSnapshot(std::map<size_t, std::string> &pages)
+{
+    pthread_mutex_lock(&snapshot_mutex);
+    snapshot_active.store(false, std::memory_order_relaxed);
+    pages.swap(snapshot_pages);
+    snapshot_pages.clear();
+    pthread_mutex_unlock(&snapshot_mutex);
+}
+
+// Save the original content of the pages to be written. Only the first
+// write to a page after the snapshot starts needs to be saved.
+void RollableFile::SaveSnapshotPages(size_t offset, size_t size)
+{
+    pthread_mutex_lock(&snapshot_mutex);
+    if(snapshot_active.load(std::memory_order_relaxed))
+    {
+        size_t page = offset - offset % RollableFile::page_size;
+        for(; page < offset + size && page < snapshot_offset; page += RollableFile::page_size)
+        {
+            if(snapshot_pages.find(page) != snapshot_pages.end())
+                continue;
+            std::string &buff = snapshot_pages[page];
+            buff.resize(RollableFile::page_size);
+            if(RandomRead(&buff[0], RollableFile::page_size, page) !=
+               static_cast<size_t>(RollableFile::page_size))
+            {
+                Logger::Log(LOG_LEVEL_WARN, "failed to save snapshot page %llu",
+                            (unsigned long long) page);
+            }
+        }
+    }
+    pthread_mutex_unlock(&snapshot_mutex);
+}
+
 void RollableFile::Close()
 {
+    WaitPrealloc();
+    prealloc_file.reset();
     if(sliding_addr != NULL)
     {
         munmap(sliding_addr, sliding_size);
         sliding_addr = NULL;
     }
+    if(block_cache != NULL)
+    {
+        delete block_cache;
+        block_cache = NULL;
+    }
+    for(size_t i = 0; i < hot_addrs.size(); i++)
+        UnmapHotBlock(i);
 }
 
 RollableFile::~RollableFile()
 {
     Close();
+    pthread_mutex_destroy(&snapshot_mutex);
 }
 
 int RollableFile::OpenAndMapBlockFile(int block_order, bool create_file)
@@ -138,32 +378,142 @@ int RollableFile::OpenAndMapBlockFile(int block_order, bool create_file)
     }
 
     int rval = MBError::SUCCESS;
-    std::stringstream ss;
-    ss << block_order;
 #ifdef __DEBUG__
     assert(files[block_order] == NULL);
 #endif
+    // Make sure the helper thread is not creating the same file.
+    WaitPrealloc();
 
     bool map_file;
-    if(mmap_mem > mem_used)
+    if(adaptive_mmap)
+        map_file = false; // Hot blocks are mapped in RebalanceHotBlocks.
+    else if(mmap_mem > mem_used)
         map_file = true; 
     else
         map_file = false;
-    if(!map_file && (mode & CONSTS::MEMORY_ONLY_MODE))
+    // Anonymous memory must be mapped. Shared memory objects can be read
+    // without mapping like files.
+    bool anon_mode = (mode & CONSTS::MEMORY_ONLY_MODE) &&
+                     !(mode & CONSTS::SHARED_MEMORY_MODE);
+    if(!map_file && anon_mode)
         return MBError::NO_MEMORY;
 
-    files[block_order] = ResourcePool::getInstance().OpenFile(path+ss.str(),
+    // Use the pre-created block if it was mapped the same way.
+    if(prealloc_file != NULL)
+    {
+        if(prealloc_order == block_order && prealloc_map == map_file)
+            ResourcePool::getInstance().AddResourceByPath(GetBlockFilePath(block_order),
+                                                          prealloc_file);
+        prealloc_file.reset();
+    }
+
+    files[block_order] = ResourcePool::getInstance().OpenFile(GetBlockFilePath(block_order),
                                                               mode,
                                                               block_size,
                                                               map_file,
                                                               create_file);
     if(map_file)
         mem_used += block_size;
-    else if(mode & CONSTS::MEMORY_ONLY_MODE)
+    else if(anon_mode)
         rval = MBError::MMAP_FAILED;
+
+    if(create_file && (mode & CONSTS::ACCESS_MODE_WRITER) &&
+       !(mode & CONSTS::MEMORY_ONLY_MODE))
+        StartPrealloc(block_order + 1);
     return rval;
 }
 
+std::string RollableFile::GetBlockFilePath(int order) const
+{
+    std::stringstream ss;
+    ss << order;
+    return path + ss.str();
+}
+
+void RollableFile::StartPrealloc(int order)
+{
+    if(order >= max_num_block)
+        return;
+    if(order < static_cast<int>(files.size()) && files[order] != NULL)
+        return;
+
+    prealloc_order = order;
+    // Use the same mmap decision as OpenAndMapBlockFile would make.
+    prealloc_map = (mmap_mem > mem_used);
+    if(pthread_create(&prealloc_tid, NULL, PreallocThread, this) != 0)
+    {
+        Logger::Log(LOG_LEVEL_WARN, "failed to start block pre-creation thread");
+        prealloc_order = -1;
+        return;
+    }
+    prealloc_running = true;
+}
+
+void RollableFile::WaitPrealloc()
+{
+    if(!prealloc_running)
+        return;
+
+    pthread_join(prealloc_tid, NULL);
+    prealloc_running = false;
+}
+
+void* RollableFile::PreallocThread(void *context)
+{
+    RollableFile *rfile = static_cast<RollableFile *>(context);
+    rfile->PreallocBlock();
+    return NULL;
+}
+
+// Runs in the helper thread: create the block file with disk space
+// allocated, add it to the resource pool and prefault its mapping.
+void RollableFile::PreallocBlock()
+{
+    std::string fpath = GetBlockFilePath(prealloc_order);
+    if(access(fpath.c_str(), F_OK) != 0)
+    {
+        FileIO file(fpath, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH, false);
+        if(file.Open() < 0)
+        {
+            Logger::Log(LOG_LEVEL_WARN, "failed to pre-create %s errno=%d",
+                        fpath.c_str(), errno);
+            return;
+        }
+        if(file.AllocateFile(block_size) != 0)
+        {
+            // Abandon the pre-creation; the writer creates the block file
+            // itself when it is needed.
+            Logger::Log(LOG_LEVEL_WARN, "failed to allocate %s errno=%d",
+                        fpath.c_str(), errno);
+            unlink(fpath.c_str());
+            return;
+        }
+    }
+
+    // The file is not added to the resource pool here. Otherwise a pool
+    // cleared while the thread is running could keep a stale mapping.
+    std::shared_ptr<MmapFileIO> block_file(new MmapFileIO(fpath, O_RDWR, block_size,
+                                           mode & CONSTS::SYNC_ON_WRITE));
+    if(prealloc_map)
+    {
+        if(block_file->MapFile(block_size, 0) == NULL)
+        {
+            Logger::Log(LOG_LEVEL_WARN, "failed to map %s", fpath.c_str());
+            return;
+        }
+        block_file->Close();
+
+        // Touch every page so that the writer does not take major faults.
+        volatile uint8_t *addr = block_file->GetMapAddr();
+        uint8_t sum = 0;
+        for(size_t off = 0; off < block_size; off += RollableFile::page_size)
+            sum += addr[off];
+        (void) sum;
+    }
+    prealloc_file = block_file;
+    Logger::Log(LOG_LEVEL_DEBUG, "pre-created block file %s", fpath.c_str());
+}
+
 // Need to make sure the required size at offset is aligned with
 // block_size and mmap_size. We should not write the size in two
 // different blocks or one in mmaped region and the other one on disk.
@@ -185,7 +535,11 @@ int RollableFile::CheckAndOpenFile(int order, bool create_file)
     int rval = MBError::SUCCESS;
 
     if(order >= static_cast<int>(files.size()))
+    {
         files.resize(order+3, NULL);
+        hot_addrs.resize(order+3, NULL);
+        block_access.resize(order+3, 0);
+    }
 
     if(files[order] == NULL)
         rval = OpenAndMapBlockFile(order, create_file);
@@ -209,6 +563,9 @@ uint8_t* RollableFile::GetShmPtr(size_t offset, int size)
         return files[order]->GetMapAddr() + index;
     }
 
+    if(hot_addrs[order] != NULL)
+        return hot_addrs[order] + (offset % block_size);
+
     if(sliding_mmap)
     {
         if(static_cast<off_t>(offset) >= sliding_start &&
@@ -232,6 +589,12 @@ int RollableFile::Reserve(size_t &offset, int size, uint8_t* &ptr, bool map_new_
     rval = CheckAndOpenFile(order, true);
     if(rval != MBError::SUCCESS)
         return rval;
+    MarkDirty(offset, size);
+
+    // Writes below the snapshot offset must go through RandomWrite so that
+    // the original pages are saved first.
+    if(SnapshotActive() && offset < snapshot_offset)
+        return rval;
 
     if(files[order]->IsMapped())
     {
@@ -256,6 +619,13 @@ int RollableFile::Reserve(size_t &offset, int size, uint8_t* &ptr, bool map_new_
                 // Load the mmap starting offset to shared memory so that readers
                 // can map the same region when reading it.
                 shm_sliding_start_ptr->store(sliding_start, std::memory_order_relaxed);
+                // Writer may modify the new sliding region using the memory
+                // address. Invalidate all pages cached by readers.
+                if(shm_cache_epoch != NULL)
+                {
+                    for(uint32_t i = 0; i < cache_epoch_slots; i++)
+                        shm_cache_epoch[i].fetch_add(1, std::memory_order_release);
+                }
             }
         }
     }
@@ -323,6 +693,9 @@ size_t RollableFile::RandomWrite(const void *data, size_t size, off_t offset)
     int rval = CheckAndOpenFile(order, false);
     if(rval != MBError::SUCCESS)
         return 0;
+    MarkDirty(offset, size);
+    if(SnapshotActive() && static_cast<size_t>(offset) < snapshot_offset)
+        SaveSnapshotPages(offset, size);
 
     // Check sliding map
     if(sliding_mmap && sliding_addr != NULL)
@@ -337,12 +710,37 @@ size_t RollableFile::RandomWrite(const void *data, size_t size, off_t offset)
                 if(msync(start_addr-page_off, size+page_off, MS_SYNC) == -1)
                     std::cout<<"msync error\n";
             }
+            IncCacheEpoch(offset, size);
             return size;
         }
     }
 
     int index = offset % block_size;
-    return files[order]->RandomWrite(data, size, index);
+    size_t bytes_written = files[order]->RandomWrite(data, size, index);
+    // Readers may not map the block even if writer does.
+    IncCacheEpoch(offset, size);
+    return bytes_written;
+}
+
+// Invalidate the pages cached by readers after writer modifies a buffer.
+// The epochs must be incremented after the data are written. Writes using
+// the memory address returned by Reserve or GetShmPtr must call this too.
+void RollableFile::IncCacheEpoch(size_t offset, size_t size)
+{
+    if(shm_cache_epoch == NULL || size == 0)
+        return;
+
+    size_t first_page = offset / RollableFile::page_size;
+    size_t last_page = (offset + size - 1) / RollableFile::page_size;
+    if(last_page - first_page >= cache_epoch_slots)
+    {
+        for(uint32_t i = 0; i < cache_epoch_slots; i++)
+            shm_cache_epoch[i].fetch_add(1, std::memory_order_release);
+        return;
+    }
+    for(size_t page = first_page; page <= last_page; page++)
+        shm_cache_epoch[BlockCacheEpochSlot(page, cache_epoch_bits)]
+            .fetch_add(1, std::memory_order_release);
 }
 
 void* RollableFile::NewReaderSlidingMap(int order)
@@ -389,10 +787,138 @@ size_t RollableFile::RandomRead(void *buff, size_t size, off_t offset)
         }
     }
 
+    if(adaptive_mmap)
+    {
+        UpdateBlockAccess(order);
+        if(hot_addrs[order] != NULL)
+        {
+            memcpy(buff, hot_addrs[order] + (offset % block_size), size);
+            return size;
+        }
+    }
+
+    if(block_cache != NULL && !files[order]->IsMapped())
+        return CachedRead(order, buff, size, offset);
+
     int index = offset % block_size;
     return files[order]->RandomRead(buff, size, index);
 }
 
+void RollableFile::UpdateBlockAccess(int order)
+{
+    block_access[order]++;
+    if(++num_access % ADAPTIVE_MMAP_INTERVAL == 0)
+    {
+        RebalanceHotBlocks();
+    }
+    else if(hot_addrs[order] == NULL && !files[order]->IsMapped() &&
+            hot_mem_used + block_size <= mmap_mem)
+    {
+        // Map the block right away if there is memory left.
+        MapHotBlock(order);
+    }
+}
+
+bool RollableFile::MapHotBlock(int order)
+{
+    uint8_t *addr = files[order]->MapFile(block_size, 0, true);
+    if(addr == NULL)
+        return false;
+
+    hot_addrs[order] = addr;
+    hot_mem_used += block_size;
+    return true;
+}
+
+void RollableFile::UnmapHotBlock(int order)
+{
+    if(hot_addrs[order] == NULL)
+        return;
+
+    munmap(hot_addrs[order], block_size);
+    hot_addrs[order] = NULL;
+    hot_mem_used -= block_size;
+}
+
+// Remap blocks based on access counts so that the most frequently
+// accessed blocks are kept in memory within the memcap budget. Access
+// counts are halved afterwards so that recent accesses weigh more.
+void RollableFile::RebalanceHotBlocks()
+{
+    std::vector<int> blocks;
+    for(size_t i = 0; i < files.size(); i++)
+    {
+        // Blocks mapped by ResourcePool are shared and always stay mapped.
+        if(files[i] != NULL && !files[i]->IsMapped())
+            blocks.push_back(i);
+    }
+    std::stable_sort(blocks.begin(), blocks.end(),
+                     [this](int a, int b) { return block_access[a] > block_access[b]; });
+
+    size_t num_hot = std::min(blocks.size(), mmap_mem / block_size);
+    for(size_t i = num_hot; i < blocks.size(); i++)
+        UnmapHotBlock(blocks[i]);
+    for(size_t i = 0; i < num_hot; i++)
+    {
+        if(block_access[blocks[i]] == 0)
+            break;
+        if(hot_addrs[blocks[i]] == NULL)
+            MapHotBlock(blocks[i]);
+    }
+
+    for(size_t i = 0; i < block_access.size(); i++)
+        block_access[i] >>= 1;
+    Logger::Log(LOG_LEVEL_DEBUG, "%s hot block memory: %llu", path.c_str(),
+                (unsigned long long) hot_mem_used);
+}
+
+// Read from unmapped block using the page cache. Pages in or beyond the
+// writer's sliding mmap region are not cached since they are still being
+// filled by the writer.
+size_t RollableFile::CachedRead(int order, void *buff, size_t size, off_t offset)
+{
+    size_t cache_page_size = block_cache->GetPageSize();
+    uint8_t *dst = reinterpret_cast<uint8_t *>(buff);
+    size_t bytes_read = 0;
+
+    while(bytes_read < size)
+    {
+        size_t curr_off = offset + bytes_read;
+        size_t page_off = curr_off - curr_off % cache_page_size;
+        size_t page_start = curr_off - page_off;
+        size_t len = cache_page_size - page_start;
+        if(len > size - bytes_read)
+            len = size - bytes_read;
+
+        uint32_t epoch = shm_cache_epoch[BlockCacheEpochSlot(page_off / cache_page_size,
+                                                             cache_epoch_bits)]
+                             .load(std::memory_order_acquire);
+        size_t writer_sliding_start = shm_sliding_start_ptr->load(std::memory_order_relaxed);
+        if(writer_sliding_start > 0 && page_off + cache_page_size > writer_sliding_start)
+            break;
+
+        uint8_t *page = block_cache->Lookup(page_off, epoch);
+        if(page == NULL)
+        {
+            page = block_cache->Allocate(page_off);
+            if(files[order]->RandomRead(page, cache_page_size, page_off % block_size)
+                   != cache_page_size)
+                break;
+            block_cache->Commit(page_off, epoch);
+        }
+
+        memcpy(dst + bytes_read, page + page_start, len);
+        bytes_read += len;
+    }
+
+    if(bytes_read < size)
+    {
+        int index = (offset + bytes_read) % block_size;
+        bytes_read += files[order]->RandomRead(dst + bytes_read, size - bytes_read, index);
+    }
+    return bytes_read;
+}
+
 void RollableFile::PrintStats(std::ostream &out_stream) const
 {
     out_stream << "Rollable file: " << path << " stats:" << std::endl;
@@ -402,6 +928,16 @@ void RollableFile::PrintStats(std::ostream &out_stream) const
         out_stream << "\tsliding mmap start: " << sliding_start << std::endl;
         out_stream << "\tsliding mmap size: " << sliding_mem_size << std::endl;
     }
+    if(adaptive_mmap)
+    {
+        out_stream << "\thot block memory: " << hot_mem_used << std::endl;
+    }
+    if(block_cache != NULL)
+    {
+        out_stream << "\tblock cache size: " << block_cache->GetCacheSize() << std::endl;
+        out_stream << "\tblock cache hits: " << block_cache->GetHits() << std::endl;
+        out_stream << "\tblock cache misses: " << block_cache->GetMisses() << std::endl;
+    }
 }
 
 void RollableFile::ResetSlidingWindow()
@@ -437,12 +973,26 @@ size_t RollableFile::GetResourceCollectionOffset() const
 void RollableFile::RemoveUnused(size_t max_size, bool writer_mode)
 {
     unsigned ibeg = max_size/(block_size + 1) + 1;
+
+    // Remove the pre-created block if it is not used.
+    WaitPrealloc();
+    prealloc_file.reset();
+    if(writer_mode && prealloc_order >= static_cast<int>(ibeg) &&
+       (prealloc_order >= static_cast<int>(files.size()) || files[prealloc_order] == NULL))
+    {
+        std::string fpath = GetBlockFilePath(prealloc_order);
+        ResourcePool::getInstance().RemoveResourceByPath(fpath);
+        unlink(fpath.c_str());
+    }
+    prealloc_order = -1;
+
     for(auto i = ibeg; i < files.size(); i++)
     {
         if(files[i] != NULL)
         {
             if(files[i]->IsMapped() && mem_used > block_size)
                 mem_used -= block_size;
+            UnmapHotBlock(i);
             if(writer_mode)
             {
                 ResourcePool::getInstance().RemoveResourceByPath(files[i]->GetFilePath());
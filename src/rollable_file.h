@@ -26,12 +26,19 @@
 #include <assert.h>
 #include <atomic>
 #include <memory>
+#include <map>
+#include <pthread.h>
 
 #include "mmap_file.h"
 #include "logger.h"
+#include "block_cache.h"
+#include "db.h"
 
 namespace mabain {
 
+// size of the range tracked by one bit in the dirty map
+#define DIRTY_RANGE_SIZE     (1024*1024ul)
+
 // Memory mapped file that can be rolled based on block size
 class RollableFile {
 public:
@@ -42,6 +49,12 @@ public:
     size_t   RandomWrite(const void *data, size_t size, off_t offset);
     size_t   RandomRead(void *buff, size_t size, off_t offset);
     void     InitShmSlidingAddr(std::atomic<size_t> *shm_sliding_addr);
+    void     InitShmCacheEpoch(std::atomic<uint32_t> *shm_epoch, uint32_t num_slots);
+    int      InitBlockCache(size_t cache_size);
+    void     GetCacheStats(uint64_t &hits, uint64_t &misses) const;
+    void     GetUsage(FileUsage &usage) const;
+    void     GetMappedRegions(size_t end_offset,
+                              std::vector<std::pair<uint8_t*, size_t>> &regions);
     int      Reserve(size_t &offset, int size, uint8_t* &ptr, bool map_new_sliding=true);
     uint8_t* GetShmPtr(size_t offset, int size);
     size_t   CheckAlignment(size_t offset, int size);
@@ -53,6 +66,17 @@ public:
     size_t   GetResourceCollectionOffset() const;
     void     RemoveUnused(size_t max_size, bool writer_mode);
 
+    int      InitDirtyMap(const std::string &map_path);
+    inline void MarkDirty(size_t offset, size_t size);
+    void     IncCacheEpoch(size_t offset, size_t size);
+    void     GetDirtyRanges(size_t end_offset,
+                            std::vector<std::pair<size_t, size_t>> &ranges) const;
+    void     ClearDirtyMap();
+
+    void     StartSnapshot(size_t end_offset);
+    void     StopSnapshot(std::map<size_t, std::string> &pages);
+    inline bool SnapshotActive() const;
+
     static const long page_size;
     static int ShmSync(uint8_t *addr, int size);
 
@@ -61,6 +85,17 @@ private:
     int      CheckAndOpenFile(int block_order, bool create_file);
     uint8_t* NewSlidingMapAddr(int order, size_t offset, int size);
     void*    NewReaderSlidingMap(int order);
+    size_t   CachedRead(int order, void *buff, size_t size, off_t offset);
+    void     UpdateBlockAccess(int order);
+    void     RebalanceHotBlocks();
+    bool     MapHotBlock(int order);
+    void     UnmapHotBlock(int order);
+    std::string GetBlockFilePath(int order) const;
+    void     StartPrealloc(int order);
+    void     WaitPrealloc();
+    void     PreallocBlock();
+    static void* PreallocThread(void *context);
+    void     SaveSnapshotPages(size_t offset, size_t size);
 
     std::string path;
     size_t block_size;
@@ -84,8 +119,65 @@ private:
 
     int rc_offset_percentage;
     size_t mem_used;
+
+    // Page cache for blocks that are not memory mapped (reader only)
+    BlockCache *block_cache;
+    // shared memory epoch counters for validating cached pages
+    std::atomic<uint32_t> *shm_cache_epoch;
+    uint32_t cache_epoch_slots;
+    int cache_epoch_bits;
+
+    // Adaptive mmap (reader only): memcap is used as a budget for mapping
+    // the most frequently accessed blocks. These mappings are private to
+    // this handle and remapped periodically based on the access counts.
+    bool adaptive_mmap;
+    std::vector<uint8_t*> hot_addrs;
+    std::vector<uint64_t> block_access;
+    uint64_t num_access;
+    size_t hot_mem_used;
+
+    // Writer pre-creates the next block in a helper thread so that
+    // block roll-over does not stall insertions.
+    pthread_t prealloc_tid;
+    bool prealloc_running;
+    int prealloc_order;
+    bool prealloc_map;
+    std::shared_ptr<MmapFileIO> prealloc_file;
+
+    // Writer keeps a persistent bitmap of the ranges modified since the
+    // last backup so that incremental backups copy changed ranges only.
+    std::shared_ptr<MmapFileIO> dirty_file;
+    uint8_t *dirty_map;
+    size_t dirty_map_size;
+
+    // Online snapshot (writer only): pages below snapshot_offset are
+    // saved before being overwritten so that the snapshot thread can
+    // restore the image at the time the snapshot started.
+    std::atomic<bool> snapshot_active;
+    size_t snapshot_offset;
+    std::map<size_t, std::string> snapshot_pages;
+    pthread_mutex_t snapshot_mutex;
 };
 
+inline bool RollableFile::SnapshotActive() const
+{
+    return snapshot_active.load(std::memory_order_relaxed);
+}
+
+// Mark the ranges modified by writer. Bits are set before the data
+// are written so that a failed write is still picked up by next backup.
+inline void RollableFile::MarkDirty(size_t offset, size_t size)
+{
+    if(dirty_map == NULL || size == 0)
+        return;
+
+    size_t last = (offset + size - 1) / DIRTY_RANGE_SIZE;
+    if(last >= dirty_map_size * 8)
+        last = dirty_map_size * 8 - 1;
+    for(size_t r = offset / DIRTY_RANGE_SIZE; r <= last; r++)
+        dirty_map[r >> 3] |= static_cast<uint8_t>(1 << (r & 7));
+}
+
 }
 
 #endif
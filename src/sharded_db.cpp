@@ -0,0 +1,692 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <algorithm>
+#include <sstream>
+
+#include "sharded_db.h"
+#include "file_io.h"
+#include "error.h"
+#include "logger.h"
+#include "util/crc32c.h"
+
+#define SHARD_JOB_ADD      1
+#define SHARD_JOB_REMOVE   2
+#define SHARD_JOB_TASK     3
+
+namespace mabain {
+
+typedef struct _ShardLayout
+{
+    uint32_t magic;
+    uint32_t partition;
+    uint32_t num_shards;
+    // checksum of the split keys for range partitioning
+    uint32_t split_crc;
+} ShardLayout;
+
+ShardedDB::iterator::iterator() : state(DB_ITER_STATE_DONE)
+{
+}
+
+bool ShardedDB::iterator::operator!=(const iterator &rhs) const
+{
+    return state != rhs.state;
+}
+
+const ShardedDB::iterator& ShardedDB::iterator::operator++()
+{
+    next();
+    return *this;
+}
+
+// Add the current key of the shard iterator to the heap unless the shard
+// has no more entries.
+void ShardedDB::iterator::push_shard(int shard_index)
+{
+    DB::iterator &shard_iter = *merge->shard_iters[shard_index];
+    if(shard_iter != merge->readers[shard_index]->end())
+        merge->heap.push(HeapEntry(shard_iter.key, shard_index));
+}
+
+// Take the smallest key from the heap and advance the shard it came from.
+void ShardedDB::iterator::next()
+{
+    if(merge == NULL || merge->heap.empty())
+    {
+        state = DB_ITER_STATE_DONE;
+        key.clear();
+        value.clear();
+        return;
+    }
+
+    int shard_index = merge->heap.top().second;
+    key = merge->heap.top().first;
+    merge->heap.pop();
+    DB::iterator &shard_iter = *merge->shard_iters[shard_index];
+    value.assign(reinterpret_cast<const char *>(shard_iter.value.buff),
+                 shard_iter.value.data_len);
+    ++shard_iter;
+    push_shard(shard_index);
+    state = DB_ITER_STATE_MORE;
+}
+
+ShardedDB::ShardedDB(const MBConfig &config, int nshards,
+                     const std::vector<std::string> &splits)
+                   : num_shards(nshards),
+                     partition(MABAIN_SHARD_PARTITION_HASH),
+                     split_keys(splits),
+                     writer_mode(config.options & CONSTS::ACCESS_MODE_WRITER),
+                     status(MBError::NOT_INITIALIZED)
+{
+    if(config.mbdir == NULL || num_shards <= 0 || num_shards > MABAIN_SHARD_MAX_NUM)
+    {
+        status = MBError::INVALID_ARG;
+        return;
+    }
+    // Replication and async writer are per DB directory.
+    if(config.repl_endpoint != NULL || (config.options & CONSTS::ASYNC_WRITER_MODE))
+    {
+        status = MBError::INVALID_ARG;
+        return;
+    }
+
+    if(!split_keys.empty())
+    {
+        partition = MABAIN_SHARD_PARTITION_RANGE;
+        if(static_cast<int>(split_keys.size()) != num_shards - 1)
+        {
+            status = MBError::INVALID_ARG;
+            return;
+        }
+        for(size_t i = 1; i < split_keys.size(); i++)
+        {
+            if(!(split_keys[i-1] < split_keys[i]))
+            {
+                status = MBError::INVALID_ARG;
+                return;
+            }
+        }
+    }
+
+    status = CheckLayout(config.mbdir, writer_mode);
+    if(status != MBError::SUCCESS)
+    {
+        Logger::Log(LOG_LEVEL_ERROR, "sharded db layout in %s does not match: %s",
+                    config.mbdir, MBError::get_error_str(status));
+        return;
+    }
+
+    status = OpenShards(config);
+    if(status != MBError::SUCCESS)
+    {
+        Close();
+        return;
+    }
+    Logger::Log(LOG_LEVEL_INFO, "sharded db %s opened with %d shards",
+                config.mbdir, num_shards);
+}
+
+ShardedDB::~ShardedDB()
+{
+    Close();
+}
+
+// Writer saves the partitioning so that readers cannot use a different one.
+int ShardedDB::CheckLayout(const std::string &mbdir, bool writer)
+{
+    ShardLayout layout;
+    memset(&layout, 0, sizeof(layout));
+    layout.magic = MABAIN_SHARD_LAYOUT_MAGIC;
+    layout.partition = partition;
+    layout.num_shards = num_shards;
+    for(size_t i = 0; i < split_keys.size(); i++)
+    {
+        uint32_t len = split_keys[i].size();
+        layout.split_crc = crc32c(layout.split_crc, &len, sizeof(len));
+        layout.split_crc = crc32c(layout.split_crc, split_keys[i].data(), len);
+    }
+
+    std::string layout_path = mbdir + MABAIN_SHARD_LAYOUT_FILE;
+    FileIO layout_file(layout_path, O_RDWR, 0, false);
+    if(layout_file.Open() < 0)
+    {
+        if(!writer)
+            return MBError::NOT_EXIST;
+        FileIO new_file(layout_path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH, true);
+        if(new_file.Open() < 0)
+            return MBError::OPEN_FAILURE;
+        if(new_file.Write(&layout, sizeof(layout)) != sizeof(layout))
+            return MBError::WRITE_ERROR;
+        return MBError::SUCCESS;
+    }
+
+    ShardLayout saved;
+    if(layout_file.Read(&saved, sizeof(saved)) != sizeof(saved))
+        return MBError::READ_ERROR;
+    if(memcmp(&saved, &layout, sizeof(layout)) != 0)
+        return MBError::INVALID_ARG;
+    return MBError::SUCCESS;
+}
+
+int ShardedDB::OpenShards(const MBConfig &config)
+{
+    for(int i = 0; i < num_shards; i++)
+    {
+        Shard *shard = new Shard();
+        shard->sdb = this;
+        shard->db = NULL;
+        shard->reader = NULL;
+        shard->running = false;
+        shard->num_pending = 0;
+        shard->async_error = MBError::SUCCESS;
+        shard->stop_processing = false;
+        if(pthread_mutex_init(&shard->mutex, NULL) != 0 ||
+           pthread_cond_init(&shard->cond_request, NULL) != 0 ||
+           pthread_cond_init(&shard->cond_done, NULL) != 0)
+        {
+            Logger::Log(LOG_LEVEL_ERROR, "failed to init shard mutex");
+            throw (int) MBError::MUTEX_ERROR;
+        }
+        shards.push_back(shard);
+
+        std::stringstream ss;
+        ss << config.mbdir << "shard_" << i << "/";
+        std::string shard_dir = ss.str();
+        if(writer_mode && mkdir(shard_dir.c_str(), 0755) != 0 && errno != EEXIST)
+        {
+            Logger::Log(LOG_LEVEL_ERROR, "failed to create %s errno=%d",
+                        shard_dir.c_str(), errno);
+            return MBError::OPEN_FAILURE;
+        }
+
+        MBConfig shard_config = config;
+        shard_config.mbdir = shard_dir.c_str();
+        shard_config.memcap_index = config.memcap_index / num_shards;
+        shard_config.memcap_data = config.memcap_data / num_shards;
+        shard->db = new DB(shard_config);
+        if(!shard->db->is_open())
+        {
+            Logger::Log(LOG_LEVEL_ERROR, "failed to open shard %s: %s",
+                        shard_dir.c_str(), shard->db->StatusStr());
+            return shard->db->Status();
+        }
+
+        shard_config.options &= ~CONSTS::ACCESS_MODE_WRITER;
+        shard_config.options &= ~CONSTS::CHANGE_NOTIFY;
+        shard->reader = new DB(shard_config);
+        if(!shard->reader->is_open())
+        {
+            Logger::Log(LOG_LEVEL_ERROR, "failed to open shard reader %s: %s",
+                        shard_dir.c_str(), shard->reader->StatusStr());
+            return shard->reader->Status();
+        }
+
+        if(pthread_create(&shard->tid, NULL, shard_thread, shard) != 0)
+        {
+            Logger::Log(LOG_LEVEL_ERROR, "failed to create shard thread");
+            return MBError::THREAD_FAILED;
+        }
+        shard->running = true;
+    }
+
+    return MBError::SUCCESS;
+}
+
+int ShardedDB::Status() const
+{
+    return status;
+}
+
+int ShardedDB::NumShards() const
+{
+    return num_shards;
+}
+
+int ShardedDB::GetShard(const std::string &key) const
+{
+    if(partition == MABAIN_SHARD_PARTITION_RANGE)
+        return std::upper_bound(split_keys.begin(), split_keys.end(), key) -
+               split_keys.begin();
+    return crc32c(0, key.data(), key.size()) % num_shards;
+}
+
+// Queue the job to the shard. Job is moved to the queue.
+int ShardedDB::Submit(int shard_index, ShardJob &job)
+{
+    if(status != MBError::SUCCESS)
+        return status;
+
+    Shard *shard = shards[shard_index];
+    pthread_mutex_lock(&shard->mutex);
+    while(shard->num_pending >= MABAIN_SHARD_QUEUE_SIZE && !shard->stop_processing)
+        pthread_cond_wait(&shard->cond_done, &shard->mutex);
+    if(shard->stop_processing)
+    {
+        pthread_mutex_unlock(&shard->mutex);
+        return MBError::DB_CLOSED;
+    }
+
+    shard->jobs.push_back(ShardJob());
+    ShardJob &queued = shard->jobs.back();
+    queued.type = job.type;
+    queued.key.swap(job.key);
+    queued.value.swap(job.value);
+    queued.overwrite = job.overwrite;
+    queued.task.swap(job.task);
+    queued.completion = job.completion;
+    queued.rval = job.rval;
+    shard->num_pending++;
+    pthread_cond_signal(&shard->cond_request);
+    pthread_mutex_unlock(&shard->mutex);
+
+    return MBError::SUCCESS;
+}
+
+static void completion_wait(pthread_mutex_t *mutex, pthread_cond_t *cond, int *pending)
+{
+    pthread_mutex_lock(mutex);
+    while(*pending > 0)
+        pthread_cond_wait(cond, mutex);
+    pthread_mutex_unlock(mutex);
+}
+
+int ShardedDB::RunTask(int shard_index, std::function<int(DB *db)> task)
+{
+    ShardCompletion completion;
+    pthread_mutex_init(&completion.mutex, NULL);
+    pthread_cond_init(&completion.cond, NULL);
+    completion.pending = 1;
+
+    int rval = MBError::SUCCESS;
+    ShardJob job;
+    job.type = SHARD_JOB_TASK;
+    job.overwrite = false;
+    job.task = task;
+    job.completion = &completion;
+    job.rval = &rval;
+    int rc = Submit(shard_index, job);
+    if(rc == MBError::SUCCESS)
+        completion_wait(&completion.mutex, &completion.cond, &completion.pending);
+    else
+        rval = rc;
+
+    pthread_mutex_destroy(&completion.mutex);
+    pthread_cond_destroy(&completion.cond);
+    return rval;
+}
+
+// Run the task in all shard threads in parallel. The first error is returned.
+int ShardedDB::RunOnAllShards(std::function<int(DB *db, int shard_index)> task)
+{
+    ShardCompletion completion;
+    pthread_mutex_init(&completion.mutex, NULL);
+    pthread_cond_init(&completion.cond, NULL);
+    completion.pending = 0;
+
+    std::vector<int> rvals(num_shards, MBError::SUCCESS);
+    int rval = MBError::SUCCESS;
+    for(int i = 0; i < num_shards; i++)
+    {
+        ShardJob job;
+        job.type = SHARD_JOB_TASK;
+        job.overwrite = false;
+        job.task = std::bind(task, std::placeholders::_1, i);
+        job.completion = &completion;
+        job.rval = &rvals[i];
+
+        pthread_mutex_lock(&completion.mutex);
+        completion.pending++;
+        pthread_mutex_unlock(&completion.mutex);
+        int rc = Submit(i, job);
+        if(rc != MBError::SUCCESS)
+        {
+            pthread_mutex_lock(&completion.mutex);
+            completion.pending--;
+            pthread_mutex_unlock(&completion.mutex);
+            rval = rc;
+            break;
+        }
+    }
+    completion_wait(&completion.mutex, &completion.cond, &completion.pending);
+
+    pthread_mutex_destroy(&completion.mutex);
+    pthread_cond_destroy(&completion.cond);
+    for(int i = 0; i < num_shards && rval == MBError::SUCCESS; i++)
+        rval = rvals[i];
+    return rval;
+}
+
+int ShardedDB::Add(const std::string &key, const std::string &value, bool overwrite)
+{
+    return RunTask(GetShard(key), [&key, &value, overwrite](DB *db) {
+        return db->Add(key, value, overwrite);
+    });
+}
+
+int ShardedDB::Remove(const std::string &key)
+{
+    return RunTask(GetShard(key), [&key](DB *db) {
+        return db->Remove(key);
+    });
+}
+
+int ShardedDB::RemoveAll()
+{
+    return RunOnAllShards([](DB *db, int shard_index) {
+        return db->RemoveAll();
+    });
+}
+
+int ShardedDB::AddAsync(const std::string &key, const std::string &value, bool overwrite)
+{
+    if(!writer_mode)
+        return MBError::NOT_ALLOWED;
+
+    ShardJob job;
+    job.type = SHARD_JOB_ADD;
+    job.key = key;
+    job.value = value;
+    job.overwrite = overwrite;
+    job.completion = NULL;
+    job.rval = NULL;
+    return Submit(GetShard(key), job);
+}
+
+int ShardedDB::RemoveAsync(const std::string &key)
+{
+    if(!writer_mode)
+        return MBError::NOT_ALLOWED;
+
+    ShardJob job;
+    job.type = SHARD_JOB_REMOVE;
+    job.key = key;
+    job.overwrite = false;
+    job.completion = NULL;
+    job.rval = NULL;
+    return Submit(GetShard(key), job);
+}
+
+int ShardedDB::Wait()
+{
+    int rval = MBError::SUCCESS;
+    for(size_t i = 0; i < shards.size(); i++)
+    {
+        Shard *shard = shards[i];
+        pthread_mutex_lock(&shard->mutex);
+        while(shard->num_pending > 0 && !shard->stop_processing)
+            pthread_cond_wait(&shard->cond_done, &shard->mutex);
+        if(rval == MBError::SUCCESS)
+            rval = shard->async_error;
+        shard->async_error = MBError::SUCCESS;
+        pthread_mutex_unlock(&shard->mutex);
+    }
+    return rval;
+}
+
+int ShardedDB::Find(const std::string &key, MBData &data) const
+{
+    if(status != MBError::SUCCESS)
+        return status;
+    return shards[GetShard(key)]->reader->Find(key, data);
+}
+
+int ShardedDB::FindBatch(const std::vector<std::string> &keys,
+                         std::vector<std::string> &values, std::vector<int> &rvals)
+{
+    values.assign(keys.size(), std::string());
+    rvals.assign(keys.size(), MBError::NOT_EXIST);
+
+    std::vector<std::vector<size_t> > shard_keys(num_shards);
+    for(size_t i = 0; i < keys.size(); i++)
+        shard_keys[GetShard(keys[i])].push_back(i);
+
+    // Each shard thread writes to the slots of its own keys.
+    return RunOnAllShards([&](DB *db, int shard_index) {
+        MBData mbd;
+        const std::vector<size_t> &indexes = shard_keys[shard_index];
+        for(size_t i = 0; i < indexes.size(); i++)
+        {
+            size_t k = indexes[i];
+            rvals[k] = db->Find(keys[k], mbd);
+            if(rvals[k] == MBError::SUCCESS)
+                values[k].assign(reinterpret_cast<const char *>(mbd.buff), mbd.data_len);
+            mbd.Clear();
+        }
+        return MBError::SUCCESS;
+    });
+}
+
+// Prefixes of the key can be in any shard for hash partitioning. They
+// are in the shard of the key or the preceding shards for range
+// partitioning.
+int ShardedDB::FindLongestPrefix(const std::string &key, MBData &data) const
+{
+    if(status != MBError::SUCCESS)
+        return status;
+
+    int last = num_shards - 1;
+    if(partition == MABAIN_SHARD_PARTITION_RANGE)
+        last = GetShard(key);
+
+    int best_shard = -1;
+    int best_len = 0;
+    int rval = MBError::NOT_EXIST;
+    MBData mbd;
+    for(int i = 0; i <= last; i++)
+    {
+        rval = shards[i]->reader->FindLongestPrefix(key, mbd);
+        if(rval == MBError::SUCCESS)
+        {
+            if(best_shard < 0 || mbd.match_len > best_len)
+            {
+                best_shard = i;
+                best_len = mbd.match_len;
+            }
+        }
+        else if(rval != MBError::NOT_EXIST)
+        {
+            return rval;
+        }
+        mbd.Clear();
+    }
+
+    if(best_shard < 0)
+        return MBError::NOT_EXIST;
+    return shards[best_shard]->reader->FindLongestPrefix(key, data);
+}
+
+int ShardedDB::FindByPrefix(const std::string &prefix, std::vector<ShardedKV> &kvs,
+                            size_t max_count)
+{
+    kvs.clear();
+    if(status != MBError::SUCCESS)
+        return status;
+
+    for(iterator iter = begin(prefix); iter != end(); ++iter)
+    {
+        kvs.push_back(ShardedKV());
+        kvs.back().key.swap(iter.key);
+        kvs.back().value.swap(iter.value);
+        if(max_count > 0 && kvs.size() >= max_count)
+            break;
+    }
+    return MBError::SUCCESS;
+}
+
+int64_t ShardedDB::Count() const
+{
+    int64_t count = 0;
+    for(size_t i = 0; i < shards.size(); i++)
+    {
+        if(shards[i]->reader != NULL)
+            count += shards[i]->reader->Count();
+    }
+    return count;
+}
+
+// Keys with the prefix can be in any shard for hash partitioning. For
+// range partitioning, they start from the shard of the prefix and span
+// the following shards whose lowest keys also start with the prefix.
+ShardedDB::iterator ShardedDB::begin(const std::string &prefix)
+{
+    iterator iter;
+    if(status != MBError::SUCCESS)
+        return iter;
+
+    int first = 0;
+    int last = num_shards - 1;
+    if(partition == MABAIN_SHARD_PARTITION_RANGE)
+    {
+        first = GetShard(prefix);
+        last = first;
+        while(last < num_shards - 1 &&
+              split_keys[last].compare(0, prefix.size(), prefix) == 0)
+            last++;
+    }
+
+    iter.merge = std::make_shared<iterator::MergeState>();
+    iter.merge->readers.resize(num_shards);
+    iter.merge->shard_iters.resize(num_shards);
+    for(int i = first; i <= last; i++)
+    {
+        iter.merge->readers[i] = shards[i]->reader;
+        iter.merge->shard_iters[i] = std::make_shared<DB::iterator>(*shards[i]->reader,
+                                                                    DB_ITER_STATE_INIT);
+        iter.merge->shard_iters[i]->init_prefix(prefix);
+        iter.push_shard(i);
+    }
+
+    iter.next();
+    return iter;
+}
+
+const ShardedDB::iterator ShardedDB::end() const
+{
+    return iterator();
+}
+
+// Stop the shard threads after all queued jobs are done.
+void ShardedDB::Close()
+{
+    for(size_t i = 0; i < shards.size(); i++)
+    {
+        Shard *shard = shards[i];
+        pthread_mutex_lock(&shard->mutex);
+        shard->stop_processing = true;
+        pthread_cond_broadcast(&shard->cond_request);
+        pthread_cond_broadcast(&shard->cond_done);
+        pthread_mutex_unlock(&shard->mutex);
+    }
+
+    for(size_t i = 0; i < shards.size(); i++)
+    {
+        Shard *shard = shards[i];
+        if(shard->running)
+            pthread_join(shard->tid, NULL);
+        if(shard->reader != NULL)
+            delete shard->reader;
+        if(shard->db != NULL)
+            delete shard->db;
+        pthread_mutex_destroy(&shard->mutex);
+        pthread_cond_destroy(&shard->cond_request);
+        pthread_cond_destroy(&shard->cond_done);
+        delete shard;
+    }
+    shards.clear();
+    if(status == MBError::SUCCESS)
+        status = MBError::DB_CLOSED;
+}
+
+void* ShardedDB::shard_thread(void *context)
+{
+    Shard *shard = static_cast<Shard *>(context);
+    shard->sdb->ProcessJobs(shard);
+    return NULL;
+}
+
+// Jobs are taken from the queue in batches to reduce the lock overhead
+// of the queue.
+void ShardedDB::ProcessJobs(Shard *shard)
+{
+    std::deque<ShardJob> batch;
+
+    while(true)
+    {
+        pthread_mutex_lock(&shard->mutex);
+        while(shard->jobs.empty() && !shard->stop_processing)
+            pthread_cond_wait(&shard->cond_request, &shard->mutex);
+        if(shard->jobs.empty())
+        {
+            // stop_processing is set and there is nothing left
+            pthread_mutex_unlock(&shard->mutex);
+            break;
+        }
+        batch.swap(shard->jobs);
+        pthread_mutex_unlock(&shard->mutex);
+
+        int async_error = MBError::SUCCESS;
+        for(std::deque<ShardJob>::iterator it = batch.begin(); it != batch.end(); ++it)
+        {
+            int rval;
+            switch(it->type)
+            {
+                case SHARD_JOB_ADD:
+                    rval = shard->db->Add(it->key, it->value, it->overwrite);
+                    break;
+                case SHARD_JOB_REMOVE:
+                    rval = shard->db->Remove(it->key);
+                    break;
+                default:
+                    rval = it->task(shard->db);
+                    break;
+            }
+
+            if(it->completion != NULL)
+            {
+                ShardCompletion *completion = it->completion;
+                pthread_mutex_lock(&completion->mutex);
+                *it->rval = rval;
+                completion->pending--;
+                pthread_cond_broadcast(&completion->cond);
+                pthread_mutex_unlock(&completion->mutex);
+            }
+            else if(rval != MBError::SUCCESS && async_error == MBError::SUCCESS)
+            {
+                async_error = rval;
+                Logger::Log(LOG_LEVEL_DEBUG, "queued write failed: %s",
+                            MBError::get_error_str(rval));
+            }
+        }
+
+        pthread_mutex_lock(&shard->mutex);
+        shard->num_pending -= batch.size();
+        if(shard->async_error == MBError::SUCCESS)
+            shard->async_error = async_error;
+        pthread_cond_broadcast(&shard->cond_done);
+        pthread_mutex_unlock(&shard->mutex);
+        batch.clear();
+    }
+}
+
+}
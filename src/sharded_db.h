@@ -0,0 +1,194 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __SHARDED_DB_H__
+#define __SHARDED_DB_H__
+
+#include <pthread.h>
+#include <string>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <queue>
+
+#include "db.h"
+
+namespace mabain {
+
+#define MABAIN_SHARD_MAX_NUM         256
+// maximum number of queued writes per shard
+#define MABAIN_SHARD_QUEUE_SIZE      4096
+#define MABAIN_SHARD_LAYOUT_FILE     "_mabain_shards"
+#define MABAIN_SHARD_LAYOUT_MAGIC    0x4D425348
+#define MABAIN_SHARD_PARTITION_HASH  0
+#define MABAIN_SHARD_PARTITION_RANGE 1
+
+typedef struct _ShardedKV
+{
+    std::string key;
+    std::string value;
+} ShardedKV;
+
+// Keys partitioned across several mabain directories so that each shard
+// has its own writer. Shard i is in the directory mbdir/shard_<i>/.
+// Every shard has a thread that owns its DB handle. Writes and batched
+// lookups are queued to the shard threads, so callers in different
+// threads can write to all shards at the same time. Find, prefix queries,
+// Count and iterators use reader handles of the caller and should only
+// be called by one thread at a time, like DB.
+class ShardedDB
+{
+public:
+    // Iterator over the entries of all shards in key order. Each shard is
+    // read in key order by a prefix iterator of its reader and the shards
+    // are merged with a heap holding the current key of every shard.
+    class iterator
+    {
+    friend class ShardedDB;
+
+    public:
+        std::string key;
+        std::string value;
+
+        iterator();
+        bool operator!=(const iterator &rhs) const;
+        const iterator& operator++();
+
+    private:
+        typedef std::pair<std::string, int> HeapEntry;
+        typedef struct _MergeState
+        {
+            std::vector<DB*> readers;
+            std::vector<std::shared_ptr<DB::iterator> > shard_iters;
+            // smallest key first
+            std::priority_queue<HeapEntry, std::vector<HeapEntry>,
+                                std::greater<HeapEntry> > heap;
+        } MergeState;
+
+        void next();
+        void push_shard(int shard_index);
+
+        // shared by the copies of the iterator
+        std::shared_ptr<MergeState> merge;
+        int state;
+    };
+
+    // Hash partitioning: keys are hashed to num_shards shards.
+    // Range partitioning: split_keys has num_shards-1 keys in increasing
+    // order. Shard i holds keys in [split_keys[i-1], split_keys[i]).
+    // The partitioning is saved in mbdir by the writer and readers must
+    // use the same one. memcap_index and memcap_data are divided evenly
+    // among shards.
+    ShardedDB(const MBConfig &config, int num_shards,
+              const std::vector<std::string> &split_keys = std::vector<std::string>());
+    ~ShardedDB();
+
+    int  Status() const;
+    int  NumShards() const;
+    // Index of the shard for the key
+    int  GetShard(const std::string &key) const;
+
+    // Synchronous writes; return after the shard thread applies them.
+    int  Add(const std::string &key, const std::string &value, bool overwrite = false);
+    int  Remove(const std::string &key);
+    int  RemoveAll();
+    // Queue writes to the shard threads. Block if the shard queue is full.
+    int  AddAsync(const std::string &key, const std::string &value, bool overwrite = false);
+    int  RemoveAsync(const std::string &key);
+    // Wait for all queued writes. Return the first error of the queued
+    // writes since the last call.
+    int  Wait();
+
+    int  Find(const std::string &key, MBData &data) const;
+    // Lookups are grouped by shard and done by the shard threads in
+    // parallel. rvals has the result of every key.
+    int  FindBatch(const std::vector<std::string> &keys,
+                   std::vector<std::string> &values, std::vector<int> &rvals);
+    // Longest prefix match of the key among all shards
+    int  FindLongestPrefix(const std::string &key, MBData &data) const;
+    // Entries starting with the prefix in key order. At most max_count
+    // entries are returned if max_count is not zero.
+    int  FindByPrefix(const std::string &prefix, std::vector<ShardedKV> &kvs,
+                      size_t max_count = 0);
+    int64_t Count() const;
+
+    // Only entries starting with the prefix are returned.
+    iterator begin(const std::string &prefix = "");
+    const iterator end() const;
+
+    void Close();
+
+private:
+    typedef struct _ShardCompletion
+    {
+        pthread_mutex_t mutex;
+        pthread_cond_t  cond;
+        int pending;
+    } ShardCompletion;
+
+    typedef struct _ShardJob
+    {
+        int type;
+        std::string key;
+        std::string value;
+        bool overwrite;
+        // used by synchronous jobs only
+        std::function<int(DB *db)> task;
+        ShardCompletion *completion;
+        int *rval;
+    } ShardJob;
+
+    typedef struct _Shard
+    {
+        ShardedDB *sdb;
+        // used by the shard thread only
+        DB *db;
+        // used by the caller
+        DB *reader;
+        pthread_t tid;
+        bool running;
+
+        pthread_mutex_t mutex;
+        pthread_cond_t  cond_request;
+        pthread_cond_t  cond_done;
+        std::deque<ShardJob> jobs;
+        int num_pending;
+        int async_error;
+        bool stop_processing;
+    } Shard;
+
+    int  CheckLayout(const std::string &mbdir, bool writer);
+    int  OpenShards(const MBConfig &config);
+    int  Submit(int shard_index, ShardJob &job);
+    int  RunTask(int shard_index, std::function<int(DB *db)> task);
+    int  RunOnAllShards(std::function<int(DB *db, int shard_index)> task);
+    static void* shard_thread(void *context);
+    void ProcessJobs(Shard *shard);
+
+    std::vector<Shard*> shards;
+    int num_shards;
+    int partition;
+    std::vector<std::string> split_keys;
+    bool writer_mode;
+    int status;
+};
+
+}
+
+#endif
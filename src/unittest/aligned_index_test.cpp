@@ -0,0 +1,259 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+#include "../mb_rc.h"
+#include "../mb_verify.h"
+#include "../mbt_base.h"
+#include "../free_list.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define ALIGNED_TEST_DIR "/var/tmp/mabain_test/"
+#define ONE_MEGA         (1024*1024)
+
+// Count the nodes that are not aligned to cache lines.
+class NodeAlignmentCheck : public DBTraverseBase
+{
+public:
+    NodeAlignmentCheck(const DB &db) : DBTraverseBase(db),
+                                       num_node(0),
+                                       num_unaligned(0)
+    {
+    }
+
+    int64_t num_node;
+    int64_t num_unaligned;
+
+protected:
+    virtual void DoTask(int arg, DBTraverseNode &dbt_node)
+    {
+        if(!(dbt_node.buffer_type & BUFFER_TYPE_NODE))
+            return;
+        num_node++;
+        if(dbt_node.node_offset % ALIGNED_NODE_SIZE != 0 ||
+           dbt_node.node_size % ALIGNED_NODE_SIZE != 0)
+            num_unaligned++;
+    }
+};
+
+class AlignedIndexTest : public ::testing::Test
+{
+public:
+    AlignedIndexTest() {
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~AlignedIndexTest() {
+    }
+
+    virtual void SetUp() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("mkdir -p ") + ALIGNED_TEST_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -rf ") + ALIGNED_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = ALIGNED_TEST_DIR;
+        mbconf.options = CONSTS::WriterOptions() | CONSTS::ALIGNED_INDEX;
+        mbconf.block_size_index = 4*ONE_MEGA;
+        mbconf.block_size_data = 4*ONE_MEGA;
+        mbconf.memcap_index = 32*ONE_MEGA;
+        mbconf.memcap_data = 32*ONE_MEGA;
+    }
+    virtual void TearDown() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("rm -rf ") + ALIGNED_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+    }
+
+    std::string GetKey(int key_type, int i) {
+        TestKey tkey(key_type);
+        return std::string(tkey.get_key(i));
+    }
+
+    void Populate(DB &db, int key_type, int num) {
+        for(int i = 0; i < num; i++) {
+            std::string key = GetKey(key_type, i);
+            EXPECT_EQ(db.Add(key, key), MBError::SUCCESS);
+        }
+    }
+
+    void CheckKeys(DB &db, int key_type, int num, int removed_mod) {
+        MBData mbd;
+        for(int i = 0; i < num; i++) {
+            std::string key = GetKey(key_type, i);
+            int rval = db.Find(key, mbd);
+            if(removed_mod > 0 && i % removed_mod == 0) {
+                EXPECT_EQ(rval, MBError::NOT_EXIST);
+            } else {
+                EXPECT_EQ(rval, MBError::SUCCESS);
+                EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len), key);
+            }
+        }
+    }
+
+    void CheckAlignment(const DB &db) {
+        NodeAlignmentCheck check(db);
+        check.TraverseDB();
+        EXPECT_GT(check.num_node, 0);
+        EXPECT_EQ(check.num_unaligned, 0);
+    }
+
+protected:
+    MBConfig mbconf;
+};
+
+TEST_F(AlignedIndexTest, add_remove_test)
+{
+    int num = 20000;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    EXPECT_EQ(db.GetDictPtr()->GetHeaderPtr()->index_format, INDEX_FORMAT_ALIGNED);
+    Populate(db, MABAIN_TEST_KEY_TYPE_INT, num);
+    Populate(db, MABAIN_TEST_KEY_TYPE_SHA_256, num);
+    CheckAlignment(db);
+
+    mbconf.options = CONSTS::ReaderOptions();
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    CheckKeys(db_r, MABAIN_TEST_KEY_TYPE_INT, num, 0);
+    CheckKeys(db_r, MABAIN_TEST_KEY_TYPE_SHA_256, num, 0);
+
+    // Released nodes and edge strings are reused by the insertions below.
+    for(int i = 0; i < num; i += 3) {
+        EXPECT_EQ(db.Remove(GetKey(MABAIN_TEST_KEY_TYPE_INT, i)), MBError::SUCCESS);
+        EXPECT_EQ(db.Remove(GetKey(MABAIN_TEST_KEY_TYPE_SHA_256, i)), MBError::SUCCESS);
+    }
+    CheckKeys(db_r, MABAIN_TEST_KEY_TYPE_INT, num, 3);
+    CheckKeys(db_r, MABAIN_TEST_KEY_TYPE_SHA_256, num, 3);
+    Populate(db, MABAIN_TEST_KEY_TYPE_SHA_128, num);
+    CheckAlignment(db);
+    CheckKeys(db_r, MABAIN_TEST_KEY_TYPE_SHA_128, num, 0);
+    CheckKeys(db_r, MABAIN_TEST_KEY_TYPE_SHA_256, num, 3);
+
+    int64_t count = 0;
+    for(DB::iterator iter = db_r.begin(); iter != db_r.end(); ++iter)
+        count++;
+    EXPECT_EQ(count, db.Count());
+
+    db_r.Close();
+    db.Close();
+}
+
+TEST_F(AlignedIndexTest, pending_buffer_size_test)
+{
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    IndexHeader *header = db.GetDictPtr()->GetHeaderPtr();
+    FreeList *free_lists = db.GetDictPtr()->GetMM()->GetFreeList();
+    EXPECT_EQ(db.Add("0", "0"), MBError::SUCCESS);
+
+    // Released edge strings of node sizes are not aligned for nodes.
+    for(int i = 0; i < 48; i++) {
+        std::string key = std::string(1, 'A' + i) + std::string(40 + i, 'a');
+        EXPECT_EQ(db.Add(key, key), MBError::SUCCESS);
+    }
+    for(int i = 0; i < 48; i++) {
+        std::string key = std::string(1, 'A' + i) + std::string(40 + i, 'a');
+        EXPECT_EQ(db.Remove(key), MBError::SUCCESS);
+    }
+    EXPECT_GT(header->pending_index_buff_size, 0);
+    EXPECT_EQ(header->pending_index_buff_size, (int64_t) free_lists->GetTotSize());
+
+    // Node allocations skip them without changing their size classes.
+    for(int i = 0; i < 48; i++) {
+        for(int j = 0; j < 16; j++) {
+            std::string key = std::string(1, 'A' + i) + std::string(1, 'a' + j);
+            EXPECT_EQ(db.Add(key, key), MBError::SUCCESS);
+        }
+    }
+    EXPECT_EQ(header->pending_index_buff_size, (int64_t) free_lists->GetTotSize());
+    CheckAlignment(db);
+    db.Close();
+}
+
+TEST_F(AlignedIndexTest, format_kept_test)
+{
+    int num = 5000;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    Populate(db, MABAIN_TEST_KEY_TYPE_SHA_256, num);
+    db.Close();
+
+    // The format is taken from the header when the DB is opened again.
+    mbconf.options = CONSTS::WriterOptions();
+    DB db_w(mbconf);
+    ASSERT_TRUE(db_w.is_open());
+    EXPECT_EQ(db_w.GetDictPtr()->GetHeaderPtr()->index_format, INDEX_FORMAT_ALIGNED);
+    Populate(db_w, MABAIN_TEST_KEY_TYPE_INT, num);
+    CheckKeys(db_w, MABAIN_TEST_KEY_TYPE_SHA_256, num, 0);
+    CheckKeys(db_w, MABAIN_TEST_KEY_TYPE_INT, num, 0);
+    CheckAlignment(db_w);
+
+    DBVerifier verifier(mbconf, 2);
+    EXPECT_EQ(verifier.Verify(), MBError::SUCCESS);
+    EXPECT_EQ(verifier.GetRecordCount(), 2*num);
+    db_w.Close();
+}
+
+TEST_F(AlignedIndexTest, packed_default_test)
+{
+    mbconf.options = CONSTS::WriterOptions();
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    EXPECT_EQ(db.GetDictPtr()->GetHeaderPtr()->index_format, INDEX_FORMAT_PACKED);
+    db.Close();
+}
+
+TEST_F(AlignedIndexTest, resource_collection_test)
+{
+    int num = 30000;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    Populate(db, MABAIN_TEST_KEY_TYPE_SHA_256, num);
+    for(int i = 0; i < num; i += 2)
+        EXPECT_EQ(db.Remove(GetKey(MABAIN_TEST_KEY_TYPE_SHA_256, i)), MBError::SUCCESS);
+
+    size_t index_size = db.GetDictPtr()->GetHeaderPtr()->m_index_offset;
+    ResourceCollection rc(db, RESOURCE_COLLECTION_TYPE_INDEX);
+    rc.ReclaimResource(1, 0, 10000000000LL, 10000000000LL);
+    EXPECT_LT(db.GetDictPtr()->GetHeaderPtr()->m_index_offset, index_size);
+
+    CheckKeys(db, MABAIN_TEST_KEY_TYPE_SHA_256, num, 2);
+    CheckAlignment(db);
+    Populate(db, MABAIN_TEST_KEY_TYPE_INT, num);
+    CheckKeys(db, MABAIN_TEST_KEY_TYPE_INT, num, 0);
+    CheckAlignment(db);
+    db.Close();
+}
+
+}
@@ -0,0 +1,127 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string>
+#include <sstream>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mb_analyze.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+
+using namespace mabain;
+
+namespace {
+
+#define ANALYZE_TEST_DIR "/var/tmp/mabain_test/"
+
+class AnalyzeTest : public ::testing::Test
+{
+public:
+    AnalyzeTest() {
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~AnalyzeTest() {
+    }
+
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + ANALYZE_TEST_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -rf ") + ANALYZE_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = ANALYZE_TEST_DIR;
+        mbconf.memcap_index = 16*1024*1024;
+        mbconf.memcap_data = 16*1024*1024;
+    }
+    virtual void TearDown() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("rm -rf ") + ANALYZE_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+    }
+
+protected:
+    MBConfig mbconf;
+};
+
+TEST_F(AnalyzeTest, shape_test)
+{
+    int num = 2000;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    DB *db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    for(int i = 0; i < num; i++)
+    {
+        std::string key = "key_" + std::to_string(i);
+        EXPECT_EQ(db->Add(key, std::string(i % 100 + 1, 'v')), MBError::SUCCESS);
+    }
+    // Long edges are stored out of line.
+    EXPECT_EQ(db->Add("a_very_long_key_with_a_long_edge", "value"), MBError::SUCCESS);
+    EXPECT_EQ(db->Add("a_very_long_key_with_a_long_edge_2", "value"), MBError::SUCCESS);
+    // Removed data buffers are kept in the free list.
+    for(int i = 0; i < 100; i++)
+        EXPECT_EQ(db->Remove("key_" + std::to_string(i)), MBError::SUCCESS);
+
+    DBAnalyzer analyzer(mbconf, 4);
+    EXPECT_EQ(analyzer.Analyze(), MBError::SUCCESS);
+    const TrieShape &shape = analyzer.GetTrieShape();
+    EXPECT_EQ(shape.num_error, 0);
+    EXPECT_EQ(shape.num_key, num - 100 + 2);
+    EXPECT_EQ(shape.num_record, shape.num_key);
+    EXPECT_GT(shape.num_node, 1);
+    EXPECT_GT(shape.num_edge_str, 0);
+    EXPECT_EQ(shape.depth[0], 0);
+    int64_t num_key = 0;
+    for(int i = 0; i <= MB_ANALYZE_MAX_DEPTH; i++)
+        num_key += shape.depth[i];
+    EXPECT_EQ(num_key, shape.num_key);
+    int64_t num_node = 0;
+    int64_t num_edge = 0;
+    for(int i = 0; i <= NUM_ALPHABET; i++)
+    {
+        num_node += shape.fanout[i];
+        num_edge += shape.fanout[i] * i;
+    }
+    EXPECT_EQ(num_node, shape.num_node);
+    // Root node has 256 edge slots, but only the used ones are edges.
+    EXPECT_EQ(num_edge, shape.num_edge);
+    // Free lists are only reported if they were saved to disk.
+    EXPECT_FALSE(analyzer.GetDataFreeList().available);
+
+    delete db;
+    DBAnalyzer analyzer_closed(mbconf, 2);
+    EXPECT_EQ(analyzer_closed.Analyze(), MBError::SUCCESS);
+    EXPECT_EQ(analyzer_closed.GetTrieShape().num_key, shape.num_key);
+    EXPECT_FALSE(analyzer_closed.GetDataFreeList().available);
+
+    std::ostringstream out;
+    analyzer_closed.WriteJSON(out);
+    EXPECT_NE(out.str().find("\"depth_hist\""), std::string::npos);
+    EXPECT_NE(out.str().find("\"out_of_line_ratio\""), std::string::npos);
+    EXPECT_NE(out.str().find("\"pending_bytes\""), std::string::npos);
+    EXPECT_NE(out.str().find("\"count\": " + std::to_string(shape.num_key)), std::string::npos);
+}
+
+}
@@ -0,0 +1,134 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string>
+#include <string.h>
+#include <atomic>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../async_reader.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define ASYNC_READER_TEST_DIR "/var/tmp/mabain_test/"
+#define ONE_MEGA 1024*1024ul
+
+class AsyncReaderTest : public ::testing::Test
+{
+public:
+    AsyncReaderTest() {
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~AsyncReaderTest() {
+    }
+
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + ASYNC_READER_TEST_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -rf ") + ASYNC_READER_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = ASYNC_READER_TEST_DIR;
+        mbconf.block_size_index = 4*ONE_MEGA;
+        mbconf.block_size_data = 4*ONE_MEGA;
+        mbconf.memcap_index = 4*ONE_MEGA;
+        mbconf.memcap_data = 4*ONE_MEGA;
+    }
+    virtual void TearDown() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("rm -rf ") + ASYNC_READER_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+    }
+
+protected:
+    MBConfig mbconf;
+};
+
+TEST_F(AsyncReaderTest, invalid_arg_test)
+{
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    AsyncReader writer_reader(mbconf, 4);
+    EXPECT_EQ(writer_reader.Status(), MBError::INVALID_ARG);
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    AsyncReader no_thread_reader(mbconf, 0);
+    EXPECT_EQ(no_thread_reader.Status(), MBError::INVALID_ARG);
+    EXPECT_EQ(no_thread_reader.Find("abc", NULL), MBError::INVALID_ARG);
+}
+
+TEST_F(AsyncReaderTest, find_test)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    std::string key;
+    int num = 50000;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db.Add(key, key), MBError::SUCCESS);
+    }
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    AsyncReader reader(mbconf, 8);
+    ASSERT_EQ(reader.Status(), MBError::SUCCESS);
+
+    std::atomic<int> num_found(0);
+    std::atomic<int> num_not_found(0);
+    std::atomic<int> num_mismatch(0);
+    AsyncFindCallback callback = [&](const std::string &k, int rval, MBData &data) {
+        if(rval == MBError::SUCCESS) {
+            num_found++;
+            if(std::string((const char *)data.buff, data.data_len) != k)
+                num_mismatch++;
+        } else if(rval == MBError::NOT_EXIST) {
+            num_not_found++;
+        }
+    };
+
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(reader.Find(key, callback), MBError::SUCCESS);
+    }
+    for(int i = 0; i < 100; i++) {
+        key = tkey.get_key(num + i);
+        EXPECT_EQ(reader.Find(key, callback), MBError::SUCCESS);
+    }
+    reader.Wait();
+
+    EXPECT_EQ(num_found.load(), num);
+    EXPECT_EQ(num_not_found.load(), 100);
+    EXPECT_EQ(num_mismatch.load(), 0);
+
+    reader.Stop();
+    EXPECT_EQ(reader.Find(key, callback), MBError::DB_CLOSED);
+    db.Close();
+}
+
+}
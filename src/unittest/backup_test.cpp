@@ -8,6 +8,8 @@
 #include <iostream>
 #include <gtest/gtest.h>
 #include <time.h>
+#include <string.h>
+#include <vector>
 
 #include "../db.h"
 #include "../mb_data.h"
@@ -174,4 +176,86 @@ TEST_F(BackupTest, Create_backup_db)
     db->Close();
     delete db;
 }
+
+TEST_F(BackupTest, Incremental_backup_db)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_128);
+    int num = 20000;
+    std::string key;
+    MBData mbd;
+    MBConfig mbconf;
+    memset(&mbconf, 0, sizeof(mbconf));
+    mbconf.mbdir = MB_DIR;
+    mbconf.options = CONSTS::WriterOptions();
+    mbconf.memcap_index = 4LL*1024*1024;
+    mbconf.memcap_data = 4LL*1024*1024;
+    mbconf.block_size_index = 4*1024*1024;
+    mbconf.block_size_data = 4*1024*1024;
+    DB *db = new DB(mbconf);
+    assert(db->is_open());
+    for(int i = 0; i < num; i++)
+    {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db->Add(key, key), MBError::SUCCESS);
+    }
+
+    // Incremental backup requires a full backup first.
+    EXPECT_EQ(db->IncrementalBackup(MB_BACKUP_DIR), MBError::OPEN_FAILURE);
+    EXPECT_EQ(db->Backup(MB_BACKUP_DIR), MBError::SUCCESS);
+    std::vector<std::pair<size_t, size_t>> ranges;
+    Dict *dict = db->GetDictPtr();
+    dict->GetDirtyRanges(dict->GetHeaderPtr()->m_data_offset, ranges);
+    EXPECT_EQ(ranges.size(), 0u);
+    EXPECT_EQ(db->IncrementalBackup(MB_BACKUP_DIR), MBError::SUCCESS);
+
+    // Update, remove and add keys. New keys roll over to new blocks.
+    for(int i = 0; i < 100; i++)
+    {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db->Add(key, key+"_new", true), MBError::SUCCESS);
+        key = tkey.get_key(i + 100);
+        EXPECT_EQ(db->Remove(key), MBError::SUCCESS);
+    }
+    dict->GetDirtyRanges(dict->GetHeaderPtr()->m_data_offset, ranges);
+    EXPECT_GT(ranges.size(), 0u);
+    for(int i = num; i < 2*num; i++)
+    {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db->Add(key, key), MBError::SUCCESS);
+    }
+    EXPECT_EQ(db->IncrementalBackup(MB_BACKUP_DIR), MBError::SUCCESS);
+    ranges.clear();
+    dict->GetDirtyRanges(dict->GetHeaderPtr()->m_data_offset, ranges);
+    EXPECT_EQ(ranges.size(), 0u);
+
+    DB *db_bkp = new DB(MB_BACKUP_DIR, CONSTS::ReaderOptions(), 4LL*1024*1024,
+                        4LL*1024*1024);
+    assert(db_bkp->is_open());
+    EXPECT_EQ(db_bkp->Count(), db->Count());
+    for(int i = 0; i < 2*num; i++)
+    {
+        key = tkey.get_key(i);
+        int rval = db_bkp->Find(key, mbd);
+        if(i >= 100 && i < 200)
+        {
+            EXPECT_EQ(rval, MBError::NOT_EXIST);
+            continue;
+        }
+        EXPECT_EQ(rval, MBError::SUCCESS);
+        if(i < 100)
+            EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), key+"_new");
+        else
+            EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), key);
+    }
+    db_bkp->Close();
+    delete db_bkp;
+
+    // A full backup to another directory makes the first backup stale.
+    EXPECT_EQ(db->Backup(MB_BACKUP_DIR_2), MBError::SUCCESS);
+    EXPECT_EQ(db->IncrementalBackup(MB_BACKUP_DIR), MBError::NOT_ALLOWED);
+    EXPECT_EQ(db->IncrementalBackup(MB_BACKUP_DIR_2), MBError::SUCCESS);
+
+    db->Close();
+    delete db;
+}
 }
@@ -0,0 +1,386 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../block_cache.h"
+#include "../rollable_file.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define BLOCK_CACHE_TEST_DIR "/var/tmp/mabain_test/"
+#define ONE_MEGA 1024*1024ul
+#define TEST_PAGE_SIZE 4096
+
+class BlockCacheTest : public ::testing::Test
+{
+public:
+    BlockCacheTest() {
+        memset(&mbconf, 0, sizeof(mbconf));
+        memset(epochs, 0, sizeof(epochs));
+        memset(sliding_start, 0, sizeof(sliding_start));
+    }
+    virtual ~BlockCacheTest() {
+    }
+
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + BLOCK_CACHE_TEST_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -rf ") + BLOCK_CACHE_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = BLOCK_CACHE_TEST_DIR;
+        mbconf.block_size_index = 4*ONE_MEGA;
+        mbconf.block_size_data = 4*ONE_MEGA;
+        mbconf.memcap_index = 4*ONE_MEGA;
+        mbconf.memcap_data = 4*ONE_MEGA;
+    }
+    virtual void TearDown() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("rm -rf ") + BLOCK_CACHE_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+    }
+
+    void FillPage(uint8_t *page, uint8_t c) {
+        memset(page, c, TEST_PAGE_SIZE);
+    }
+
+    void VerifyDB(DB &db, int num, const std::string &suffix) {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+        std::string key;
+        MBData mbd;
+        for(int i = 0; i < num; i++) {
+            key = tkey.get_key(i);
+            EXPECT_EQ(db.Find(key, mbd), MBError::SUCCESS);
+            EXPECT_EQ(std::string((const char *)mbd.buff, mbd.data_len), key + suffix);
+        }
+    }
+
+protected:
+    MBConfig mbconf;
+    std::atomic<uint32_t> epochs[BLOCK_CACHE_EPOCH_SLOTS];
+    std::atomic<size_t> sliding_start[1];
+};
+
+TEST_F(BlockCacheTest, lookup_test)
+{
+    BlockCache cache(4*TEST_PAGE_SIZE, TEST_PAGE_SIZE);
+    EXPECT_EQ(cache.GetCacheSize(), 4u*TEST_PAGE_SIZE);
+    EXPECT_EQ(cache.GetPageSize(), (size_t) TEST_PAGE_SIZE);
+
+    EXPECT_TRUE(cache.Lookup(0, 0) == NULL);
+    FillPage(cache.Allocate(0), 'a');
+    cache.Commit(0, 0);
+
+    uint8_t *page = cache.Lookup(0, 0);
+    ASSERT_TRUE(page != NULL);
+    EXPECT_EQ(page[0], 'a');
+    EXPECT_EQ(page[TEST_PAGE_SIZE-1], 'a');
+
+    // Page is invalid once the epoch changed.
+    EXPECT_TRUE(cache.Lookup(0, 1) == NULL);
+    EXPECT_TRUE(cache.Lookup(0, 0) == NULL);
+    FillPage(cache.Allocate(0), 'b');
+    cache.Commit(0, 1);
+    page = cache.Lookup(0, 1);
+    ASSERT_TRUE(page != NULL);
+    EXPECT_EQ(page[0], 'b');
+
+    EXPECT_EQ(cache.GetHits(), 2u);
+    EXPECT_EQ(cache.GetMisses(), 3u);
+
+    cache.Clear();
+    EXPECT_TRUE(cache.Lookup(0, 1) == NULL);
+}
+
+TEST_F(BlockCacheTest, clock_eviction_test)
+{
+    BlockCache cache(4*TEST_PAGE_SIZE, TEST_PAGE_SIZE);
+
+    for(int i = 0; i < 4; i++) {
+        FillPage(cache.Allocate(i*TEST_PAGE_SIZE), 'a'+i);
+        cache.Commit(i*TEST_PAGE_SIZE, 0);
+    }
+    for(int i = 0; i < 4; i++)
+        EXPECT_TRUE(cache.Lookup(i*TEST_PAGE_SIZE, 0) != NULL);
+
+    // All pages are referenced; the first page is replaced after
+    // the clock hand clears all the referenced bits.
+    FillPage(cache.Allocate(4*TEST_PAGE_SIZE), 'e');
+    cache.Commit(4*TEST_PAGE_SIZE, 0);
+    EXPECT_TRUE(cache.Lookup(0, 0) == NULL);
+
+    // Page 2 gets a second chance since it is referenced again.
+    EXPECT_TRUE(cache.Lookup(2*TEST_PAGE_SIZE, 0) != NULL);
+    FillPage(cache.Allocate(5*TEST_PAGE_SIZE), 'f');
+    cache.Commit(5*TEST_PAGE_SIZE, 0);
+    EXPECT_TRUE(cache.Lookup(1*TEST_PAGE_SIZE, 0) == NULL);
+    EXPECT_TRUE(cache.Lookup(2*TEST_PAGE_SIZE, 0) != NULL);
+    EXPECT_TRUE(cache.Lookup(3*TEST_PAGE_SIZE, 0) != NULL);
+
+    uint8_t *page = cache.Lookup(5*TEST_PAGE_SIZE, 0);
+    ASSERT_TRUE(page != NULL);
+    EXPECT_EQ(page[100], 'f');
+}
+
+TEST_F(BlockCacheTest, rollable_file_test)
+{
+    std::string path = std::string(BLOCK_CACHE_TEST_DIR) + "_mabain_d";
+    RollableFile *writer = new RollableFile(path, 4*ONE_MEGA, 0, CONSTS::ACCESS_MODE_WRITER, 0);
+    writer->InitShmSlidingAddr(&sliding_start[0]);
+    writer->InitShmCacheEpoch(epochs, BLOCK_CACHE_EPOCH_SLOTS);
+    size_t offset = 0;
+    uint8_t *ptr;
+    EXPECT_EQ(writer->Reserve(offset, 8192, ptr), MBError::SUCCESS);
+    EXPECT_TRUE(ptr == NULL);
+
+    std::string data(8192, 'x');
+    EXPECT_EQ(writer->RandomWrite(data.data(), data.size(), 0), data.size());
+
+    RollableFile *reader = new RollableFile(path, 4*ONE_MEGA, 0, CONSTS::ACCESS_MODE_READER, 2);
+    reader->InitShmSlidingAddr(&sliding_start[0]);
+    reader->InitShmCacheEpoch(epochs, BLOCK_CACHE_EPOCH_SLOTS);
+    EXPECT_EQ(reader->InitBlockCache(ONE_MEGA), MBError::SUCCESS);
+
+    char buff[64];
+    uint64_t hits, misses;
+    for(int i = 0; i < 10; i++) {
+        EXPECT_EQ(reader->RandomRead(buff, sizeof(buff), 100 + i*10), sizeof(buff));
+        EXPECT_EQ(buff[0], 'x');
+    }
+    reader->GetCacheStats(hits, misses);
+    EXPECT_EQ(hits, 9u);
+    EXPECT_EQ(misses, 1u);
+
+    // Read across the page boundary
+    EXPECT_EQ(reader->RandomRead(buff, sizeof(buff), 4096 - 10), sizeof(buff));
+    EXPECT_EQ(std::string(buff, sizeof(buff)), std::string(sizeof(buff), 'x'));
+
+    // Reader must see writer updates.
+    EXPECT_EQ(writer->RandomWrite("yyyy", 4, 200), 4u);
+    EXPECT_EQ(reader->RandomRead(buff, 4, 200), 4u);
+    EXPECT_EQ(std::string(buff, 4), "yyyy");
+    EXPECT_EQ(reader->RandomRead(buff, 4, 196), 4u);
+    EXPECT_EQ(std::string(buff, 4), "xxxx");
+
+    delete reader;
+    delete writer;
+}
+
+TEST_F(BlockCacheTest, unrelated_page_epoch_test)
+{
+    std::string path = std::string(BLOCK_CACHE_TEST_DIR) + "_mabain_d";
+    RollableFile *writer = new RollableFile(path, 4*ONE_MEGA, 0, CONSTS::ACCESS_MODE_WRITER, 0);
+    writer->InitShmSlidingAddr(&sliding_start[0]);
+    writer->InitShmCacheEpoch(epochs, BLOCK_CACHE_EPOCH_SLOTS);
+    size_t offset = 0;
+    uint8_t *ptr;
+    EXPECT_EQ(writer->Reserve(offset, ONE_MEGA, ptr), MBError::SUCCESS);
+    std::string data(ONE_MEGA, 'x');
+    EXPECT_EQ(writer->RandomWrite(data.data(), data.size(), 0), data.size());
+
+    RollableFile *reader = new RollableFile(path, 4*ONE_MEGA, 0, CONSTS::ACCESS_MODE_READER, 2);
+    reader->InitShmSlidingAddr(&sliding_start[0]);
+    reader->InitShmCacheEpoch(epochs, BLOCK_CACHE_EPOCH_SLOTS);
+    EXPECT_EQ(reader->InitBlockCache(2*ONE_MEGA), MBError::SUCCESS);
+
+    int num_page = ONE_MEGA / TEST_PAGE_SIZE;
+    char buff[64];
+    uint64_t hits, misses;
+    for(int i = 0; i < num_page; i++)
+        EXPECT_EQ(reader->RandomRead(buff, sizeof(buff), i*TEST_PAGE_SIZE), sizeof(buff));
+    reader->GetCacheStats(hits, misses);
+    EXPECT_EQ(misses, (uint64_t) num_page);
+
+    // Only the modified page is reloaded.
+    EXPECT_EQ(writer->RandomWrite("yyyy", 4, 10*TEST_PAGE_SIZE), 4u);
+    for(int i = 0; i < num_page; i++) {
+        EXPECT_EQ(reader->RandomRead(buff, sizeof(buff), i*TEST_PAGE_SIZE), sizeof(buff));
+        EXPECT_EQ(buff[0], (i == 10) ? 'y' : 'x');
+    }
+    reader->GetCacheStats(hits, misses);
+    EXPECT_EQ(hits, (uint64_t) num_page - 1);
+    EXPECT_EQ(misses, (uint64_t) num_page + 1);
+
+    delete reader;
+    delete writer;
+}
+
+TEST_F(BlockCacheTest, reader_cache_test)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    std::string key;
+    int num = 100000;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db.Add(key, key + "_0"), MBError::SUCCESS);
+    }
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    mbconf.cache_size_index = ONE_MEGA;
+    mbconf.cache_size_data = ONE_MEGA;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    VerifyDB(db_r, num, "_0");
+
+    // Overwrite all values in place.
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db.Add(key, key + "_1", true), MBError::SUCCESS);
+    }
+    VerifyDB(db_r, num, "_1");
+
+    db_r.Close();
+    db.Close();
+}
+
+TEST_F(BlockCacheTest, reader_cache_sliding_window_test)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    std::string key;
+    int num = 100000;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::USE_SLIDING_WINDOW;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER | CONSTS::USE_SLIDING_WINDOW;
+    mbconf.cache_size_index = ONE_MEGA;
+    mbconf.cache_size_data = ONE_MEGA;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db.Add(key, key + "_0"), MBError::SUCCESS);
+        if(i % 1000 == 0)
+            VerifyDB(db_r, i + 1, "_0");
+    }
+    VerifyDB(db_r, num, "_0");
+
+    for(int i = 0; i < num; i += 2) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db.Remove(key), MBError::SUCCESS);
+    }
+    db.RemoveAll();
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db.Add(key, key + "_2"), MBError::SUCCESS);
+    }
+    VerifyDB(db_r, num, "_2");
+
+    db_r.Close();
+    db.Close();
+}
+
+// The writer maps all blocks while the reader in another process reads
+// most of them through the cache. Overwritten values must not be served
+// from pages cached by the reader.
+TEST_F(BlockCacheTest, multi_process_overwrite_test)
+{
+    int num = 2000;
+    int num_update = 100;
+    mbconf.block_size_index = ONE_MEGA;
+    mbconf.block_size_data = ONE_MEGA;
+    mbconf.memcap_index = 64*ONE_MEGA;
+    mbconf.memcap_data = 64*ONE_MEGA;
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    for(int i = 0; i < num; i++) {
+        std::string key = "cache_key_" + std::to_string(i);
+        EXPECT_EQ(db.Add(key, key + std::string(1000, 'a')), MBError::SUCCESS);
+    }
+
+    int ready[2];
+    int updated[2];
+    ASSERT_EQ(pipe(ready), 0);
+    ASSERT_EQ(pipe(updated), 0);
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if(pid == 0) {
+        ResourcePool::getInstance().RemoveAll();
+        MBConfig rconf = mbconf;
+        rconf.options = CONSTS::ACCESS_MODE_READER;
+        rconf.memcap_index = ONE_MEGA;
+        rconf.memcap_data = ONE_MEGA;
+        rconf.cache_size_index = ONE_MEGA;
+        rconf.cache_size_data = 4*ONE_MEGA;
+        DB db_r(rconf);
+        if(!db_r.is_open())
+            _exit(255);
+        MBData mbd;
+        for(int i = 0; i < num; i++) {
+            std::string key = "cache_key_" + std::to_string(i);
+            if(db_r.Find(key, mbd) != MBError::SUCCESS)
+                _exit(255);
+        }
+        char c = 0;
+        if(write(ready[1], &c, 1) != 1 || read(updated[0], &c, 1) != 1)
+            _exit(255);
+
+        int stale = 0;
+        for(int i = 0; i < num; i += num / num_update) {
+            std::string key = "cache_key_" + std::to_string(i);
+            if(db_r.Find(key, mbd) != MBError::SUCCESS ||
+               std::string((const char *)mbd.buff, mbd.data_len) !=
+                   key + std::string(1000, 'b'))
+                stale++;
+        }
+        db_r.Close();
+        _exit(stale);
+    }
+
+    char c = 0;
+    ASSERT_EQ(read(ready[0], &c, 1), 1);
+    for(int i = 0; i < num; i += num / num_update) {
+        std::string key = "cache_key_" + std::to_string(i);
+        EXPECT_EQ(db.Add(key, key + std::string(1000, 'b'), true), MBError::SUCCESS);
+    }
+    ASSERT_EQ(write(updated[1], &c, 1), 1);
+
+    int wstatus = 0;
+    ASSERT_EQ(waitpid(pid, &wstatus, 0), pid);
+    ASSERT_TRUE(WIFEXITED(wstatus));
+    EXPECT_EQ(WEXITSTATUS(wstatus), 0);
+    for(int i = 0; i < 2; i++) {
+        close(ready[i]);
+        close(updated[i]);
+    }
+    db.Close();
+}
+
+}
@@ -0,0 +1,144 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../mb_verify.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+#include "../util/crc32c.h"
+
+using namespace mabain;
+
+namespace {
+
+#define CHECKSUM_TEST_DIR "/var/tmp/mabain_test/"
+
+class ChecksumTest : public ::testing::Test
+{
+public:
+    ChecksumTest() {
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~ChecksumTest() {
+    }
+
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + CHECKSUM_TEST_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -rf ") + CHECKSUM_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = CHECKSUM_TEST_DIR;
+        mbconf.memcap_index = 64*1024*1024;
+        mbconf.memcap_data = 64*1024*1024;
+    }
+    virtual void TearDown() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("rm -rf ") + CHECKSUM_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+    }
+
+    std::string GetKey(int i) {
+        return "checksum_key_" + std::to_string(i);
+    }
+    std::string GetValue(int i) {
+        return "{\"id\":" + std::to_string(i) + ",\"value\":\"checksum test value\"}";
+    }
+
+protected:
+    MBConfig mbconf;
+};
+
+TEST_F(ChecksumTest, crc32c_test)
+{
+    const char *buff = "123456789";
+    EXPECT_EQ(crc32c(0, buff, 9), 0xE3069283u);
+    EXPECT_EQ(crc32c(crc32c(0, buff, 4), buff + 4, 5), 0xE3069283u);
+    EXPECT_EQ(crc32c(0, buff, 0), 0u);
+}
+
+TEST_F(ChecksumTest, verify_test)
+{
+    int num = 10000;
+    MBData mbd;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::DATA_CHECKSUM |
+                     CONSTS::COMPRESS_DATA;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    for(int i = 0; i < num; i++)
+    {
+        std::string key = GetKey(i);
+        std::string value = GetValue(i);
+        if(i % 3 == 0)
+            EXPECT_EQ(db.AddWithTTL(key.c_str(), key.size(), value.c_str(),
+                                    value.size(), 3600), MBError::SUCCESS);
+        else
+            EXPECT_EQ(db.Add(key, value), MBError::SUCCESS);
+    }
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER | CONSTS::DATA_CHECKSUM;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    for(int i = 0; i < num; i++)
+    {
+        EXPECT_EQ(db_r.Find(GetKey(i), mbd), MBError::SUCCESS);
+        EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len), GetValue(i));
+    }
+
+    DBVerifier verifier(mbconf, 4);
+    EXPECT_EQ(verifier.Verify(), MBError::SUCCESS);
+    EXPECT_EQ(verifier.GetRecordCount(), num);
+    EXPECT_EQ(verifier.GetCheckedCount(), num);
+    EXPECT_EQ(verifier.GetErrorCount(), 0);
+
+    // Corrupt the last byte of one data record
+    EXPECT_EQ(db.Find(GetKey(100), mbd), MBError::SUCCESS);
+    size_t data_offset = mbd.data_offset;
+    int record_size;
+    Dict *dict = db.GetDictPtr();
+    ASSERT_EQ(dict->GetDataRecordSize(data_offset, record_size), MBError::SUCCESS);
+    size_t last_byte_offset = data_offset + record_size - 1;
+    uint8_t byte;
+    ASSERT_EQ(dict->ReadData(&byte, 1, last_byte_offset), 1);
+    byte ^= 0xFF;
+    dict->WriteData(&byte, 1, last_byte_offset);
+
+    EXPECT_EQ(db_r.Find(GetKey(100), mbd), MBError::CHECKSUM_ERROR);
+    EXPECT_EQ(db_r.Find(GetKey(101), mbd), MBError::SUCCESS);
+
+    EXPECT_EQ(verifier.Verify(), MBError::CHECKSUM_ERROR);
+    EXPECT_EQ(verifier.GetRecordCount(), num);
+    ASSERT_EQ(verifier.GetErrorCount(), 1);
+    EXPECT_FALSE(verifier.GetErrors()[0].index);
+    EXPECT_EQ(verifier.GetErrors()[0].offset, data_offset);
+
+    db_r.Close();
+    db.Close();
+}
+
+}
@@ -0,0 +1,237 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+#include "../mb_rc.h"
+#include "../mb_verify.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define COMPACT_TEST_DIR "/var/tmp/mabain_test/"
+#define ONE_MEGA         (1024*1024)
+
+class CompactIndexTest : public ::testing::Test
+{
+public:
+    CompactIndexTest() {
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~CompactIndexTest() {
+    }
+
+    virtual void SetUp() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("mkdir -p ") + COMPACT_TEST_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -rf ") + COMPACT_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = COMPACT_TEST_DIR;
+        mbconf.options = CONSTS::WriterOptions() | CONSTS::COMPACT_INDEX;
+        mbconf.block_size_index = 4*ONE_MEGA;
+        mbconf.block_size_data = 4*ONE_MEGA;
+        mbconf.memcap_index = 32*ONE_MEGA;
+        mbconf.memcap_data = 32*ONE_MEGA;
+    }
+    virtual void TearDown() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("rm -rf ") + COMPACT_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+    }
+
+    std::string GetKey(int key_type, int i) {
+        TestKey tkey(key_type);
+        return std::string(tkey.get_key(i));
+    }
+
+    void Populate(DB &db, int key_type, int num) {
+        for(int i = 0; i < num; i++) {
+            std::string key = GetKey(key_type, i);
+            EXPECT_EQ(db.Add(key, key), MBError::SUCCESS);
+        }
+    }
+
+    void CheckKeys(DB &db, int key_type, int num, int removed_mod) {
+        MBData mbd;
+        for(int i = 0; i < num; i++) {
+            std::string key = GetKey(key_type, i);
+            int rval = db.Find(key, mbd);
+            if(removed_mod > 0 && i % removed_mod == 0) {
+                EXPECT_EQ(rval, MBError::NOT_EXIST);
+            } else {
+                EXPECT_EQ(rval, MBError::SUCCESS);
+                EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len), key);
+            }
+        }
+    }
+
+protected:
+    MBConfig mbconf;
+};
+
+TEST_F(CompactIndexTest, add_remove_test)
+{
+    int num = 20000;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    EXPECT_EQ(db.GetDictPtr()->GetHeaderPtr()->index_format, INDEX_FORMAT_COMPACT);
+    EXPECT_EQ(db.GetDictPtr()->GetMM()->GetEdgeSize(), COMPACT_EDGE_SIZE);
+    Populate(db, MABAIN_TEST_KEY_TYPE_INT, num);
+    Populate(db, MABAIN_TEST_KEY_TYPE_SHA_256, num);
+
+    mbconf.options = CONSTS::ReaderOptions();
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    CheckKeys(db_r, MABAIN_TEST_KEY_TYPE_INT, num, 0);
+    CheckKeys(db_r, MABAIN_TEST_KEY_TYPE_SHA_256, num, 0);
+
+    for(int i = 0; i < num; i += 3) {
+        EXPECT_EQ(db.Remove(GetKey(MABAIN_TEST_KEY_TYPE_INT, i)), MBError::SUCCESS);
+        EXPECT_EQ(db.Remove(GetKey(MABAIN_TEST_KEY_TYPE_SHA_256, i)), MBError::SUCCESS);
+    }
+    CheckKeys(db_r, MABAIN_TEST_KEY_TYPE_INT, num, 3);
+    CheckKeys(db_r, MABAIN_TEST_KEY_TYPE_SHA_256, num, 3);
+
+    // Overwrite the remaining keys with longer values.
+    MBData mbd;
+    for(int i = 1; i < num; i += 3) {
+        std::string key = GetKey(MABAIN_TEST_KEY_TYPE_INT, i);
+        EXPECT_EQ(db.Add(key, key + key, true), MBError::SUCCESS);
+        EXPECT_EQ(db_r.Find(key, mbd), MBError::SUCCESS);
+        EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len), key + key);
+    }
+
+    std::string key = GetKey(MABAIN_TEST_KEY_TYPE_SHA_256, 1);
+    EXPECT_EQ(db_r.FindLongestPrefix(key + "suffix", mbd), MBError::SUCCESS);
+    EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len), key);
+
+    int64_t count = 0;
+    for(DB::iterator iter = db_r.begin(); iter != db_r.end(); ++iter)
+        count++;
+    EXPECT_EQ(count, db.Count());
+
+    db_r.Close();
+    db.Close();
+}
+
+TEST_F(CompactIndexTest, index_size_test)
+{
+    int num = 20000;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    Populate(db, MABAIN_TEST_KEY_TYPE_SHA_256, num);
+    size_t compact_size = db.GetDictPtr()->GetHeaderPtr()->m_index_offset;
+    db.Close();
+    TearDown();
+    SetUp();
+
+    mbconf.options = CONSTS::WriterOptions();
+    DB db_d(mbconf);
+    ASSERT_TRUE(db_d.is_open());
+    Populate(db_d, MABAIN_TEST_KEY_TYPE_SHA_256, num);
+    EXPECT_LT(compact_size, db_d.GetDictPtr()->GetHeaderPtr()->m_index_offset);
+    db_d.Close();
+}
+
+TEST_F(CompactIndexTest, format_kept_test)
+{
+    int num = 5000;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    Populate(db, MABAIN_TEST_KEY_TYPE_SHA_256, num);
+    db.Close();
+
+    // The format is taken from the header when the DB is opened again.
+    mbconf.options = CONSTS::WriterOptions();
+    DB db_w(mbconf);
+    ASSERT_TRUE(db_w.is_open());
+    EXPECT_EQ(db_w.GetDictPtr()->GetHeaderPtr()->index_format, INDEX_FORMAT_COMPACT);
+    Populate(db_w, MABAIN_TEST_KEY_TYPE_INT, num);
+    CheckKeys(db_w, MABAIN_TEST_KEY_TYPE_SHA_256, num, 0);
+    CheckKeys(db_w, MABAIN_TEST_KEY_TYPE_INT, num, 0);
+
+    DBVerifier verifier(mbconf, 2);
+    EXPECT_EQ(verifier.Verify(), MBError::SUCCESS);
+    EXPECT_EQ(verifier.GetRecordCount(), 2*num);
+    db_w.Close();
+}
+
+TEST_F(CompactIndexTest, aligned_compact_test)
+{
+    int num = 10000;
+    mbconf.options |= CONSTS::ALIGNED_INDEX;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    EXPECT_EQ(db.GetDictPtr()->GetHeaderPtr()->index_format,
+              INDEX_FORMAT_ALIGNED | INDEX_FORMAT_COMPACT);
+    Populate(db, MABAIN_TEST_KEY_TYPE_SHA_128, num);
+    for(int i = 0; i < num; i += 2)
+        EXPECT_EQ(db.Remove(GetKey(MABAIN_TEST_KEY_TYPE_SHA_128, i)), MBError::SUCCESS);
+    CheckKeys(db, MABAIN_TEST_KEY_TYPE_SHA_128, num, 2);
+    db.Close();
+
+    DBVerifier verifier(mbconf, 2);
+    EXPECT_EQ(verifier.Verify(), MBError::SUCCESS);
+    EXPECT_EQ(verifier.GetRecordCount(), num/2);
+}
+
+TEST_F(CompactIndexTest, resource_collection_test)
+{
+    int num = 30000;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    Populate(db, MABAIN_TEST_KEY_TYPE_SHA_256, num);
+    for(int i = 0; i < num; i += 2)
+        EXPECT_EQ(db.Remove(GetKey(MABAIN_TEST_KEY_TYPE_SHA_256, i)), MBError::SUCCESS);
+
+    size_t index_size = db.GetDictPtr()->GetHeaderPtr()->m_index_offset;
+    size_t data_size = db.GetDictPtr()->GetHeaderPtr()->m_data_offset;
+    ResourceCollection rc(db);
+    rc.ReclaimResource(1, 1, 10000000000LL, 10000000000LL);
+    EXPECT_LT(db.GetDictPtr()->GetHeaderPtr()->m_index_offset, index_size);
+    EXPECT_LT(db.GetDictPtr()->GetHeaderPtr()->m_data_offset, data_size);
+
+    CheckKeys(db, MABAIN_TEST_KEY_TYPE_SHA_256, num, 2);
+    Populate(db, MABAIN_TEST_KEY_TYPE_INT, num);
+    CheckKeys(db, MABAIN_TEST_KEY_TYPE_INT, num, 0);
+    db.Close();
+}
+
+TEST_F(CompactIndexTest, max_num_block_test)
+{
+    // Files of the compact format cannot grow beyond 4GB.
+    EXPECT_EQ(CompactMaxNumBlock(0, 4*ONE_MEGA), 1024);
+    EXPECT_EQ(CompactMaxNumBlock(100000, 4*ONE_MEGA), 1024);
+    EXPECT_EQ(CompactMaxNumBlock(100, 4*ONE_MEGA), 100);
+}
+
+}
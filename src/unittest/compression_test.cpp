@@ -0,0 +1,273 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <string.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../mb_codec.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+
+using namespace mabain;
+
+namespace {
+
+#define COMPRESSION_TEST_DIR "/var/tmp/mabain_test/"
+
+class CompressionTest : public ::testing::Test
+{
+public:
+    CompressionTest() {
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~CompressionTest() {
+    }
+
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + COMPRESSION_TEST_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -rf ") + COMPRESSION_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = COMPRESSION_TEST_DIR;
+        mbconf.memcap_index = 64*1024*1024;
+        mbconf.memcap_data = 64*1024*1024;
+    }
+    virtual void TearDown() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("rm -rf ") + COMPRESSION_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+    }
+
+    std::string GetValue(int i) {
+        return "{\"id\":" + std::to_string(i) + ",\"name\":\"user" + std::to_string(i*7) +
+               "\",\"status\":\"active\",\"roles\":[\"reader\",\"writer\"],\"region\":\"us-west-" +
+               std::to_string(i%3) + "\",\"created\":\"2018-01-01T00:00:00Z\"}";
+    }
+
+    std::string GetKey(int i) {
+        return "key_" + std::to_string(i);
+    }
+
+protected:
+    MBConfig mbconf;
+};
+
+TEST_F(CompressionTest, codec_test)
+{
+    std::vector<std::string> samples;
+    for(int i = 0; i < 100; i++)
+        samples.push_back(GetValue(i));
+
+    uint8_t dict[MB_CODEC_MAX_DICT_SIZE];
+    int dict_len = MBCodec::TrainDictionary(samples, dict, MB_CODEC_MAX_DICT_SIZE);
+    EXPECT_GT(dict_len, 0);
+    EXPECT_LE(dict_len, MB_CODEC_MAX_DICT_SIZE);
+
+    MBCodec codec;
+    codec.SetDictionary(dict, dict_len);
+    EXPECT_EQ(codec.GetDictionaryLength(), dict_len);
+
+    uint8_t compressed[1024];
+    uint8_t decompressed[1024];
+    for(int i = 1000; i < 1100; i++)
+    {
+        std::string value = GetValue(i);
+        int len = codec.Compress((const uint8_t *) value.data(), value.size(),
+                                 compressed, sizeof(compressed));
+        EXPECT_GT(len, 0);
+        EXPECT_LT(len, (int) value.size() / 2);
+        EXPECT_EQ(MBCodec::Decompress(compressed, len, decompressed, value.size(),
+                                      dict, dict_len), MBError::SUCCESS);
+        EXPECT_EQ(std::string((const char *) decompressed, value.size()), value);
+        // Corrupted data must not be decompressed.
+        EXPECT_EQ(MBCodec::Decompress(compressed, len, decompressed, value.size()-1,
+                                      dict, dict_len), MBError::DECOMPRESS_FAILED);
+    }
+
+    // Value that cannot be compressed within the limit
+    std::string value = "0123456789abcdefghijklmnopqrstuvwxyz";
+    EXPECT_EQ(codec.Compress((const uint8_t *) value.data(), value.size(),
+                             compressed, value.size() - 1), 0);
+}
+
+TEST_F(CompressionTest, db_compression_test)
+{
+    int num = 20000;
+    MBData mbd;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::COMPRESS_DATA;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    for(int i = 0; i < num; i++)
+    {
+        std::string value = GetValue(i);
+        if(i % 10 == 0)
+            EXPECT_EQ(db.AddWithTTL(GetKey(i).c_str(), GetKey(i).size(), value.c_str(),
+                                    value.size(), 3600), MBError::SUCCESS);
+        else
+            EXPECT_EQ(db.Add(GetKey(i), value), MBError::SUCCESS);
+    }
+
+    IndexHeader *header = db.GetDictPtr()->GetHeaderPtr();
+    EXPECT_GT(header->compress_dict_len, 0);
+    // Compressed and uncompressed data take much less space than raw values.
+    size_t raw_size = 0;
+    for(int i = 0; i < num; i++)
+        raw_size += GetValue(i).size() + DATA_HDR_BYTE;
+    EXPECT_LT(header->m_data_offset, raw_size / 2);
+
+    for(int i = 0; i < num; i += 7)
+    {
+        EXPECT_EQ(db.Find(GetKey(i), mbd), MBError::SUCCESS);
+        EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len), GetValue(i));
+    }
+
+    // Overwrite with a value that cannot be compressed
+    std::string value = "0123456789abcdefghijklmnopqrstuvwxyz";
+    EXPECT_EQ(db.Add(GetKey(0), value, true), MBError::SUCCESS);
+
+    // Only the extension fields in use are stored.
+    int record_size;
+    EXPECT_EQ(db.Find(GetKey(0), mbd), MBError::SUCCESS);
+    EXPECT_EQ(db.GetDictPtr()->GetDataRecordSize(mbd.data_offset, record_size),
+              MBError::SUCCESS);
+    EXPECT_EQ(record_size, static_cast<int>(DATA_HDR_BYTE + value.size()));
+    EXPECT_EQ(db.AddWithTTL(value.c_str(), value.size(), value.c_str(), value.size(), 3600),
+              MBError::SUCCESS);
+    EXPECT_EQ(db.Find(value, mbd), MBError::SUCCESS);
+    EXPECT_EQ(db.GetDictPtr()->GetDataRecordSize(mbd.data_offset, record_size),
+              MBError::SUCCESS);
+    EXPECT_EQ(record_size, static_cast<int>(DATA_HDR_BYTE + DATA_EXT_FLAGS_BYTE +
+                                            DATA_EXPIRE_BYTE + value.size()));
+    EXPECT_EQ(db.Remove(value), MBError::SUCCESS);
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    EXPECT_EQ(db_r.Find(GetKey(0), mbd), MBError::SUCCESS);
+    EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len), value);
+    for(int i = 1; i < num; i++)
+    {
+        EXPECT_EQ(db_r.Find(GetKey(i), mbd), MBError::SUCCESS);
+        EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len), GetValue(i));
+        if(i % 10 == 0)
+            EXPECT_NE(mbd.expire_time, 0u);
+        else
+            EXPECT_EQ(mbd.expire_time, 0u);
+    }
+
+    int count = 0;
+    for(DB::iterator iter = db_r.begin(); iter != db_r.end(); ++iter)
+    {
+        if(iter.key == GetKey(0))
+            continue;
+        int i = atoi(iter.key.c_str() + 4);
+        EXPECT_EQ(std::string((const char *) iter.value.buff, iter.value.data_len),
+                  GetValue(i));
+        count++;
+    }
+    EXPECT_EQ(count, num - 1);
+
+    for(int i = 1; i < num; i += 2)
+        EXPECT_EQ(db.Remove(GetKey(i)), MBError::SUCCESS);
+    EXPECT_EQ(db_r.Find(GetKey(1), mbd), MBError::NOT_EXIST);
+    EXPECT_EQ(db_r.Find(GetKey(2), mbd), MBError::SUCCESS);
+    EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len), GetValue(2));
+
+    db_r.Close();
+    db.Close();
+}
+
+TEST_F(CompressionTest, async_writer_encode_test)
+{
+    int num = 20000;
+    int num_threads = 4;
+    MBData mbd;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::ASYNC_WRITER_MODE |
+                     CONSTS::COMPRESS_DATA | CONSTS::DATA_CHECKSUM;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    mbconf.options = CONSTS::ACCESS_MODE_READER | CONSTS::DATA_CHECKSUM;
+    std::vector<DB*> db_handles;
+    for(int t = 0; t < num_threads; t++)
+    {
+        db_handles.push_back(new DB(mbconf));
+        ASSERT_TRUE(db_handles[t]->is_open());
+        ASSERT_EQ(db_handles[t]->SetAsyncWriterPtr(&db), MBError::SUCCESS);
+    }
+
+    // Values added after the dictionary is trained are encoded by the
+    // adding threads.
+    std::vector<std::thread> threads;
+    for(int t = 0; t < num_threads; t++)
+    {
+        threads.push_back(std::thread([&, t] {
+            for(int i = t; i < num; i += num_threads)
+                EXPECT_EQ(db_handles[t]->Add(GetKey(i), GetValue(i)), MBError::SUCCESS);
+        }));
+    }
+    for(int t = 0; t < num_threads; t++)
+        threads[t].join();
+    // Updates of the same key are stored in order.
+    for(int i = 0; i < 100; i++)
+        EXPECT_EQ(db_handles[0]->Add(GetKey(1), GetValue(i), true), MBError::SUCCESS);
+    while(db.AsyncWriterBusy())
+        usleep(10);
+
+    EXPECT_EQ(db.Count(), num);
+    DB *db_r = db_handles[0];
+    EXPECT_EQ(db_r->Find(GetKey(1), mbd), MBError::SUCCESS);
+    EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len), GetValue(99));
+    int num_compressed = 0;
+    for(int i = 2; i < num; i++)
+    {
+        ASSERT_EQ(db_r->Find(GetKey(i), mbd), MBError::SUCCESS);
+        EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len), GetValue(i));
+
+        int record_size, value_len;
+        bool compressed;
+        EXPECT_EQ(db.GetDictPtr()->ReadDataRecordSize(mbd.data_offset, record_size,
+                                                      value_len, compressed),
+                  MBError::SUCCESS);
+        if(compressed)
+            num_compressed++;
+    }
+    EXPECT_GT(num_compressed, num / 2);
+
+    for(int t = 0; t < num_threads; t++)
+    {
+        EXPECT_EQ(db_handles[t]->UnsetAsyncWriterPtr(&db), MBError::SUCCESS);
+        db_handles[t]->Close();
+        delete db_handles[t];
+    }
+    db.Close();
+}
+
+}
@@ -0,0 +1,212 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string>
+#include <vector>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+#include "../mb_hot_keys.h"
+
+using namespace mabain;
+
+namespace {
+
+#define HOT_KEY_TEST_DIR "/var/tmp/mabain_test/"
+
+class HotKeysTest : public ::testing::Test
+{
+public:
+    HotKeysTest() {
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~HotKeysTest() {
+    }
+
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + HOT_KEY_TEST_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -rf ") + HOT_KEY_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = HOT_KEY_TEST_DIR;
+        mbconf.memcap_index = 16*1024*1024;
+        mbconf.memcap_data = 16*1024*1024;
+    }
+    virtual void TearDown() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("rm -rf ") + HOT_KEY_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+    }
+
+    void AddKeys(DB &db, int num) {
+        for(int i = 0; i < num; i++)
+            EXPECT_EQ(db.Add("hot_key_" + std::to_string(i), "value"), MBError::SUCCESS);
+    }
+    void FindKeys(DB &db, int num, const std::string &hot_key, int num_hot) {
+        MBData mbd;
+        for(int n = 0; n < num_hot; n++)
+        {
+            db.Find(hot_key, mbd);
+            if(n < num)
+            {
+                EXPECT_EQ(db.Find("hot_key_" + std::to_string(n), mbd), MBError::SUCCESS);
+            }
+        }
+    }
+
+protected:
+    MBConfig mbconf;
+};
+
+TEST_F(HotKeysTest, top_k_test)
+{
+    std::vector<HotKey> hot_keys;
+    std::string long_key = "hot_key_" + std::string(100, 'x');
+    int num = 1000;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    DB db_no_stats(mbconf);
+    ASSERT_TRUE(db_no_stats.is_open());
+    EXPECT_EQ(db_no_stats.GetHotKeys(hot_keys), MBError::NOT_EXIST);
+    db_no_stats.Close();
+    ResourcePool::getInstance().RemoveAll();
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::HOT_KEY_STATS;
+    mbconf.hot_key_sample_rate = 1;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    AddKeys(db, num);
+    EXPECT_EQ(db.Add(long_key, "value"), MBError::SUCCESS);
+    EXPECT_EQ(db.GetHotKeys(hot_keys), MBError::SUCCESS);
+    EXPECT_EQ(hot_keys.size(), 0u);
+
+    // Lookups by writer are not counted.
+    FindKeys(db, 0, "hot_key_1", 100);
+    EXPECT_EQ(db.GetHotKeys(hot_keys), MBError::SUCCESS);
+    EXPECT_EQ(hot_keys.size(), 0u);
+
+    // Every key is found once and hot_key_7 is found 2000 times by two
+    // readers. The long key is found 1000 times.
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    DB db_r1(mbconf);
+    ASSERT_TRUE(db_r1.is_open());
+    DB db_r2(mbconf);
+    ASSERT_TRUE(db_r2.is_open());
+    FindKeys(db_r1, num, "hot_key_7", 1000);
+    FindKeys(db_r2, 0, "hot_key_7", 1000);
+    FindKeys(db_r2, 0, long_key, 1000);
+
+    EXPECT_EQ(db_r1.GetHotKeys(hot_keys), MBError::SUCCESS);
+    ASSERT_EQ(hot_keys.size(), static_cast<size_t>(MB_HOT_KEY_TOP_K));
+    EXPECT_EQ(hot_keys[0].key, "hot_key_7");
+    EXPECT_GE(hot_keys[0].count, 2001u);
+    EXPECT_EQ(hot_keys[1].key, long_key.substr(0, 64));
+    EXPECT_EQ(hot_keys[1].key_len, static_cast<int>(long_key.size()));
+    EXPECT_GE(hot_keys[1].count, 1000u);
+    for(size_t i = 2; i < hot_keys.size(); i++)
+        EXPECT_LT(hot_keys[i].count, 1000u);
+
+    // Writer sees the same counts.
+    std::vector<HotKey> writer_hot_keys;
+    EXPECT_EQ(db.GetHotKeys(writer_hot_keys), MBError::SUCCESS);
+    ASSERT_EQ(writer_hot_keys.size(), hot_keys.size());
+    EXPECT_EQ(writer_hot_keys[0].count, hot_keys[0].count);
+
+    db_r2.Close();
+    db_r1.Close();
+    db.Close();
+}
+
+TEST_F(HotKeysTest, sample_rate_test)
+{
+    std::vector<HotKey> hot_keys;
+    int num = 100;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::HOT_KEY_STATS;
+    mbconf.hot_key_sample_rate = 10;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    AddKeys(db, num);
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    FindKeys(db_r, 0, "hot_key_3", 5000);
+    EXPECT_EQ(db_r.GetHotKeys(hot_keys), MBError::SUCCESS);
+    ASSERT_EQ(hot_keys.size(), 1u);
+    EXPECT_EQ(hot_keys[0].key, "hot_key_3");
+    EXPECT_EQ(hot_keys[0].count, 5000u);
+
+    db_r.Close();
+    db.Close();
+}
+
+TEST_F(HotKeysTest, dead_lock_owner_test)
+{
+    std::vector<HotKey> hot_keys;
+    int num = 100;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::HOT_KEY_STATS;
+    mbconf.hot_key_sample_rate = 1;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    AddKeys(db, num);
+
+    // Leave the heap locked by a process that has exited.
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if(pid == 0)
+        _exit(0);
+    ASSERT_EQ(waitpid(pid, NULL, 0), pid);
+    std::string path = std::string(HOT_KEY_TEST_DIR) + "_mabain_hotkeys";
+    int fd = open(path.c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+    void *addr = mmap(NULL, sizeof(HotKeyHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    ASSERT_TRUE(addr != MAP_FAILED);
+    HotKeyHeader *header = reinterpret_cast<HotKeyHeader *>(addr);
+    header->heap_lock.store(static_cast<uint32_t>(pid));
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    FindKeys(db_r, 0, "hot_key_7", 100);
+    EXPECT_EQ(header->heap_lock.load(), 0u);
+    EXPECT_EQ(db_r.GetHotKeys(hot_keys), MBError::SUCCESS);
+    ASSERT_EQ(hot_keys.size(), 1u);
+    EXPECT_EQ(hot_keys[0].key, "hot_key_7");
+    EXPECT_EQ(hot_keys[0].count, 100u);
+
+    munmap(addr, sizeof(HotKeyHeader));
+    db_r.Close();
+    db.Close();
+}
+
+}
@@ -0,0 +1,169 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string>
+#include <sstream>
+#include <string.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mb_stats.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+
+using namespace mabain;
+
+namespace {
+
+#define STATS_TEST_DIR "/var/tmp/mabain_test/"
+
+class LatencyStatsTest : public ::testing::Test
+{
+public:
+    LatencyStatsTest() {
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~LatencyStatsTest() {
+    }
+
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + STATS_TEST_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -rf ") + STATS_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = STATS_TEST_DIR;
+        mbconf.memcap_index = 16*1024*1024;
+        mbconf.memcap_data = 16*1024*1024;
+    }
+    virtual void TearDown() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("rm -rf ") + STATS_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+    }
+
+protected:
+    MBConfig mbconf;
+};
+
+TEST_F(LatencyStatsTest, histogram_test)
+{
+    OpStats op_stats;
+    LatencyStats stats;
+
+    op_stats.Get(MB_STATS_OP_FIND, stats);
+    EXPECT_EQ(stats.count, 0u);
+
+    // 990 fast operations and 10 slow ones
+    for(int i = 0; i < 990; i++)
+        op_stats.Record(MB_STATS_OP_FIND, OpStats::Now());
+    for(int i = 0; i < 10; i++)
+        op_stats.Record(MB_STATS_OP_FIND, OpStats::Now() - 10000000);
+    op_stats.Get(MB_STATS_OP_FIND, stats);
+    EXPECT_EQ(stats.count, 1000u);
+    EXPECT_LT(stats.p50_ns, 1000000u);
+    EXPECT_LT(stats.p99_ns, 1000000u);
+    EXPECT_GE(stats.p999_ns, 10000000u * 7 / 8);
+    EXPECT_GE(stats.max_ns, 10000000u);
+    EXPECT_LE(stats.p999_ns, stats.max_ns);
+    EXPECT_GT(stats.mean_ns, 10000000u / 100);
+
+    op_stats.Get(MB_STATS_OP_ADD, stats);
+    EXPECT_EQ(stats.count, 0u);
+    op_stats.Reset();
+    op_stats.Get(MB_STATS_OP_FIND, stats);
+    EXPECT_EQ(stats.count, 0u);
+}
+
+TEST_F(LatencyStatsTest, db_stats_test)
+{
+    LatencyStats stats;
+    MBData mbd;
+    int num = 1000;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    DB db_no_stats(mbconf);
+    ASSERT_TRUE(db_no_stats.is_open());
+    EXPECT_EQ(db_no_stats.GetLatencyStats(MB_STATS_OP_ADD, stats), MBError::NOT_EXIST);
+    EXPECT_EQ(db_no_stats.GetWriterLatencyStats(MB_STATS_OP_ADD, stats), MBError::NOT_EXIST);
+    db_no_stats.Close();
+    ResourcePool::getInstance().RemoveAll();
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::LATENCY_STATS;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    for(int i = 0; i < num; i++)
+        EXPECT_EQ(db.Add("key_" + std::to_string(i), "value"), MBError::SUCCESS);
+    for(int i = 0; i < 10; i++)
+        EXPECT_EQ(db.Remove("key_" + std::to_string(i)), MBError::SUCCESS);
+    EXPECT_EQ(db.Find("key_100", mbd), MBError::SUCCESS);
+
+    // A reader without latency stats can read the writer histograms.
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    EXPECT_EQ(db_r.GetLatencyStats(MB_STATS_OP_FIND, stats), MBError::NOT_EXIST);
+    EXPECT_EQ(db_r.GetWriterLatencyStats(MB_STATS_NUM_OPS, stats), MBError::INVALID_ARG);
+    EXPECT_EQ(db_r.GetWriterLatencyStats(MB_STATS_OP_ADD, stats), MBError::SUCCESS);
+    EXPECT_EQ(stats.count, static_cast<uint64_t>(num));
+    EXPECT_GT(stats.p50_ns, 0u);
+    EXPECT_LE(stats.p50_ns, stats.p99_ns);
+    EXPECT_LE(stats.p99_ns, stats.p999_ns);
+    EXPECT_LE(stats.p999_ns, stats.max_ns);
+    EXPECT_EQ(db_r.GetWriterLatencyStats(MB_STATS_OP_REMOVE, stats), MBError::SUCCESS);
+    EXPECT_EQ(stats.count, 10u);
+    EXPECT_EQ(db_r.GetWriterLatencyStats(MB_STATS_OP_FIND, stats), MBError::SUCCESS);
+    EXPECT_EQ(stats.count, 1u);
+    EXPECT_EQ(db.GetLatencyStats(MB_STATS_OP_FIND, stats), MBError::SUCCESS);
+    EXPECT_EQ(stats.count, 1u);
+    EXPECT_EQ(db.CollectResource(1, 1), MBError::SUCCESS);
+    EXPECT_EQ(db_r.GetWriterLatencyStats(MB_STATS_OP_RC, stats), MBError::SUCCESS);
+    EXPECT_EQ(stats.count, 1u);
+    EXPECT_GT(stats.max_ns, 0u);
+
+    // Reader histograms are per handle.
+    mbconf.options = CONSTS::ACCESS_MODE_READER | CONSTS::LATENCY_STATS;
+    DB db_r2(mbconf);
+    ASSERT_TRUE(db_r2.is_open());
+    for(int i = 0; i < num; i++)
+        EXPECT_EQ(db_r2.Find("key_" + std::to_string(i), mbd),
+                  i < 10 ? MBError::NOT_EXIST : MBError::SUCCESS);
+    EXPECT_EQ(db_r2.FindLongestPrefix("key_100_abc", mbd), MBError::SUCCESS);
+    EXPECT_EQ(db_r2.GetLatencyStats(MB_STATS_OP_FIND, stats), MBError::SUCCESS);
+    EXPECT_EQ(stats.count, static_cast<uint64_t>(num));
+    EXPECT_EQ(db_r2.GetLatencyStats(MB_STATS_OP_FIND_PREFIX, stats), MBError::SUCCESS);
+    EXPECT_EQ(stats.count, 1u);
+    EXPECT_EQ(db_r.GetWriterLatencyStats(MB_STATS_OP_FIND, stats), MBError::SUCCESS);
+    EXPECT_EQ(stats.count, 1u);
+
+    std::ostringstream out;
+    db_r2.PrintLatencyStats(out);
+    EXPECT_NE(out.str().find("this handle"), std::string::npos);
+    EXPECT_NE(out.str().find("writer"), std::string::npos);
+
+    db_r2.Close();
+    db_r.Close();
+    db.Close();
+}
+
+}
@@ -16,9 +16,17 @@
 
 // @author Changxue Deng <chadeng@cisco.com>
 
+#include <string>
+#include <functional>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
 #include <gtest/gtest.h>
 
 #include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
 #include "../resource_pool.h"
 
 using namespace mabain;
@@ -98,4 +106,161 @@ TEST_F(MemoryOnlyTest, MemoryOnlyTest_test_async)
     db_r.Close();
 }
 
+#define SHM_TEST_DIR "/var/tmp/mabain_test/shm_db/"
+#define SHM_SNAPSHOT_DIR "/var/tmp/mabain_test/shm_snapshot/"
+
+class SharedMemoryTest : public ::testing::Test
+{
+public:
+    SharedMemoryTest() {
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~SharedMemoryTest() {
+    }
+
+    virtual void SetUp() {
+        DB::RemoveSharedMemory(SHM_TEST_DIR);
+        std::string cmd = std::string("rm -rf ") + SHM_SNAPSHOT_DIR + "; mkdir -p " +
+                          SHM_SNAPSHOT_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = SHM_TEST_DIR;
+        mbconf.options = CONSTS::WriterOptions() | CONSTS::SHARED_MEMORY_MODE;
+        mbconf.block_size_index = 4*1024*1024;
+        mbconf.block_size_data = 4*1024*1024;
+        mbconf.memcap_index = 16*1024*1024;
+        mbconf.memcap_data = 16*1024*1024;
+    }
+    virtual void TearDown() {
+        ResourcePool::getInstance().RemoveAll();
+        DB::RemoveSharedMemory(SHM_TEST_DIR);
+        std::string cmd = std::string("rm -rf ") + SHM_SNAPSHOT_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+    }
+
+    // Run the function in a child process and return its exit code.
+    int run_in_child(std::function<int()> func) {
+        pid_t pid = fork();
+        if(pid == 0) {
+            // Drop handles inherited from the parent.
+            ResourcePool::getInstance().RemoveAll();
+            _exit(func());
+        }
+        int wstatus = 0;
+        if(pid < 0 || waitpid(pid, &wstatus, 0) != pid || !WIFEXITED(wstatus))
+            return -1;
+        return WEXITSTATUS(wstatus);
+    }
+
+protected:
+    MBConfig mbconf;
+};
+
+TEST_F(SharedMemoryTest, multi_process_test)
+{
+    MBConfig rconf = mbconf;
+    rconf.options = CONSTS::ReaderOptions() | CONSTS::SHARED_MEMORY_MODE;
+    DB db_none(rconf);
+    EXPECT_EQ(db_none.Status(), MBError::NO_DB);
+
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    int num = 10000;
+    for(int i = 0; i < num; i++) {
+        std::string key = "shm_key_" + std::to_string(i);
+        EXPECT_EQ(db.Add(key, key), MBError::SUCCESS);
+    }
+    // Nothing is written to the DB directory.
+    EXPECT_NE(access(SHM_TEST_DIR "_mabain_h", F_OK), 0);
+
+    // Readers in other processes see the DB.
+    EXPECT_EQ(run_in_child([&] {
+        DB db_r(rconf);
+        if(!db_r.is_open() || db_r.Count() != num)
+            return 1;
+        MBData mbd;
+        for(int i = 0; i < num; i++) {
+            std::string key = "shm_key_" + std::to_string(i);
+            if(db_r.Find(key, mbd) != MBError::SUCCESS ||
+               std::string((const char *) mbd.buff, mbd.data_len) != key)
+                return 2;
+        }
+        db_r.Close();
+        return 0;
+    }), 0);
+
+    // Only one writer across processes
+    EXPECT_EQ(run_in_child([&] {
+        DB db_w(mbconf);
+        return db_w.Status() == MBError::WRITER_EXIST ? 0 : 1;
+    }), 0);
+
+    // Writer changes are seen by the reader in this process.
+    DB db_r(rconf);
+    ASSERT_TRUE(db_r.is_open());
+    EXPECT_EQ(db.Remove("shm_key_0"), MBError::SUCCESS);
+    MBData mbd;
+    EXPECT_EQ(db_r.Find("shm_key_0", mbd), MBError::NOT_EXIST);
+    db_r.Close();
+    db.Close();
+}
+
+TEST_F(SharedMemoryTest, persist_restore_test)
+{
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    int num = 5000;
+    for(int i = 0; i < num; i++) {
+        std::string key = "shm_key_" + std::to_string(i);
+        EXPECT_EQ(db.Add(key, "value_" + std::to_string(i)), MBError::SUCCESS);
+    }
+
+    // Snapshot persists the DB to disk.
+    EXPECT_EQ(db.Snapshot(SHM_SNAPSHOT_DIR), MBError::SUCCESS);
+    EXPECT_EQ(db.WaitSnapshot(), MBError::SUCCESS);
+    db.Close();
+    ResourcePool::getInstance().RemoveAll();
+
+    // Shared memory DB survives the writer handle.
+    MBConfig rconf = mbconf;
+    rconf.options = CONSTS::ReaderOptions() | CONSTS::SHARED_MEMORY_MODE;
+    DB db_r(rconf);
+    EXPECT_TRUE(db_r.is_open());
+    EXPECT_EQ(db_r.Count(), num);
+    db_r.Close();
+    ResourcePool::getInstance().RemoveAll();
+
+    EXPECT_EQ(DB::RemoveSharedMemory(SHM_TEST_DIR), MBError::SUCCESS);
+    EXPECT_EQ(DB::RemoveSharedMemory(SHM_TEST_DIR), MBError::NOT_EXIST);
+    DB db_gone(rconf);
+    EXPECT_EQ(db_gone.Status(), MBError::NO_DB);
+
+    // The snapshot is a regular DB on disk.
+    MBConfig disk_conf = rconf;
+    disk_conf.mbdir = SHM_SNAPSHOT_DIR;
+    disk_conf.options = CONSTS::ReaderOptions();
+    DB db_disk(disk_conf);
+    ASSERT_TRUE(db_disk.is_open());
+    EXPECT_EQ(db_disk.Count(), num);
+    db_disk.Close();
+    ResourcePool::getInstance().RemoveAll();
+
+    EXPECT_EQ(DB::RestoreSharedMemory(SHM_SNAPSHOT_DIR, SHM_TEST_DIR), MBError::SUCCESS);
+    EXPECT_EQ(DB::RestoreSharedMemory(SHM_SNAPSHOT_DIR, SHM_TEST_DIR), MBError::NOT_ALLOWED);
+    DB db_w(mbconf);
+    ASSERT_TRUE(db_w.is_open());
+    EXPECT_EQ(db_w.Count(), num);
+    MBData mbd;
+    for(int i = 0; i < num; i += 7) {
+        std::string key = "shm_key_" + std::to_string(i);
+        EXPECT_EQ(db_w.Find(key, mbd), MBError::SUCCESS);
+        EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len),
+                  "value_" + std::to_string(i));
+    }
+    EXPECT_EQ(db_w.Add("new_key", "new_value"), MBError::SUCCESS);
+    EXPECT_EQ(db_w.Count(), num + 1);
+    db_w.Close();
+}
+
 }
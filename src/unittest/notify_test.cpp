@@ -0,0 +1,166 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string>
+#include <thread>
+#include <string.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mb_notify.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+
+using namespace mabain;
+
+namespace {
+
+#define NOTIFY_TEST_DIR "/var/tmp/mabain_test/"
+
+class ChangeNotifyTest : public ::testing::Test
+{
+public:
+    ChangeNotifyTest() {
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~ChangeNotifyTest() {
+    }
+
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + NOTIFY_TEST_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -rf ") + NOTIFY_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = NOTIFY_TEST_DIR;
+        mbconf.memcap_index = 16*1024*1024;
+        mbconf.memcap_data = 16*1024*1024;
+    }
+    virtual void TearDown() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("rm -rf ") + NOTIFY_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+    }
+
+protected:
+    MBConfig mbconf;
+};
+
+TEST_F(ChangeNotifyTest, feed_test)
+{
+    MBData mbd;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    DB db_no_notify(mbconf);
+    ASSERT_TRUE(db_no_notify.is_open());
+    ChangeFeed no_feed(db_no_notify);
+    EXPECT_EQ(no_feed.Status(), MBError::NOT_EXIST);
+    EXPECT_EQ(db_no_notify.WaitForKey("abc", mbd, 10), MBError::NOT_EXIST);
+    db_no_notify.Close();
+    ResourcePool::getInstance().RemoveAll();
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::CHANGE_NOTIFY;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    EXPECT_EQ(db.Add("key_0", "value_0"), MBError::SUCCESS);
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    ChangeFeed feed(db_r);
+    ASSERT_EQ(feed.Status(), MBError::SUCCESS);
+    uint64_t seq = feed.GetSeq();
+
+    ChangeRecord rec;
+    EXPECT_EQ(feed.Next(rec, 10), MBError::TRY_AGAIN);
+
+    int num = 1000;
+    std::thread writer([&] {
+        for(int i = 1; i <= num; i++) {
+            std::string key = "key_" + std::to_string(i);
+            EXPECT_EQ(db.Add(key, "value_" + std::to_string(i)), MBError::SUCCESS);
+            if(i % 100 == 0)
+                usleep(1000);
+        }
+        EXPECT_EQ(db.Remove("key_1"), MBError::SUCCESS);
+        EXPECT_EQ(db.RemoveAll(), MBError::SUCCESS);
+    });
+
+    for(int i = 1; i <= num; i++) {
+        ASSERT_EQ(feed.Next(rec, 5000), MBError::SUCCESS);
+        EXPECT_EQ(rec.op, MB_REPL_OP_ADD);
+        EXPECT_EQ(rec.key, "key_" + std::to_string(i));
+        EXPECT_EQ(rec.seq, seq + i);
+        // The change is visible to readers once published.
+        EXPECT_EQ(db_r.Find(rec.key, mbd), MBError::SUCCESS);
+    }
+    EXPECT_EQ(feed.Next(rec, 5000), MBError::SUCCESS);
+    EXPECT_EQ(rec.op, MB_REPL_OP_REMOVE);
+    EXPECT_EQ(rec.key, "key_1");
+    EXPECT_EQ(feed.Next(rec, 5000), MBError::SUCCESS);
+    EXPECT_EQ(rec.op, MB_REPL_OP_REMOVE_ALL);
+    writer.join();
+
+    // Reader falling behind more than the ring size loses changes.
+    for(int i = 0; i < MB_NOTIFY_NUM_SLOTS + 10; i++)
+        EXPECT_EQ(db.Add("key_" + std::to_string(i), "value"), MBError::SUCCESS);
+    EXPECT_EQ(feed.Next(rec, 10), MBError::BUFFER_LOST);
+    EXPECT_EQ(feed.Next(rec, 10), MBError::TRY_AGAIN);
+    EXPECT_EQ(db.Add("key_new", "value"), MBError::SUCCESS);
+    EXPECT_EQ(feed.Next(rec, 10), MBError::SUCCESS);
+    EXPECT_EQ(rec.key, "key_new");
+
+    db_r.Close();
+    db.Close();
+}
+
+TEST_F(ChangeNotifyTest, wait_for_key_test)
+{
+    MBData mbd;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::CHANGE_NOTIFY;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    EXPECT_EQ(db.Add("existing", "value"), MBError::SUCCESS);
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    EXPECT_EQ(db_r.WaitForKey("existing", mbd, 0), MBError::SUCCESS);
+    EXPECT_EQ(db_r.WaitForKey("missing", mbd, 50), MBError::NOT_EXIST);
+
+    std::thread writer([&] {
+        usleep(100000);
+        for(int i = 0; i < 100; i++)
+            EXPECT_EQ(db.Add("other_" + std::to_string(i), "value"), MBError::SUCCESS);
+        EXPECT_EQ(db.Add("waited", "waited_value"), MBError::SUCCESS);
+    });
+    EXPECT_EQ(db_r.WaitForKey("waited", mbd, 5000), MBError::SUCCESS);
+    EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len), "waited_value");
+    writer.join();
+
+    db_r.Close();
+    db.Close();
+}
+
+}
@@ -0,0 +1,219 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string>
+#include <thread>
+#include <string.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../mb_repl.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define REPL_TEST_DIR      "/var/tmp/mabain_test/"
+#define REPL_FOLLOWER_DIR  "/var/tmp/mabain_test/follower/"
+#define REPL_ENDPOINT      "/var/tmp/mabain_test/_repl_sock"
+#define ONE_MEGA 1024*1024ul
+
+class ReplicationTest : public ::testing::Test
+{
+public:
+    ReplicationTest() {
+        memset(&master_conf, 0, sizeof(master_conf));
+        memset(&follower_conf, 0, sizeof(follower_conf));
+    }
+    virtual ~ReplicationTest() {
+    }
+
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + REPL_FOLLOWER_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -rf ") + REPL_TEST_DIR + "_* " + REPL_FOLLOWER_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        master_conf.mbdir = REPL_TEST_DIR;
+        master_conf.options = CONSTS::ACCESS_MODE_WRITER;
+        master_conf.memcap_index = 16*ONE_MEGA;
+        master_conf.memcap_data = 16*ONE_MEGA;
+        master_conf.repl_endpoint = REPL_ENDPOINT;
+        follower_conf.mbdir = REPL_FOLLOWER_DIR;
+        follower_conf.options = CONSTS::ACCESS_MODE_WRITER;
+        follower_conf.memcap_index = 16*ONE_MEGA;
+        follower_conf.memcap_data = 16*ONE_MEGA;
+    }
+    virtual void TearDown() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("rm -rf ") + REPL_TEST_DIR + "_* " + REPL_FOLLOWER_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+    }
+
+    bool WaitForSeq(const ReplicationFollower &follower, uint64_t seq) {
+        for(int i = 0; i < 1000; i++) {
+            if(follower.GetSeq() == seq)
+                return true;
+            usleep(10000);
+        }
+        return false;
+    }
+
+    void CompareDB(DB &master, DB &follower) {
+        MBData mbd;
+        int64_t count = 0;
+        for(DB::iterator iter = master.begin(); iter != master.end(); ++iter) {
+            EXPECT_EQ(follower.Find(iter.key, mbd), MBError::SUCCESS);
+            EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len),
+                      std::string((const char *) iter.value.buff, iter.value.data_len));
+            EXPECT_EQ(mbd.expire_time, iter.value.expire_time);
+            count++;
+        }
+        EXPECT_EQ(count, master.Count());
+        EXPECT_EQ(follower.Count(), master.Count());
+    }
+
+protected:
+    MBConfig master_conf;
+    MBConfig follower_conf;
+};
+
+TEST_F(ReplicationTest, replicate_test)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    std::string key;
+    int num = 5000;
+
+    DB db(master_conf);
+    ASSERT_TRUE(db.is_open());
+    IndexHeader *header = db.GetDictPtr()->GetHeaderPtr();
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        if(i % 10 == 0)
+            EXPECT_EQ(db.AddWithTTL(key.c_str(), key.size(), key.c_str(), key.size(), 3600),
+                      MBError::SUCCESS);
+        else
+            EXPECT_EQ(db.Add(key, key), MBError::SUCCESS);
+    }
+    for(int i = 0; i < num; i += 7) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db.Add(key, key + "_updated", true), MBError::SUCCESS);
+    }
+    for(int i = 1; i < num; i += 9)
+        EXPECT_EQ(db.Remove(tkey.get_key(i)), MBError::SUCCESS);
+    // Failed operations are not shipped.
+    EXPECT_EQ(db.Add(tkey.get_key(2), "abc"), MBError::IN_DICT);
+
+    DB db_follower(follower_conf);
+    ASSERT_TRUE(db_follower.is_open());
+    int rval = MBError::SUCCESS;
+    ReplicationFollower *follower = new ReplicationFollower(db_follower, REPL_ENDPOINT);
+    std::thread follower_thread([&] { rval = follower->Run(); });
+    EXPECT_TRUE(WaitForSeq(*follower, header->repl_seq));
+    CompareDB(db, db_follower);
+    follower->Stop();
+    follower_thread.join();
+    EXPECT_EQ(rval, MBError::DB_CLOSED);
+    delete follower;
+
+    // Follower resumes from the last applied record.
+    uint64_t seq = header->repl_seq;
+    for(int i = num; i < 2*num; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db.Add(key, key), MBError::SUCCESS);
+    }
+    follower = new ReplicationFollower(db_follower, REPL_ENDPOINT);
+    EXPECT_EQ(follower->GetSeq(), seq);
+    std::thread resume_thread([&] { rval = follower->Run(); });
+    EXPECT_TRUE(WaitForSeq(*follower, header->repl_seq));
+    CompareDB(db, db_follower);
+
+    EXPECT_EQ(db.RemoveAll(), MBError::SUCCESS);
+    EXPECT_TRUE(WaitForSeq(*follower, header->repl_seq));
+    EXPECT_EQ(db_follower.Count(), 0);
+    follower->Stop();
+    resume_thread.join();
+    EXPECT_EQ(rval, MBError::DB_CLOSED);
+    delete follower;
+
+    db_follower.Close();
+    db.Close();
+}
+
+TEST_F(ReplicationTest, resync_test)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    std::string key;
+
+    master_conf.repl_log_size = 4096;
+    DB db(master_conf);
+    ASSERT_TRUE(db.is_open());
+    IndexHeader *header = db.GetDictPtr()->GetHeaderPtr();
+    for(int i = 0; i < 1000; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db.Add(key, key), MBError::SUCCESS);
+    }
+
+    DB db_follower(follower_conf);
+    ASSERT_TRUE(db_follower.is_open());
+    IndexHeader *follower_header = db_follower.GetDictPtr()->GetHeaderPtr();
+
+    // Records before the follower were dropped from the log.
+    ReplicationFollower follower(db_follower, REPL_ENDPOINT);
+    EXPECT_EQ(follower.Run(), MBError::NOT_EXIST);
+    EXPECT_EQ(follower.GetSeq(), 0u);
+
+    // Follower cannot be ahead of master.
+    follower_header->repl_seq = header->repl_seq + 100;
+    EXPECT_EQ(follower.Run(), MBError::INVALID_ARG);
+
+    // Follower restored to the current sequence catches up new records.
+    follower_header->repl_seq = header->repl_seq;
+    int rval = MBError::SUCCESS;
+    std::thread follower_thread([&] { rval = follower.Run(); });
+    for(int i = 1000; i < 1100; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db.Add(key, key), MBError::SUCCESS);
+    }
+    EXPECT_TRUE(WaitForSeq(follower, header->repl_seq));
+    EXPECT_EQ(db_follower.Count(), 100);
+    follower.Stop();
+    follower_thread.join();
+    EXPECT_EQ(rval, MBError::DB_CLOSED);
+
+    // Reader DB cannot be a follower.
+    follower_conf.options = CONSTS::ACCESS_MODE_READER;
+    DB db_reader(follower_conf);
+    ReplicationFollower reader_follower(db_reader, REPL_ENDPOINT);
+    EXPECT_EQ(reader_follower.Run(), MBError::NOT_ALLOWED);
+
+    db_reader.Close();
+    db_follower.Close();
+    db.Close();
+}
+
+}
@@ -0,0 +1,130 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+
+using namespace mabain;
+
+namespace {
+
+#define USAGE_TEST_DIR "/var/tmp/mabain_test/"
+#define ONE_MEGA       (1024*1024)
+
+class ResourceUsageTest : public ::testing::Test
+{
+public:
+    ResourceUsageTest() {
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~ResourceUsageTest() {
+    }
+
+    virtual void SetUp() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("mkdir -p ") + USAGE_TEST_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -rf ") + USAGE_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = USAGE_TEST_DIR;
+        mbconf.block_size_index = 4*ONE_MEGA;
+        mbconf.block_size_data = 4*ONE_MEGA;
+        mbconf.memcap_index = 16*ONE_MEGA;
+        mbconf.memcap_data = 4*ONE_MEGA;
+    }
+    virtual void TearDown() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("rm -rf ") + USAGE_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+    }
+
+    int64_t SumBytes(const int64_t *bytes) {
+        int64_t sum = 0;
+        for(int i = 0; i < MB_USAGE_NUM_SIZE_CLASS; i++)
+            sum += bytes[i];
+        return sum;
+    }
+
+protected:
+    MBConfig mbconf;
+};
+
+TEST_F(ResourceUsageTest, usage_test)
+{
+    ResourceUsage usage;
+    std::string value(1000, 'v');
+    int num = 10000;
+    int num_removed = 100;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    for(int i = 0; i < num; i++)
+        EXPECT_EQ(db.Add("usage_key_" + std::to_string(i), value), MBError::SUCCESS);
+    for(int i = 0; i < num_removed; i++)
+        EXPECT_EQ(db.Remove("usage_key_" + std::to_string(i)), MBError::SUCCESS);
+
+    EXPECT_EQ(db.GetResourceUsage(usage), MBError::SUCCESS);
+    EXPECT_EQ(usage.count, num - num_removed);
+    EXPECT_GE(usage.index.num_block, 1);
+    EXPECT_EQ(usage.index.num_mapped_block, usage.index.num_block);
+    // About 10M of values in 4M data blocks and only one block is mapped
+    EXPECT_GE(usage.data.num_block, 3);
+    EXPECT_EQ(usage.data.num_mapped_block, 1);
+    EXPECT_GE(usage.data.mapped_bytes, static_cast<size_t>(4*ONE_MEGA));
+    EXPECT_GT(usage.pending_data_buff_size, 0);
+    EXPECT_GT(usage.pending_index_buff_size, 0);
+    // Removed values are all in the same size class.
+    int64_t data_free_bytes = SumBytes(usage.data_free_bytes);
+    EXPECT_GT(data_free_bytes, 0);
+    EXPECT_LE(data_free_bytes, usage.pending_data_buff_size);
+    EXPECT_EQ(usage.data_free_bytes[9], data_free_bytes);
+    EXPECT_LE(SumBytes(usage.index_free_bytes), usage.pending_index_buff_size);
+    EXPECT_EQ(usage.rc_root_offset, 0u);
+    EXPECT_EQ(usage.rc_index_bytes, 0u);
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    mbconf.cache_size_data = ONE_MEGA;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open()) << db_r.StatusStr();
+    MBData mbd;
+    EXPECT_EQ(db_r.Find("usage_key_" + std::to_string(num - 1), mbd), MBError::SUCCESS);
+    EXPECT_EQ(db_r.GetResourceUsage(usage), MBError::SUCCESS);
+    EXPECT_EQ(usage.count, num - num_removed);
+    // Reader only opened the last data block, which is not mapped.
+    EXPECT_GE(usage.data.num_block, 1);
+    EXPECT_LT(usage.data.num_mapped_block, usage.data.num_block);
+    EXPECT_GT(usage.data.cache_bytes, 0u);
+    EXPECT_EQ(SumBytes(usage.data_free_bytes), 0);
+    EXPECT_EQ(SumBytes(usage.index_free_bytes), 0);
+
+    db_r.Close();
+    db.Close();
+}
+
+}
@@ -17,6 +17,8 @@
 // @author Changxue Deng <chadeng@cisco.com>
 
 #include <string>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <gtest/gtest.h>
 
@@ -230,4 +232,86 @@ TEST_F(RollableFileTest, Flush_test)
     rfile->Flush();
 }
 
+TEST_F(RollableFileTest, AdaptiveMmap_test)
+{
+    std::string path = std::string(ROLLABLE_FILE_TEST_DIR) + "/_mabain_d";
+    rfile = new RollableFile(path, 4*ONE_MEGA, 0, CONSTS::ACCESS_MODE_WRITER, 0);
+    EXPECT_EQ(rfile != NULL, true);
+
+    int nbytes = 64;
+    size_t offset;
+    uint8_t *ptr;
+    for(int i = 0; i < 4; i++) {
+        offset = i*4*ONE_MEGA + 1000;
+        rfile->Reserve(offset, nbytes, ptr);
+        EXPECT_EQ(rfile->RandomWrite((const void *)FAKE_DATA, nbytes, offset), 64u);
+    }
+
+    // Memcap only allows one block to be mapped.
+    RollableFile *reader = new RollableFile(path, 4*ONE_MEGA, 4*ONE_MEGA,
+                CONSTS::ACCESS_MODE_READER | CONSTS::ADAPTIVE_MMAP, 8);
+    uint8_t buff[256];
+    EXPECT_EQ(reader->RandomRead(buff, nbytes, 1000), 64u);
+    EXPECT_EQ(memcmp(buff, FAKE_DATA, nbytes)==0, true);
+    EXPECT_EQ(reader->GetShmPtr(1000, nbytes) != NULL, true);
+
+    offset = 3*4*ONE_MEGA + 1000;
+    for(int i = 0; i < 100000; i++) {
+        EXPECT_EQ(reader->RandomRead(buff, nbytes, offset), 64u);
+    }
+    EXPECT_EQ(memcmp(buff, FAKE_DATA, nbytes)==0, true);
+
+    // The hot block is mapped and the cold one is unmapped.
+    EXPECT_EQ(reader->GetShmPtr(offset, nbytes) != NULL, true);
+    EXPECT_EQ(reader->GetShmPtr(1000, nbytes) == NULL, true);
+    EXPECT_EQ(memcmp(reader->GetShmPtr(offset, nbytes), FAKE_DATA, nbytes)==0, true);
+    EXPECT_EQ(reader->RandomRead(buff, nbytes, 1000), 64u);
+    EXPECT_EQ(memcmp(buff, FAKE_DATA, nbytes)==0, true);
+    delete reader;
+}
+
+TEST_F(RollableFileTest, Prealloc_test)
+{
+    std::string path = std::string(ROLLABLE_FILE_TEST_DIR) + "/_mabain_d";
+    rfile = new RollableFile(path, 4*ONE_MEGA, 8*ONE_MEGA, CONSTS::ACCESS_MODE_WRITER, 0);
+    EXPECT_EQ(rfile != NULL, true);
+
+    size_t offset = 0;
+    uint8_t *ptr;
+    EXPECT_EQ(rfile->Reserve(offset, 64, ptr), MBError::SUCCESS);
+    EXPECT_EQ(ptr != NULL, true);
+
+    // The next block is created in background.
+    struct stat st;
+    int i;
+    for(i = 0; i < 200; i++) {
+        if(stat((path + "1").c_str(), &st) == 0 && st.st_size == (off_t) (4*ONE_MEGA))
+            break;
+        usleep(10000);
+    }
+    EXPECT_LT(i, 200);
+
+    offset = 4*ONE_MEGA;
+    EXPECT_EQ(rfile->Reserve(offset, 64, ptr), MBError::SUCCESS);
+    EXPECT_EQ(ptr != NULL, true);
+    memcpy(ptr, FAKE_DATA, 64);
+
+    // Memcap is used up; the third block is not mapped.
+    offset = 8*ONE_MEGA;
+    EXPECT_EQ(rfile->Reserve(offset, 64, ptr), MBError::SUCCESS);
+    EXPECT_EQ(ptr == NULL, true);
+    EXPECT_EQ(rfile->RandomWrite((const void *)FAKE_DATA, 64, offset), 64u);
+
+    uint8_t buff[256];
+    EXPECT_EQ(rfile->RandomRead(buff, 64, 4*ONE_MEGA), 64u);
+    EXPECT_EQ(memcmp(buff, FAKE_DATA, 64)==0, true);
+    EXPECT_EQ(rfile->RandomRead(buff, 64, 8*ONE_MEGA), 64u);
+    EXPECT_EQ(memcmp(buff, FAKE_DATA, 64)==0, true);
+
+    delete rfile;
+    rfile = NULL;
+    EXPECT_EQ(stat((path + "3").c_str(), &st), 0);
+    EXPECT_EQ(st.st_size, (off_t) (4*ONE_MEGA));
+}
+
 }
@@ -0,0 +1,306 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include "../sharded_db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define SHARD_TEST_DIR "/var/tmp/mabain_test/"
+#define ONE_MEGA 1024*1024ul
+
+class ShardedDBTest : public ::testing::Test
+{
+public:
+    ShardedDBTest() {
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~ShardedDBTest() {
+    }
+
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + SHARD_TEST_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -rf ") + SHARD_TEST_DIR + "_* " + SHARD_TEST_DIR + "shard_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = SHARD_TEST_DIR;
+        mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+        mbconf.memcap_index = 64*ONE_MEGA;
+        mbconf.memcap_data = 64*ONE_MEGA;
+    }
+    virtual void TearDown() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("rm -rf ") + SHARD_TEST_DIR + "_* " + SHARD_TEST_DIR + "shard_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+    }
+
+protected:
+    MBConfig mbconf;
+};
+
+TEST_F(ShardedDBTest, hash_shard_test)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    int num_shards = 4;
+    int num = 10000;
+    int num_threads = 4;
+
+    ShardedDB sdb(mbconf, num_shards);
+    ASSERT_EQ(sdb.Status(), MBError::SUCCESS);
+    EXPECT_EQ(sdb.NumShards(), num_shards);
+
+    // Several ingest threads write to all shards at the same time.
+    std::vector<std::thread> threads;
+    for(int t = 0; t < num_threads; t++) {
+        threads.push_back(std::thread([&, t] {
+            // TestKey returns its own buffer and cannot be shared by threads.
+            TestKey thread_tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+            for(int i = t; i < num; i += num_threads) {
+                std::string key = thread_tkey.get_key(i);
+                EXPECT_EQ(sdb.AddAsync(key, key), MBError::SUCCESS);
+            }
+        }));
+    }
+    for(int t = 0; t < num_threads; t++)
+        threads[t].join();
+    EXPECT_EQ(sdb.Wait(), MBError::SUCCESS);
+    EXPECT_EQ(sdb.Count(), num);
+
+    // Queued write errors are reported by Wait.
+    EXPECT_EQ(sdb.AddAsync(tkey.get_key(0), "abc"), MBError::SUCCESS);
+    EXPECT_EQ(sdb.Wait(), MBError::IN_DICT);
+    EXPECT_EQ(sdb.Wait(), MBError::SUCCESS);
+
+    // Keys are spread across all shards.
+    std::vector<int> shard_count(num_shards, 0);
+    for(int i = 0; i < num; i++)
+        shard_count[sdb.GetShard(tkey.get_key(i))]++;
+    for(int i = 0; i < num_shards; i++)
+        EXPECT_GT(shard_count[i], num / num_shards / 2);
+
+    MBData mbd;
+    std::string key = tkey.get_key(10);
+    EXPECT_EQ(sdb.Find(key, mbd), MBError::SUCCESS);
+    EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len), key);
+
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+    std::vector<int> rvals;
+    for(int i = 0; i < 100; i++)
+        keys.push_back(tkey.get_key(i * 2));
+    keys.push_back("not_found");
+    EXPECT_EQ(sdb.FindBatch(keys, values, rvals), MBError::SUCCESS);
+    ASSERT_EQ(rvals.size(), keys.size());
+    for(int i = 0; i < 100; i++) {
+        EXPECT_EQ(rvals[i], MBError::SUCCESS);
+        EXPECT_EQ(values[i], keys[i]);
+    }
+    EXPECT_EQ(rvals[100], MBError::NOT_EXIST);
+
+    // Merged iterator returns all keys in order.
+    std::string prev;
+    int count = 0;
+    for(ShardedDB::iterator iter = sdb.begin(); iter != sdb.end(); ++iter) {
+        if(count > 0) {
+            EXPECT_LT(prev, iter.key);
+        }
+        EXPECT_EQ(iter.key, iter.value);
+        prev = iter.key;
+        count++;
+    }
+    EXPECT_EQ(count, num);
+
+    EXPECT_EQ(sdb.Remove(key), MBError::SUCCESS);
+    EXPECT_EQ(sdb.Find(key, mbd), MBError::NOT_EXIST);
+    EXPECT_EQ(sdb.Remove(key), MBError::NOT_EXIST);
+    EXPECT_EQ(sdb.Count(), num - 1);
+    EXPECT_EQ(sdb.RemoveAll(), MBError::SUCCESS);
+    EXPECT_EQ(sdb.Count(), 0);
+
+    sdb.Close();
+    EXPECT_EQ(sdb.Add("abc", "abc"), MBError::DB_CLOSED);
+}
+
+TEST_F(ShardedDBTest, prefix_test)
+{
+    ShardedDB sdb(mbconf, 3);
+    ASSERT_EQ(sdb.Status(), MBError::SUCCESS);
+
+    EXPECT_EQ(sdb.Add("ab", "ab"), MBError::SUCCESS);
+    EXPECT_EQ(sdb.Add("abcd", "abcd"), MBError::SUCCESS);
+    EXPECT_EQ(sdb.Add("abcdef", "abcdef"), MBError::SUCCESS);
+    EXPECT_EQ(sdb.Add("abx", "abx"), MBError::SUCCESS);
+    EXPECT_EQ(sdb.Add("b", "b"), MBError::SUCCESS);
+    for(int i = 0; i < 100; i++) {
+        std::string key = "prefix_" + std::to_string(i);
+        EXPECT_EQ(sdb.Add(key, key), MBError::SUCCESS);
+    }
+
+    MBData mbd;
+    EXPECT_EQ(sdb.FindLongestPrefix("abcdexyz", mbd), MBError::SUCCESS);
+    EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len), "abcd");
+    mbd.Clear();
+    EXPECT_EQ(sdb.FindLongestPrefix("abz", mbd), MBError::SUCCESS);
+    EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len), "ab");
+    mbd.Clear();
+    EXPECT_EQ(sdb.FindLongestPrefix("xyz", mbd), MBError::NOT_EXIST);
+
+    std::vector<ShardedKV> kvs;
+    EXPECT_EQ(sdb.FindByPrefix("ab", kvs), MBError::SUCCESS);
+    ASSERT_EQ(kvs.size(), 4u);
+    EXPECT_EQ(kvs[0].key, "ab");
+    EXPECT_EQ(kvs[1].key, "abcd");
+    EXPECT_EQ(kvs[2].key, "abcdef");
+    EXPECT_EQ(kvs[3].key, "abx");
+    EXPECT_EQ(kvs[3].value, "abx");
+
+    EXPECT_EQ(sdb.FindByPrefix("prefix_", kvs), MBError::SUCCESS);
+    EXPECT_EQ(kvs.size(), 100u);
+    EXPECT_EQ(sdb.FindByPrefix("prefix_", kvs, 10), MBError::SUCCESS);
+    ASSERT_EQ(kvs.size(), 10u);
+    EXPECT_EQ(kvs[0].key, "prefix_0");
+    EXPECT_EQ(kvs[1].key, "prefix_1");
+    EXPECT_EQ(kvs[2].key, "prefix_10");
+    EXPECT_EQ(sdb.FindByPrefix("zzz", kvs), MBError::SUCCESS);
+    EXPECT_EQ(kvs.size(), 0u);
+    sdb.Close();
+}
+
+TEST_F(ShardedDBTest, range_shard_test)
+{
+    std::vector<std::string> split_keys;
+    split_keys.push_back("g");
+    split_keys.push_back("p");
+
+    // Number of split keys must match the number of shards.
+    ShardedDB bad_sdb(mbconf, 4, split_keys);
+    EXPECT_EQ(bad_sdb.Status(), MBError::INVALID_ARG);
+
+    ShardedDB sdb(mbconf, 3, split_keys);
+    ASSERT_EQ(sdb.Status(), MBError::SUCCESS);
+    EXPECT_EQ(sdb.GetShard("apple"), 0);
+    EXPECT_EQ(sdb.GetShard("g"), 1);
+    EXPECT_EQ(sdb.GetShard("orange"), 1);
+    EXPECT_EQ(sdb.GetShard("pear"), 2);
+    EXPECT_EQ(sdb.GetShard("zoo"), 2);
+
+    const char *keys[] = {"zoo", "apple", "pear", "grape", "orange", "banana", "melon"};
+    for(int i = 0; i < 7; i++)
+        EXPECT_EQ(sdb.AddAsync(keys[i], keys[i]), MBError::SUCCESS);
+    EXPECT_EQ(sdb.Wait(), MBError::SUCCESS);
+
+    // Readers must use the same partitioning.
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    ShardedDB hash_reader(mbconf, 3);
+    EXPECT_EQ(hash_reader.Status(), MBError::INVALID_ARG);
+    ShardedDB reader(mbconf, 3, split_keys);
+    ASSERT_EQ(reader.Status(), MBError::SUCCESS);
+    EXPECT_EQ(reader.AddAsync("kiwi", "kiwi"), MBError::NOT_ALLOWED);
+
+    const char *sorted_keys[] = {"apple", "banana", "grape", "melon", "orange", "pear", "zoo"};
+    int count = 0;
+    for(ShardedDB::iterator iter = reader.begin(); iter != reader.end(); ++iter) {
+        ASSERT_LT(count, 7);
+        EXPECT_EQ(iter.key, sorted_keys[count]);
+        count++;
+    }
+    EXPECT_EQ(count, 7);
+    EXPECT_EQ(reader.Count(), 7);
+
+    // Reader sees changes made by writer.
+    EXPECT_EQ(sdb.Add("kiwi", "kiwi"), MBError::SUCCESS);
+    MBData mbd;
+    EXPECT_EQ(reader.Find("kiwi", mbd), MBError::SUCCESS);
+
+    // Keys with the prefix span the shards starting at the split keys.
+    EXPECT_EQ(sdb.Add("g", "g"), MBError::SUCCESS);
+    EXPECT_EQ(sdb.Add("gaa", "gaa"), MBError::SUCCESS);
+    EXPECT_EQ(sdb.Add("ga", "ga"), MBError::SUCCESS);
+    std::vector<ShardedKV> kvs;
+    EXPECT_EQ(reader.FindByPrefix("g", kvs), MBError::SUCCESS);
+    ASSERT_EQ(kvs.size(), 4u);
+    EXPECT_EQ(kvs[0].key, "g");
+    EXPECT_EQ(kvs[1].key, "ga");
+    EXPECT_EQ(kvs[2].key, "gaa");
+    EXPECT_EQ(kvs[3].key, "grape");
+    EXPECT_EQ(kvs[3].value, "grape");
+    EXPECT_EQ(reader.FindByPrefix("", kvs), MBError::SUCCESS);
+    EXPECT_EQ(kvs.size(), 11u);
+
+    reader.Close();
+    sdb.Close();
+}
+
+TEST_F(ShardedDBTest, prefix_iterator_test)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_128);
+    std::set<std::string> keys;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    for(int i = 0; i < 2000; i++) {
+        std::string key = tkey.get_key(i);
+        EXPECT_EQ(db.Add(key, key), MBError::SUCCESS);
+        keys.insert(key);
+    }
+    EXPECT_EQ(db.Add("ab", "ab"), MBError::SUCCESS);
+    keys.insert("ab");
+
+    // Entries are returned in key order.
+    std::set<std::string>::iterator it = keys.begin();
+    for(DB::iterator iter = db.begin_prefix(""); iter != db.end(); ++iter) {
+        ASSERT_TRUE(it != keys.end());
+        EXPECT_EQ(iter.key, *it);
+        EXPECT_EQ(std::string((const char *) iter.value.buff, iter.value.data_len), *it);
+        ++it;
+    }
+    EXPECT_TRUE(it == keys.end());
+
+    const char *prefixes[] = {"a", "ab", "3f", "3f2", "zz"};
+    for(int i = 0; i < 5; i++) {
+        std::string prefix = prefixes[i];
+        std::vector<std::string> expected;
+        for(it = keys.lower_bound(prefix); it != keys.end(); ++it) {
+            if(it->compare(0, prefix.size(), prefix) != 0)
+                break;
+            expected.push_back(*it);
+        }
+        std::vector<std::string> found;
+        for(DB::iterator iter = db.begin_prefix(prefix); iter != db.end(); ++iter)
+            found.push_back(iter.key);
+        EXPECT_EQ(found, expected);
+    }
+    db.Close();
+}
+
+}
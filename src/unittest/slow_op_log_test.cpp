@@ -0,0 +1,135 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <set>
+#include <string>
+#include <vector>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+#include "../util/crc32c.h"
+
+using namespace mabain;
+
+namespace {
+
+#define SLOW_OP_TEST_DIR "/var/tmp/mabain_test/"
+
+class SlowOpLogTest : public ::testing::Test
+{
+public:
+    SlowOpLogTest() {
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~SlowOpLogTest() {
+    }
+
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + SLOW_OP_TEST_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -rf ") + SLOW_OP_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = SLOW_OP_TEST_DIR;
+        mbconf.block_size_data = 4*1024*1024;
+        mbconf.memcap_index = 16*1024*1024;
+        mbconf.memcap_data = 4*1024*1024;
+    }
+    virtual void TearDown() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("rm -rf ") + SLOW_OP_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+    }
+
+protected:
+    MBConfig mbconf;
+};
+
+TEST_F(SlowOpLogTest, slow_find_test)
+{
+    std::vector<SlowOp> slow_ops;
+    MBData mbd;
+    int num = 10000;
+    std::string value(1000, 'v');
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    EXPECT_EQ(db.GetSlowOps(slow_ops), MBError::NOT_EXIST);
+    for(int i = 0; i < num; i++)
+        EXPECT_EQ(db.Add("slow_op_key_" + std::to_string(i), value), MBError::SUCCESS);
+
+    // Only the first data block is memory mapped so that values of the
+    // last keys are read using pread. The threshold of one microsecond logs
+    // almost every find.
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    mbconf.slow_op_threshold_us = 1;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    for(int i = 0; i < num; i++)
+        EXPECT_EQ(db_r.Find("slow_op_key_" + std::to_string(i), mbd), MBError::SUCCESS);
+    EXPECT_EQ(db_r.Find("slow_op_key", mbd), MBError::NOT_EXIST);
+
+    EXPECT_EQ(db_r.GetSlowOps(slow_ops), MBError::SUCCESS);
+    ASSERT_GT(slow_ops.size(), 0u);
+    EXPECT_LE(slow_ops.size(), static_cast<size_t>(MB_SLOW_OP_LOG_SIZE));
+    for(size_t i = 0; i < slow_ops.size(); i++)
+    {
+        EXPECT_EQ(slow_ops[i].op, MB_STATS_OP_FIND);
+        EXPECT_GE(slow_ops[i].latency_ns, 1000u);
+    }
+
+#ifdef __SLOW_OP_LOG__
+    // The cost is only counted if the library is built with __SLOW_OP_LOG__.
+    int num_sys_read_op = 0;
+    for(size_t i = 0; i < slow_ops.size(); i++)
+    {
+        const SlowOp &slow_op = slow_ops[i];
+        EXPECT_GT(slow_op.cost.hops, 0u);
+        if(slow_op.cost.copy_bytes > 0)
+        {
+            EXPECT_EQ(slow_op.cost.copy_bytes, value.size());
+        }
+        if(slow_op.cost.sys_reads > 0)
+            num_sys_read_op++;
+    }
+    EXPECT_GT(num_sys_read_op, 0);
+#endif
+
+    std::set<uint32_t> key_hashes;
+    key_hashes.insert(crc32c(0, "slow_op_key", 11));
+    for(int i = 0; i < num; i++)
+    {
+        std::string key = "slow_op_key_" + std::to_string(i);
+        key_hashes.insert(crc32c(0, key.data(), key.size()));
+    }
+    for(size_t i = 0; i < slow_ops.size(); i++)
+        EXPECT_EQ(key_hashes.count(slow_ops[i].key_hash), 1u);
+
+    db_r.Close();
+    db.Close();
+}
+
+}
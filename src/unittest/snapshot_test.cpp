@@ -0,0 +1,180 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string>
+#include <string.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define SNAPSHOT_TEST_DIR "/var/tmp/mabain_test/"
+#define SNAPSHOT_DIR "/var/tmp/mabain_snapshot/"
+#define ONE_MEGA 1024*1024ul
+
+class SnapshotTest : public ::testing::Test
+{
+public:
+    SnapshotTest() {
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~SnapshotTest() {
+    }
+
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + SNAPSHOT_TEST_DIR + " " + SNAPSHOT_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -rf ") + SNAPSHOT_TEST_DIR + "_* " + SNAPSHOT_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = SNAPSHOT_TEST_DIR;
+        mbconf.block_size_index = 4*ONE_MEGA;
+        mbconf.block_size_data = 4*ONE_MEGA;
+        mbconf.memcap_index = 8*ONE_MEGA;
+        mbconf.memcap_data = 8*ONE_MEGA;
+    }
+    virtual void TearDown() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("rm -rf ") + SNAPSHOT_TEST_DIR + "_* " + SNAPSHOT_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+    }
+
+    // Modify the DB while the snapshot is being copied.
+    void ModifyDB(DB &db, TestKey &tkey, int num) {
+        std::string key;
+        for(int i = 0; i < num; i += 3) {
+            key = tkey.get_key(i);
+            EXPECT_EQ(db.Add(key, key + "_new", true), MBError::SUCCESS);
+        }
+        for(int i = 1; i < num; i += 3) {
+            key = tkey.get_key(i);
+            EXPECT_EQ(db.Remove(key), MBError::SUCCESS);
+        }
+        for(int i = num; i < 2*num; i++) {
+            key = tkey.get_key(i);
+            EXPECT_EQ(db.Add(key, key), MBError::SUCCESS);
+        }
+    }
+
+    // Snapshot must hold the original keys only.
+    void CheckSnapshot(TestKey &tkey, int num) {
+        MBConfig snap_conf = mbconf;
+        snap_conf.mbdir = SNAPSHOT_DIR;
+        snap_conf.options = CONSTS::ACCESS_MODE_READER;
+        DB db_snap(snap_conf);
+        ASSERT_TRUE(db_snap.is_open());
+        EXPECT_EQ(db_snap.Count(), num);
+
+        MBData mbd;
+        std::string key;
+        for(int i = 0; i < 2*num; i++) {
+            key = tkey.get_key(i);
+            int rval = db_snap.Find(key, mbd);
+            if(i >= num) {
+                EXPECT_EQ(rval, MBError::NOT_EXIST);
+                continue;
+            }
+            EXPECT_EQ(rval, MBError::SUCCESS);
+            EXPECT_EQ(std::string((const char *) mbd.buff, mbd.data_len), key);
+        }
+        int count = 0;
+        for(DB::iterator iter = db_snap.begin(); iter != db_snap.end(); ++iter)
+            count++;
+        EXPECT_EQ(count, num);
+        db_snap.Close();
+    }
+
+protected:
+    MBConfig mbconf;
+};
+
+TEST_F(SnapshotTest, snapshot_test)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    std::string key;
+    int num = 30000;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    EXPECT_EQ(db.WaitSnapshot(), MBError::NOT_EXIST);
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db.Add(key, key), MBError::SUCCESS);
+    }
+    // Release some buffers before the snapshot.
+    for(int i = 0; i < num; i += 10) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db.Remove(key), MBError::SUCCESS);
+        EXPECT_EQ(db.Add(key, key), MBError::SUCCESS);
+    }
+
+    EXPECT_EQ(db.Snapshot(SNAPSHOT_DIR), MBError::SUCCESS);
+    ModifyDB(db, tkey, num);
+    EXPECT_EQ(db.WaitSnapshot(), MBError::SUCCESS);
+    // Snapshot directory must be empty.
+    EXPECT_EQ(db.Snapshot(SNAPSHOT_DIR), MBError::OPEN_FAILURE);
+
+    CheckSnapshot(tkey, num);
+    EXPECT_EQ(db.Count(), 2*num - (num + 1)/3);
+    db.Close();
+}
+
+TEST_F(SnapshotTest, async_snapshot_test)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    std::string key;
+    int num = 30000;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::ASYNC_WRITER_MODE;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    ASSERT_EQ(db_r.SetAsyncWriterPtr(&db), MBError::SUCCESS);
+
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db_r.Add(key, key), MBError::SUCCESS);
+    }
+    EXPECT_EQ(db_r.Snapshot(SNAPSHOT_DIR), MBError::SUCCESS);
+    ModifyDB(db_r, tkey, num);
+    EXPECT_EQ(db_r.WaitSnapshot(), MBError::SUCCESS);
+    while(db_r.AsyncWriterBusy())
+        usleep(10);
+
+    CheckSnapshot(tkey, num);
+    EXPECT_EQ(db_r.UnsetAsyncWriterPtr(&db), MBError::SUCCESS);
+    db_r.Close();
+    db.Close();
+}
+
+}
@@ -0,0 +1,259 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mb_data.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+#define MB_DIR "/var/tmp/mabain_test/"
+
+using namespace mabain;
+
+namespace {
+
+class TTLTest : public ::testing::Test
+{
+public:
+    TTLTest() {
+        db = NULL;
+    }
+    virtual ~TTLTest() {
+        if(db != NULL)
+            delete db;
+    }
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + MB_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm ") + MB_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        db = new DB(MB_DIR, CONSTS::WriterOptions());
+        assert(db->is_open());
+    }
+    virtual void TearDown() {
+        db->Close();
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    // Add an entry which expired a second ago.
+    int AddExpired(const std::string &key, const std::string &value,
+                   bool overwrite = false) {
+        MBData mbd;
+        mbd.buff = (uint8_t *) value.data();
+        mbd.data_len = value.size();
+        mbd.expire_time = (uint32_t) time(NULL) - 1;
+        int rval = db->Add(key.data(), key.size(), mbd, overwrite);
+        mbd.buff = NULL;
+        return rval;
+    }
+
+protected:
+    DB *db;
+};
+
+TEST_F(TTLTest, find_expired)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    int num = 1000;
+    std::string key;
+    MBData mbd;
+
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        if(i % 2 == 0) {
+            EXPECT_EQ(AddExpired(key, key), MBError::SUCCESS);
+        } else {
+            EXPECT_EQ(db->AddWithTTL(key.data(), key.size(), key.data(), key.size(), 3600),
+                      MBError::SUCCESS);
+        }
+    }
+    EXPECT_EQ(db->Count(), num);
+
+    DB db_r(MB_DIR, CONSTS::ReaderOptions());
+    EXPECT_TRUE(db_r.is_open());
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        if(i % 2 == 0) {
+            EXPECT_EQ(db->Find(key, mbd), MBError::NOT_EXIST);
+            EXPECT_EQ(db_r.Find(key, mbd), MBError::NOT_EXIST);
+        } else {
+            EXPECT_EQ(db_r.Find(key, mbd), MBError::SUCCESS);
+            EXPECT_EQ(std::string((const char *)mbd.buff, mbd.data_len), key);
+            EXPECT_GT(mbd.expire_time, (uint32_t) time(NULL));
+        }
+    }
+
+    int count = 0;
+    for(DB::iterator iter = db_r.begin(); iter != db_r.end(); ++iter) {
+        EXPECT_NE(iter.value.expire_time, 0u);
+        count++;
+    }
+    EXPECT_EQ(count, num/2);
+    db_r.Close();
+}
+
+TEST_F(TTLTest, reclaim_expired)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_128);
+    int num = 2000;
+    std::string key;
+    MBData mbd;
+
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        if(i % 4 == 0) {
+            EXPECT_EQ(db->Add(key, key), MBError::SUCCESS);
+        } else {
+            EXPECT_EQ(AddExpired(key, key), MBError::SUCCESS);
+        }
+    }
+    // Overwritten without expiry time; these must not be reclaimed.
+    for(int i = 1; i < num; i += 4) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db->Add(key, key + "_new", true), MBError::SUCCESS);
+    }
+    EXPECT_EQ(db->Count(), num);
+
+    // Removal is bounded by batch size.
+    EXPECT_EQ(db->ReclaimExpired(100), MBError::SUCCESS);
+    EXPECT_EQ(db->Count(), num - 100);
+    EXPECT_EQ(db->ReclaimExpired(), MBError::SUCCESS);
+    EXPECT_EQ(db->Count(), num / 2);
+
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        if(i % 4 == 0) {
+            EXPECT_EQ(db->Find(key, mbd), MBError::SUCCESS);
+            EXPECT_EQ(std::string((const char *)mbd.buff, mbd.data_len), key);
+        } else if(i % 4 == 1) {
+            EXPECT_EQ(db->Find(key, mbd), MBError::SUCCESS);
+            EXPECT_EQ(std::string((const char *)mbd.buff, mbd.data_len), key + "_new");
+            EXPECT_EQ(mbd.expire_time, 0u);
+        } else {
+            EXPECT_EQ(db->Find(key, mbd), MBError::NOT_EXIST);
+            EXPECT_EQ(db->Remove(key), MBError::NOT_EXIST);
+        }
+    }
+}
+
+TEST_F(TTLTest, resource_collection)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    int num = 5000;
+    std::string key;
+    MBData mbd;
+
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db->AddWithTTL(key.data(), key.size(), key.data(), key.size(), 3600),
+                  MBError::SUCCESS);
+    }
+    for(int i = 0; i < num; i += 2) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db->Remove(key), MBError::SUCCESS);
+    }
+
+    db->CollectResource(1, 1);
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        if(i % 2 == 0) {
+            EXPECT_EQ(db->Find(key, mbd), MBError::NOT_EXIST);
+        } else {
+            EXPECT_EQ(db->Find(key, mbd), MBError::SUCCESS);
+            EXPECT_EQ(std::string((const char *)mbd.buff, mbd.data_len), key);
+            EXPECT_NE(mbd.expire_time, 0u);
+        }
+    }
+}
+
+TEST_F(TTLTest, writer_restart)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    int num = 3000;
+    std::string key;
+    MBData mbd;
+
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        if(i % 3 == 0) {
+            EXPECT_EQ(db->Add(key, key), MBError::SUCCESS);
+        } else if(i % 3 == 1) {
+            EXPECT_EQ(AddExpired(key, key), MBError::SUCCESS);
+        } else {
+            EXPECT_EQ(db->AddWithTTL(key.data(), key.size(), key.data(), key.size(), 3600),
+                      MBError::SUCCESS);
+        }
+    }
+
+    // Expired entries are only visible to iterators that include them.
+    int count = 0;
+    for(DB::iterator iter = db->begin(false, false, true); iter != db->end(); ++iter)
+        count++;
+    EXPECT_EQ(count, num);
+
+    // Entries added by the old writer are removed by the new writer.
+    db->Close();
+    delete db;
+    db = new DB(MB_DIR, CONSTS::WriterOptions());
+    ASSERT_TRUE(db->is_open());
+    EXPECT_EQ(db->Count(), num);
+    EXPECT_EQ(db->ReclaimExpired(num), MBError::SUCCESS);
+    EXPECT_EQ(db->Count(), num - num / 3);
+
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        if(i % 3 == 1) {
+            EXPECT_EQ(db->Find(key, mbd), MBError::NOT_EXIST);
+        } else {
+            EXPECT_EQ(db->Find(key, mbd), MBError::SUCCESS);
+            EXPECT_EQ(std::string((const char *)mbd.buff, mbd.data_len), key);
+        }
+    }
+}
+
+TEST_F(TTLTest, sweep_cursor)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    int num = 1000;
+    std::string key;
+
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(AddExpired(key, key), MBError::SUCCESS);
+    }
+    // Entries are removed in key order.
+    EXPECT_EQ(db->ReclaimExpired(100), MBError::SUCCESS);
+    EXPECT_EQ(db->Count(), num - 100);
+    std::vector<std::string> remaining;
+    for(DB::iterator iter = db->begin(false, false, true); iter != db->end(); ++iter)
+        remaining.push_back(iter.key);
+    std::sort(remaining.begin(), remaining.end());
+    ASSERT_EQ((int) remaining.size(), num - 100);
+
+    // The new writer continues after the keys removed by the old writer.
+    db->Close();
+    delete db;
+    db = new DB(MB_DIR, CONSTS::WriterOptions());
+    ASSERT_TRUE(db->is_open());
+    EXPECT_EQ(db->ReclaimExpired(100), MBError::SUCCESS);
+    EXPECT_EQ(db->Count(), num - 200);
+    int count = 0;
+    for(DB::iterator iter = db->begin(false, false, true); iter != db->end(); ++iter) {
+        EXPECT_GE(iter.key, remaining[100]);
+        count++;
+    }
+    EXPECT_EQ(count, num - 200);
+
+    // The sweep wraps around after the last key.
+    EXPECT_EQ(db->ReclaimExpired(num), MBError::SUCCESS);
+    EXPECT_EQ(db->Count(), 0);
+}
+
+}
@@ -0,0 +1,136 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mb_warmup.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define WARMUP_TEST_DIR "/var/tmp/mabain_test/"
+#define ONE_MEGA 1024*1024ul
+
+class WarmupTest : public ::testing::Test
+{
+public:
+    WarmupTest() {
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~WarmupTest() {
+    }
+
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + WARMUP_TEST_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -rf ") + WARMUP_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = WARMUP_TEST_DIR;
+        mbconf.block_size_index = 4*ONE_MEGA;
+        mbconf.block_size_data = 4*ONE_MEGA;
+        mbconf.memcap_index = 64*ONE_MEGA;
+        mbconf.memcap_data = 64*ONE_MEGA;
+    }
+    virtual void TearDown() {
+        ResourcePool::getInstance().RemoveAll();
+        std::string cmd = std::string("rm -rf ") + WARMUP_TEST_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+    }
+
+    // Wait at most 10 seconds for warmup to finish.
+    int WaitForWarmup(DB &db) {
+        int progress = db.GetWarmupProgress();
+        for(int i = 0; i < 1000 && progress < 100; i++) {
+            usleep(10000);
+            progress = db.GetWarmupProgress();
+        }
+        return progress;
+    }
+
+protected:
+    MBConfig mbconf;
+};
+
+TEST_F(WarmupTest, region_test)
+{
+    size_t size = 10*ONE_MEGA + 4096;
+    uint8_t *addr = (uint8_t *) mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_TRUE(addr != MAP_FAILED);
+
+    DBWarmup warmup(CONSTS::WARMUP_INDEX | CONSTS::WARMUP_HUGEPAGE, 3);
+    EXPECT_EQ(warmup.GetProgress(), 100);
+    warmup.AddRegion(addr, size);
+    EXPECT_EQ(warmup.GetProgress(), 0);
+    EXPECT_EQ(warmup.Start(), MBError::SUCCESS);
+    for(int i = 0; i < 1000 && warmup.GetProgress() < 100; i++)
+        usleep(10000);
+    EXPECT_EQ(warmup.GetProgress(), 100);
+    warmup.Stop();
+
+    munmap(addr, size);
+}
+
+TEST_F(WarmupTest, db_warmup_test)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    std::string key;
+    MBData mbd;
+    int num = 50000;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    DB db(mbconf);
+    ASSERT_TRUE(db.is_open());
+    EXPECT_EQ(db.GetWarmupProgress(), 100);
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db.Add(key, key), MBError::SUCCESS);
+    }
+    db.Close();
+    ResourcePool::getInstance().RemoveAll();
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    mbconf.warmup_options = CONSTS::WARMUP_INDEX | CONSTS::WARMUP_DATA | CONSTS::WARMUP_MLOCK;
+    mbconf.warmup_threads = 4;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    EXPECT_EQ(WaitForWarmup(db_r), 100);
+
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db_r.Find(key, mbd), MBError::SUCCESS);
+        EXPECT_EQ(std::string((const char *)mbd.buff, mbd.data_len), key);
+    }
+    db_r.Close();
+}
+
+}
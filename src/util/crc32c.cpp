@@ -0,0 +1,90 @@
+/**
+ * Copyright (C) 2018 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+#include "crc32c.h"
+
+// reflected CRC32C polynomial
+#define CRC32C_POLY 0x82F63B78
+
+namespace mabain {
+
+static uint32_t crc32c_table[256];
+
+static void init_crc32c_table()
+{
+    for(uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for(int j = 0; j < 8; j++)
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        crc32c_table[i] = crc;
+    }
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t *ptr, size_t len)
+{
+    while(len-- > 0)
+        crc = crc32c_table[(crc ^ *ptr++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *ptr, size_t len)
+{
+    uint64_t crc64 = crc;
+    uint64_t val;
+    while(len >= sizeof(val))
+    {
+        memcpy(&val, ptr, sizeof(val));
+        crc64 = _mm_crc32_u64(crc64, val);
+        ptr += sizeof(val);
+        len -= sizeof(val);
+    }
+    crc = static_cast<uint32_t>(crc64);
+    while(len-- > 0)
+        crc = _mm_crc32_u8(crc, *ptr++);
+    return crc;
+}
+#endif
+
+typedef uint32_t (*crc32c_func)(uint32_t crc, const uint8_t *ptr, size_t len);
+
+static crc32c_func select_crc32c()
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse4.2"))
+        return crc32c_hw;
+#endif
+    init_crc32c_table();
+    return crc32c_sw;
+}
+
+uint32_t crc32c(uint32_t crc, const void *buff, size_t len)
+{
+    static const crc32c_func crc_func = select_crc32c();
+    return ~crc_func(~crc, static_cast<const uint8_t *>(buff), len);
+}
+
+}
@@ -21,14 +21,21 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/mman.h>
 
 #include "error.h"
+#include "file_io.h"
 
 namespace mabain {
 
-int acquire_writer_lock(const std::string &lock_file_path)
+int acquire_writer_lock(const std::string &lock_file_path, bool shm)
 {
-    int fd = open(lock_file_path.c_str(), O_WRONLY | O_CREAT,
+    int fd;
+    if(shm)
+        fd = shm_open(FileIO::ShmName(lock_file_path).c_str(), O_RDWR | O_CREAT,
+                      S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    else
+        fd = open(lock_file_path.c_str(), O_WRONLY | O_CREAT,
                   S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
     if(fd < 0)
     {
@@ -23,7 +23,8 @@
 
 namespace mabain {
 
-int  acquire_writer_lock(const std::string &lock_file_path);
+// The lock file is a POSIX shared memory object if shm is true.
+int  acquire_writer_lock(const std::string &lock_file_path, bool shm = false);
 void release_writer_lock(int &fd);
 
 }